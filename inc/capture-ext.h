@@ -0,0 +1,47 @@
+/**
+ * Filename: capture-ext.h
+ * Description: abs-capture-time RTP header extension
+ * Created: Fri Oct 16 13:05:40 2026 (-0700)
+ * Version: 1.0
+ */
+
+/**
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef _CAPTURE_EXT_H_
+#define _CAPTURE_EXT_H_
+
+#include <gst/gst.h>
+
+/**
+ * abs-capture-time, RFC 8285 one-byte header form:
+ *  - Only the 64 bit NTP capture timestamp is sent, on the last packet of
+ *    each frame
+ *  - CAPTURE_EXT_BYTES: What it adds to a packet (0xBEDE header, id/len
+ *    byte and padding included), taken off the payloader's MTU
+ */
+#define CAPTURE_EXT_URI \
+	"http://www.webrtc.org/experiments/rtp-hdrext/abs-capture-time"
+#define CAPTURE_EXT_ID    1
+#define CAPTURE_EXT_BYTES 16
+
+gulong capture_ext_attach(GstElement *pay);
+guint8 capture_ext_find_id(const GstCaps *caps);
+gboolean capture_ext_read(GstBuffer *buf, guint8 id, gint64 *wall_us);
+
+#endif  /* _CAPTURE_EXT_H_ */
+
+/* capture-ext.h ends here */
@@ -0,0 +1,49 @@
+/**
+ * Filename: clip.h
+ * Description: MP4 clips remuxed from the timeshift ring
+ * Created: Thu Oct 22 14:03:27 2026 (-0700)
+ * Version: 1.0
+ */
+
+/**
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef _CLIP_H_
+#define _CLIP_H_
+
+#include <timeshift.h>
+
+#include <gst/gst.h>
+
+/**
+ * Clips:
+ *  - CLIP_MUX_TIMEOUT: Longest the muxer may take for any output buffer
+ */
+#define CLIP_MUX_TIMEOUT (5 * GST_SECOND)
+
+struct clip_result {
+	guint frames;		/* In the clip */
+	gint64 start;		/* Monotonic time of its first (key) frame */
+	gint64 end;		/* And of its last */
+	gint64 mux_us;		/* Time spent remuxing */
+};
+
+GBytes *clip_export(struct timeshift *ts, gint64 from, gint64 to,
+		    gint64 deadline, struct clip_result *res);
+
+#endif  /* _CLIP_H_ */
+
+/* clip.h ends here */
@@ -0,0 +1,52 @@
+/**
+ * Filename: encoder.h
+ * Description: Map encoder controls onto the properties of each backend
+ * Created: Tue Oct 13 09:12:33 2026 (-0700)
+ * Version: 1.0
+ */
+
+/**
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef _ENCODER_H_
+#define _ENCODER_H_
+
+#include <gst/gst.h>
+
+/**
+ * Encoder controls, all integers:
+ *  - ENC_BITRATE:     Target bitrate in kbps
+ *  - ENC_QUANT:       Constant quantizer (0 = best)
+ *  - ENC_IDR:         Frames between IDR frames
+ *  - ENC_SLICE_BYTES: Max encoded bytes per slice (0 = one slice per frame)
+ *  - ENC_BFRAMES:     B-frames between references
+ *  - ENC_LOOKAHEAD:   Frames of rate control lookahead
+ *  - ENC_INTRA_REFRESH: Frames per intra refresh cycle, which replaces
+ *                       periodic IDRs (0 = off)
+ */
+enum enc_ctl {ENC_BITRATE=0, ENC_QUANT, ENC_IDR, ENC_SLICE_BYTES,
+	      ENC_BFRAMES, ENC_LOOKAHEAD, ENC_INTRA_REFRESH};
+#define NUM_ENC_CTL (ENC_INTRA_REFRESH + 1)
+
+gboolean enc_supports(GstElement *enc, enum enc_ctl ctl);
+gboolean enc_set(GstElement *enc, enum enc_ctl ctl, gint val);
+gboolean enc_live(GstElement *enc, enum enc_ctl ctl);
+gboolean enc_force_idr(GstElement *enc);
+const char *enc_ctl_str(enum enc_ctl ctl);
+
+#endif  /* _ENCODER_H_ */
+
+/* encoder.h ends here */
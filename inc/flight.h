@@ -0,0 +1,62 @@
+/**
+ * Filename: flight.h
+ * Description: Always-on in-memory flight recorder
+ * Created: Sat Oct 17 09:14:55 2026 (-0700)
+ * Version: 1.0
+ */
+
+/**
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef _FLIGHT_H_
+#define _FLIGHT_H_
+
+#include <glib.h>
+
+/* Events kept, power of 2. ~3 minutes at the usual event rate */
+#define FLIGHT_SIZE 4096
+
+/**
+ * Events and what their arguments mean:
+ *  - FLIGHT_CLIENT_CONNECT/CLOSE: clients after the change
+ *  - FLIGHT_MEDIA_CONFIGURE:      clients
+ *  - FLIGHT_BITRATE/QUANT/FEC:    old, new, clients
+ *  - FLIGHT_IDR:                  old, new interval in frames, clients
+ *  - FLIGHT_BUS_WARNING/ERROR:    text is 'element: message'
+ *  - FLIGHT_STAGE_FPS:            stage, frames in the last second
+ *  - FLIGHT_QUEUE_LEVEL:          buffers, bytes, text is the queue name
+ *  - FLIGHT_WATCHDOG:             seconds without a frame at pay0
+ *  - FLIGHT_RATE_SCALE:           old, new encoder bitrate scale and
+ *                                 actual/target ratio, all in percent
+ *  - FLIGHT_MOTION:               still, score x100, clients
+ *  - FLIGHT_TIMESHIFT:            speed x100, text is the PLAY Range
+ *  - FLIGHT_CLIP:                 frames, remux ms, clip ms, text is t
+ *  - FLIGHT_DUMP:                 reason for the dump (in text)
+ */
+enum flight_event {FLIGHT_CLIENT_CONNECT=0, FLIGHT_CLIENT_CLOSE,
+		   FLIGHT_MEDIA_CONFIGURE, FLIGHT_BITRATE, FLIGHT_QUANT,
+		   FLIGHT_FEC, FLIGHT_BUS_WARNING, FLIGHT_BUS_ERROR,
+		   FLIGHT_STAGE_FPS, FLIGHT_QUEUE_LEVEL, FLIGHT_WATCHDOG,
+		   FLIGHT_DUMP, FLIGHT_RATE_SCALE, FLIGHT_MOTION,
+		   FLIGHT_IDR, FLIGHT_TIMESHIFT, FLIGHT_CLIP};
+
+void flight_record(enum flight_event ev, gint a, gint b, gint c,
+		   const char *text);
+gchar *flight_dump(const char *dir, gint secs, const char *reason);
+
+#endif  /* _FLIGHT_H_ */
+
+/* flight.h ends here */
@@ -0,0 +1,76 @@
+/**
+ * Filename: history.h
+ * Description: Fixed memory statistics history with 1s/1m/1h rollups
+ * Created: Sat Oct 17 13:02:31 2026 (-0700)
+ * Version: 1.0
+ */
+
+/**
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef _HISTORY_H_
+#define _HISTORY_H_
+
+#include <glib.h>
+
+/**
+ * Samples are added once a second and kept at three resolutions, each
+ * point holding the average and max of the samples it covers:
+ *  - HIST_1S: 1 second for 10 minutes
+ *  - HIST_1M: 1 minute for 24 hours
+ *  - HIST_1H: 1 hour for 30 days
+ */
+enum hist_res {HIST_1S=0, HIST_1M, HIST_1H};
+#define NUM_HIST_RES (HIST_1H + 1)
+
+enum hist_metric {HIST_CLIENTS=0, HIST_BITRATE, HIST_QUANT, HIST_FPS,
+		  HIST_EGRESS, HIST_LOSS, HIST_PSNR, HIST_SSIM,
+		  HIST_MOTION};
+#define NUM_HIST_METRIC (HIST_MOTION + 1)
+
+struct hist_point {
+	gint64 t;		/* Start, unix seconds */
+	gfloat avg[NUM_HIST_METRIC];
+	gfloat max[NUM_HIST_METRIC];
+};
+
+struct hist_ring {
+	gint period;		/* Seconds per point */
+	guint size;		/* Points kept */
+	guint head;		/* Next point to write */
+	guint count;		/* Points written, up to size */
+	struct hist_point *pt;
+	/* The point being built */
+	gint64 acc_t;
+	guint acc_n;
+	gdouble acc_sum[NUM_HIST_METRIC];
+	gfloat acc_max[NUM_HIST_METRIC];
+};
+
+struct history {
+	GMutex lock;		/* Added to from the main loop, read by HTTP */
+	struct hist_ring ring[NUM_HIST_RES];
+};
+
+struct history *history_new(void);
+void history_add(struct history *h, gint64 t,
+		 const gfloat val[NUM_HIST_METRIC]);
+gchar *history_json(struct history *h, enum hist_res res, gint64 since);
+gboolean history_parse_res(const char *str, enum hist_res *res);
+
+#endif  /* _HISTORY_H_ */
+
+/* history.h ends here */
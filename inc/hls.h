@@ -0,0 +1,121 @@
+/**
+ * Filename: hls.h
+ * Description: HLS and Low-Latency HLS of the encoded stream, from memory
+ * Created: Fri Oct 23 10:26:54 2026 (-0700)
+ * Version: 1.0
+ */
+
+/**
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef _HLS_H_
+#define _HLS_H_
+
+#include <http.h>
+
+#include <gst/gst.h>
+
+/**
+ * HLS:
+ *  - HLS_SEGMENTS: Finished segments listed, and kept, besides the open one
+ *  - HLS_PART_SEGMENTS: Last segments whose parts are listed too
+ *  - HLS_QUEUE_MAX: Bytes of frames waiting for the segmenter. Beyond it
+ *                   frames are dropped up to the next key frame.
+ *  - HLS_WAIT: Longest (us) the segmenter waits for a frame
+ *  - HLS_VIEWER_SECS: A viewer that hasn't asked for anything this long
+ *                     has left
+ *  - HLS_TIMESCALE: Units of the fMP4 timestamps per second
+ *  - HLS_TARGET_SLACK: Seconds a segment may run past its length while
+ *                      the key frame asked for comes. The target
+ *                      duration is fixed at both, a segment reaching it
+ *                      is cut even without a key frame.
+ *  - HLS_MAX_BLOCKING: Requests that may wait for a part or playlist at
+ *                      once, beyond it they are answered right away so
+ *                      HLS can't take all of the HTTP threads
+ */
+#define HLS_SEGMENTS      4
+#define HLS_PART_SEGMENTS 2
+#define HLS_QUEUE_MAX     (4 << 20)
+#define HLS_WAIT          100000
+#define HLS_VIEWER_SECS   10
+#define HLS_TIMESCALE     90000
+#define HLS_TARGET_SLACK  1
+#define HLS_MAX_BLOCKING  (HTTP_MAX_THREADS / 4)
+
+/* Ask the encoder for a key frame, from the segmenter thread */
+typedef void (*hls_key_fn)(gpointer data);
+
+struct hls_au {
+	GstBuffer *buf;		/* A reference, not a copy */
+	GstCaps *caps;		/* Set when they changed */
+};
+
+struct hls_part {
+	GBytes *data;		/* moof and mdat */
+	guint32 duration;	/* In HLS_TIMESCALE units */
+	gboolean independent;	/* Starts with a key frame */
+};
+
+struct hls_segment {
+	guint64 msn;		/* Media sequence number */
+	guint init;		/* Init section it needs */
+	gboolean discont;	/* Init section changed with this one */
+	GPtrArray *parts;	/* hls_part, the segment is all of them */
+	guint64 duration;	/* Of the parts so far */
+	gboolean complete;	/* No more parts */
+};
+
+struct hls {
+	gint64 seg_len;		/* Segment target (HLS_TIMESCALE units) */
+	gint64 part_len;	/* Part target */
+	gint64 target_len;	/* Longest segment, EXT-X-TARGETDURATION */
+	hls_key_fn key_fn;
+	gpointer key_data;
+
+	/* Encoder's streaming thread */
+	GstCaps *caps;		/* Last caps queued */
+	gboolean need_key;	/* Dropping up to the next key frame */
+
+	GAsyncQueue *queue;	/* hls_au, to the segmenter */
+	gint queued;		/* Bytes in the queue (atomic) */
+	GThread *thread;
+	gint stop;		/* Segmenter should finish (atomic) */
+	gint blocking;		/* Requests that may wait (atomic) */
+
+	GMutex lock;		/* Everything below */
+	GCond changed;		/* A part or segment was added */
+	GQueue segments;	/* Oldest first, the last may be open */
+	guint64 next_msn;	/* Of the next segment */
+	guint discont_seq;	/* Discontinuities dropped off the front */
+	GPtrArray *inits;	/* GBytes init sections, by number */
+	GHashTable *viewers;	/* Address to last request (s) */
+
+	/* Counters since start (atomic) */
+	gint dropped;		/* Frames the segmenter was too slow for */
+	gint requests;
+};
+
+struct hls *hls_new(gint seg_secs, gint part_ms, hls_key_fn key_fn,
+		    gpointer key_data);
+gulong hls_attach(GstElement *enc, struct hls *hls);
+void hls_serve(struct hls *hls, struct http_request *req, const gchar *name);
+guint hls_viewers(struct hls *hls);
+void hls_held(struct hls *hls, guint *segments, guint64 *bytes);
+void hls_free(struct hls *hls);
+
+#endif  /* _HLS_H_ */
+
+/* hls.h ends here */
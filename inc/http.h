@@ -0,0 +1,80 @@
+/**
+ * Filename: http.h
+ * Description: Minimal threaded HTTP/1.0 server for local queries
+ * Created: Sat Oct 17 11:40:08 2026 (-0700)
+ * Version: 1.0
+ */
+
+/**
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef _HTTP_H_
+#define _HTTP_H_
+
+#include <gio/gio.h>
+
+/**
+ * HTTP server:
+ *  - Every connection gets its own thread from the GThreadedSocketService
+ *    pool, so handlers may block but must be thread safe
+ *  - One request per connection, the response closes it
+ *  - Handlers are matched on the path, a path ending in '/' matches
+ *    everything below it. Add them all before http_server_start().
+ */
+#define HTTP_MAX_HANDLERS 16
+#define HTTP_MAX_THREADS  32
+#define HTTP_HEADER_MAX   8192
+#define HTTP_BODY_MAX     65536
+
+struct http_request {
+	gchar *method;		/* GET, POST, ... */
+	gchar *path;		/* Without the query */
+	gchar *query;		/* After the '?', NULL if none */
+	gchar *remote;		/* Peer address */
+	gchar *body;		/* Content-Length bytes, NUL ended, or NULL */
+	gsize body_len;
+	GSocketConnection *conn;
+	GOutputStream *out;
+};
+
+typedef void (*http_handler_fn)(struct http_request *req, gpointer data);
+
+struct http_handler {
+	const char *path;
+	http_handler_fn fn;
+	gpointer data;
+};
+
+struct http_server {
+	GSocketService *service;
+	guint n;
+	struct http_handler h[HTTP_MAX_HANDLERS];
+};
+
+void http_server_add(struct http_server *hs, const char *path,
+		     http_handler_fn fn, gpointer data);
+gboolean http_server_start(struct http_server *hs, const char *addr,
+			   gint port);
+gboolean http_respond(struct http_request *req, gint status,
+		      const char *type, const void *body, gsize len);
+gboolean http_respond_headers(struct http_request *req, gint status,
+			      const char *type, const char *headers,
+			      const void *body, gsize len);
+gchar *http_query_get(const struct http_request *req, const char *key);
+
+#endif  /* _HTTP_H_ */
+
+/* http.h ends here */
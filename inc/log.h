@@ -0,0 +1,64 @@
+/**
+ * Filename: log.h
+ * Description: Asynchronous per-thread ring buffer logging
+ * Created: Fri Oct 16 18:02:44 2026 (-0700)
+ * Version: 1.0
+ */
+
+/**
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef _LOG_H_
+#define _LOG_H_
+
+#include <glib.h>
+#include <syslog.h>
+
+/**
+ * Logging:
+ *  - Callers format into a ring buffer owned by their thread and return,
+ *    a writer thread does the actual output. No locks or syscalls on the
+ *    way in, so streaming threads never wait on a slow console.
+ *  - A full ring drops the message and counts it, the writer reports the
+ *    count once it catches up, as it does for truncated messages.
+ *    g_print() output is split rather than truncated.
+ *  - LOG_RATE_MAX: Messages per second a single call site may log, the
+ *    rest are counted and reported as suppressed
+ */
+#define LOG_MSG_MAX   512	/* Longer messages are truncated */
+#define LOG_RING_SIZE 256	/* Messages per thread, power of 2 */
+#define LOG_RATE_MAX  50
+
+enum log_target {LOG_TO_STDOUT=0, LOG_TO_SYSLOG};
+
+/* Per call site rate limiting state, zero initialized */
+struct log_site {
+	gint64 window;		/* Start of the current second (us) */
+	gint count;		/* Messages in this window */
+	gint suppressed;	/* Dropped by the limit in this window */
+};
+
+void log_init(const char *ident);
+void log_set_target(enum log_target target);
+void log_lost(gint *dropped, gint *truncated);
+/* 'prio' is a syslog priority (LOG_DEBUG, LOG_INFO, ...) */
+void log_write(struct log_site *site, int prio, const char *fmt, ...)
+	G_GNUC_PRINTF(3, 4);
+void log_close(void);
+
+#endif  /* _LOG_H_ */
+
+/* log.h ends here */
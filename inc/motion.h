@@ -0,0 +1,84 @@
+/**
+ * Filename: motion.h
+ * Description: Per-frame motion score of the raw video
+ * Created: Mon Oct 19 09:48:26 2026 (-0700)
+ * Version: 1.0
+ */
+
+/**
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef _MOTION_H_
+#define _MOTION_H_
+
+#include <quality.h>
+
+#include <gst/gst.h>
+
+/**
+ * Motion analysis:
+ *  - The score is the mean absolute luma difference per pixel between a
+ *    frame and the last one let through, on the QUALITY_SCALE downscaled
+ *    plane
+ *  - A scene is still once no frame has scored above the threshold for
+ *    MOTION_HOLD_US, and moving again on the first frame that does
+ *  - With skip_max_us set, frames scoring below skip_threshold are dropped,
+ *    but never for skip_max_us or longer in a row
+ */
+#define MOTION_HOLD_US 3000000
+
+typedef void (*motion_fn)(gboolean still, gdouble score, gpointer data);
+
+struct motion {
+	gdouble threshold;	/* Score that counts as motion */
+	motion_fn changed;	/* Called on the streaming thread */
+	gpointer data;
+	gdouble skip_threshold;	/* Score below which a frame is skipped */
+	gint64 skip_max_us;	/* Longest run of skipped frames, 0 = off */
+
+	/* Streaming thread only */
+	struct luma_plane prev, cur;
+	gint64 last_motion;	/* Monotonic time of the last motion */
+	gint64 last_pass;	/* Monotonic time of the last passed frame */
+
+	/* Read from anywhere (atomic) */
+	gint still;		/* Scene is still */
+	gint score;		/* Last score, x100 */
+	gint cost_total;	/* Analyzer time in us, never reset, wraps */
+	gint skipped_total;	/* Frames skipped, never reset, wraps */
+	gint skipped;		/* Frames skipped since the last sample */
+	gint frames;		/* Frames since the last sample */
+	gint score_sum;		/* Scores since the last sample, x100 */
+	gint score_max;		/* Highest since the last sample, x100 */
+	gint cost_us;		/* Analyzer time since the last sample */
+	gint64 last_sample;	/* Monotonic time of the last sample */
+};
+
+struct motion_sample {
+	gint frames;		/* Frames analyzed since the last sample */
+	gint skipped;		/* Of which were skipped */
+	gdouble score_avg;
+	gdouble score_max;
+	gdouble cost_us;	/* Per frame */
+	gdouble load_pct;	/* Of one core */
+};
+
+gulong motion_attach(GstElement *elem, struct motion *m);
+void motion_sample(struct motion *m, struct motion_sample *out);
+
+#endif  /* _MOTION_H_ */
+
+/* motion.h ends here */
@@ -0,0 +1,98 @@
+/**
+ * Filename: quality-sampler.h
+ * Description: Sample PSNR/SSIM of the encoder's output against its input
+ * Created: Sun Oct 18 11:42:19 2026 (-0700)
+ * Version: 1.0
+ */
+
+/**
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef _QUALITY_SAMPLER_H_
+#define _QUALITY_SAMPLER_H_
+
+#include <quality.h>
+
+#include <gst/gst.h>
+
+/**
+ * Sampling:
+ *  - QUALITY_MAX_FRAMES: Most frames decoded and scored per sample
+ *  - QUALITY_REFS:       Raw frames kept to match decoded ones against,
+ *                        room for the IDR, the frame budget and encoder
+ *                        latency
+ *  - QUALITY_KEY_WAIT:   How long to wait for an IDR the encoder makes
+ *                        anyway (us) before forcing one. A sample is given
+ *                        up after twice that.
+ *  - QUALITY_FORCE_US:   Least time between two forced IDRs, each is a
+ *                        bitrate spike live viewers see
+ */
+#define QUALITY_MAX_FRAMES 8
+#define QUALITY_REFS       16
+#define QUALITY_KEY_WAIT   2000000
+#define QUALITY_FORCE_US   (60 * G_USEC_PER_SEC)
+
+/* Ask the encoder for a key frame, from the streaming thread */
+typedef void (*quality_key_fn)(gpointer data);
+
+struct quality_result {
+	gint frames;		/* Frames scored */
+	gdouble psnr;		/* Average, dB */
+	gdouble psnr_min;
+	gdouble ssim;		/* Average, 0.0 - 1.0 */
+	gdouble ssim_min;
+};
+
+struct quality_ref {
+	GstClockTime pts;
+	struct luma_plane luma;
+};
+
+struct quality_sampler {
+	GMutex lock;		/* Everything below, taken by 3 threads */
+	gint state;		/* Idle, armed or running (atomic) */
+	gint budget;		/* Frames decoded per sample */
+	gint64 armed_at;	/* Monotonic time the sample was asked for */
+	gboolean forced;	/* IDR requested for this sample */
+	gint64 forced_at;	/* Monotonic time of the last one, 0 = never */
+	GstClockTime key_pts;	/* The sample's IDR, decoded but not scored */
+	gint fed;		/* Encoded frames handed to the decoder */
+	gint captured;		/* Raw frames kept, ring index */
+	gint decoded;		/* Frames out of the decoder */
+	struct quality_ref ref[QUALITY_REFS];
+	struct luma_plane dec;	/* Decoded frame being scored */
+	GstElement *pipe;	/* Decoder pipeline */
+	GstElement *src;	/* Its appsrc */
+	GstCaps *caps;		/* What the decoder was set up for */
+	quality_key_fn key_fn;
+	gpointer key_data;
+	struct quality_result acc;   /* Sample being built */
+	struct quality_result last;  /* Last finished sample */
+	gboolean have_last;
+};
+
+struct quality_sampler *quality_sampler_new(gint frames,
+					    quality_key_fn key_fn,
+					    gpointer key_data);
+gboolean quality_sampler_attach(struct quality_sampler *qs, GstElement *raw,
+				GstElement *enc);
+void quality_sampler_trigger(struct quality_sampler *qs);
+gboolean quality_sampler_result(struct quality_sampler *qs,
+				struct quality_result *out);
+
+#endif  /* _QUALITY_SAMPLER_H_ */
+
+/* quality-sampler.h ends here */
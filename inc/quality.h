@@ -0,0 +1,57 @@
+/**
+ * Filename: quality.h
+ * Description: PSNR and SSIM of downscaled luma planes
+ * Created: Sun Oct 18 10:05:51 2026 (-0700)
+ * Version: 1.0
+ */
+
+/**
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef _QUALITY_H_
+#define _QUALITY_H_
+
+#include <gst/gst.h>
+
+/**
+ * Both pictures are reduced to their luma plane at 1/QUALITY_SCALE the
+ * size in each dimension (2x2 box filter) before being compared. Scores
+ * are of the reduced planes, which is a quarter of the work and hides
+ * some of the noise a viewer wouldn't see either.
+ */
+#define QUALITY_SCALE    2
+#define QUALITY_PSNR_MAX 100.0	/* Reported for identical planes */
+
+struct luma_plane {
+	guint8 *data;		/* width * height, no padding */
+	gint width;
+	gint height;
+	gsize alloc;		/* Bytes allocated at 'data' */
+};
+
+void luma_downscale(struct luma_plane *out, const guint8 *src, gint pstride,
+		    gint stride, gint width, gint height);
+gboolean luma_from_buffer(struct luma_plane *out, GstCaps *caps,
+			  GstBuffer *buf);
+void luma_free(struct luma_plane *p);
+gdouble luma_psnr(const struct luma_plane *a, const struct luma_plane *b);
+gdouble luma_ssim(const struct luma_plane *a, const struct luma_plane *b);
+gdouble luma_mad(const struct luma_plane *a, const struct luma_plane *b);
+const char *quality_simd(void);
+
+#endif  /* _QUALITY_H_ */
+
+/* quality.h ends here */
@@ -0,0 +1,71 @@
+/**
+ * Filename: rate-stats.h
+ * Description: Encoded bitrate and frame sizes at the encoder's output
+ * Created: Sat Oct 17 17:10:38 2026 (-0700)
+ * Version: 1.0
+ */
+
+/**
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef _RATE_STATS_H_
+#define _RATE_STATS_H_
+
+#include <gst/gst.h>
+
+/* Key frames (IDR) and everything predicted from them */
+enum frame_type {FRAME_KEY=0, FRAME_DELTA};
+#define NUM_FRAME_TYPES (FRAME_DELTA + 1)
+
+/* Histogram resolution, the last bucket catches everything above */
+#define RATE_HIST_BYTES   1024
+#define RATE_HIST_BUCKETS 512
+
+struct rate_hist {
+	gint bucket[RATE_HIST_BUCKETS];	/* Frames per size (atomic) */
+	gint frames;			/* Frames seen (atomic) */
+	gint bytes;			/* Bytes seen (atomic) */
+	gint max;			/* Largest frame (atomic) */
+};
+
+struct rate_stats {
+	struct rate_hist hist[NUM_FRAME_TYPES];
+	gint total;		/* Bytes, never reset, wraps (atomic) */
+	gint64 last_sample;	/* Monotonic time of the last sample */
+};
+
+struct rate_type_sample {
+	gint frames;		/* Frames since the last sample */
+	gdouble avg_kb;
+	gdouble p50_kb;
+	gdouble p95_kb;
+	gdouble max_kb;
+};
+
+struct rate_sample {
+	gdouble kbps;		/* Encoded bitrate since the last sample */
+	gdouble fps;
+	gdouble peak_avg;	/* Largest frame over the average frame */
+	struct rate_type_sample type[NUM_FRAME_TYPES];
+};
+
+gulong rate_stats_attach(GstElement *enc, struct rate_stats *rs);
+void rate_stats_sample(struct rate_stats *rs, struct rate_sample *out);
+const char *frame_type_str(enum frame_type t);
+
+#endif  /* _RATE_STATS_H_ */
+
+/* rate-stats.h ends here */
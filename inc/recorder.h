@@ -0,0 +1,125 @@
+/**
+ * Filename: recorder.h
+ * Description: Segmented recording of the encoded stream to disk
+ * Created: Thu Oct 22 08:12:41 2026 (-0700)
+ * Version: 1.0
+ */
+
+/**
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef _RECORDER_H_
+#define _RECORDER_H_
+
+#include <gst/gst.h>
+
+/**
+ * Recorder:
+ *  - RECORD_QUEUE_MAX: Bytes of frames waiting for the writer. Beyond it
+ *                      frames are dropped up to the next key frame.
+ *  - RECORD_CHUNK: Bytes written per write, a multiple of RECORD_ALIGN
+ *  - RECORD_ALIGN: O_DIRECT alignment of buffers, offsets and lengths
+ *  - RECORD_WAIT: Longest (us) the writer waits for a frame
+ *  - RECORD_EOS_TIMEOUT: Longest the muxer may take to finish a segment
+ *  - RECORD_PREALLOC: Bytes preallocated per segment when the bitrate
+ *                     doesn't tell
+ */
+#define RECORD_QUEUE_MAX   (8 << 20)
+#define RECORD_CHUNK       (1 << 20)
+#define RECORD_ALIGN       4096
+#define RECORD_WAIT        100000
+#define RECORD_EOS_TIMEOUT (5 * GST_SECOND)
+#define RECORD_PREALLOC    (64 << 20)
+
+enum record_format {RECORD_MKV=0, RECORD_MP4};
+
+/**
+ * Every segment <time>.mkv|mp4 has an index <time>.idx next to it: a
+ * header, then one entry per key frame in the order they were written.
+ * Both are in host byte order.
+ */
+#define RECORD_INDEX_MAGIC   0x58495747	/* "GWIX" */
+#define RECORD_INDEX_VERSION 1
+
+struct record_index_header {
+	guint32 magic;
+	guint32 version;
+	gint64 start;		/* Wall clock (us) of the first frame */
+};
+
+struct record_index_entry {
+	gint64 time;		/* Wall clock (us) the key frame was encoded */
+	gint64 pts;		/* Its timestamp in the segment (us) */
+};
+
+struct record_segment {
+	gchar *name;		/* Without the extension */
+	enum record_format format;
+	gint64 start;		/* Wall clock (us) of the first frame */
+	gint64 end;		/* Of the last frame, or its file's mtime */
+	guint64 bytes;		/* Segment and index */
+};
+
+struct record_au {
+	GstBuffer *buf;		/* A reference, not a copy */
+	GstCaps *caps;		/* Set when they changed */
+	gint64 time;		/* Wall clock (us) it left the encoder */
+};
+
+struct recorder {
+	gchar *dir;
+	enum record_format format;
+	gint64 seg_len;		/* Segment length (us) */
+	guint64 max_bytes;	/* Retention, 0 = no limit */
+	gint64 max_age;		/* Retention (us), 0 = no limit */
+	gsize prealloc;		/* Bytes fallocate()d at a time */
+	gboolean direct;	/* Write with O_DIRECT */
+
+	/* Encoder's streaming thread */
+	GstCaps *caps;		/* Last caps queued */
+	gboolean need_key;	/* Dropping up to the next key frame */
+
+	GAsyncQueue *queue;	/* record_au, to the writer */
+	gint queued;		/* Bytes in the queue (atomic) */
+	gint stop;		/* Writer should finish (atomic) */
+	GThread *thread;
+
+	GMutex lock;		/* Segment list and total */
+	GQueue segments;	/* Oldest first, the last may be open */
+	guint64 total;		/* Bytes in all segments */
+
+	/* Counters since start (atomic) */
+	gint dropped;		/* Frames the writer was too slow for */
+	gint write_max_us;	/* Slowest write */
+	gint errors;		/* Failed writes */
+	gint removed;		/* Segments removed by retention */
+};
+
+struct recorder *recorder_new(const gchar *dir, enum record_format format,
+			      gint seg_secs, gint max_mb, gint max_hours,
+			      gsize prealloc, gboolean direct);
+gulong recorder_attach(GstElement *enc, struct recorder *rec);
+gboolean recorder_parse_format(const gchar *str, enum record_format *format);
+const gchar *recorder_ext(struct recorder *rec);
+void recorder_held(struct recorder *rec, guint *segments, guint64 *bytes,
+		   gint64 *oldest);
+gboolean recorder_find(struct recorder *rec, gint64 time, gchar **path,
+		       struct record_index_entry *key);
+void recorder_free(struct recorder *rec);
+
+#endif  /* _RECORDER_H_ */
+
+/* recorder.h ends here */
@@ -0,0 +1,51 @@
+/**
+ * Filename: rtcp-stats.h
+ * Description: Per-client receiver report statistics from the RTP sessions
+ * Created: Wed Oct 14 10:31:48 2026 (-0700)
+ * Version: 1.0
+ */
+
+/**
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef _RTCP_STATS_H_
+#define _RTCP_STATS_H_
+
+#include <gst/rtsp-server/rtsp-server.h>
+
+/* Clients beyond this still count towards max/avg loss */
+#define RTCP_MAX_CLIENTS 32
+
+struct rtcp_client {
+	gchar addr[48];		/* Where its RTCP comes from */
+	guint32 ssrc;		/* Receiver SSRC */
+	gdouble loss;		/* Fraction lost, 0.0 - 1.0 */
+	gdouble rtt_ms;		/* Round trip time */
+	gdouble jitter_ms;	/* Interarrival jitter */
+};
+
+struct rtcp_stats {
+	guint n;		/* Clients that sent a receiver report */
+	gdouble max_loss;	/* Worst fraction lost */
+	gdouble avg_loss;	/* Mean fraction lost */
+	struct rtcp_client cli[RTCP_MAX_CLIENTS];
+};
+
+void rtcp_stats_collect(GstRTSPMedia *media, struct rtcp_stats *rs);
+
+#endif  /* _RTCP_STATS_H_ */
+
+/* rtcp-stats.h ends here */
@@ -0,0 +1,46 @@
+/**
+ * Filename: rtp-batch.h
+ * Description: Count RTP output and collect a frame into one buffer list
+ * Created: Mon Oct 12 15:21:07 2026 (-0700)
+ * Version: 1.0
+ */
+
+/**
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef _RTP_BATCH_H_
+#define _RTP_BATCH_H_
+
+#include <gst/gst.h>
+
+/* Never hold more than this many packets, even without a marker bit */
+#define RTP_BATCH_MAX 64
+
+struct rtp_batch {
+	gboolean enabled;	/* Collect frames into lists */
+	gint sends;		/* Buffers/lists pushed downstream (atomic) */
+	gint packets;		/* RTP packets pushed downstream (atomic) */
+	gint frames;		/* Marker bits seen (atomic) */
+	gint bytes;		/* RTP bytes pushed, never reset (atomic) */
+};
+
+gulong rtp_batch_attach(GstElement *pay, struct rtp_batch *rb);
+void rtp_batch_sample(struct rtp_batch *rb, gint *sends, gint *packets,
+		      gint *frames);
+
+#endif  /* _RTP_BATCH_H_ */
+
+/* rtp-batch.h ends here */
@@ -0,0 +1,107 @@
+/**
+ * Filename: shm-stats.h
+ * Description: Seqlock protected live statistics in shared memory
+ * Created: Sat Oct 17 15:20:12 2026 (-0700)
+ * Version: 1.0
+ */
+
+/**
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef _SHM_STATS_H_
+#define _SHM_STATS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Shared memory statistics:
+ *  - Lives in /dev/shm as SHM_STATS_PREFIX<rtsp port>, rewritten by the
+ *    server once a second
+ *  - Readers map it read-only and copy it out under a seqlock, no
+ *    syscalls into the server and no work on its main loop
+ *  - Fields are only ever appended. Readers check magic, then use
+ *    'size' to tell which fields a newer or older server has.
+ *  - SHM_STATS_VERSION: 1 ends at the sessions, 2 appended rate_ratio
+ *    through idr_interval. SHM_STATS_MIN_SIZE is version 1's size, the
+ *    least a reader accepts.
+ */
+#define SHM_STATS_PREFIX       "/gst-variable-rtsp-server-"
+#define SHM_STATS_MAGIC        0x53525647 /* "GVRS" */
+#define SHM_STATS_VERSION      2
+#define SHM_STATS_MAX_SESSIONS 32
+#define SHM_STATS_STAGES       4
+
+struct shm_session {
+	char addr[48];		/* Where its RTCP comes from */
+	uint32_t ssrc;
+	float loss;		/* Fraction lost, 0.0 - 1.0 */
+	float rtt_ms;
+	float jitter_ms;
+};
+
+struct shm_stats {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t size;		/* sizeof(struct shm_stats) of the writer */
+	uint32_t seq;		/* Odd while being written */
+	int64_t update_us;	/* Wall clock of the last update */
+	int32_t pid;
+
+	int32_t num_cli;
+	int32_t connected;
+	int32_t curr_bitrate;
+	int32_t min_bitrate;
+	int32_t max_bitrate;
+	int32_t curr_quant_lvl;
+	int32_t min_quant_lvl;
+	int32_t max_quant_lvl;
+	int32_t steps;
+	int32_t mtu;
+	int32_t fec_pct;
+	float loss;		/* Smoothed worst client loss */
+
+	/* Running totals, they wrap. Rates are up to the reader. */
+	uint32_t rtp_bytes;
+	uint32_t frames[SHM_STATS_STAGES]; /* source0, caps0, enc0, pay0 */
+
+	uint32_t n_sessions;
+	struct shm_session session[SHM_STATS_MAX_SESSIONS];
+
+	float rate_ratio;	/* Smoothed encoded/target bitrate, 0 = n/a */
+	float rate_scale;	/* Correction applied to the encoder bitrate */
+	float psnr;		/* Last quality sample, dB, 0 = none */
+	float ssim;
+	float motion_score;	/* Last frame difference, 0-255 */
+	int32_t motion_still;	/* Scene is still, bitrate lowered */
+	uint32_t motion_cost_us; /* Analyzer time, wraps */
+	uint32_t frames_skipped; /* Static frames not encoded, wraps */
+	int32_t idr_interval;	/* Frames, 0 = encoder default */
+};
+
+#define SHM_STATS_MIN_SIZE offsetof(struct shm_stats, rate_ratio)
+
+struct shm_stats *shm_stats_create(const char *name);
+void shm_stats_destroy(const char *name, struct shm_stats *s);
+void shm_stats_begin(struct shm_stats *s);
+void shm_stats_end(struct shm_stats *s);
+const struct shm_stats *shm_stats_open(const char *name, size_t *len);
+int shm_stats_read(const struct shm_stats *s, size_t len,
+		   struct shm_stats *out);
+
+#endif  /* _SHM_STATS_H_ */
+
+/* shm-stats.h ends here */
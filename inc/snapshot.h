@@ -0,0 +1,59 @@
+/**
+ * Filename: snapshot.h
+ * Description: Latest raw frame as a JPEG, encoded on demand
+ * Created: Tue Oct 20 10:14:52 2026 (-0700)
+ * Version: 1.0
+ */
+
+/**
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef _SNAPSHOT_H_
+#define _SNAPSHOT_H_
+
+#include <gst/gst.h>
+
+/**
+ * Snapshots:
+ *  - SNAPSHOT_MAX_AGE: Oldest frame (us) still served, older means the
+ *                      pipeline stopped
+ *  - SNAPSHOT_TIMEOUT: Longest a JPEG encode may take
+ */
+#define SNAPSHOT_MAX_AGE 2000000
+#define SNAPSHOT_TIMEOUT (2 * GST_SECOND)
+
+struct snapshot {
+	GMutex lock;		/* Everything below */
+	GCond done;		/* An encode finished */
+	GstBuffer *buf;		/* Latest frame, a reference, not a copy */
+	GstCaps *caps;		/* Its caps */
+	gint64 time;		/* Monotonic time it arrived */
+	guint64 seq;		/* Frames seen */
+	GBytes *jpeg;		/* Encoding of frame 'jpeg_seq' */
+	guint64 jpeg_seq;
+	gboolean encoding;	/* A request is encoding, the rest wait */
+	gint requests;		/* Since start (atomic) */
+	gint encodes;		/* Since start (atomic) */
+};
+
+struct snapshot *snapshot_new(void);
+gulong snapshot_attach(GstElement *elem, struct snapshot *s);
+void snapshot_clear(struct snapshot *s);
+GBytes *snapshot_jpeg(struct snapshot *s);
+
+#endif  /* _SNAPSHOT_H_ */
+
+/* snapshot.h ends here */
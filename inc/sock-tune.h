@@ -0,0 +1,47 @@
+/**
+ * Filename: sock-tune.h
+ * Description: Transport socket tuning (buffers, latency, DSCP)
+ * Created: Wed Oct 14 16:05:12 2026 (-0700)
+ * Version: 1.0
+ */
+
+/**
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef _SOCK_TUNE_H_
+#define _SOCK_TUNE_H_
+
+/* Any field left at SOCK_TUNE_UNSET is not touched */
+#define SOCK_TUNE_UNSET -1
+
+struct sock_tune {
+	int sndbuf;		/* SO_SNDBUF in bytes */
+	int nodelay;		/* TCP_NODELAY (TCP only) */
+	int notsent_lowat;	/* TCP_NOTSENT_LOWAT in bytes (TCP only) */
+	int dscp;		/* DiffServ code point, 0 - 63 */
+};
+
+#define SOCK_TUNE_INIT { SOCK_TUNE_UNSET, SOCK_TUNE_UNSET, \
+			 SOCK_TUNE_UNSET, SOCK_TUNE_UNSET }
+
+int sock_tune_is_set(const struct sock_tune *t);
+int sock_tune_tcp(int fd, const struct sock_tune *t);
+int sock_tune_udp(int fd, const struct sock_tune *t);
+int sock_tune_parse_dscp(const char *str);
+
+#endif  /* _SOCK_TUNE_H_ */
+
+/* sock-tune.h ends here */
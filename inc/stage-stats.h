@@ -0,0 +1,73 @@
+/**
+ * Filename: stage-stats.h
+ * Description: Per-stage capture latency histograms and frame rates
+ * Created: Fri Oct 16 09:48:12 2026 (-0700)
+ * Version: 1.0
+ */
+
+/**
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef _STAGE_STATS_H_
+#define _STAGE_STATS_H_
+
+#include <gst/gst.h>
+
+/**
+ * Pipeline stages, measured on each element's src pad:
+ *  - STAGE_SOURCE:  source0, capture driver hand-over
+ *  - STAGE_CAPS:    caps0, colorspace/scaling
+ *  - STAGE_ENCODER: enc0, encoded access units
+ *  - STAGE_PAYLOAD: pay0, last RTP packet of each frame
+ */
+enum stage {STAGE_SOURCE=0, STAGE_CAPS, STAGE_ENCODER, STAGE_PAYLOAD};
+#define NUM_STAGES (STAGE_PAYLOAD + 1)
+
+/* Histogram resolution, the last bucket catches everything above */
+#define STAGE_HIST_US      500
+#define STAGE_HIST_BUCKETS 1024
+
+struct stage_hist {
+	gint bucket[STAGE_HIST_BUCKETS]; /* Frames per latency (atomic) */
+	gint frames;			 /* Frames seen (atomic) */
+	gint total;			 /* Never reset (atomic) */
+	gint max_us;			 /* Worst latency (atomic) */
+};
+
+struct stage_stats {
+	struct stage_hist hist[NUM_STAGES];
+	gint64 last_sample;	/* Monotonic time of the last sample */
+};
+
+/* Latency is from capture to the stage, not the time spent in it */
+struct stage_sample {
+	gint frames;		/* Frames since the last sample */
+	gdouble fps;
+	gdouble p50_ms;
+	gdouble p99_ms;
+	gdouble max_ms;
+};
+
+gulong stage_stats_attach(GstElement *elem, enum stage st,
+			  struct stage_stats *ss);
+void stage_stats_sample(struct stage_stats *ss,
+			struct stage_sample out[NUM_STAGES]);
+const char *stage_str(enum stage st);
+GstClockTime stage_capture_time(GstElement *elem, GstBuffer *buf);
+
+#endif  /* _STAGE_STATS_H_ */
+
+/* stage-stats.h ends here */
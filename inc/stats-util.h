@@ -0,0 +1,35 @@
+/**
+ * Filename: stats-util.h
+ * Description: Helpers shared by the statistics probes
+ * Created: Sun Oct 25 10:12:36 2026 (-0700)
+ * Version: 1.0
+ */
+
+/**
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef _STATS_UTIL_H_
+#define _STATS_UTIL_H_
+
+#include <gst/gst.h>
+
+void atomic_max(gint *p, gint val);
+gboolean rtp_has_marker(GstBuffer *buf);
+gint hist_percentile(const gint *bucket, gint buckets, gint n, gint pct);
+
+#endif  /* _STATS_UTIL_H_ */
+
+/* stats-util.h ends here */
@@ -0,0 +1,104 @@
+/**
+ * Filename: timeshift.h
+ * Description: Ring of encoded frames for rewinding the live stream
+ * Created: Wed Oct 21 09:37:15 2026 (-0700)
+ * Version: 1.0
+ */
+
+/**
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef _TIMESHIFT_H_
+#define _TIMESHIFT_H_
+
+#include <gst/gst.h>
+
+/**
+ * Timeshift:
+ *  - TIMESHIFT_MAX_FPS: Sizes the frame index, frames beyond it push the
+ *                       oldest out early
+ *  - TIMESHIFT_MAX_SPEED: Fastest a reader replays (RTSP Speed header)
+ *  - TIMESHIFT_WAIT: Longest (us) a reader sleeps between checks for
+ *                    being stopped
+ */
+#define TIMESHIFT_MAX_FPS   120
+#define TIMESHIFT_MAX_SPEED 8.0
+#define TIMESHIFT_WAIT      100000
+
+struct timeshift_au {
+	gsize offset;		/* Into the arena */
+	gsize size;
+	gint64 time;		/* Monotonic time it left the encoder */
+	GstClockTime pts, dts;	/* The encoder's timestamps */
+	gboolean key;		/* A reader can start here */
+};
+
+/**
+ * Frames are numbered in the order they arrive, frame 'seq' lives in
+ * au[seq % cap] while first <= seq < next. keys[] holds the numbers of
+ * the key frames among them the same way.
+ */
+struct timeshift {
+	GMutex lock;		/* Everything below */
+	GCond added;		/* A frame was added, or a reader stopped */
+	guint8 *arena;		/* Frame data, allocated once */
+	gsize size;		/* Bytes in the arena */
+	gsize head;		/* Where the next frame goes */
+	gsize used;		/* Bytes held by frames */
+	gint64 max_age;		/* Oldest frame (us) kept */
+	struct timeshift_au *au;
+	guint64 *keys;
+	guint cap;		/* Entries in au[] and keys[] */
+	guint64 first, next;
+	guint64 key_first, key_next;
+	GstCaps *caps;		/* Encoder output */
+	gint dropped;		/* Frames too large to keep (atomic) */
+};
+
+struct timeshift_reader {
+	struct timeshift *ts;
+	GstElement *src;	/* appsrc the frames are pushed to */
+	GThread *thread;
+	/* Under ts->lock */
+	gboolean stop;
+	guint64 pos;		/* Next frame to push */
+	gboolean need_key;	/* Skip to a key frame, then anchor */
+	gboolean live;		/* Anchor on the newest frame */
+	gdouble speed;
+	gint64 anchor;		/* Monotonic time 'anchor_time' is due */
+	gint64 anchor_time;	/* Ring time of the anchor frame */
+	GstClockTime anchor_pts; /* Encoder PTS of the anchor frame */
+	GstClockTime base;	/* Running time it is stamped with */
+	GstClockTime end;	/* Latest running time stamped so far */
+};
+
+struct timeshift *timeshift_new(gint secs, gsize bytes);
+gulong timeshift_attach(GstElement *enc, struct timeshift *ts);
+gdouble timeshift_held(struct timeshift *ts, gsize *bytes);
+guint64 timeshift_find(struct timeshift *ts, gint64 time);
+GstBuffer *timeshift_get(struct timeshift *ts, guint64 seq, gint64 *time);
+gboolean timeshift_wait(struct timeshift *ts, gint64 time, gint64 deadline);
+GstCaps *timeshift_caps(struct timeshift *ts);
+
+struct timeshift_reader *timeshift_reader_new(struct timeshift *ts,
+					      GstElement *src);
+gboolean timeshift_reader_seek(struct timeshift_reader *r,
+			       const gchar *range, gdouble speed);
+void timeshift_reader_free(struct timeshift_reader *r);
+
+#endif  /* _TIMESHIFT_H_ */
+
+/* timeshift.h ends here */
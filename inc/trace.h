@@ -0,0 +1,59 @@
+/**
+ * Filename: trace.h
+ * Description: USDT static tracepoints
+ * Created: Fri Oct 16 16:31:02 2026 (-0700)
+ * Version: 1.0
+ */
+
+/**
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+/**
+ * Static tracepoints for bpftrace/perf/systemtap, provider 'gvrs':
+ *  - Each one is a single nop plus an ELF note until a tracer attaches,
+ *    arguments are plain integers that are at hand anyway
+ *  - Used automatically when <sys/sdt.h> (systemtap-sdt-dev) is found,
+ *    -DNO_SDT leaves them out, -DHAVE_SDT forces them on for compilers
+ *    without __has_include
+ *
+ * List them with: bpftrace -l 'usdt:bin/gst-variable-rtsp-server:*'
+ */
+#if !defined(NO_SDT) && !defined(HAVE_SDT) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#define HAVE_SDT 1
+#endif
+#endif
+
+#if defined(HAVE_SDT) && !defined(NO_SDT)
+#include <sys/sdt.h>
+
+#define TRACE1(name, a)		DTRACE_PROBE1(gvrs, name, a)
+#define TRACE2(name, a, b)	DTRACE_PROBE2(gvrs, name, a, b)
+#define TRACE3(name, a, b, c)	DTRACE_PROBE3(gvrs, name, a, b, c)
+#else
+/* Still 'use' the arguments so nothing warns about them */
+#define TRACE1(name, a)		do { (void) (a); } while (0)
+#define TRACE2(name, a, b)	do { (void) (a); (void) (b); } while (0)
+#define TRACE3(name, a, b, c)	\
+	do { (void) (a); (void) (b); (void) (c); } while (0)
+#endif
+
+#endif  /* _TRACE_H_ */
+
+/* trace.h ends here */
@@ -0,0 +1,68 @@
+/**
+ * Filename: udp-batch.h
+ * Description: Batched UDP transmission (sendmmsg / UDP_SEGMENT GSO)
+ * Created: Mon Oct 12 10:02:14 2026 (-0700)
+ * Version: 1.0
+ */
+
+/**
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef _UDP_BATCH_H_
+#define _UDP_BATCH_H_
+
+#include <stddef.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+/**
+ * Batch modes:
+ *  - UDP_BATCH_NONE: one sendto() per packet (what a naive sink does)
+ *  - UDP_BATCH_MMSG: one sendmmsg() per flush
+ *  - UDP_BATCH_GSO:  one sendmsg() with UDP_SEGMENT per run of equally sized
+ *                    packets, falls back to sendmmsg() if the kernel
+ *                    doesn't support it
+ */
+enum udp_batch_mode {UDP_BATCH_NONE=0, UDP_BATCH_MMSG, UDP_BATCH_GSO};
+
+/* Max packets queued before a flush is forced */
+#define UDP_BATCH_MAX 64
+
+/* Kernel limit on segments per GSO super-packet */
+#define UDP_BATCH_GSO_MAX_SEGS 64
+
+struct udp_batch {
+	int fd;				 /* Socket to send on */
+	enum udp_batch_mode mode;	 /* Requested batching mode */
+	int gso;			 /* Kernel accepts UDP_SEGMENT */
+	unsigned int count;		 /* Number of queued packets */
+	struct iovec iov[UDP_BATCH_MAX]; /* Queued packets */
+	struct mmsghdr msgs[UDP_BATCH_MAX];
+	unsigned long syscalls;		 /* Send syscalls issued */
+	unsigned long packets;		 /* Packets handed to the kernel */
+};
+
+int udp_batch_gso_supported(int fd);
+void udp_batch_init(struct udp_batch *b, int fd, enum udp_batch_mode mode);
+int udp_batch_add(struct udp_batch *b, const struct sockaddr *dst,
+		  socklen_t dst_len, void *data, size_t len);
+int udp_batch_flush(struct udp_batch *b, const struct sockaddr *dst,
+		    socklen_t dst_len);
+const char *udp_batch_mode_str(enum udp_batch_mode mode);
+
+#endif  /* _UDP_BATCH_H_ */
+
+/* udp-batch.h ends here */
@@ -0,0 +1,143 @@
+/**
+ * Filename: webrtc.h
+ * Description: WebRTC viewers of the encoded stream
+ * Created: Sat Oct 24 09:41:06 2026 (-0700)
+ * Version: 1.0
+ */
+
+/**
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef _WEBRTC_H_
+#define _WEBRTC_H_
+
+#include <gst/gst.h>
+
+/**
+ * WebRTC:
+ *  - WEBRTC_QUEUE_MAX: Bytes waiting in a peer's appsrc. Beyond it the
+ *                      peer skips to the next key frame.
+ *  - WEBRTC_GATHER_US: Longest an answer waits for ICE gathering
+ *  - WEBRTC_CONNECT_US: Longest a peer may take to connect, or to come
+ *                       back once disconnected
+ */
+#define WEBRTC_QUEUE_MAX  (1 << 20)
+#define WEBRTC_GATHER_US  (2 * G_USEC_PER_SEC)
+#define WEBRTC_CONNECT_US (15 * G_USEC_PER_SEC)
+
+/* Ask the encoder for a key frame, from any thread */
+typedef void (*webrtc_key_fn)(gpointer data);
+
+struct webrtc;
+
+struct webrtc_peer {
+	struct webrtc *w;
+	guint id;		/* In its /webrtc/<id> resource */
+	gchar *remote;		/* Address that signalled it */
+	GstElement *pipe;
+	GstElement *src;	/* Frames from enc0 */
+	GstElement *bin;	/* webrtcbin */
+	gboolean live;		/* Connected, frames go to it */
+	gboolean need_key;	/* Skipping up to the next key frame */
+	gboolean gathered;	/* ICE candidates are all known */
+	gint64 offset;		/* enc0 time to the peer's running time */
+	gboolean have_offset;	/* Set on the first frame pushed */
+	gint state;		/* GstWebRTCPeerConnectionState */
+	gint64 since;		/* Monotonic time of the last state change */
+	gint frames;		/* Sent to it (atomic) */
+	gint key_requests;	/* PLIs/FIRs it sent (atomic) */
+};
+
+struct webrtc {
+	gchar *stun;		/* STUN server URI, NULL = host candidates */
+	guint max_peers;
+	gboolean capture_ext;	/* Send abs-capture-time */
+	gint mtu;
+	webrtc_key_fn key_fn;
+	gpointer key_data;
+
+	GMutex lock;		/* Peers, their state and caps */
+	GCond changed;		/* A peer's state changed */
+	GList *peers;
+	guint answering;	/* Peers still gathering, not in the list */
+	GstCaps *caps;		/* Of enc0's output */
+	guint next_id;
+
+	/* Counters since start (atomic) */
+	gint signalled;		/* Offers answered */
+	gint failed;		/* Peers that never connected or failed */
+	gint dropped;		/* Frames a peer fell too far behind for */
+	gint key_requests;	/* PLIs/FIRs from all peers */
+};
+
+/*
+ * HAVE_WEBRTC is set by the Makefile when pkg-config finds
+ * gstreamer-webrtc-1.0 (GStreamer 1.14 and up). Without it there is no
+ * webrtc.o and these never have a peer.
+ */
+#ifdef HAVE_WEBRTC
+struct webrtc *webrtc_new(const gchar *stun, guint max_peers,
+			  gboolean capture_ext, gint mtu, webrtc_key_fn key_fn,
+			  gpointer key_data);
+gulong webrtc_attach(GstElement *enc, struct webrtc *w);
+gchar *webrtc_answer(struct webrtc *w, const gchar *offer,
+		     const gchar *remote, guint *id, gint *status);
+gboolean webrtc_close(struct webrtc *w, guint id);
+guint webrtc_reap(struct webrtc *w);
+guint webrtc_peers(struct webrtc *w, guint *connected);
+#else
+static inline struct webrtc *webrtc_new(const gchar *stun, guint max_peers,
+					gboolean capture_ext, gint mtu,
+					webrtc_key_fn key_fn,
+					gpointer key_data)
+{
+	return NULL;
+}
+
+static inline gulong webrtc_attach(GstElement *enc, struct webrtc *w)
+{
+	return 0;
+}
+
+static inline gchar *webrtc_answer(struct webrtc *w, const gchar *offer,
+				   const gchar *remote, guint *id,
+				   gint *status)
+{
+	*status = 501;
+	return NULL;
+}
+
+static inline gboolean webrtc_close(struct webrtc *w, guint id)
+{
+	return FALSE;
+}
+
+static inline guint webrtc_reap(struct webrtc *w)
+{
+	return 0;
+}
+
+static inline guint webrtc_peers(struct webrtc *w, guint *connected)
+{
+	if (connected)
+		*connected = 0;
+	return 0;
+}
+#endif
+
+#endif  /* _WEBRTC_H_ */
+
+/* webrtc.h ends here */
@@ -0,0 +1,219 @@
+/**
+ * Filename: capture-ext.c
+ * Description: abs-capture-time RTP header extension
+ * Created: Fri Oct 16 13:05:40 2026 (-0700)
+ * Version: 1.0
+ */
+
+/**
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/**
+ * The server stamps the wall clock time a frame was captured at onto its
+ * RTP packets so a receiver with an NTP synced clock can measure capture
+ * to receive latency itself. The capture time comes from the same clock
+ * time stage-stats tracks, moved onto the wall clock by how long ago it
+ * was. The extmap is added to the payloader's caps, which is where the
+ * RTSP server builds the SDP from.
+ */
+
+#include <capture-ext.h>
+#include <stage-stats.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#include <gst/rtp/gstrtpbuffer.h>
+
+/* Seconds from the NTP epoch (1900) to the unix one (1970) */
+#define NTP_UNIX_OFFSET G_GUINT64_CONSTANT(2208988800)
+
+static guint64 us_to_ntp(gint64 us)
+{
+	guint64 sec = us / G_USEC_PER_SEC + NTP_UNIX_OFFSET;
+	guint64 frac = ((guint64) (us % G_USEC_PER_SEC) << 32) /
+		G_USEC_PER_SEC;
+
+	return (sec << 32) | frac;
+}
+
+static gint64 ntp_to_us(guint64 ntp)
+{
+	gint64 sec = (gint64) (ntp >> 32) - NTP_UNIX_OFFSET;
+	gint64 frac = ((ntp & 0xffffffff) * G_USEC_PER_SEC) >> 32;
+
+	return sec * G_USEC_PER_SEC + frac;
+}
+
+/**
+ * stamp
+ * Add the capture time to 'buf' if it ends a frame and hasn't got it yet.
+ * Batched frames come past a second time as a list.
+ */
+static void stamp(GstBuffer **buf, GstElement *pay)
+{
+	GstRTPBuffer rtp = GST_RTP_BUFFER_INIT;
+	GstClock *clock;
+	GstClockTime cap, now;
+	gpointer data;
+	guint size;
+	gboolean want;
+	guint64 ntp;
+
+	if (!gst_rtp_buffer_map(*buf, GST_MAP_READ, &rtp))
+		return;
+	want = gst_rtp_buffer_get_marker(&rtp) &&
+		!gst_rtp_buffer_get_extension_onebyte_header(&rtp,
+			CAPTURE_EXT_ID, 0, &data, &size);
+	gst_rtp_buffer_unmap(&rtp);
+
+	cap = stage_capture_time(pay, *buf);
+	if (!want || !GST_CLOCK_TIME_IS_VALID(cap))
+		return;
+
+	clock = gst_element_get_clock(pay);
+	if (!clock)
+		return;
+	now = gst_clock_get_time(clock);
+	gst_object_unref(clock);
+
+	ntp = GUINT64_TO_BE(us_to_ntp(g_get_real_time() -
+				      GST_CLOCK_DIFF(cap, now) / GST_USECOND));
+
+	*buf = gst_buffer_make_writable(*buf);
+	if (!gst_rtp_buffer_map(*buf, GST_MAP_READWRITE, &rtp))
+		return;
+	gst_rtp_buffer_add_extension_onebyte_header(&rtp, CAPTURE_EXT_ID,
+						    &ntp, sizeof(ntp));
+	gst_rtp_buffer_unmap(&rtp);
+}
+
+static gboolean stamp_list(GstBuffer **buf, guint idx, gpointer pay)
+{
+	stamp(buf, pay);
+
+	return TRUE;
+}
+
+static GstPadProbeReturn ext_probe(GstPad *pad, GstPadProbeInfo *info,
+				   GstElement *pay)
+{
+	if (info->type & GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM) {
+		GstEvent *event = GST_PAD_PROBE_INFO_EVENT(info);
+		GstCaps *caps;
+
+		if (GST_EVENT_TYPE(event) != GST_EVENT_CAPS)
+			return GST_PAD_PROBE_OK;
+
+		gst_event_parse_caps(event, &caps);
+		caps = gst_caps_copy(caps);
+		gst_caps_set_simple(caps, "extmap-" G_STRINGIFY(CAPTURE_EXT_ID),
+				    G_TYPE_STRING, CAPTURE_EXT_URI, NULL);
+		GST_PAD_PROBE_INFO_DATA(info) = gst_event_new_caps(caps);
+		gst_caps_unref(caps);
+		gst_event_unref(event);
+	} else if (info->type & GST_PAD_PROBE_TYPE_BUFFER) {
+		GstBuffer *buf = GST_PAD_PROBE_INFO_BUFFER(info);
+
+		stamp(&buf, pay);
+		GST_PAD_PROBE_INFO_DATA(info) = buf;
+	} else {
+		GstBufferList *list = GST_PAD_PROBE_INFO_BUFFER_LIST(info);
+
+		list = gst_buffer_list_make_writable(list);
+		gst_buffer_list_foreach(list, stamp_list, pay);
+		GST_PAD_PROBE_INFO_DATA(info) = list;
+	}
+
+	return GST_PAD_PROBE_OK;
+}
+
+/**
+ * capture_ext_attach
+ * Stamp the output of payloader 'pay'. Attach before anything that wants
+ * to see the final packets.
+ */
+gulong capture_ext_attach(GstElement *pay)
+{
+	GstPad *pad = gst_element_get_static_pad(pay, "src");
+	gulong id;
+
+	if (!pad)
+		return 0;
+
+	id = gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER |
+			       GST_PAD_PROBE_TYPE_BUFFER_LIST |
+			       GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM,
+			       (GstPadProbeCallback) ext_probe, pay, NULL);
+	gst_object_unref(pad);
+
+	return id;
+}
+
+/**
+ * capture_ext_find_id
+ * Extension id the sender announced for abs-capture-time, 0 if none
+ */
+guint8 capture_ext_find_id(const GstCaps *caps)
+{
+	const GstStructure *s = gst_caps_get_structure(caps, 0);
+	gint i;
+
+	for (i = 0; s && i < gst_structure_n_fields(s); i++) {
+		const gchar *name = gst_structure_nth_field_name(s, i);
+		const gchar *uri;
+		guint id;
+
+		if (sscanf(name, "extmap-%u", &id) != 1 || id < 1 || id > 14)
+			continue;
+
+		/* Either a plain uri or (direction, uri, attributes) */
+		uri = gst_structure_get_string(s, name);
+		if (uri && strcmp(uri, CAPTURE_EXT_URI) == 0)
+			return id;
+	}
+
+	return 0;
+}
+
+/**
+ * capture_ext_read
+ * Capture wall clock time (us since the unix epoch) carried by 'buf'
+ */
+gboolean capture_ext_read(GstBuffer *buf, guint8 id, gint64 *wall_us)
+{
+	GstRTPBuffer rtp = GST_RTP_BUFFER_INIT;
+	gpointer data;
+	guint size;
+	guint64 ntp;
+	gboolean ret = FALSE;
+
+	if (!gst_rtp_buffer_map(buf, GST_MAP_READ, &rtp))
+		return FALSE;
+
+	if (gst_rtp_buffer_get_extension_onebyte_header(&rtp, id, 0, &data,
+							&size) &&
+	    size >= sizeof(ntp)) {
+		memcpy(&ntp, data, sizeof(ntp));
+		*wall_us = ntp_to_us(GUINT64_FROM_BE(ntp));
+		ret = TRUE;
+	}
+	gst_rtp_buffer_unmap(&rtp);
+
+	return ret;
+}
+
+/* capture-ext.c ends here */
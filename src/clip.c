@@ -0,0 +1,132 @@
+/**
+ * Filename: clip.c
+ * Description: MP4 clips remuxed from the timeshift ring
+ * Created: Thu Oct 22 14:03:27 2026 (-0700)
+ * Version: 1.0
+ */
+
+/**
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/**
+ * A clip is the frames the timeshift ring holds from the key frame before
+ * its start up to its end, copied out one at a time (the ring is only
+ * locked per frame, the live probe barely notices) and pushed as fast as
+ * the muxer takes them through h264parse into an mp4mux of the caller's
+ * own. Nothing is decoded or encoded, so a clip takes a small fraction
+ * of its length to make. faststart puts the moov in front, so the result
+ * plays and uploads as is.
+ */
+
+#include <clip.h>
+
+#include <gst/app/gstappsink.h>
+#include <gst/app/gstappsrc.h>
+
+#define CLIP_PIPELINE							\
+	"appsrc name=csrc0 format=time block=true ! h264parse !"	\
+	" mp4mux faststart=true ! appsink name=csink0 sync=false"
+
+/**
+ * clip_export
+ * An MP4 of the frames between monotonic times 'from' and 'to', starting
+ * at the key frame before 'from'. Waits until 'deadline' for 'to' to be
+ * encoded, a clip ends early if it isn't. NULL if the ring holds nothing
+ * of it. Blocks, not for streaming threads or the main loop.
+ */
+GBytes *clip_export(struct timeshift *ts, gint64 from, gint64 to,
+		    gint64 deadline, struct clip_result *res)
+{
+	GstElement *pipe, *src, *sink;
+	GstSample *sample;
+	GstBuffer *buf;
+	GstMapInfo map;
+	GByteArray *out;
+	GstCaps *caps;
+	GstClockTime base = 0;
+	gint64 time, t;
+	guint64 seq;
+	gboolean eos;
+
+	res->frames = 0;
+	timeshift_wait(ts, to, deadline);
+	t = g_get_monotonic_time();
+
+	caps = timeshift_caps(ts);
+	if (!caps)
+		return NULL;
+
+	pipe = gst_parse_launch(CLIP_PIPELINE, NULL);
+	if (!pipe) {
+		gst_caps_unref(caps);
+		return NULL;
+	}
+	src = gst_bin_get_by_name(GST_BIN(pipe), "csrc0");
+	sink = gst_bin_get_by_name(GST_BIN(pipe), "csink0");
+	gst_app_src_set_caps(GST_APP_SRC(src), caps);
+	gst_caps_unref(caps);
+	gst_element_set_state(pipe, GST_STATE_PLAYING);
+
+	for (seq = timeshift_find(ts, from);
+	     (buf = timeshift_get(ts, seq, &time)); seq++) {
+		if (time > to) {
+			gst_buffer_unref(buf);
+			break;
+		}
+		/* The encoder's timestamps, from 0 at the first frame */
+		if (!res->frames) {
+			res->start = time;
+			base = (GST_BUFFER_DTS_IS_VALID(buf)) ?
+				MIN(GST_BUFFER_DTS(buf), GST_BUFFER_PTS(buf)) :
+				GST_BUFFER_PTS(buf);
+		}
+		res->end = time;
+		res->frames++;
+
+		GST_BUFFER_PTS(buf) -= MIN(GST_BUFFER_PTS(buf), base);
+		if (GST_BUFFER_DTS_IS_VALID(buf))
+			GST_BUFFER_DTS(buf) -= MIN(GST_BUFFER_DTS(buf), base);
+		gst_app_src_push_buffer(GST_APP_SRC(src), buf);
+	}
+	gst_app_src_end_of_stream(GST_APP_SRC(src));
+
+	out = g_byte_array_new();
+	while ((sample = gst_app_sink_try_pull_sample(GST_APP_SINK(sink),
+						      CLIP_MUX_TIMEOUT))) {
+		buf = gst_sample_get_buffer(sample);
+		if (buf && gst_buffer_map(buf, &map, GST_MAP_READ)) {
+			g_byte_array_append(out, map.data, map.size);
+			gst_buffer_unmap(buf, &map);
+		}
+		gst_sample_unref(sample);
+	}
+	eos = gst_app_sink_is_eos(GST_APP_SINK(sink));
+
+	gst_element_set_state(pipe, GST_STATE_NULL);
+	gst_object_unref(src);
+	gst_object_unref(sink);
+	gst_object_unref(pipe);
+	res->mux_us = g_get_monotonic_time() - t;
+
+	if (!eos || !res->frames) {
+		g_byte_array_unref(out);
+		return NULL;
+	}
+
+	return g_byte_array_free_to_bytes(out);
+}
+
+/* clip.c ends here */
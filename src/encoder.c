@@ -0,0 +1,288 @@
+/**
+ * Filename: encoder.c
+ * Description: Map encoder controls onto the properties of each backend
+ * Created: Tue Oct 13 09:12:33 2026 (-0700)
+ * Version: 1.0
+ */
+
+/**
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <encoder.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <gst/video/video.h>
+
+/**
+ * How a control reaches the encoder:
+ *  - PROP_INT:  Plain integer property
+ *  - PROP_OPT:  'key=value' inside x264enc's 'option-string'
+ *  - PROP_CTRL: V4L2 control(s) in 'extra-controls', comma separated
+ */
+enum prop_kind {PROP_NONE=0, PROP_INT, PROP_OPT, PROP_CTRL};
+
+struct enc_map {
+	enum prop_kind kind;
+	const char *name;	/* Property, option key or control name(s) */
+	gint scale;		/* Multiplier from our units to theirs */
+	const char *extra;	/* Set alongside: 'control=value' for
+				 * PROP_CTRL, a property that takes the
+				 * same value for PROP_INT */
+};
+
+struct enc_backend {
+	const char *factory;	/* Factory name pattern */
+	struct enc_map map[NUM_ENC_CTL];
+};
+
+/* First match wins, keep the catch-all last */
+static const struct enc_backend backends[] = {
+	{"imxvpuenc_h264", {
+		[ENC_BITRATE]     = {PROP_INT, "bitrate", 1},
+		[ENC_QUANT]       = {PROP_INT, "quant-param", 1},
+		[ENC_IDR]         = {PROP_INT, "idr-interval", 1},
+	}},
+	{"x264enc", {
+		[ENC_BITRATE]     = {PROP_INT, "bitrate", 1},
+		[ENC_QUANT]       = {PROP_INT, "quantizer", 1},
+		[ENC_IDR]         = {PROP_INT, "key-int-max", 1},
+		[ENC_SLICE_BYTES] = {PROP_OPT, "slice-max-size", 1},
+		[ENC_BFRAMES]     = {PROP_INT, "bframes", 1},
+		[ENC_LOOKAHEAD]   = {PROP_INT, "rc-lookahead", 1},
+		/* The refresh sweeps over key-int-max frames */
+		[ENC_INTRA_REFRESH] = {PROP_INT, "intra-refresh", 1,
+				       "key-int-max"},
+	}},
+	{"v4l2*h264enc", {
+		[ENC_BITRATE]     = {PROP_CTRL, "video_bitrate", 1000},
+		[ENC_QUANT]       = {PROP_CTRL, "h264_i_frame_qp_value,"
+				     "h264_p_frame_qp_value", 1},
+		[ENC_IDR]         = {PROP_CTRL, "h264_i_frame_period", 1},
+		[ENC_SLICE_BYTES] = {PROP_CTRL, "maximum_bytes_in_a_slice", 1,
+				     "slice_partitioning_method=2"},
+		[ENC_BFRAMES]     = {PROP_CTRL, "number_of_b_frames", 1},
+		[ENC_INTRA_REFRESH] = {PROP_CTRL, "intra_refresh_period", 1,
+				       "intra_refresh_period_type=1"},
+	}},
+	{"*", {
+		[ENC_BITRATE]     = {PROP_INT, "bitrate", 1},
+		[ENC_QUANT]       = {PROP_INT, "quant-param", 1},
+		[ENC_IDR]         = {PROP_INT, "idr-interval", 1},
+	}},
+};
+
+static const struct enc_map *get_map(GstElement *enc, enum enc_ctl ctl)
+{
+	GstElementFactory *factory = gst_element_get_factory(enc);
+	const gchar *name;
+	const struct enc_map *map = NULL;
+	int i;
+
+	if (!factory)
+		return NULL;
+
+	name = gst_plugin_feature_get_name(GST_PLUGIN_FEATURE(factory));
+	for (i = 0; i < G_N_ELEMENTS(backends); i++) {
+		if (g_pattern_match_simple(backends[i].factory, name)) {
+			map = &backends[i].map[ctl];
+			break;
+		}
+	}
+
+	if (!map || map->kind == PROP_NONE)
+		return NULL;
+
+	/* Whatever the kind, the carrying property has to exist */
+	if (!g_object_class_find_property(G_OBJECT_GET_CLASS(enc),
+					  (map->kind == PROP_INT) ? map->name :
+					  (map->kind == PROP_OPT) ?
+					  "option-string" : "extra-controls"))
+		return NULL;
+
+	return map;
+}
+
+/**
+ * set_option
+ * Replace or append 'key=val' in x264enc's colon separated option-string
+ */
+static void set_option(GstElement *enc, const char *key, gint val)
+{
+	gchar *opts = NULL;
+	gchar **kv;
+	GString *out = g_string_new(NULL);
+	size_t klen = strlen(key);
+	int i;
+
+	g_object_get(enc, "option-string", &opts, NULL);
+	kv = g_strsplit((opts) ? opts : "", ":", -1);
+	for (i = 0; kv[i]; i++) {
+		if (!*kv[i] || (strncmp(kv[i], key, klen) == 0 &&
+				kv[i][klen] == '='))
+			continue;
+		g_string_append_printf(out, "%s%s", (out->len) ? ":" : "",
+				       kv[i]);
+	}
+	g_string_append_printf(out, "%s%s=%d", (out->len) ? ":" : "", key,
+			       val);
+
+	g_object_set(enc, "option-string", out->str, NULL);
+
+	g_strfreev(kv);
+	g_free(opts);
+	g_string_free(out, TRUE);
+}
+
+/**
+ * set_controls
+ * Merge V4L2 controls into 'extra-controls' so earlier ones are kept for
+ * when the device gets reopened.
+ */
+static void set_controls(GstElement *enc, const struct enc_map *map, gint val)
+{
+	GstStructure *ctrls = NULL;
+	gchar **names;
+	int i;
+
+	g_object_get(enc, "extra-controls", &ctrls, NULL);
+	if (!ctrls)
+		ctrls = gst_structure_new_empty("controls");
+
+	names = g_strsplit(map->name, ",", -1);
+	for (i = 0; names[i]; i++)
+		gst_structure_set(ctrls, names[i], G_TYPE_INT, val, NULL);
+	g_strfreev(names);
+
+	if (map->extra) {
+		gchar **extra = g_strsplit(map->extra, "=", 2);
+
+		if (extra[0] && extra[1])
+			gst_structure_set(ctrls, extra[0], G_TYPE_INT,
+					  atoi(extra[1]), NULL);
+		g_strfreev(extra);
+	}
+
+	g_object_set(enc, "extra-controls", ctrls, NULL);
+	gst_structure_free(ctrls);
+}
+
+/**
+ * enc_supports
+ * Whether 'enc' knows how to apply 'ctl'
+ */
+gboolean enc_supports(GstElement *enc, enum enc_ctl ctl)
+{
+	return get_map(enc, ctl) != NULL;
+}
+
+/**
+ * enc_set
+ * Apply 'val' for 'ctl' to 'enc'. Returns FALSE if the backend has no
+ * equivalent, callers decide whether that is worth telling the user.
+ */
+gboolean enc_set(GstElement *enc, enum enc_ctl ctl, gint val)
+{
+	const struct enc_map *map = get_map(enc, ctl);
+
+	if (!map)
+		return FALSE;
+
+	switch (map->kind) {
+	case PROP_INT:
+		g_object_set(enc, map->name, val * map->scale, NULL);
+		if (map->extra)
+			g_object_set(enc, map->extra, val * map->scale, NULL);
+		break;
+	case PROP_OPT:
+		set_option(enc, map->name, val * map->scale);
+		break;
+	case PROP_CTRL:
+		set_controls(enc, map, val * map->scale);
+		break;
+	default:
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/**
+ * enc_live
+ * Whether a change of 'ctl' still reaches 'enc' once it is running. V4L2
+ * controls go to the open device straight away.
+ */
+gboolean enc_live(GstElement *enc, enum enc_ctl ctl)
+{
+	const struct enc_map *map = get_map(enc, ctl);
+	GParamSpec *pspec;
+
+	if (!map)
+		return FALSE;
+	if (map->kind == PROP_CTRL)
+		return TRUE;
+
+	pspec = g_object_class_find_property(G_OBJECT_GET_CLASS(enc),
+					     (map->kind == PROP_INT) ?
+					     map->name : "option-string");
+
+	return pspec && (pspec->flags & GST_PARAM_MUTABLE_PLAYING);
+}
+
+/**
+ * enc_force_idr
+ * Ask 'enc' for an IDR (with SPS/PPS) as soon as possible
+ */
+gboolean enc_force_idr(GstElement *enc)
+{
+	GstPad *pad = gst_element_get_static_pad(enc, "src");
+	gboolean ret;
+
+	if (!pad)
+		return FALSE;
+
+	ret = gst_pad_send_event(pad,
+		gst_video_event_new_upstream_force_key_unit(
+			GST_CLOCK_TIME_NONE, TRUE, 0));
+	gst_object_unref(pad);
+
+	return ret;
+}
+
+const char *enc_ctl_str(enum enc_ctl ctl)
+{
+	switch (ctl) {
+	case ENC_BITRATE:
+		return "bitrate";
+	case ENC_QUANT:
+		return "quant-level";
+	case ENC_IDR:
+		return "idr-interval";
+	case ENC_SLICE_BYTES:
+		return "slice-size";
+	case ENC_BFRAMES:
+		return "b-frames";
+	case ENC_LOOKAHEAD:
+		return "lookahead";
+	case ENC_INTRA_REFRESH:
+		return "intra-refresh";
+	}
+
+	return "unknown";
+}
+
+/* encoder.c ends here */
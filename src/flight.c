@@ -0,0 +1,175 @@
+/**
+ * Filename: flight.c
+ * Description: Always-on in-memory flight recorder
+ * Created: Sat Oct 17 09:14:55 2026 (-0700)
+ * Version: 1.0
+ */
+
+/**
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/**
+ * A fixed array of events that any thread can add to without locking or
+ * allocating. A writer claims a slot with an atomic add, fills it in and
+ * then publishes the slot's sequence number. The dump copies each slot
+ * and only keeps it if the sequence number was the same before and after,
+ * so a slot being overwritten at the time is skipped rather than torn.
+ */
+
+#include <flight.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define FLIGHT_TEXT_MAX 64
+
+struct flight_entry {
+	guint seq;		/* Claim number + 1, 0 while being written */
+	gint64 time;		/* Monotonic, us */
+	enum flight_event ev;
+	gint a, b, c;
+	char text[FLIGHT_TEXT_MAX];
+};
+
+static struct {
+	guint next;		/* Next claim number (atomic) */
+	struct flight_entry ring[FLIGHT_SIZE];
+} fr;
+
+static const char *event_str(enum flight_event ev)
+{
+	switch (ev) {
+	case FLIGHT_CLIENT_CONNECT:
+		return "client-connect";
+	case FLIGHT_CLIENT_CLOSE:
+		return "client-close";
+	case FLIGHT_MEDIA_CONFIGURE:
+		return "media-configure";
+	case FLIGHT_BITRATE:
+		return "bitrate";
+	case FLIGHT_QUANT:
+		return "quant";
+	case FLIGHT_FEC:
+		return "fec";
+	case FLIGHT_BUS_WARNING:
+		return "bus-warning";
+	case FLIGHT_BUS_ERROR:
+		return "bus-error";
+	case FLIGHT_STAGE_FPS:
+		return "stage-fps";
+	case FLIGHT_QUEUE_LEVEL:
+		return "queue-level";
+	case FLIGHT_WATCHDOG:
+		return "watchdog";
+	case FLIGHT_DUMP:
+		return "dump";
+	case FLIGHT_RATE_SCALE:
+		return "rate-scale";
+	case FLIGHT_MOTION:
+		return "motion";
+	case FLIGHT_IDR:
+		return "idr";
+	case FLIGHT_TIMESHIFT:
+		return "timeshift";
+	case FLIGHT_CLIP:
+		return "clip";
+	}
+
+	return "unknown";
+}
+
+/**
+ * flight_record
+ * Add an event, callable from any thread. 'text' may be NULL and is
+ * truncated to FLIGHT_TEXT_MAX.
+ */
+void flight_record(enum flight_event ev, gint a, gint b, gint c,
+		   const char *text)
+{
+	guint n = g_atomic_int_add(&fr.next, 1);
+	struct flight_entry *e = &fr.ring[n & (FLIGHT_SIZE - 1)];
+
+	g_atomic_int_set(&e->seq, 0);
+	e->time = g_get_monotonic_time();
+	e->ev = ev;
+	e->a = a;
+	e->b = b;
+	e->c = c;
+	if (text)
+		g_strlcpy(e->text, text, sizeof(e->text));
+	else
+		e->text[0] = '\0';
+	g_atomic_int_set(&e->seq, n + 1);
+}
+
+/**
+ * flight_dump
+ * Write the last 'secs' seconds of events to a new file in 'dir'. Returns
+ * the file name (free with g_free()) or NULL if it couldn't be written.
+ * Not for streaming threads, it does file I/O.
+ */
+gchar *flight_dump(const char *dir, gint secs, const char *reason)
+{
+	gint64 now = g_get_monotonic_time();
+	gint64 wall = g_get_real_time();
+	struct flight_entry e;
+	guint end, n;
+	gchar *path;
+	FILE *f;
+
+	flight_record(FLIGHT_DUMP, 0, 0, 0, reason);
+
+	path = g_strdup_printf("%s/gst-variable-rtsp-server-%" G_GINT64_FORMAT
+			       ".flight", dir, wall / G_USEC_PER_SEC);
+	f = fopen(path, "w");
+	if (!f) {
+		g_free(path);
+		return NULL;
+	}
+
+	end = g_atomic_int_get(&fr.next);
+	for (n = (end > FLIGHT_SIZE) ? end - FLIGHT_SIZE : 0; n != end; n++) {
+		struct flight_entry *slot = &fr.ring[n & (FLIGHT_SIZE - 1)];
+		time_t t;
+		struct tm tm;
+		char ts[16];
+
+		if (g_atomic_int_get(&slot->seq) != n + 1)
+			continue;
+		memcpy(&e, slot, sizeof(e));
+		if (g_atomic_int_get(&slot->seq) != n + 1)
+			continue;
+		if (now - e.time > (gint64) secs * G_USEC_PER_SEC)
+			continue;
+
+		/* Monotonic to wall clock for the reader */
+		e.time += wall - now;
+		t = e.time / G_USEC_PER_SEC;
+		localtime_r(&t, &tm);
+		strftime(ts, sizeof(ts), "%H:%M:%S", &tm);
+		e.text[sizeof(e.text) - 1] = '\0';
+		fprintf(f, "%s.%03d %-16s %8d %8d %8d %s\n", ts,
+			(int) (e.time % G_USEC_PER_SEC / 1000),
+			event_str(e.ev), e.a, e.b, e.c, e.text);
+	}
+
+	fclose(f);
+
+	return path;
+}
+
+/* flight.c ends here */
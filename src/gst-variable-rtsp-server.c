@@ -31,16 +31,40 @@
 #define VERSION "1.4"
 #endif
 
+#include <capture-ext.h>
+#include <clip.h>
 #include <ecode.h>
+#include <encoder.h>
+#include <flight.h>
+#include <history.h>
+#include <hls.h>
+#include <http.h>
+#include <log.h>
+#include <quality-sampler.h>
+#include <motion.h>
+#include <rate-stats.h>
+#include <recorder.h>
+#include <rtcp-stats.h>
+#include <rtp-batch.h>
+#include <shm-stats.h>
+#include <snapshot.h>
+#include <sock-tune.h>
+#include <stage-stats.h>
+#include <timeshift.h>
+#include <webrtc.h>
+#include <trace.h>
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <getopt.h>
+#include <signal.h>
+#include <math.h>
 
 #include <gst/gst.h>
 #include <gst/rtsp-server/rtsp-server.h>
 #include <glib.h>
+#include <glib-unix.h>
 
 /**
  * gstreamer rtph264pay:
@@ -52,7 +76,9 @@
  *  - mount_point: Server mount point
  *  - host: local host name
  *  - src_element: GStreamer element to act as a source
- *  - sink pipeline: Static pipeline to take source to rtsp server
+ *  - enc_element: GStreamer H.264 encoder element
+ *  - sink pipeline: Static pipeline to take source to rtsp server, the
+ *                   '%s' are where low latency queues go and the encoder
  */
 #define DEFAULT_CONFIG_INTERVAL "2"
 #define DEFAULT_IDR_INTERVAL    "0"
@@ -60,11 +86,201 @@
 #define DEFAULT_MOUNT_POINT     "/stream"
 #define DEFAULT_HOST            "127.0.0.1"
 #define DEFAULT_SRC_ELEMENT     "v4l2src"
+#define DEFAULT_ENC_ELEMENT     "imxvpuenc_h264"
+#define DEFAULT_MTU             "1400"
 #define STATIC_SINK_PIPELINE			\
-	" imxipuvideotransform name=caps0 !"	\
-	" imxvpuenc_h264 name=enc0 !"		\
+	"%s imxipuvideotransform name=caps0 !"	\
+	"%s %s name=enc0 !"			\
 	" rtph264pay name=pay0 pt=96"
 
+/**
+ * Low latency mode:
+ *  - Never hold more than one frame between capture, transform and
+ *    encode. When a stage stalls the oldest frame is dropped instead of
+ *    queueing up or blocking the capture driver.
+ *  - RTP latency (ms) given to the media
+ */
+#define LOW_LATENCY_QUEUE(name)					\
+	" queue name=" name " max-size-buffers=1 max-size-bytes=0"	\
+	" max-size-time=0 leaky=downstream !"
+#define LOW_LATENCY_MS 20
+
+/* RTP header plus room for header extensions, subtracted for slice size */
+#define RTP_OVERHEAD 28
+
+/**
+ * Loss protection:
+ *  - rtx-time: How long sent packets are kept around for retransmission
+ *  - fec: Max ULPFEC percentage (FEC packets per 100 media packets). The
+ *         current percentage follows the worst client's RTCP fraction-lost
+ *         times FEC_LOSS_GAIN, in FEC_STEP increments.
+ */
+#define DEFAULT_RTX_TIME "0"
+#define DEFAULT_FEC      "0"
+#define ULPFEC_PT        122
+#define FEC_LOSS_GAIN    3
+#define FEC_STEP         5
+
+/**
+ * Rate accuracy, produced vs. target bitrate at enc0's src pad:
+ *  - RATE_SMOOTH: Seconds the actual/target ratio is averaged over
+ *  - rate-correct: When the ratio stays more than RATE_TOLERANCE off for
+ *                  RATE_PERSIST_SECS, scale the bitrate handed to the
+ *                  encoder by 1/ratio. Only ever below the target, never
+ *                  under RATE_SCALE_MIN of it.
+ */
+#define RATE_SMOOTH       4
+#define RATE_TOLERANCE    0.10
+#define RATE_PERSIST_SECS 5
+#define RATE_SCALE_MIN    0.5
+
+/**
+ * Quality sampling (off unless an interval is given):
+ *  - quality: Seconds between samples
+ *  - quality-frames: Frames decoded and scored per sample, the CPU budget
+ */
+#define DEFAULT_QUALITY        "0"
+#define DEFAULT_QUALITY_FRAMES "4"
+
+/**
+ * Motion adaptation (off unless a percentage is given):
+ *  - motion-adapt: Percent of the bitrate a still scene is encoded at. In
+ *                  quant mode the quant level moves the rest of the way
+ *                  towards max-quant-lvl instead.
+ *  - motion-threshold: Mean absolute luma difference per pixel between
+ *                      frames (0-255) that counts as motion
+ */
+#define DEFAULT_MOTION_ADAPT     "0"
+#define DEFAULT_MOTION_THRESHOLD "2.0"
+
+/**
+ * Static frame skipping (off unless an interval is given):
+ *  - skip-static: Longest time in ms frames may be skipped in a row, so
+ *                 clients keep getting something
+ *  - skip-threshold: Score against the last encoded frame below which a
+ *                    frame is not worth encoding
+ */
+#define DEFAULT_SKIP_STATIC    "0"
+#define DEFAULT_SKIP_THRESHOLD "1.0"
+
+/**
+ * Flight recorder:
+ *  - flight-dir: Where dumps are written
+ *  - flight-secs: How far back a dump goes
+ *  - WATCHDOG_SECS: Seconds without a frame leaving pay0 while clients are
+ *                   connected before a dump is taken
+ */
+#define DEFAULT_FLIGHT_DIR  "/tmp"
+#define DEFAULT_FLIGHT_SECS "60"
+#define WATCHDOG_SECS       5
+
+/**
+ * HTTP queries (off unless a port is given):
+ *  - /stats?res=1s|1m|1h&since=<unix time>: statistics history as JSON
+ *  - /snapshot.jpg: latest frame, with --snapshot
+ *  - /clip.mp4?t=<unix time>&before=<s>&after=<s>: MP4 remuxed from the
+ *    timeshift around t (default now), with --timeshift. CLIP_SLACK_US
+ *    is how long after t + after a clip waits for its last frame.
+ */
+#define DEFAULT_HTTP_PORT "0"
+#define DEFAULT_HTTP_ADDR "127.0.0.1"
+#define CLIP_BEFORE       10
+#define CLIP_AFTER        10
+#define CLIP_SLACK_US     2000000
+
+/**
+ * Automatic IDR interval (off unless a short interval is given):
+ *  - idr-auto: Frames between IDRs while clients join or report loss. A
+ *              joining client also gets an IDR right away. Every
+ *              IDR_STABLE_SECS without either the interval doubles, up
+ *              to --idr (IDR_AUTO_MAX when that is 0).
+ *  - IDR_LOSS: Smoothed worst client loss that counts as unstable
+ */
+#define DEFAULT_IDR_AUTO "0"
+#define IDR_AUTO_MAX     300
+#define IDR_STABLE_SECS  30
+#define IDR_LOSS         0.01
+
+/**
+ * Key frame requests (RTSP joins, HLS segments, WebRTC PLI/FIR):
+ *  - IDR_COALESCE_MS: Requests closer together than this share one IDR
+ */
+#define IDR_COALESCE_MS 300
+
+/**
+ * Intra refresh (off unless a period is given):
+ *  - intra-refresh: Frames per refresh cycle. Instead of whole IDR frames
+ *                   a band of intra blocks sweeps over the picture, a
+ *                   client can decode once it has seen a full cycle.
+ *                   SPS/PPS go out every IR_CONFIG_INTERVAL seconds at
+ *                   least, there are no IDRs to carry them.
+ */
+#define DEFAULT_INTRA_REFRESH "0"
+#define IR_CONFIG_INTERVAL    1
+
+/**
+ * Timeshift (off unless a length is given):
+ *  - timeshift: Seconds of encoded video kept in memory. Each client of
+ *               <mount point>TIMESHIFT_MOUNT gets a media of its own
+ *               replaying it from where its PLAY Range asks for.
+ *  - timeshift-mb: Memory the frames may take, whichever limit is hit
+ *                  first drops the oldest ones
+ */
+#define DEFAULT_TIMESHIFT    "0"
+#define DEFAULT_TIMESHIFT_MB "32"
+#define TIMESHIFT_MOUNT      "/timeshift"
+#define TIMESHIFT_PIPELINE					\
+	"( appsrc name=tsrc0 is-live=true format=time block=true !"	\
+	" rtph264pay name=pay0 pt=96 config-interval=%d mtu=%d )"
+#define TIMESHIFT_KEY        "timeshift"
+#define LIVE_KEY             "live"
+
+/**
+ * Recording (off unless a directory is given):
+ *  - record: Directory the segments and their key frame indexes go to
+ *  - record-secs: Segment length, segments start on a key frame
+ *  - record-format: mkv or mp4 (fragmented)
+ *  - record-max-mb/hours: Retention, the oldest segments are removed
+ *                         once either is exceeded, 0 == no limit
+ *  - RECORD_PREALLOC_PCT: Space reserved per segment, in percent of what
+ *                         --max-bitrate takes for a segment
+ *  - RECORD_PREALLOC_MAX: Most space reserved per segment, however long
+ *                         or fast
+ */
+#define DEFAULT_RECORD_SECS      "60"
+#define DEFAULT_RECORD_FORMAT    "mkv"
+#define DEFAULT_RECORD_MAX_MB    "1024"
+#define DEFAULT_RECORD_MAX_HOURS "0"
+#define RECORD_PREALLOC_PCT      125
+#define RECORD_PREALLOC_MAX      (1024 << 20)
+
+/**
+ * HLS (off unless asked for, needs --http-port):
+ *  - hls: Serve Low-Latency HLS at HLS_PATH of the HTTP port, cut from
+ *         enc0's output without another encode
+ *  - hls-segment: Segment length in seconds, segments start on a key
+ *                 frame and ask for one when the GOP is longer
+ *  - hls-part: Longest part in ms, parts are what players fetch ahead
+ *  - hls-weight: Percent of an RTSP client each HLS viewer counts for
+ *                in the bitrate/quant steps, 0 == they don't
+ */
+#define DEFAULT_HLS_SEGMENT "4"
+#define DEFAULT_HLS_PART    "500"
+#define DEFAULT_HLS_WEIGHT  "0"
+#define HLS_PATH            "/hls/"
+
+/**
+ * WebRTC (off unless asked for, needs --http-port):
+ *  - webrtc: POST an SDP offer to WEBRTC_PATH for an answer, DELETE the
+ *            WEBRTC_PATH/<id> it names to hang up. Peers get enc0's
+ *            output without another encode and count as clients.
+ *  - webrtc-stun: STUN server URI, stun://host:port, host candidates
+ *                 only without one
+ *  - webrtc-max: Most peers at once
+ */
+#define DEFAULT_WEBRTC_MAX "4"
+#define WEBRTC_PATH        "/webrtc"
+
 /* Default quality 'steps' */
 #define DEFAULT_STEPS "5"
 
@@ -94,6 +310,9 @@
 enum {pipeline=0, source, caps, encoder, protocol, sink};
 #define NUM_ELEM (source + sink)
 
+/* Periodic handlers run while someone is watching, see start_handlers */
+#define NUM_HANDLERS 6
+
 struct stream_info {
 	gint num_cli;		      /* Number of clients */
 	GMainLoop *main_loop;	      /* Main loop pointer */
@@ -104,9 +323,23 @@ struct stream_info {
 	GstRTSPMedia *media;	      /* RTSP Media */
 	GstElement **stream;	      /* Array of elements */
 	gboolean connected;	      /* Flag to see if this is in use */
+	guint handlers[NUM_HANDLERS]; /* Periodic sources while in use */
+	guint n_handlers;
 	gchar *video_in;	      /* Video in device */
 	gint config_interval;	      /* RTP Send Config Interval */
 	gint idr;		      /* Interval betweeen IDR frames */
+	gint idr_auto;		      /* Short interval, 0 = fixed --idr */
+	gint idr_curr;		      /* Interval in use in auto mode */
+	gboolean idr_live;	      /* Encoder takes interval changes */
+	gboolean idr_churn;	      /* A client joined since last check */
+	gint idr_stable;	      /* Seconds without churn or loss */
+	gint idr_frames;	      /* enc0 frame total a second ago */
+	gint idr_count;		      /* Frames since the last forced IDR */
+	gint idr_pending;	      /* An IDR request is queued (atomic) */
+	gint64 idr_last;	      /* When the last one was forced */
+	gint idr_requests;	      /* IDRs asked for (atomic) */
+	gint idr_forced;	      /* IDRs forced for them */
+	gint intra_refresh;	      /* Frames per refresh cycle, 0 = off */
 	gint steps;		      /* Steps to scale quality at */
 	gint min_quant_lvl;	      /* Min Quant Level */
 	gint max_quant_lvl;	      /* Max Quant Level */
@@ -115,36 +348,103 @@ struct stream_info {
 	gint max_bitrate;	      /* Max Bitrate */
 	gint curr_bitrate;	      /* Current Bitrate */
 	gint msg_rate;		      /* In Seconds */
+	gint mtu;		      /* Max RTP packet size */
+	gboolean slice_mtu;	      /* Encode slices that fit the MTU */
+	struct rtp_batch batch;	      /* RTP counters and batching */
+	gint rtx_time;		      /* Retransmission history in ms */
+	gint fec_max;		      /* Max ULPFEC percentage, 0 = off */
+	gint fec_pct;		      /* Current ULPFEC percentage */
+	gdouble loss;		      /* Smoothed worst client loss */
+	struct rtcp_stats rtcp;	      /* Last receiver report snapshot */
+	struct sock_tune tune;	      /* Transport socket options */
+	gboolean low_latency;	      /* Bounded queues, no B-frames */
+	struct stage_stats stages;    /* Capture latency per element */
+	gboolean capture_ext;	      /* Send abs-capture-time */
+	gchar *flight_dir;	      /* Flight recorder dump directory */
+	gint flight_secs;	      /* Seconds of events per dump */
+	gint stage_total[NUM_STAGES]; /* Frame counts a second ago */
+	gint stall;		      /* Seconds without output */
+	gint dump_pending;	      /* Error dump queued (atomic) */
+	struct history *history;      /* Statistics history */
+	gint hist_frames;	      /* pay0 frame total a second ago */
+	gint hist_bytes;	      /* RTP byte total a second ago */
+	struct http_server http;      /* Local queries */
+	struct shm_stats *shm;	      /* Shared memory statistics */
+	struct rate_stats rate;	      /* Encoded bitrate and frame sizes */
+	gboolean rate_correct;	      /* Trim the encoder on overshoot */
+	gint enc_target;	      /* Bitrate the encoder should produce */
+	gdouble rate_scale;	      /* Correction applied to enc_target */
+	gdouble rate_ratio;	      /* Smoothed actual/target bitrate */
+	gint rate_persist;	      /* Seconds over (>0) or under (<0) */
+	gint rate_total;	      /* enc0 byte total a second ago */
+	gint quality_secs;	      /* Seconds between quality samples */
+	gint quality_frames;	      /* Frames scored per sample */
+	struct quality_sampler *quality; /* PSNR/SSIM sampler */
+	gint motion_pct;	      /* Still scene bitrate, 0 = off */
+	struct motion motion;	      /* Frame difference analyzer */
+	gboolean motion_on;	      /* Analyzer needed (adapt or skip) */
+	GMutex enc_lock;	      /* Encoder rate settings, see apply_*.
+				       * Taken to write curr_bitrate,
+				       * curr_quant_lvl, fec_pct and
+				       * rate_scale, the main loop may read
+				       * them without it. Also taken to
+				       * free 'stream'. */
+	gboolean always_on;	      /* Keep the media running, no clients */
+	struct snapshot *snapshot;    /* Latest frame for /snapshot.jpg */
+	gint timeshift_secs;	      /* Seconds kept, 0 = off */
+	gint timeshift_mb;	      /* Memory for them */
+	struct timeshift *timeshift;  /* Encoded frames to replay */
+	gchar *timeshift_mount;	      /* Where replays are served */
+	gchar *record_dir;	      /* Recording directory, NULL = off */
+	gint record_secs;	      /* Segment length */
+	enum record_format record_format;
+	gint record_max_mb;	      /* Retention by size */
+	gint record_max_hours;	      /* Retention by age */
+	gboolean record_direct;	      /* Write segments with O_DIRECT */
+	struct recorder *recorder;    /* Segments on disk */
+	gboolean hls_on;	      /* Serve HLS */
+	gint hls_segment;	      /* Segment length in seconds */
+	gint hls_part;		      /* Part length in ms */
+	gint hls_weight;	      /* Percent of a client per viewer */
+	gint hls_load;		      /* Viewers in clients */
+	struct hls *hls;	      /* Segments in memory */
+	gboolean webrtc_on;	      /* Serve WebRTC */
+	gchar *webrtc_stun;	      /* STUN server, NULL = none */
+	gint webrtc_max;	      /* Most peers */
+	gint webrtc_load;	      /* Connected peers */
+	struct webrtc *webrtc;	      /* Peers */
 };
 
 /* Global Variables */
 static unsigned int g_dbg = 0;
 
-#define dbg(lvl, fmt, ...) _dbg (__func__, __LINE__, lvl, fmt, ##__VA_ARGS__)
-void _dbg(const char *func, unsigned int line,
-	  unsigned int lvl, const char *fmt, ...)
-{
-	if (g_dbg >= lvl) {
-		va_list ap;
-		printf("[%d]:%s:%d - ", lvl, func, line);
-		va_start(ap, fmt);
-		vprintf(fmt, ap);
-		fflush(stdout);
-		va_end(ap);
-	}
-}
+/**
+ * Debug levels above DBG_MAX_LEVEL are compiled out entirely, the rest
+ * are queued to the log writer (rate limited per call site) so callers
+ * never block on output.
+ */
+#ifndef DBG_MAX_LEVEL
+#define DBG_MAX_LEVEL 4
+#endif
+
+#define dbg(lvl, fmt, ...) do {						\
+	static struct log_site _site;					\
+	if ((lvl) <= DBG_MAX_LEVEL && g_dbg >= (lvl))			\
+		log_write(&_site, LOG_DEBUG, "[%d]:%s:%d - " fmt, lvl,	\
+			  __func__, __LINE__, ##__VA_ARGS__);		\
+} while (0)
 
 static gboolean periodic_msg_handler(struct stream_info *si)
 {
 	dbg(4, "called\n");
 
-	if (si->connected == FALSE) {
-		dbg(2, "Destroying 'periodic message' handler\n");
-		return FALSE;
-	}
-
+	/* Only started with a message rate */
 	if (si->msg_rate > 0) {
 		GstStructure *stats;
+		struct stage_sample stage[NUM_STAGES];
+		struct rate_sample rate;
+		struct quality_result quality;
+		guint i;
 		g_print("### MSG BLOCK ###\n");
 		g_print("Number of Clients    : %d\n", si->num_cli);
 		g_print("Current Quant Level  : %d\n", si->curr_quant_lvl);
@@ -152,9 +452,153 @@ static gboolean periodic_msg_handler(struct stream_info *si)
 		g_print("Step Factor          : %d\n", (si->curr_bitrate) ?
 			((si->max_bitrate - si->min_bitrate) / si->steps) :
 			((si->max_quant_lvl - si->min_quant_lvl) / si->steps));
+		if (si->idr_auto)
+			g_print("IDR Interval         : %d (auto%s, stable %ds)"
+				"\n", si->idr_curr, (si->idr_live) ? "" :
+				", forced", si->idr_stable);
+
+		gint sends, packets, frames;
+
+		rtp_batch_sample(&si->batch, &sends, &packets, &frames);
+		g_print("RTP Packets per Frame: %.1f\n", (frames) ?
+			(gdouble) packets / frames : 0);
+		if (si->batch.enabled)
+			g_print("RTP Packets per Send : %.1f\n", (sends) ?
+				(gdouble) packets / sends : 0);
+
+		rate_stats_sample(&si->rate, &rate);
+		g_print("Encoded Bitrate      : %.0f", rate.kbps);
+		if (si->enc_target)
+			g_print(" (%.0f%% of %d, x%.2f)", rate.kbps * 100 /
+				si->enc_target, si->enc_target,
+				si->rate_scale);
+		g_print("\n");
+		g_print("Frame Size           : n, avg/p50/p95/max KB\n");
+		for (i = 0; i < NUM_FRAME_TYPES; i++)
+			g_print("  %-8s %5d %7.1f %7.1f %7.1f %7.1f\n",
+				frame_type_str(i), rate.type[i].frames,
+				rate.type[i].avg_kb, rate.type[i].p50_kb,
+				rate.type[i].p95_kb, rate.type[i].max_kb);
+		if (rate.type[FRAME_KEY].frames &&
+		    rate.type[FRAME_DELTA].avg_kb > 0)
+			g_print("IDR / Avg P Frame    : %.1f\n",
+				rate.type[FRAME_KEY].avg_kb /
+				rate.type[FRAME_DELTA].avg_kb);
+		g_print("Peak / Avg Frame     : %.1f\n", rate.peak_avg);
+
+		if (si->motion_on) {
+			struct motion_sample ms;
+
+			motion_sample(&si->motion, &ms);
+			g_print("Motion Score         : %.2f avg, %.2f max%s\n",
+				ms.score_avg, ms.score_max,
+				g_atomic_int_get(&si->motion.still) ?
+				" (still)" : "");
+			g_print("Motion Analyzer      : %.0fus/frame, %.1f%% "
+				"cpu (%s)\n", ms.cost_us, ms.load_pct,
+				quality_simd());
+			if (si->motion.skip_max_us)
+				g_print("Skipped Frames       : %d of %d "
+					"(%.0f%%)\n", ms.skipped, ms.frames,
+					(ms.frames) ? ms.skipped * 100.0 /
+					ms.frames : 0);
+		}
 
-		g_object_get(G_OBJECT(si->stream[protocol]), "stats", &stats,
-			     NULL);
+		if (si->timeshift) {
+			gsize bytes;
+			gdouble secs = timeshift_held(si->timeshift, &bytes);
+
+			g_print("Timeshift            : %.1fs in %.1fMB\n",
+				secs, bytes / (1024.0 * 1024.0));
+		}
+
+		if (si->recorder) {
+			struct recorder *rec = si->recorder;
+			guint segments;
+			guint64 bytes;
+			gint64 oldest;
+
+			recorder_held(rec, &segments, &bytes, &oldest);
+			g_print("Recording            : %u segments, %.1fMB, "
+				"%.1fh\n", segments, bytes / (1024.0 * 1024.0),
+				(oldest) ? (g_get_real_time() - oldest) /
+				(3600.0 * G_USEC_PER_SEC) : 0);
+			g_print("Recording Writer     : slowest %.1fms, "
+				"%d dropped, %d errors, %d removed\n",
+				g_atomic_int_get(&rec->write_max_us) / 1000.0,
+				g_atomic_int_get(&rec->dropped),
+				g_atomic_int_get(&rec->errors),
+				g_atomic_int_get(&rec->removed));
+		}
+
+		if (si->hls) {
+			guint segments;
+			guint64 bytes;
+
+			hls_held(si->hls, &segments, &bytes);
+			g_print("HLS                  : %u viewers (load %d), "
+				"%u segments, %.1fMB, %d requests, %d "
+				"dropped\n", hls_viewers(si->hls), si->hls_load,
+				segments, bytes / (1024.0 * 1024.0),
+				g_atomic_int_get(&si->hls->requests),
+				g_atomic_int_get(&si->hls->dropped));
+		}
+
+		if (si->webrtc) {
+			struct webrtc *w = si->webrtc;
+			guint peers, connected;
+
+			peers = webrtc_peers(w, &connected);
+			g_print("WebRTC               : %u peers (%u connected), "
+				"%d signalled, %d failed, %d dropped, %d "
+				"PLI/FIR\n", peers, connected,
+				g_atomic_int_get(&w->signalled),
+				g_atomic_int_get(&w->failed),
+				g_atomic_int_get(&w->dropped),
+				g_atomic_int_get(&w->key_requests));
+		}
+
+		gint dropped, truncated;
+
+		log_lost(&dropped, &truncated);
+		if (dropped || truncated)
+			g_print("Log                  : %d dropped, %d "
+				"truncated\n", dropped, truncated);
+
+		if (g_atomic_int_get(&si->idr_requests))
+			g_print("IDR Requests         : %d, %d forced\n",
+				g_atomic_int_get(&si->idr_requests),
+				si->idr_forced);
+
+		if (si->quality &&
+		    quality_sampler_result(si->quality, &quality))
+			g_print("Quality (PSNR/SSIM)  : %.1fdB/%.3f, min "
+				"%.1fdB/%.3f over %d frames\n", quality.psnr,
+				quality.ssim, quality.psnr_min,
+				quality.ssim_min, quality.frames);
+
+		stage_stats_sample(&si->stages, stage);
+		g_print("Capture Latency      : p50/p99/max ms, fps\n");
+		for (i = 0; i < NUM_STAGES; i++)
+			g_print("  %-8s %7.1f %7.1f %7.1f %6.1f\n",
+				stage_str(i), stage[i].p50_ms, stage[i].p99_ms,
+				stage[i].max_ms, stage[i].fps);
+
+		g_print("Client Loss (max/avg): %.1f%%/%.1f%%\n",
+			si->rtcp.max_loss * 100, si->rtcp.avg_loss * 100);
+		if (si->fec_max)
+			g_print("FEC Percentage       : %d\n", si->fec_pct);
+		for (i = 0; i < si->rtcp.n; i++)
+			g_print("  %-24s loss %5.1f%% rtt %6.1fms "
+				"jitter %6.1fms\n", si->rtcp.cli[i].addr,
+				si->rtcp.cli[i].loss * 100,
+				si->rtcp.cli[i].rtt_ms,
+				si->rtcp.cli[i].jitter_ms);
+
+		stats = NULL;
+		if (si->stream)
+			g_object_get(G_OBJECT(si->stream[protocol]), "stats",
+				     &stats, NULL);
 		if (stats) {
 			g_print("General RTSP Stats   : %s\n",
 				gst_structure_to_string(stats));
@@ -162,14 +606,562 @@ static gboolean periodic_msg_handler(struct stream_info *si)
 		}
 
 		g_print("\n");
-	} else {
-		dbg(2, "Destroying 'periodic message' handler\n");
+	}
+
+	return TRUE;
+}
+
+/**
+ * apply_bitrate
+ * The bitrate levels are a budget for everything we send. Hand the encoder
+ * what is left of it once FEC packets have been paid for, less still
+ * more while the scene is still.
+ *
+ * The motion analyzer calls this from the streaming thread, hence the
+ * lock around the encoder settings.
+ */
+static void apply_bitrate(struct stream_info *si)
+{
+	gboolean still = g_atomic_int_get(&si->motion.still);
+	gint br;
+
+	g_mutex_lock(&si->enc_lock);
+	si->enc_target = (gint64) si->curr_bitrate * 100 / (100 + si->fec_pct);
+	if (si->motion_pct && still)
+		si->enc_target = (gint64) si->enc_target * si->motion_pct / 100;
+	br = si->enc_target * si->rate_scale;
+
+	dbg(3, "Encoder bitrate %d (budget %d, fec %d%%, scale %.2f%s)\n", br,
+	    si->curr_bitrate, si->fec_pct, si->rate_scale,
+	    (si->motion_pct && still) ? ", still" : "");
+	/* The media may have just been unprepared */
+	if (si->stream)
+		enc_set(si->stream[encoder], ENC_BITRATE, br);
+	g_mutex_unlock(&si->enc_lock);
+}
+
+/**
+ * apply_quant
+ * Same as apply_bitrate for quant mode, a still scene moves the quant level
+ * the rest of the way towards max-quant-lvl.
+ */
+static void apply_quant(struct stream_info *si)
+{
+	gint q;
+
+	g_mutex_lock(&si->enc_lock);
+	q = si->curr_quant_lvl;
+	if (si->motion_pct && g_atomic_int_get(&si->motion.still))
+		q += (si->max_quant_lvl - q) * (100 - si->motion_pct) / 100;
+
+	dbg(3, "Encoder quant-param %d (level %d)\n", q, si->curr_quant_lvl);
+	if (si->stream)
+		enc_set(si->stream[encoder], ENC_QUANT, q);
+	g_mutex_unlock(&si->enc_lock);
+}
+
+/**
+ * motion_handler
+ * The scene went still or started moving. Runs on the streaming thread
+ * ahead of the frame that changed it, so the first moving frame is
+ * already encoded at the full rate.
+ */
+static void motion_handler(gboolean still, gdouble score,
+			   struct stream_info *si)
+{
+	if (!si->connected)
+		return;
+
+	dbg(1, "Scene is %s (score %.2f)\n", (still) ? "still" : "moving",
+	    score);
+	flight_record(FLIGHT_MOTION, still, score * 100, si->num_cli, NULL);
+
+	if (si->curr_bitrate)
+		apply_bitrate(si);
+	else
+		apply_quant(si);
+}
+
+/**
+ * rate_handler
+ * Compare what enc0 produced in the last second with what it was asked
+ * for and, with --rate-correct, lean on the encoder when it persistently
+ * overshoots. Corrections wait for the ratio to settle again, rate
+ * control needs a moment to react.
+ */
+static gboolean rate_handler(struct stream_info *si)
+{
+	gint total = g_atomic_int_get(&si->rate.total);
+	gdouble kbps = (guint) (total - si->rate_total) * 8 / 1000.0;
+	gdouble ratio, scale;
+
+	dbg(4, "called\n");
+
+	si->rate_total = total;
+	if (!si->enc_target)
+		return TRUE;
+
+	ratio = kbps / si->enc_target;
+	si->rate_ratio = (si->rate_ratio * (RATE_SMOOTH - 1) + ratio) /
+		RATE_SMOOTH;
+
+	if (!si->rate_correct)
+		return TRUE;
+
+	if (si->rate_ratio > 1 + RATE_TOLERANCE)
+		si->rate_persist = MAX(si->rate_persist, 0) + 1;
+	else if (si->rate_ratio < 1 - RATE_TOLERANCE && si->rate_scale < 1)
+		si->rate_persist = MIN(si->rate_persist, 0) - 1;
+	else
+		si->rate_persist = 0;
+
+	if (ABS(si->rate_persist) < RATE_PERSIST_SECS)
+		return TRUE;
+
+	scale = CLAMP(si->rate_scale / si->rate_ratio, RATE_SCALE_MIN, 1.0);
+	if (scale != si->rate_scale) {
+		g_print("[%d]Encoder at %.0f%% of %d, scaling bitrate by "
+			"%.2f\n", si->num_cli, si->rate_ratio * 100,
+			si->enc_target, scale);
+		flight_record(FLIGHT_RATE_SCALE, si->rate_scale * 100,
+			      scale * 100, si->rate_ratio * 100, NULL);
+		g_mutex_lock(&si->enc_lock);
+		si->rate_scale = scale;
+		g_mutex_unlock(&si->enc_lock);
+		apply_bitrate(si);
+	}
+	si->rate_persist = 0;
+	si->rate_ratio = 1.0;
+
+	return TRUE;
+}
+
+/**
+ * set_fec
+ * Apply the ULPFEC percentage to every stream of the current media
+ */
+static void set_fec(struct stream_info *si, gint pct)
+{
+	guint i;
+
+	g_mutex_lock(&si->enc_lock);
+	si->fec_pct = pct;
+	g_mutex_unlock(&si->enc_lock);
+	for (i = 0; si->media && i < gst_rtsp_media_n_streams(si->media); i++)
+		gst_rtsp_stream_set_ulpfec_percentage(
+			gst_rtsp_media_get_stream(si->media, i), pct);
+
+	if (si->curr_bitrate)
+		apply_bitrate(si);
+}
+
+/**
+ * loss_handler
+ * Poll the clients' receiver reports and size FEC to the worst one
+ */
+static gboolean loss_handler(struct stream_info *si)
+{
+	gint pct;
+
+	dbg(4, "called\n");
+
+	rtcp_stats_collect(si->media, &si->rtcp);
+
+	/* React to bursts right away, back off slowly */
+	if (si->rtcp.max_loss > si->loss)
+		si->loss = si->rtcp.max_loss;
+	else
+		si->loss = (si->loss * 7 + si->rtcp.max_loss) / 8;
+
+	if (!si->fec_max)
+		return TRUE;
+
+	/*
+	 * Round up to the next step so any loss gets some protection. Loss
+	 * decayed below half of RTCP's 1/256 resolution counts as none.
+	 */
+	if (si->loss < 1.0 / 512)
+		pct = 0;
+	else
+		pct = ((gint) ceil(si->loss * 100 * FEC_LOSS_GAIN) +
+		       FEC_STEP - 1) / FEC_STEP * FEC_STEP;
+	if (pct > si->fec_max)
+		pct = si->fec_max;
+
+	if (pct != si->fec_pct) {
+		TRACE2(fec_change, si->fec_pct, pct);
+		flight_record(FLIGHT_FEC, si->fec_pct, pct, si->num_cli, NULL);
+		g_print("[%d]Changing fec from %d%% to %d%% (loss %.1f%%)\n",
+			si->num_cli, si->fec_pct, pct, si->loss * 100);
+		set_fec(si, pct);
+	}
+
+	return TRUE;
+}
+
+/**
+ * set_idr
+ * Change the automatic IDR interval. Encoders that can't take it while
+ * running keep the long interval and idr_handler forces the extra IDRs.
+ */
+static void set_idr(struct stream_info *si, gint idr)
+{
+	if (idr == si->idr_curr)
+		return;
+
+	g_print("[%d]Changing idr interval from %d to %d\n", si->num_cli,
+		si->idr_curr, idr);
+	flight_record(FLIGHT_IDR, si->idr_curr, idr, si->num_cli, NULL);
+	si->idr_curr = idr;
+	if (si->idr_live && si->stream)
+		enc_set(si->stream[encoder], ENC_IDR, idr);
+}
+
+/**
+ * idr_request_handler
+ * Force the IDR asked for, or wait until IDR_COALESCE_MS after the last
+ * one. Requests made meanwhile are served by it.
+ */
+static gboolean idr_request_handler(struct stream_info *si)
+{
+	gint64 wait = si->idr_last + IDR_COALESCE_MS * 1000 -
+		g_get_monotonic_time();
+
+	if (wait > 0) {
+		g_timeout_add(wait / 1000 + 1,
+			      (GSourceFunc) idr_request_handler, si);
 		return FALSE;
 	}
+	g_atomic_int_set(&si->idr_pending, FALSE);
+
+	/* The encoder goes with the media */
+	if (!si->stream)
+		return FALSE;
+
+	dbg(3, "Forcing IDR after %d frames\n", si->idr_count);
+	enc_force_idr(si->stream[encoder]);
+	si->idr_last = g_get_monotonic_time();
+	si->idr_count = 0;
+	si->idr_forced++;
+
+	return FALSE;
+}
+
+/**
+ * request_idr
+ * Ask enc0 for an IDR, from any thread. Forced on the main loop right
+ * away when called from it, requests closer together than
+ * IDR_COALESCE_MS share one.
+ */
+static void request_idr(struct stream_info *si)
+{
+	g_atomic_int_inc(&si->idr_requests);
+	if (g_atomic_int_compare_and_exchange(&si->idr_pending, FALSE, TRUE))
+		g_main_context_invoke(NULL, (GSourceFunc) idr_request_handler,
+				      si);
+}
+
+/**
+ * idr_handler
+ * Short IDR intervals while the audience changes or loses packets, so
+ * joins and recovery are quick, long ones once it has settled
+ */
+static gboolean idr_handler(struct stream_info *si)
+{
+	gint max = (si->idr) ? si->idr : IDR_AUTO_MAX;
+	gint frames = g_atomic_int_get(&si->stages.hist[STAGE_ENCODER].total);
+
+	dbg(4, "called\n");
+
+	si->idr_count += frames - si->idr_frames;
+	si->idr_frames = frames;
+
+	if (si->idr_churn || si->loss > IDR_LOSS) {
+		si->idr_churn = FALSE;
+		si->idr_stable = 0;
+		set_idr(si, si->idr_auto);
+	} else if (++si->idr_stable >= IDR_STABLE_SECS) {
+		si->idr_stable = 0;
+		set_idr(si, MIN(si->idr_curr * 2, max));
+	}
+
+	/* To the second is close enough for a GOP */
+	if (!si->idr_live && si->idr_curr < max &&
+	    si->idr_count >= si->idr_curr)
+		request_idr(si);
+
+	return TRUE;
+}
+
+/**
+ * quality_handler
+ * Take a PSNR/SSIM sample every --quality seconds
+ */
+static gboolean quality_handler(struct stream_info *si)
+{
+	dbg(4, "called\n");
+
+	quality_sampler_trigger(si->quality);
 
 	return TRUE;
 }
 
+/**
+ * dump_flight
+ * Write out the flight recorder and tell the user where it went
+ */
+static void dump_flight(struct stream_info *si, const char *reason)
+{
+	gchar *path = flight_dump(si->flight_dir, si->flight_secs, reason);
+
+	if (path)
+		g_print("Flight recorder (%s) written to %s\n", reason, path);
+	else
+		g_printerr("Couldn't write flight recorder to %s\n",
+			   si->flight_dir);
+	g_free(path);
+}
+
+static gboolean bus_error_dump(struct stream_info *si)
+{
+	dump_flight(si, "pipeline error");
+	g_atomic_int_set(&si->dump_pending, 0);
+
+	return FALSE;
+}
+
+static gboolean sigusr1_handler(struct stream_info *si)
+{
+	dump_flight(si, "SIGUSR1");
+
+	return TRUE;
+}
+
+/**
+ * quit_handler
+ * SIGINT/SIGTERM leave the main loop, so the outputs are finished on the
+ * way out. A second one kills the server as before.
+ */
+static gboolean quit_handler(struct stream_info *si)
+{
+	g_print("Shutting down\n");
+	g_main_loop_quit(si->main_loop);
+
+	return FALSE;
+}
+
+/**
+ * bus_sync_handler
+ * Called from whichever thread posted the message. The RTSP media owns
+ * the bus watch, so this listens to the sync emission instead. Dumps are
+ * left to the main loop, one per burst of errors.
+ */
+static void bus_sync_handler(GstBus *bus, GstMessage *msg,
+			     struct stream_info *si)
+{
+	GError *err = NULL;
+	gchar *debug = NULL;
+	gchar text[64];
+	gboolean error = GST_MESSAGE_TYPE(msg) == GST_MESSAGE_ERROR;
+
+	if (error)
+		gst_message_parse_error(msg, &err, &debug);
+	else
+		gst_message_parse_warning(msg, &err, &debug);
+
+	snprintf(text, sizeof(text), "%s: %s", GST_OBJECT_NAME(msg->src),
+		 (err) ? err->message : "?");
+	flight_record((error) ? FLIGHT_BUS_ERROR : FLIGHT_BUS_WARNING, 0, 0,
+		      0, text);
+
+	if (error && g_atomic_int_compare_and_exchange(&si->dump_pending, 0, 1))
+		g_idle_add((GSourceFunc) bus_error_dump, si);
+
+	if (err)
+		g_error_free(err);
+	g_free(debug);
+}
+
+/**
+ * record_queue
+ * Note the fill level of a queue in the flight recorder, if it exists
+ */
+static void record_queue(struct stream_info *si, const gchar *name)
+{
+	GstElement *q = NULL;
+	guint buffers = 0, bytes = 0;
+
+	if (si->stream)
+		q = gst_bin_get_by_name(GST_BIN(si->stream[pipeline]), name);
+	if (!q)
+		return;
+
+	g_object_get(q, "current-level-buffers", &buffers,
+		     "current-level-bytes", &bytes, NULL);
+	flight_record(FLIGHT_QUEUE_LEVEL, buffers, bytes, 0, name);
+	gst_object_unref(q);
+}
+
+/**
+ * watchdog_handler
+ * Once a second, note how the pipeline is doing and dump the flight
+ * recorder if frames have stopped coming out while clients are watching
+ */
+static gboolean watchdog_handler(struct stream_info *si)
+{
+	gint i, total;
+
+	dbg(4, "called\n");
+
+	for (i = 0; i < NUM_STAGES; i++) {
+		total = g_atomic_int_get(&si->stages.hist[i].total);
+		flight_record(FLIGHT_STAGE_FPS, i, total - si->stage_total[i],
+			      0, stage_str(i));
+		if (i == STAGE_PAYLOAD)
+			si->stall = (total == si->stage_total[i]) ?
+				si->stall + 1 : 0;
+		si->stage_total[i] = total;
+	}
+
+	record_queue(si, "capq0");
+	record_queue(si, "encq0");
+
+	if (si->stall == WATCHDOG_SECS) {
+		g_print("No frames for %ds\n", si->stall);
+		flight_record(FLIGHT_WATCHDOG, si->stall, 0, 0, NULL);
+		dump_flight(si, "watchdog");
+	}
+
+	return TRUE;
+}
+
+/**
+ * media_prepared_handler
+ * Report what latency the pipeline ended up with
+ */
+static void media_prepared_handler(GstRTSPMedia *media,
+				   struct stream_info *si)
+{
+	GstQuery *query = gst_query_new_latency();
+	GstElement *pipe = gst_rtsp_media_get_element(media);
+	gboolean live;
+	GstClockTime min, max;
+
+	dbg(4, "called\n");
+
+	if (gst_element_query(pipe, query)) {
+		gst_query_parse_latency(query, &live, &min, &max);
+		g_print("Pipeline latency: live=%s min=%" G_GUINT64_FORMAT
+			"ms max=%s%" G_GUINT64_FORMAT "%s\n",
+			(live) ? "yes" : "no", GST_TIME_AS_MSECONDS(min),
+			GST_CLOCK_TIME_IS_VALID(max) ? "" : "(none)",
+			GST_CLOCK_TIME_IS_VALID(max) ?
+			GST_TIME_AS_MSECONDS(max) : 0,
+			GST_CLOCK_TIME_IS_VALID(max) ? "ms" : "");
+	} else {
+		g_print("Pipeline latency query failed\n");
+	}
+
+	/* Clients start a media playing, without one it's up to us */
+	if (si->always_on && si->num_cli == 0) {
+		g_print("Starting pipeline without clients\n");
+		gst_element_set_state(pipe, GST_STATE_PLAYING);
+	}
+
+	gst_query_unref(query);
+	gst_object_unref(pipe);
+}
+
+/**
+ * start_handlers
+ * Periodic work that is only done while someone is watching, until
+ * stop_handlers(). The per second ones assume they are the only copy,
+ * so starting them again while running does nothing.
+ */
+static void start_handlers(struct stream_info *si)
+{
+	guint *h = si->handlers;
+
+	if (si->n_handlers)
+		return;
+
+	/* Create Msg Event Handler */
+	if (si->msg_rate > 0) {
+		dbg(2, "Creating 'periodic message' handler\n");
+		h[si->n_handlers++] = g_timeout_add(si->msg_rate * 1000,
+			(GSourceFunc)periodic_msg_handler, si);
+	}
+
+	dbg(2, "Creating 'loss' handler\n");
+	h[si->n_handlers++] = g_timeout_add_seconds(1,
+		(GSourceFunc)loss_handler, si);
+
+	dbg(2, "Creating 'rate' handler\n");
+	si->rate_total = g_atomic_int_get(&si->rate.total);
+	h[si->n_handlers++] = g_timeout_add_seconds(1,
+		(GSourceFunc)rate_handler, si);
+
+	if (si->idr_auto) {
+		dbg(2, "Creating 'idr' handler\n");
+		h[si->n_handlers++] = g_timeout_add_seconds(1,
+			(GSourceFunc)idr_handler, si);
+	}
+
+	if (si->quality) {
+		dbg(2, "Creating 'quality' handler\n");
+		h[si->n_handlers++] = g_timeout_add_seconds(si->quality_secs,
+			(GSourceFunc)quality_handler, si);
+	}
+
+	dbg(2, "Creating 'watchdog' handler\n");
+	si->stall = 0;
+	h[si->n_handlers++] = g_timeout_add_seconds(1,
+		(GSourceFunc)watchdog_handler, si);
+}
+
+/**
+ * stop_handlers
+ * Nobody is watching any more, remove what start_handlers() added
+ */
+static void stop_handlers(struct stream_info *si)
+{
+	if (si->n_handlers)
+		dbg(2, "Destroying periodic handlers\n");
+	while (si->n_handlers)
+		g_source_remove(si->handlers[--si->n_handlers]);
+}
+
+/**
+ * media_unprepared_handler
+ * The live media is gone and with it the elements in si->stream. A
+ * client dropping without TEARDOWN keeps a shared media prepared until
+ * its session times out, so this and not the client count decides when
+ * they go. apply_* may be running on the streaming thread.
+ */
+static void media_unprepared_handler(GstRTSPMedia *media,
+				     struct stream_info *si)
+{
+	GstElement **stream = si->stream;
+	gint i;
+
+	dbg(4, "called\n");
+
+	if (media != si->media)
+		return;
+
+	g_mutex_lock(&si->enc_lock);
+	si->stream = NULL;
+	si->media = NULL;
+	g_mutex_unlock(&si->enc_lock);
+
+	if (!stream)
+		return;
+	for (i = pipeline; i <= protocol; i++)
+		if (stream[i])
+			gst_object_unref(stream[i]);
+	free(stream);
+}
+
 /**
  * media_configure_handler
  * Setup pipeline when the stream is first configured
@@ -177,12 +1169,20 @@ static gboolean periodic_msg_handler(struct stream_info *si)
 static void media_configure_handler(GstRTSPMediaFactory *factory,
 				    GstRTSPMedia *media, struct stream_info *si)
 {
+	GstBus *bus;
+
 	dbg(4, "called\n");
+	TRACE1(media_configure, si->num_cli);
+	flight_record(FLIGHT_MEDIA_CONFIGURE, si->num_cli, 0, 0, NULL);
 
 	si->media = media;
 
 	g_print("[%d]Configuring pipeline...\n", si->num_cli);
 
+	/* Free'd again with the media (in unprepared handler) */
+	if (!si->stream)
+		si->stream = calloc(NUM_ELEM, sizeof(GstElement *));
+
 	si->stream[pipeline] = gst_rtsp_media_get_element(media);
 	si->stream[source] = gst_bin_get_by_name(GST_BIN(si->stream[pipeline]),
 						 "source0");
@@ -201,31 +1201,541 @@ static void media_configure_handler(GstRTSPMediaFactory *factory,
 		exit(-ECODE_PIPE);
 	}
 
-	/* Modify v4l2src Properties */
-	g_print("Setting input device=%s\n", si->video_in);
-	g_object_set(si->stream[source], "device", si->video_in, NULL);
+	/* Modify v4l2src Properties */
+	g_print("Setting input device=%s\n", si->video_in);
+	g_object_set(si->stream[source], "device", si->video_in, NULL);
+
+	/* A new encoder starts from the target again */
+	if (si->num_cli == 0) {
+		g_mutex_lock(&si->enc_lock);
+		si->rate_scale = 1.0;
+		g_mutex_unlock(&si->enc_lock);
+		si->rate_ratio = 1.0;
+		si->rate_persist = 0;
+		si->rate_total = g_atomic_int_get(&si->rate.total);
+	}
+
+	/* Modify imxvpuenc_h264 Properties */
+	g_print("Setting encoder bitrate=%d\n", si->curr_bitrate);
+	apply_bitrate(si);
+	g_print("Setting encoder quant-param=%d\n", si->curr_quant_lvl);
+	apply_quant(si);
+	if (si->idr_auto) {
+		/* The first client is churn as well */
+		si->idr_curr = si->idr_auto;
+		si->idr_live = enc_live(si->stream[encoder], ENC_IDR);
+		si->idr_stable = 0;
+		si->idr_count = 0;
+		si->idr_frames = g_atomic_int_get(
+			&si->stages.hist[STAGE_ENCODER].total);
+		g_print("Setting encoder idr-interval=%d (auto%s)\n",
+			si->idr_curr, (si->idr_live) ? "" : ", forced");
+		enc_set(si->stream[encoder], ENC_IDR, (si->idr_live) ?
+			si->idr_curr : (si->idr) ? si->idr : IDR_AUTO_MAX);
+	} else {
+		enc_set(si->stream[encoder], ENC_IDR, si->idr);
+	}
+
+	if (si->intra_refresh) {
+		if (enc_set(si->stream[encoder], ENC_INTRA_REFRESH,
+			    si->intra_refresh))
+			g_print("Setting encoder intra-refresh=%d\n",
+				si->intra_refresh);
+		else
+			g_print("Encoder can't do intra refresh, "
+				"ignoring --intra-refresh\n");
+	}
+
+	if (si->low_latency) {
+		if (enc_set(si->stream[encoder], ENC_BFRAMES, 0))
+			g_print("Setting encoder b-frames=0\n");
+		if (enc_set(si->stream[encoder], ENC_LOOKAHEAD, 0))
+			g_print("Setting encoder lookahead=0\n");
+	}
+
+	if (si->slice_mtu) {
+		gint slice = si->mtu - RTP_OVERHEAD;
+
+		if (enc_set(si->stream[encoder], ENC_SLICE_BYTES, slice))
+			g_print("Setting encoder slice-size=%d\n", slice);
+		else
+			g_print("Encoder can't limit slice size, "
+				"ignoring --slice-mtu\n");
+	}
+
+	/* Modify rtph264pay Properties */
+	g_print("Setting rtp config-interval=%d\n",(int) si->config_interval);
+	g_object_set(si->stream[protocol], "config-interval",
+		     si->config_interval, NULL);
+	if (si->capture_ext) {
+		/* Keep packets within the MTU once the extension is added */
+		g_print("Sending capture time, extension id %d\n",
+			CAPTURE_EXT_ID);
+		capture_ext_attach(si->stream[protocol]);
+		g_print("Setting rtp mtu=%d\n", si->mtu - CAPTURE_EXT_BYTES);
+		g_object_set(si->stream[protocol], "mtu",
+			     (guint) (si->mtu - CAPTURE_EXT_BYTES), NULL);
+	} else {
+		g_print("Setting rtp mtu=%d\n", si->mtu);
+		g_object_set(si->stream[protocol], "mtu", (guint) si->mtu,
+			     NULL);
+	}
+
+	if (si->batch.enabled)
+		g_print("Batching RTP packets per frame\n");
+	rtp_batch_attach(si->stream[protocol], &si->batch);
+
+	/* After batching, so a batched frame is only seen once */
+	stage_stats_attach(si->stream[source], STAGE_SOURCE, &si->stages);
+	stage_stats_attach(si->stream[caps], STAGE_CAPS, &si->stages);
+	stage_stats_attach(si->stream[encoder], STAGE_ENCODER, &si->stages);
+	stage_stats_attach(si->stream[protocol], STAGE_PAYLOAD, &si->stages);
+	rate_stats_attach(si->stream[encoder], &si->rate);
+	if (si->quality &&
+	    !quality_sampler_attach(si->quality, si->stream[caps],
+				    si->stream[encoder]))
+		g_print("Couldn't attach quality sampler\n");
+	if (si->motion_on &&
+	    !motion_attach(si->stream[caps], &si->motion))
+		g_print("Couldn't attach motion analyzer\n");
+	if (si->snapshot)
+		snapshot_attach(si->stream[caps], si->snapshot);
+	if (si->timeshift)
+		timeshift_attach(si->stream[encoder], si->timeshift);
+	if (si->recorder)
+		recorder_attach(si->stream[encoder], si->recorder);
+	if (si->hls)
+		hls_attach(si->stream[encoder], si->hls);
+	if (si->webrtc)
+		webrtc_attach(si->stream[encoder], si->webrtc);
+
+	g_signal_connect(media, "prepared",
+			 G_CALLBACK(media_prepared_handler), si);
+	g_signal_connect(media, "unprepared",
+			 G_CALLBACK(media_unprepared_handler), si);
+
+	/* Errors and warnings go to the flight recorder as they happen */
+	bus = gst_element_get_bus(si->stream[pipeline]);
+	gst_bus_enable_sync_message_emission(bus);
+	g_signal_connect(bus, "sync-message::error",
+			 G_CALLBACK(bus_sync_handler), si);
+	g_signal_connect(bus, "sync-message::warning",
+			 G_CALLBACK(bus_sync_handler), si);
+	gst_object_unref(bus);
+
+	/* ULPFEC has to be configured before the streams join rtpbin */
+	if (si->fec_max) {
+		guint i;
+
+		g_print("Enabling ulpfec pt=%d, max %d%%\n", ULPFEC_PT,
+			si->fec_max);
+		for (i = 0; i < gst_rtsp_media_n_streams(media); i++)
+			gst_rtsp_stream_set_ulpfec_pt(
+				gst_rtsp_media_get_stream(media, i), ULPFEC_PT);
+		set_fec(si, si->fec_pct);
+	}
+}
+
+/**
+ * timeshift_unprepared_handler
+ * The pipeline is stopped, so the reader can't be stuck pushing
+ */
+static void timeshift_unprepared_handler(GstRTSPMedia *media,
+					 struct stream_info *si)
+{
+	dbg(4, "called\n");
+
+	g_object_set_data(G_OBJECT(media), TIMESHIFT_KEY, NULL);
+}
+
+/**
+ * timeshift_configure_handler
+ * Every timeshift client gets its own media, give it a reader that
+ * starts from where PLAY asks for
+ */
+static void timeshift_configure_handler(GstRTSPMediaFactory *factory,
+					GstRTSPMedia *media,
+					struct stream_info *si)
+{
+	GstElement *pipe = gst_rtsp_media_get_element(media);
+	GstElement *src = gst_bin_get_by_name(GST_BIN(pipe), "tsrc0");
+
+	dbg(4, "called\n");
+
+	if (!src) {
+		g_printerr("Couldn't get timeshift pipeline elements\n");
+		gst_object_unref(pipe);
+		return;
+	}
+
+	g_object_set_data_full(G_OBJECT(media), TIMESHIFT_KEY,
+			       timeshift_reader_new(si->timeshift, src),
+			       (GDestroyNotify) timeshift_reader_free);
+	g_signal_connect(media, "unprepared",
+			 G_CALLBACK(timeshift_unprepared_handler), si);
+
+	gst_object_unref(src);
+	gst_object_unref(pipe);
+}
+
+/**
+ * publish_shm
+ * Copy the live counters into the shared memory segment for readers
+ */
+static void publish_shm(struct stream_info *si)
+{
+	struct shm_stats *s = si->shm;
+	struct quality_result quality;
+	guint i, n = MIN(si->rtcp.n, SHM_STATS_MAX_SESSIONS);
+
+	shm_stats_begin(s);
+
+	s->update_us = g_get_real_time();
+	s->num_cli = si->num_cli;
+	s->connected = si->connected;
+	s->curr_bitrate = si->curr_bitrate;
+	s->min_bitrate = si->min_bitrate;
+	s->max_bitrate = si->max_bitrate;
+	s->curr_quant_lvl = si->curr_quant_lvl;
+	s->min_quant_lvl = si->min_quant_lvl;
+	s->max_quant_lvl = si->max_quant_lvl;
+	s->steps = si->steps;
+	s->mtu = si->mtu;
+	s->fec_pct = si->fec_pct;
+	s->loss = si->loss;
+	s->rate_ratio = (si->connected && si->enc_target) ?
+		si->rate_ratio : 0;
+	s->rate_scale = si->rate_scale;
+
+	s->psnr = s->ssim = 0;
+	if (si->quality && quality_sampler_result(si->quality, &quality)) {
+		s->psnr = quality.psnr;
+		s->ssim = quality.ssim;
+	}
+
+	s->motion_score = g_atomic_int_get(&si->motion.score) / 100.0;
+	s->motion_still = g_atomic_int_get(&si->motion.still);
+	s->motion_cost_us = g_atomic_int_get(&si->motion.cost_total);
+	s->frames_skipped = g_atomic_int_get(&si->motion.skipped_total);
+	s->idr_interval = (si->idr_auto && si->connected) ? si->idr_curr :
+		si->idr;
+
+	s->rtp_bytes = g_atomic_int_get(&si->batch.bytes);
+	for (i = 0; i < NUM_STAGES; i++)
+		s->frames[i] = g_atomic_int_get(&si->stages.hist[i].total);
+
+	/* Receiver reports are only collected while someone is watching */
+	if (!si->connected)
+		n = 0;
+	for (i = 0; i < n; i++) {
+		g_strlcpy(s->session[i].addr, si->rtcp.cli[i].addr,
+			  sizeof(s->session[i].addr));
+		s->session[i].ssrc = si->rtcp.cli[i].ssrc;
+		s->session[i].loss = si->rtcp.cli[i].loss;
+		s->session[i].rtt_ms = si->rtcp.cli[i].rtt_ms;
+		s->session[i].jitter_ms = si->rtcp.cli[i].jitter_ms;
+	}
+	s->n_sessions = n;
+
+	shm_stats_end(s);
+}
+
+/**
+ * history_handler
+ * Add this second's sample to the statistics history. Runs for as long as
+ * the server does, idle seconds are worth keeping too.
+ */
+static gboolean history_handler(struct stream_info *si)
+{
+	gfloat val[NUM_HIST_METRIC];
+	struct quality_result quality;
+	gint frames = g_atomic_int_get(&si->stages.hist[STAGE_PAYLOAD].total);
+	gint bytes = g_atomic_int_get(&si->batch.bytes);
+
+	val[HIST_CLIENTS] = si->num_cli;
+	val[HIST_BITRATE] = si->curr_bitrate;
+	val[HIST_QUANT] = si->curr_quant_lvl;
+	val[HIST_FPS] = frames - si->hist_frames;
+	/* Every client gets its own copy of each packet */
+	val[HIST_EGRESS] = (guint) (bytes - si->hist_bytes) * 8.0 / 1000 *
+		si->num_cli;
+	val[HIST_LOSS] = (si->connected) ? si->rtcp.max_loss * 100 : 0;
+	val[HIST_PSNR] = val[HIST_SSIM] = 0;
+	if (si->connected && si->quality &&
+	    quality_sampler_result(si->quality, &quality)) {
+		val[HIST_PSNR] = quality.psnr;
+		val[HIST_SSIM] = quality.ssim;
+	}
+	val[HIST_MOTION] = (si->connected && si->motion_on) ?
+		g_atomic_int_get(&si->motion.score) / 100.0 : 0;
+
+	si->hist_frames = frames;
+	si->hist_bytes = bytes;
+	history_add(si->history, g_get_real_time() / G_USEC_PER_SEC, val);
+
+	if (si->shm)
+		publish_shm(si);
+
+	return TRUE;
+}
+
+/**
+ * http_stats_handler
+ * /stats: statistics history, runs on an HTTP thread
+ */
+static void http_stats_handler(struct http_request *req,
+			       struct stream_info *si)
+{
+	gchar *res_str = http_query_get(req, "res");
+	gchar *since_str = http_query_get(req, "since");
+	enum hist_res res = HIST_1S;
+	const char bad_res[] = "res is 1s, 1m or 1h\n";
+	gchar *json;
+
+	if (res_str && !history_parse_res(res_str, &res)) {
+		http_respond(req, 400, NULL, bad_res, sizeof(bad_res) - 1);
+	} else {
+		json = history_json(si->history, res, (since_str) ?
+				    g_ascii_strtoll(since_str, NULL, 10) : 0);
+		http_respond(req, 200, "application/json", json, strlen(json));
+		g_free(json);
+	}
+
+	g_free(res_str);
+	g_free(since_str);
+}
+
+/**
+ * http_snapshot_handler
+ * /snapshot.jpg: the latest frame, runs on an HTTP thread
+ */
+static void http_snapshot_handler(struct http_request *req,
+				  struct stream_info *si)
+{
+	const char no_frame[] = "No live frame\n";
+	GBytes *jpeg = snapshot_jpeg(si->snapshot);
+	gconstpointer data;
+	gsize len;
+
+	if (!jpeg) {
+		http_respond(req, 503, NULL, no_frame, sizeof(no_frame) - 1);
+		return;
+	}
+
+	data = g_bytes_get_data(jpeg, &len);
+	http_respond(req, 200, "image/jpeg", data, len);
+	g_bytes_unref(jpeg);
+}
+
+/**
+ * json_escape
+ * 's' as the inside of a JSON string. Free with g_free().
+ */
+static gchar *json_escape(const gchar *s)
+{
+	GString *out = g_string_sized_new(strlen(s));
+
+	for (; *s; s++) {
+		if (*s == '"' || *s == '\\')
+			g_string_append_printf(out, "\\%c", *s);
+		else if ((guchar) *s < 0x20)
+			g_string_append_printf(out, "\\u%04x", (guchar) *s);
+		else
+			g_string_append_c(out, *s);
+	}
+
+	return g_string_free(out, FALSE);
+}
 
-	/* Modify imxvpuenc_h264 Properties */
-	g_print("Setting encoder bitrate=%d\n", si->curr_bitrate);
-	g_object_set(si->stream[encoder], "bitrate", si->curr_bitrate, NULL);
-	g_print("Setting encoder quant-param=%d\n", si->curr_quant_lvl);
-	g_object_set(si->stream[encoder], "quant-param", si->curr_quant_lvl,
-		     NULL);
-	g_object_set(si->stream[encoder], "idr-interval", si->idr, NULL);
+/**
+ * http_recording_handler
+ * /recording?t=<unix time>: the segment holding that time and where its
+ * last key frame before it is, runs on an HTTP thread. The segment is
+ * named relative to the recording directory.
+ */
+static void http_recording_handler(struct http_request *req,
+				   struct stream_info *si)
+{
+	const char bad_t[] = "t is a unix time\n";
+	const char not_found[] = "Not recorded\n";
+	gchar *t_str = http_query_get(req, "t");
+	struct record_index_entry key;
+	gchar *path, *base, *file, *json;
+	gchar *end = NULL;
+	gdouble t = 0;
+
+	if (t_str)
+		t = g_ascii_strtod(t_str, &end);
+	if (!t_str || end == t_str || t <= 0) {
+		http_respond(req, 400, NULL, bad_t, sizeof(bad_t) - 1);
+	} else if (!recorder_find(si->recorder, t * G_USEC_PER_SEC, &path,
+				  &key)) {
+		http_respond(req, 404, NULL, not_found, sizeof(not_found) - 1);
+	} else {
+		/* Segments are kept directly in the recording directory */
+		base = g_path_get_basename(path);
+		file = json_escape(base);
+		json = g_strdup_printf("{\"file\":\"%s\","
+				       "\"offset\":%.3f,\"key_time\":%.3f}\n",
+				       file, key.pts / 1e6, key.time / 1e6);
+		http_respond(req, 200, "application/json", json, strlen(json));
+		g_free(json);
+		g_free(file);
+		g_free(base);
+		g_free(path);
+	}
 
-	/* Modify rtph264pay Properties */
-	g_print("Setting rtp config-interval=%d\n",(int) si->config_interval);
-	g_object_set(si->stream[protocol], "config-interval",
-		     si->config_interval, NULL);
+	g_free(t_str);
+}
 
-	if (si->num_cli == 1) {
-		/* Create Msg Event Handler */
-		dbg(2, "Creating 'periodic message' handler\n");
-		g_timeout_add(si->msg_rate * 1000,
-			      (GSourceFunc)periodic_msg_handler, si);
+/**
+ * http_clip_handler
+ * /clip.mp4: the timeshift around a point in time as an MP4, runs on an
+ * HTTP thread. 't' must be within the timeshift, a clip reaching past
+ * now waits for it.
+ */
+static void http_clip_handler(struct http_request *req,
+			      struct stream_info *si)
+{
+	const char bad_args[] = "t is a unix time, before and after are "
+		"seconds within the timeshift\n";
+	const char not_held[] = "Not in the timeshift\n";
+	gchar *t_str = http_query_get(req, "t");
+	gchar *before_str = http_query_get(req, "before");
+	gchar *after_str = http_query_get(req, "after");
+	gdouble before = (before_str) ? g_ascii_strtod(before_str, NULL) :
+		CLIP_BEFORE;
+	gdouble after = (after_str) ? g_ascii_strtod(after_str, NULL) :
+		CLIP_AFTER;
+	/* Seconds before now, the ring runs on monotonic time */
+	gdouble ago = (t_str) ? g_get_real_time() / (gdouble) G_USEC_PER_SEC -
+		g_ascii_strtod(t_str, NULL) : 0;
+	gint64 now = g_get_monotonic_time();
+	struct clip_result res;
+	gconstpointer data;
+	GBytes *clip;
+	gint64 t;
+	gsize len;
+
+	/* A t in the future would hold an HTTP thread until it comes */
+	if (!isfinite(ago) || !isfinite(before) || !isfinite(after) ||
+	    ago < 0 || ago > si->timeshift_secs || before < 0 || after < 0 ||
+	    before + after > si->timeshift_secs) {
+		http_respond(req, 400, NULL, bad_args, sizeof(bad_args) - 1);
+		goto out;
+	}
+	t = now - ago * G_USEC_PER_SEC;
+
+	clip = clip_export(si->timeshift, t - before * G_USEC_PER_SEC,
+			   t + after * G_USEC_PER_SEC,
+			   t + after * G_USEC_PER_SEC + CLIP_SLACK_US, &res);
+	if (!clip) {
+		http_respond(req, 404, NULL, not_held, sizeof(not_held) - 1);
+		goto out;
+	}
+
+	data = g_bytes_get_data(clip, &len);
+	g_print("Exported %.1fs clip for %s, %u frames, %.1fMB, remuxed in "
+		"%dms\n", (res.end - res.start) / (gdouble) G_USEC_PER_SEC,
+		(req->remote) ? req->remote : "?", res.frames,
+		len / (1024.0 * 1024.0), (gint) (res.mux_us / 1000));
+	flight_record(FLIGHT_CLIP, res.frames, res.mux_us / 1000,
+		      (res.end - res.start) / 1000, t_str);
+	http_respond(req, 200, "video/mp4", data, len);
+	g_bytes_unref(clip);
+
+out:
+	g_free(t_str);
+	g_free(before_str);
+	g_free(after_str);
+}
+
+/**
+ * http_hls_handler
+ * HLS_PATH*: playlist, init sections, segments and parts, runs on an
+ * HTTP thread and may block until what was asked for is cut
+ */
+static void http_hls_handler(struct http_request *req, struct stream_info *si)
+{
+	hls_serve(si->hls, req, req->path + strlen(HLS_PATH));
+}
+
+/**
+ * http_webrtc_handler
+ * WEBRTC_PATH: POST an SDP offer, the answer comes back with the peer's
+ * resource in Location. WEBRTC_PATH/<id>: DELETE hangs up. Runs on an
+ * HTTP thread, an answer waits for ICE gathering.
+ */
+static void http_webrtc_handler(struct http_request *req,
+				struct stream_info *si)
+{
+	const char cors[] =
+		"Access-Control-Allow-Methods: POST, DELETE, OPTIONS\r\n"
+		"Access-Control-Allow-Headers: Content-Type\r\n"
+		"Access-Control-Expose-Headers: Location\r\n";
+	const char bad_offer[] = "POST an SDP offer\n";
+	const char full[] = "Too many peers\n";
+	const char no_ice[] = "No ICE candidates gathered\n";
+	const gchar *res = req->path + strlen(WEBRTC_PATH);
+	gchar *answer, *hdr;
+	gint status;
+	guint id;
+
+	if (strcmp(req->method, "OPTIONS") == 0) {
+		/* Browser preflight of a cross origin POST */
+		http_respond_headers(req, 204, NULL, cors, NULL, 0);
+	} else if (strcmp(req->method, "POST") == 0 && !*res) {
+		if (!req->body) {
+			http_respond(req, 400, NULL, bad_offer,
+				     sizeof(bad_offer) - 1);
+			return;
+		}
+		answer = webrtc_answer(si->webrtc, req->body, req->remote, &id,
+				       &status);
+		if (!answer) {
+			if (status == 503)
+				http_respond(req, status, NULL, full,
+					     sizeof(full) - 1);
+			else if (status == 400)
+				http_respond(req, status, NULL, bad_offer,
+					     sizeof(bad_offer) - 1);
+			else if (status == 504)
+				http_respond(req, status, NULL, no_ice,
+					     sizeof(no_ice) - 1);
+			else
+				http_respond(req, status, NULL, NULL, 0);
+			return;
+		}
+		g_print("WebRTC peer %u signalled from %s\n", id,
+			(req->remote) ? req->remote : "?");
+		hdr = g_strdup_printf("%sLocation: " WEBRTC_PATH "/%u\r\n",
+				      cors, id);
+		http_respond_headers(req, 201, "application/sdp", hdr, answer,
+				     strlen(answer));
+		g_free(hdr);
+		g_free(answer);
+	} else if (strcmp(req->method, "DELETE") == 0 && res[0] == '/') {
+		id = strtoul(res + 1, NULL, 10);
+		if (webrtc_close(si->webrtc, id)) {
+			g_print("WebRTC peer %u hung up\n", id);
+			http_respond_headers(req, 200, NULL, cors, NULL, 0);
+		} else {
+			http_respond(req, 404, NULL, NULL, 0);
+		}
+	} else {
+		http_respond(req, 405, NULL, NULL, 0);
 	}
 }
 
+/**
+ * audience
+ * RTSP clients, connected WebRTC peers and HLS viewers at --hls-weight
+ */
+static gint audience(struct stream_info *si)
+{
+	return si->num_cli + si->webrtc_load + si->hls_load;
+}
+
 /**
  * change_quant
  * handle changing of quant-levels
@@ -236,21 +1746,29 @@ static void change_quant(struct stream_info *si)
 
 	gint c = si->curr_quant_lvl;
 	int step = (si->max_quant_lvl - si->min_quant_lvl) / si->steps;
+	gint q;
 
 	/* Change quantization based on # of clients * step factor */
 	/* It's OK to scale from min since lower val means higher qual */
-	si->curr_quant_lvl = ((si->num_cli - 1) * step) + si->min_quant_lvl;
+	q = ((audience(si) - 1) * step) + si->min_quant_lvl;
 
 	/* Cap to max quant level */
-	if (si->curr_quant_lvl > si->max_quant_lvl)
-		si->curr_quant_lvl = si->max_quant_lvl;
+	if (q > si->max_quant_lvl)
+		q = si->max_quant_lvl;
+
+	/* The motion analyzer reads it from the streaming thread */
+	g_mutex_lock(&si->enc_lock);
+	si->curr_quant_lvl = q;
+	g_mutex_unlock(&si->enc_lock);
 
 	if (si->curr_quant_lvl != c) {
 		g_print("[%d]Changing quant-lvl from %d to %d\n", si->num_cli,
 			c, si->curr_quant_lvl);
-		g_object_set(si->stream[encoder], "quant-param",
-			     si->curr_quant_lvl, NULL);
+		apply_quant(si);
+		flight_record(FLIGHT_QUANT, c, si->curr_quant_lvl,
+			      si->num_cli, NULL);
 	}
+	TRACE3(quant_change, c, si->curr_quant_lvl, si->num_cli);
 }
 
 /**
@@ -263,22 +1781,211 @@ static void change_bitrate(struct stream_info *si)
 
 	int c = si->curr_bitrate;
 	int step = (si->max_bitrate - si->min_bitrate) / si->steps;
+	gint br;
 
 	/* Change bitrate based on # of clients * step factor */
-	si->curr_bitrate = si->max_bitrate - ((si->num_cli - 1) * step);
+	br = si->max_bitrate - ((audience(si) - 1) * step);
 
 	/* cap to min bitrate levels */
-	if (si->curr_bitrate < si->min_bitrate) {
+	if (br < si->min_bitrate) {
 		dbg(3, "Snapping bitrate to %d\n", si->min_bitrate);
-		si->curr_bitrate = si->min_bitrate;
+		br = si->min_bitrate;
 	}
 
+	/* The motion analyzer reads it from the streaming thread */
+	g_mutex_lock(&si->enc_lock);
+	si->curr_bitrate = br;
+	g_mutex_unlock(&si->enc_lock);
+
 	if (si->curr_bitrate != c) {
 		g_print("[%d]Changing bitrate from %d to %d\n", si->num_cli, c,
 			si->curr_bitrate);
-		g_object_set(si->stream[encoder], "bitrate", si->curr_bitrate,
-			     NULL);
+		apply_bitrate(si);
+		flight_record(FLIGHT_BITRATE, c, si->curr_bitrate,
+			      si->num_cli, NULL);
+	}
+	TRACE3(bitrate_change, c, si->curr_bitrate, si->num_cli);
+}
+
+/**
+ * audience_changed
+ * Someone joined or left, 'before' being the audience until now. The
+ * periodic handlers run while anyone watches, however they watch, and
+ * the encoder steps with the audience. Nobody left, it stays where it was.
+ */
+static void audience_changed(struct stream_info *si, gint before)
+{
+	gint now = audience(si);
+
+	if (before == 0 && now > 0) {
+		si->connected = TRUE;
+		start_handlers(si);
+	} else if (before > 0 && now == 0) {
+		dbg(3, "Connection terminated\n");
+		si->connected = FALSE;
+		stop_handlers(si);
+	}
+
+	if (now > 0) {
+		if (si->curr_bitrate)
+			change_bitrate(si);
+		else
+			change_quant(si);
+	}
+}
+
+/**
+ * webrtc_handler
+ * Hang up peers that failed or left without saying, and count the
+ * connected ones into the audience, for the lifetime of the server
+ */
+static gboolean webrtc_handler(struct stream_info *si)
+{
+	guint connected;
+	guint gone = webrtc_reap(si->webrtc);
+	gint before = audience(si);
+
+	webrtc_peers(si->webrtc, &connected);
+	if (gone)
+		g_print("WebRTC hung up %u peers\n", gone);
+	if ((gint) connected == si->webrtc_load)
+		return TRUE;
+
+	g_print("[%d]WebRTC peers from %d to %u\n", si->num_cli,
+		si->webrtc_load, connected);
+	si->webrtc_load = connected;
+	audience_changed(si, before);
+
+	return TRUE;
+}
+
+/**
+ * hls_handler
+ * Count HLS viewers into the audience at --hls-weight percent each, for
+ * the lifetime of the server
+ */
+static gboolean hls_handler(struct stream_info *si)
+{
+	gint load = (hls_viewers(si->hls) * si->hls_weight + 50) / 100;
+	gint before = audience(si);
+
+	if (load == si->hls_load)
+		return TRUE;
+
+	g_print("[%d]HLS load from %d to %d\n", si->num_cli, si->hls_load,
+		load);
+	si->hls_load = load;
+	audience_changed(si, before);
+
+	return TRUE;
+}
+
+/**
+ * tune_udp_socket
+ * Apply the socket options to one of a stream's RTP/RTCP sockets
+ */
+static void tune_udp_socket(GSocket *sock, struct stream_info *si)
+{
+	if (!sock)
+		return;
+
+	if (sock_tune_udp(g_socket_get_fd(sock), &si->tune))
+		dbg(1, "Couldn't apply all udp socket options\n");
+	g_object_unref(sock);
+}
+
+/**
+ * client_play_handler
+ * UDP sockets only exist once a client has been through SETUP, so tune
+ * them when it asks to PLAY. They are shared by all clients of the
+ * stream, doing it again for every client is harmless.
+ */
+static void client_play_handler(GstRTSPClient *client, GstRTSPContext *ctx,
+				struct stream_info *si)
+{
+	guint i;
+
+	dbg(4, "called\n");
+
+	for (i = 0; ctx->media && i < gst_rtsp_media_n_streams(ctx->media);
+	     i++) {
+		GstRTSPStream *stream = gst_rtsp_media_get_stream(ctx->media,
+								  i);
+
+		tune_udp_socket(gst_rtsp_stream_get_rtp_socket(stream,
+			G_SOCKET_FAMILY_IPV4), si);
+		tune_udp_socket(gst_rtsp_stream_get_rtcp_socket(stream,
+			G_SOCKET_FAMILY_IPV4), si);
+		tune_udp_socket(gst_rtsp_stream_get_rtp_socket(stream,
+			G_SOCKET_FAMILY_IPV6), si);
+		tune_udp_socket(gst_rtsp_stream_get_rtcp_socket(stream,
+			G_SOCKET_FAMILY_IPV6), si);
+	}
+}
+
+/**
+ * tune_client
+ * Apply the socket options to a new client's RTSP connection, which also
+ * carries its RTP when it uses interleaved TCP
+ */
+static void tune_client(GstRTSPClient *client, struct stream_info *si)
+{
+	GstRTSPConnection *conn = gst_rtsp_client_get_connection(client);
+	GSocket *rd, *wr;
+
+	if (!conn)
+		return;
+
+	rd = gst_rtsp_connection_get_read_socket(conn);
+	wr = gst_rtsp_connection_get_write_socket(conn);
+
+	if (rd && sock_tune_tcp(g_socket_get_fd(rd), &si->tune))
+		dbg(1, "Couldn't apply all tcp socket options\n");
+	if (wr && wr != rd && sock_tune_tcp(g_socket_get_fd(wr), &si->tune))
+		dbg(1, "Couldn't apply all tcp socket options\n");
+
+	g_signal_connect(client, "play-request",
+			 G_CALLBACK(client_play_handler), si);
+}
+
+/**
+ * client_pre_play_handler
+ * Position a timeshift media where the Range asks for. The media itself
+ * can't seek, so the server must not try to once we are done with it.
+ */
+static GstRTSPStatusCode client_pre_play_handler(GstRTSPClient *client,
+						 GstRTSPContext *ctx,
+						 struct stream_info *si)
+{
+	struct timeshift_reader *r = NULL;
+	gchar *range = NULL;
+	gchar *speed = NULL;
+	gdouble x;
+
+	dbg(4, "called\n");
+
+	if (ctx->media)
+		r = g_object_get_data(G_OBJECT(ctx->media), TIMESHIFT_KEY);
+	if (!r)
+		return GST_RTSP_STS_OK;
+
+	gst_rtsp_message_get_header(ctx->request, GST_RTSP_HDR_RANGE, &range,
+				    0);
+	gst_rtsp_message_get_header(ctx->request, GST_RTSP_HDR_SPEED, &speed,
+				    0);
+	x = (speed) ? g_ascii_strtod(speed, NULL) : 1.0;
+	if (!timeshift_reader_seek(r, range, x)) {
+		g_print("Invalid timeshift range: %s\n", range);
+		return GST_RTSP_STS_INVALID_RANGE;
 	}
+	g_print("Timeshift playing from %s at %.1fx\n",
+		(range) ? range : "live", x);
+	flight_record(FLIGHT_TIMESHIFT, x * 100, 0, 0, range);
+
+	gst_rtsp_message_remove_header(ctx->request, GST_RTSP_HDR_RANGE, -1);
+	gst_rtsp_message_remove_header(ctx->request, GST_RTSP_HDR_SPEED, -1);
+
+	return GST_RTSP_STS_OK;
 }
 
 /**
@@ -288,82 +1995,124 @@ static void change_bitrate(struct stream_info *si)
  */
 static void client_close_handler(GstRTSPClient *client, struct stream_info *si)
 {
+	gint before;
+
 	dbg(4, "called\n");
 
+	/* Never in the count */
+	if (!g_object_get_data(G_OBJECT(client), LIVE_KEY)) {
+		g_print("[%d]Client not watching live is closing down\n",
+			si->num_cli);
+		return;
+	}
+
+	before = audience(si);
 	si->num_cli--;
+	TRACE1(client_close, si->num_cli);
+	flight_record(FLIGHT_CLIENT_CLOSE, si->num_cli, 0, 0, NULL);
 
 	g_print("[%d]Client is closing down\n", si->num_cli);
-	if (si->num_cli == 0) {
-		dbg(3, "Connection terminated\n");
-		si->connected = FALSE;
+	audience_changed(si, before);
 
-		if (!(si->stream[pipeline] && si->stream[source] &&
-		      si->stream[caps] && si->stream[encoder] &&
-		      si->stream[protocol])) {
-			gst_element_set_state(si->stream[pipeline],
-					      GST_STATE_NULL);
-
-			gst_object_unref(si->stream[source]);
-			gst_object_unref(si->stream[caps]);
-			gst_object_unref(si->stream[encoder]);
-			gst_object_unref(si->stream[protocol]);
-			gst_object_unref(si->stream[pipeline]);
-		}
-		/* Created when first new client connected */
-		free(si->stream);
-	} else {
-		if (si->curr_bitrate)
-			change_bitrate(si);
-		else
-			change_quant(si);
+	/* Always on keeps running, with the encoder where it was left */
+	if (si->num_cli == 0 && !si->always_on && si->snapshot)
+		snapshot_clear(si->snapshot);
+	/* The elements go with the media, see unprepared handler */
+}
+
+/**
+ * client_setup_handler
+ * Count a client once it sets up the live media. Timeshift clients get a
+ * media of their own and never touch the encoder, so they aren't counted.
+ */
+static void client_setup_handler(GstRTSPClient *client, GstRTSPContext *ctx,
+				 struct stream_info *si)
+{
+	gint before;
+
+	dbg(4, "called\n");
+
+	if (!ctx->uri || g_object_get_data(G_OBJECT(client), LIVE_KEY) ||
+	    (si->timeshift_mount &&
+	     g_str_has_prefix(ctx->uri->abspath, si->timeshift_mount)))
+		return;
+
+	g_object_set_data(G_OBJECT(client), LIVE_KEY, si);
+	before = audience(si);
+	si->num_cli++;
+	TRACE1(client_connect, si->num_cli);
+	flight_record(FLIGHT_CLIENT_CONNECT, si->num_cli, 0, 0, NULL);
+	g_print("[%d]A new client is watching\n", si->num_cli);
+	audience_changed(si, before);
+
+	/* A shared media is already past its IDR, don't make them wait */
+	if (si->idr_auto && (si->num_cli > 1 || si->always_on)) {
+		si->idr_churn = TRUE;
+		request_idr(si);
 	}
 }
 
 /**
  * new_client_handler
- * Called by rtsp server on a new client connection
+ * Called by rtsp server on a new client connection. Clients are counted
+ * by what they set up, not here.
  */
 static void new_client_handler(GstRTSPServer *server, GstRTSPClient *client,
 			       struct stream_info *si)
 {
 	dbg(4, "called\n");
 
-	/* Used to initiate the media-configure callback */
-	static gboolean first_run = TRUE;
+	g_print("A new client has connected\n");
 
-	si->num_cli++;
-	g_print("[%d]A new client has connected\n", si->num_cli);
-	si->connected = TRUE;
-
-	/* Create media-configure handler */
-	if (si->num_cli == 1) {	/* Initial Setup */
-		/* Free if no more clients (in close handler) */
-		si->stream = malloc(sizeof(GstElement *) * NUM_ELEM);
-
-		/**
-		 * Stream info is required, which is only
-		 * available on the first connection. Stream info is created
-		 * upon the first connection and is never destroyed after that.
-		 */
-		if (first_run == TRUE) {
-			dbg(2, "Creating 'media-configure' signal handler\n");
-			g_signal_connect(si->factory, "media-configure",
-					 G_CALLBACK(media_configure_handler),
-					 si);
-		}
-	} else {
-		if (si->curr_bitrate)
-			change_bitrate(si);
-		else
-			change_quant(si);
-	}
+	if (sock_tune_is_set(&si->tune))
+		tune_client(client, si);
+
+	g_signal_connect(client, "setup-request",
+			 G_CALLBACK(client_setup_handler), si);
+	if (si->timeshift)
+		g_signal_connect(client, "pre-play-request",
+				 G_CALLBACK(client_pre_play_handler), si);
 
 	/* Create new client_close_handler */
 	dbg(2, "Creating 'closed' signal handler\n");
 	g_signal_connect(client, "closed",
 			 G_CALLBACK(client_close_handler), si);
+}
+
+/**
+ * start_always_on
+ * Construct and prepare the shared media the way a client's DESCRIBE
+ * would, and hold on to it. Our prepare keeps the media from being
+ * paused or torn down when the last client leaves.
+ */
+static gboolean start_always_on(struct stream_info *si, const char *port,
+				const char *mount_point)
+{
+	gchar *uri = g_strdup_printf("rtsp://" DEFAULT_HOST ":%s%s", port,
+				     mount_point);
+	GstRTSPThreadPool *pool;
+	GstRTSPThread *thread;
+	GstRTSPMedia *media;
+	GstRTSPUrl *url;
+
+	if (gst_rtsp_url_parse(uri, &url) != GST_RTSP_OK) {
+		g_free(uri);
+		return FALSE;
+	}
+	g_free(uri);
+
+	media = gst_rtsp_media_factory_construct(si->factory, url);
+	gst_rtsp_url_free(url);
+	if (!media)
+		return FALSE;
+
+	pool = gst_rtsp_server_get_thread_pool(si->server);
+	thread = gst_rtsp_thread_pool_get_thread(pool,
+						 GST_RTSP_THREAD_TYPE_MEDIA,
+						 NULL);
+	g_object_unref(pool);
 
-	first_run = FALSE;
+	return gst_rtsp_media_prepare(media, thread);
 }
 
 int main (int argc, char *argv[])
@@ -376,6 +2125,8 @@ int main (int argc, char *argv[])
 		.video_in = "/dev/video0",
 		.config_interval = atoi(DEFAULT_CONFIG_INTERVAL),
 		.idr = atoi(DEFAULT_IDR_INTERVAL),
+		.idr_auto = atoi(DEFAULT_IDR_AUTO),
+		.intra_refresh = atoi(DEFAULT_INTRA_REFRESH),
 		.steps = atoi(DEFAULT_STEPS) - 1,
 		.min_quant_lvl = atoi(MIN_QUANT_LVL),
 		.max_quant_lvl = atoi(MAX_QUANT_LVL),
@@ -384,13 +2135,50 @@ int main (int argc, char *argv[])
 		.max_bitrate = atoi(CURR_BR),
 		.curr_bitrate = atoi(CURR_BR),
 		.msg_rate = 5,
+		.mtu = atoi(DEFAULT_MTU),
+		.slice_mtu = FALSE,
+		.batch = { .enabled = FALSE },
+		.rtx_time = atoi(DEFAULT_RTX_TIME),
+		.fec_max = atoi(DEFAULT_FEC),
+		.fec_pct = 0,
+		.tune = SOCK_TUNE_INIT,
+		.low_latency = FALSE,
+		.capture_ext = FALSE,
+		.flight_dir = DEFAULT_FLIGHT_DIR,
+		.flight_secs = atoi(DEFAULT_FLIGHT_SECS),
+		.rate_correct = FALSE,
+		.rate_scale = 1.0,
+		.quality_secs = atoi(DEFAULT_QUALITY),
+		.quality_frames = atoi(DEFAULT_QUALITY_FRAMES),
+		.motion_pct = atoi(DEFAULT_MOTION_ADAPT),
+		.motion = {
+			.threshold = atof(DEFAULT_MOTION_THRESHOLD),
+			.skip_threshold = atof(DEFAULT_SKIP_THRESHOLD),
+			.skip_max_us = atoi(DEFAULT_SKIP_STATIC) * 1000,
+		},
+		.timeshift_secs = atoi(DEFAULT_TIMESHIFT),
+		.timeshift_mb = atoi(DEFAULT_TIMESHIFT_MB),
+		.record_secs = atoi(DEFAULT_RECORD_SECS),
+		.record_format = RECORD_MKV,
+		.record_max_mb = atoi(DEFAULT_RECORD_MAX_MB),
+		.record_max_hours = atoi(DEFAULT_RECORD_MAX_HOURS),
+		.hls_segment = atoi(DEFAULT_HLS_SEGMENT),
+		.hls_part = atoi(DEFAULT_HLS_PART),
+		.hls_weight = atoi(DEFAULT_HLS_WEIGHT),
+		.webrtc_max = atoi(DEFAULT_WEBRTC_MAX),
 	};
 
 	char *port = (char *) DEFAULT_PORT;
 	char *mount_point = (char *) DEFAULT_MOUNT_POINT;
 	char *src_element = (char *) DEFAULT_SRC_ELEMENT;
+	char *enc_element = (char *) DEFAULT_ENC_ELEMENT;
 	char *caps_filter = NULL;
 	char *user_pipeline = NULL;
+	char *http_addr = (char *) DEFAULT_HTTP_ADDR;
+	int http_port = atoi(DEFAULT_HTTP_PORT);
+	gboolean shm_stats = FALSE;
+	gboolean snapshot = FALSE;
+	char shm_name[64];
 	/* Launch pipeline shouldn't exceed LAUNCH_MAX bytes of characters */
 	char launch[LAUNCH_MAX];
 
@@ -413,6 +2201,50 @@ int main (int argc, char *argv[])
 		{"config-interval",  required_argument, 0, 'c'},
 		{"idr",              required_argument, 0, 'a'},
 		{"msg-rate",         required_argument, 0, 'r'},
+		{"udp-batch",        no_argument,       0,  0 },
+		{"mtu",              required_argument, 0,  0 },
+		{"slice-mtu",        no_argument,       0,  0 },
+		{"rtx-time",         required_argument, 0,  0 },
+		{"fec",              required_argument, 0,  0 },
+		{"sndbuf",           required_argument, 0,  0 },
+		{"tcp-nodelay",      no_argument,       0,  0 },
+		{"tcp-notsent-lowat", required_argument, 0, 0 },
+		{"dscp",             required_argument, 0,  0 },
+		{"encoder",          required_argument, 0,  0 },
+		{"low-latency",      no_argument,       0,  0 },
+		{"capture-time",     no_argument,       0,  0 },
+		{"syslog",           no_argument,       0,  0 },
+		{"flight-dir",       required_argument, 0,  0 },
+		{"flight-secs",      required_argument, 0,  0 },
+		{"http-port",        required_argument, 0,  0 },
+		{"http-addr",        required_argument, 0,  0 },
+		{"snapshot",         no_argument,       0,  0 },
+		{"always-on",        no_argument,       0,  0 },
+		{"shm-stats",        no_argument,       0,  0 },
+		{"rate-correct",     no_argument,       0,  0 },
+		{"quality",          required_argument, 0,  0 },
+		{"quality-frames",   required_argument, 0,  0 },
+		{"idr-auto",         required_argument, 0,  0 },
+		{"intra-refresh",    required_argument, 0,  0 },
+		{"motion-adapt",     required_argument, 0,  0 },
+		{"motion-threshold", required_argument, 0,  0 },
+		{"skip-static",      required_argument, 0,  0 },
+		{"skip-threshold",   required_argument, 0,  0 },
+		{"timeshift",        required_argument, 0,  0 },
+		{"timeshift-mb",     required_argument, 0,  0 },
+		{"record",           required_argument, 0,  0 },
+		{"record-secs",      required_argument, 0,  0 },
+		{"record-format",    required_argument, 0,  0 },
+		{"record-max-mb",    required_argument, 0,  0 },
+		{"record-max-hours", required_argument, 0,  0 },
+		{"record-direct",    no_argument,       0,  0 },
+		{"hls",              no_argument,       0,  0 },
+		{"hls-segment",      required_argument, 0,  0 },
+		{"hls-part",         required_argument, 0,  0 },
+		{"hls-weight",       required_argument, 0,  0 },
+		{"webrtc",           no_argument,       0,  0 },
+		{"webrtc-stun",      required_argument, 0,  0 },
+		{"webrtc-max",       required_argument, 0,  0 },
 		{ /* Sentinel */ }
 	};
 	char *arg_parse = "?hvd:m:p:u:s:i:f:b:l:c:a:r:";
@@ -450,7 +2282,117 @@ int main (int argc, char *argv[])
 		" --idr              -a - Interval between IDR Frames"
 		" (default: " DEFAULT_IDR_INTERVAL ")\n"
 		" --msg-rate,        -r - Rate of messages displayed"
-		" (default: 5s)\n\n"
+		" (default: 5s)\n"
+		" --udp-batch,          - Send each frame's RTP packets to a\n"
+		"                         client with one sendmmsg()"
+		" (default: off)\n"
+		" --mtu,                - Max RTP packet size"
+		" (default: " DEFAULT_MTU ")\n"
+		" --slice-mtu,          - Encode slices that fit in one RTP\n"
+		"                         packet (default: off)\n"
+		" --rtx-time,           - Keep packets for retransmission\n"
+		"                         (ms), 0 == off"
+		" (default: " DEFAULT_RTX_TIME ")\n"
+		" --fec,                - Max ULPFEC percentage, adapts to\n"
+		"                         client loss, 0 == off"
+		" (default: " DEFAULT_FEC ")\n"
+		" --sndbuf,             - SO_SNDBUF of RTSP and RTP sockets\n"
+		"                         (default: system)\n"
+		" --tcp-nodelay,        - Disable Nagle on RTSP connections\n"
+		"                         (default: off)\n"
+		" --tcp-notsent-lowat,  - Max unsent bytes queued on RTSP\n"
+		"                         connections (default: system)\n"
+		" --dscp,               - DSCP mark, e.g. EF, AF41 or 0-63\n"
+		"                         (default: none)\n"
+		" --encoder,            - Gstreamer H.264 encoder element\n"
+		"                         (default: " DEFAULT_ENC_ELEMENT ")\n"
+		" --low-latency,        - One frame queues between stages,\n"
+		"                         no B-frames or lookahead"
+		" (default: off)\n"
+		" --capture-time,       - Send capture time in an RTP header\n"
+		"                         extension (default: off)\n"
+		" --syslog,             - Log to syslog/journald instead of\n"
+		"                         stdout (default: off)\n"
+		" --flight-dir,         - Where flight recorder dumps go on\n"
+		"                         errors, stalls and SIGUSR1"
+		" (default: " DEFAULT_FLIGHT_DIR ")\n"
+		" --flight-secs,        - Seconds of events per dump"
+		" (default: " DEFAULT_FLIGHT_SECS ")\n"
+		" --http-port,          - Port for HTTP queries, 0 == off"
+		" (default: " DEFAULT_HTTP_PORT ")\n"
+		" --http-addr,          - Address for HTTP queries\n"
+		"                         (default: " DEFAULT_HTTP_ADDR ")\n"
+		" --snapshot,           - Serve the latest frame at\n"
+		"                         /snapshot.jpg (default: off)\n"
+		" --always-on,          - Keep the pipeline running without\n"
+		"                         clients (default: off)\n"
+		" --shm-stats,          - Publish live statistics in\n"
+		"                         /dev/shm" SHM_STATS_PREFIX "<port>"
+		" (default: off)\n"
+		" --rate-correct,       - Lower the encoder bitrate when it\n"
+		"                         keeps overshooting (default: off)\n"
+		" --quality,            - Seconds between PSNR/SSIM samples,\n"
+		"                         0 == off"
+		" (default: " DEFAULT_QUALITY ")\n"
+		" --quality-frames,     - Frames scored per sample"
+		" (default: " DEFAULT_QUALITY_FRAMES ")\n"
+		" --idr-auto,           - IDR interval while clients join or\n"
+		"                         lose packets, growing to --idr\n"
+		"                         when stable, 0 == off"
+		" (default: " DEFAULT_IDR_AUTO ")\n"
+		" --intra-refresh,      - Frames per intra refresh cycle,\n"
+		"                         instead of IDRs, 0 == off"
+		" (default: " DEFAULT_INTRA_REFRESH ")\n"
+		" --motion-adapt,       - Percent of the bitrate kept while\n"
+		"                         the scene is still, 0 == off"
+		" (default: " DEFAULT_MOTION_ADAPT ")\n"
+		" --motion-threshold,   - Mean luma difference per pixel that\n"
+		"                         counts as motion"
+		" (default: " DEFAULT_MOTION_THRESHOLD ")\n"
+		" --skip-static,        - Skip frames that barely differ from\n"
+		"                         the last encoded one, for at most\n"
+		"                         this many ms, 0 == off"
+		" (default: " DEFAULT_SKIP_STATIC ")\n"
+		" --skip-threshold,     - Mean luma difference per pixel\n"
+		"                         under which frames are skipped"
+		" (default: " DEFAULT_SKIP_THRESHOLD ")\n"
+		" --timeshift,          - Seconds of video kept for replay\n"
+		"                         at <mount point>" TIMESHIFT_MOUNT
+		", 0 == off"
+		" (default: " DEFAULT_TIMESHIFT ")\n"
+		" --timeshift-mb,       - Memory for the timeshift in MB"
+		" (default: " DEFAULT_TIMESHIFT_MB ")\n"
+		" --record,             - Record segments into this directory\n"
+		"                         (default: off)\n"
+		" --record-secs,        - Seconds per segment"
+		" (default: " DEFAULT_RECORD_SECS ")\n"
+		" --record-format,      - mkv or mp4"
+		" (default: " DEFAULT_RECORD_FORMAT ")\n"
+		" --record-max-mb,      - Remove the oldest segments beyond\n"
+		"                         this size, 0 == no limit"
+		" (default: " DEFAULT_RECORD_MAX_MB ")\n"
+		" --record-max-hours,   - Remove segments older than this,\n"
+		"                         0 == no limit"
+		" (default: " DEFAULT_RECORD_MAX_HOURS ")\n"
+		" --record-direct,      - Write segments with O_DIRECT"
+		" (default: off)\n"
+		" --hls,                - Serve Low-Latency HLS at\n"
+		"                         http://<http-addr>:<http-port>"
+		HLS_PATH "index.m3u8 (default: off)\n"
+		" --hls-segment,        - Seconds per HLS segment"
+		" (default: " DEFAULT_HLS_SEGMENT ")\n"
+		" --hls-part,           - Longest HLS part in ms"
+		" (default: " DEFAULT_HLS_PART ")\n"
+		" --hls-weight,         - Percent of a client each HLS viewer\n"
+		"                         counts for, 0 == none"
+		" (default: " DEFAULT_HLS_WEIGHT ")\n"
+		" --webrtc,             - Serve WebRTC, signalled at\n"
+		"                         http://<http-addr>:<http-port>"
+		WEBRTC_PATH " (default: off)\n"
+		" --webrtc-stun,        - STUN server for WebRTC,\n"
+		"                         stun://host:port (default: none)\n"
+		" --webrtc-max,         - Most WebRTC peers at once"
+		" (default: " DEFAULT_WEBRTC_MAX ")\n\n"
 		"Examples:\n"
 		" 1. Capture using imxv4l2videosrc, changes quality:\n"
 		"\tgst-variable-rtsp-server -s imxv4l2videosrc\n"
@@ -463,6 +2405,10 @@ int main (int argc, char *argv[])
 	/* Init GStreamer */
 	gst_init(&argc, &argv);
 
+	/* Output happens on a writer thread from here on */
+	log_init("gst-variable-rtsp-server");
+	atexit(log_close);
+
 	/* Parse Args */
 	while (TRUE) {
 		int opt_ndx;
@@ -510,6 +2456,214 @@ int main (int argc, char *argv[])
 				}
 				dbg(1, "set max quant to: %d\n",
 				    info.max_quant_lvl);
+			} else if (strcmp(long_opts[opt_ndx].name,
+					  "udp-batch") == 0) {
+				info.batch.enabled = TRUE;
+				dbg(1, "enabled udp batching\n");
+			} else if (strcmp(long_opts[opt_ndx].name,
+					  "mtu") == 0) {
+				info.mtu = atoi(optarg);
+				dbg(1, "set mtu to: %d\n", info.mtu);
+			} else if (strcmp(long_opts[opt_ndx].name,
+					  "slice-mtu") == 0) {
+				info.slice_mtu = TRUE;
+				dbg(1, "enabled slice-mtu\n");
+			} else if (strcmp(long_opts[opt_ndx].name,
+					  "rtx-time") == 0) {
+				info.rtx_time = atoi(optarg);
+				dbg(1, "set rtx time to: %d\n", info.rtx_time);
+			} else if (strcmp(long_opts[opt_ndx].name,
+					  "fec") == 0) {
+				info.fec_max = CLAMP(atoi(optarg), 0, 100);
+				dbg(1, "set max fec to: %d\n", info.fec_max);
+			} else if (strcmp(long_opts[opt_ndx].name,
+					  "sndbuf") == 0) {
+				info.tune.sndbuf = atoi(optarg);
+				dbg(1, "set sndbuf to: %d\n", info.tune.sndbuf);
+			} else if (strcmp(long_opts[opt_ndx].name,
+					  "tcp-nodelay") == 0) {
+				info.tune.nodelay = 1;
+				dbg(1, "enabled tcp nodelay\n");
+			} else if (strcmp(long_opts[opt_ndx].name,
+					  "tcp-notsent-lowat") == 0) {
+				info.tune.notsent_lowat = atoi(optarg);
+				dbg(1, "set tcp notsent lowat to: %d\n",
+				    info.tune.notsent_lowat);
+			} else if (strcmp(long_opts[opt_ndx].name,
+					  "dscp") == 0) {
+				info.tune.dscp = sock_tune_parse_dscp(optarg);
+				if (info.tune.dscp == SOCK_TUNE_UNSET) {
+					g_printerr("Unknown DSCP: %s\n",
+						   optarg);
+					return -ECODE_ARGS;
+				}
+				dbg(1, "set dscp to: %d\n", info.tune.dscp);
+			} else if (strcmp(long_opts[opt_ndx].name,
+					  "encoder") == 0) {
+				enc_element = optarg;
+				dbg(1, "set encoder element to: %s\n",
+				    enc_element);
+			} else if (strcmp(long_opts[opt_ndx].name,
+					  "low-latency") == 0) {
+				info.low_latency = TRUE;
+				dbg(1, "enabled low latency\n");
+			} else if (strcmp(long_opts[opt_ndx].name,
+					  "capture-time") == 0) {
+				info.capture_ext = TRUE;
+				dbg(1, "enabled capture time extension\n");
+			} else if (strcmp(long_opts[opt_ndx].name,
+					  "syslog") == 0) {
+				log_set_target(LOG_TO_SYSLOG);
+				dbg(1, "logging to syslog\n");
+			} else if (strcmp(long_opts[opt_ndx].name,
+					  "flight-dir") == 0) {
+				info.flight_dir = optarg;
+				dbg(1, "set flight dir to: %s\n",
+				    info.flight_dir);
+			} else if (strcmp(long_opts[opt_ndx].name,
+					  "flight-secs") == 0) {
+				info.flight_secs = atoi(optarg);
+				dbg(1, "set flight secs to: %d\n",
+				    info.flight_secs);
+			} else if (strcmp(long_opts[opt_ndx].name,
+					  "http-port") == 0) {
+				http_port = atoi(optarg);
+				dbg(1, "set http port to: %d\n", http_port);
+			} else if (strcmp(long_opts[opt_ndx].name,
+					  "http-addr") == 0) {
+				http_addr = optarg;
+				dbg(1, "set http addr to: %s\n", http_addr);
+			} else if (strcmp(long_opts[opt_ndx].name,
+					  "snapshot") == 0) {
+				snapshot = TRUE;
+				dbg(1, "enabled snapshots\n");
+			} else if (strcmp(long_opts[opt_ndx].name,
+					  "always-on") == 0) {
+				info.always_on = TRUE;
+				dbg(1, "enabled always on\n");
+			} else if (strcmp(long_opts[opt_ndx].name,
+					  "shm-stats") == 0) {
+				shm_stats = TRUE;
+				dbg(1, "enabled shm stats\n");
+			} else if (strcmp(long_opts[opt_ndx].name,
+					  "rate-correct") == 0) {
+				info.rate_correct = TRUE;
+				dbg(1, "enabled rate correction\n");
+			} else if (strcmp(long_opts[opt_ndx].name,
+					  "quality") == 0) {
+				info.quality_secs = atoi(optarg);
+				dbg(1, "set quality interval to: %d\n",
+				    info.quality_secs);
+			} else if (strcmp(long_opts[opt_ndx].name,
+					  "quality-frames") == 0) {
+				info.quality_frames = atoi(optarg);
+				dbg(1, "set quality frames to: %d\n",
+				    info.quality_frames);
+			} else if (strcmp(long_opts[opt_ndx].name,
+					  "idr-auto") == 0) {
+				info.idr_auto = MAX(atoi(optarg), 0);
+				dbg(1, "set idr auto to: %d\n", info.idr_auto);
+			} else if (strcmp(long_opts[opt_ndx].name,
+					  "intra-refresh") == 0) {
+				info.intra_refresh = MAX(atoi(optarg), 0);
+				dbg(1, "set intra refresh to: %d\n",
+				    info.intra_refresh);
+			} else if (strcmp(long_opts[opt_ndx].name,
+					  "motion-adapt") == 0) {
+				info.motion_pct = CLAMP(atoi(optarg), 0, 100);
+				dbg(1, "set motion adapt to: %d\n",
+				    info.motion_pct);
+			} else if (strcmp(long_opts[opt_ndx].name,
+					  "motion-threshold") == 0) {
+				info.motion.threshold = atof(optarg);
+				dbg(1, "set motion threshold to: %.2f\n",
+				    info.motion.threshold);
+			} else if (strcmp(long_opts[opt_ndx].name,
+					  "skip-static") == 0) {
+				info.motion.skip_max_us = MAX(atoi(optarg), 0) *
+					(gint64) 1000;
+				dbg(1, "set skip static to: %s\n", optarg);
+			} else if (strcmp(long_opts[opt_ndx].name,
+					  "skip-threshold") == 0) {
+				info.motion.skip_threshold = atof(optarg);
+				dbg(1, "set skip threshold to: %.2f\n",
+				    info.motion.skip_threshold);
+			} else if (strcmp(long_opts[opt_ndx].name,
+					  "timeshift") == 0) {
+				info.timeshift_secs = MAX(atoi(optarg), 0);
+				dbg(1, "set timeshift to: %d\n",
+				    info.timeshift_secs);
+			} else if (strcmp(long_opts[opt_ndx].name,
+					  "timeshift-mb") == 0) {
+				info.timeshift_mb = MAX(atoi(optarg), 1);
+				dbg(1, "set timeshift mb to: %d\n",
+				    info.timeshift_mb);
+			} else if (strcmp(long_opts[opt_ndx].name,
+					  "record") == 0) {
+				info.record_dir = optarg;
+				dbg(1, "set record dir to: %s\n",
+				    info.record_dir);
+			} else if (strcmp(long_opts[opt_ndx].name,
+					  "record-secs") == 0) {
+				info.record_secs = MAX(atoi(optarg), 1);
+				dbg(1, "set record secs to: %d\n",
+				    info.record_secs);
+			} else if (strcmp(long_opts[opt_ndx].name,
+					  "record-format") == 0) {
+				if (!recorder_parse_format(optarg,
+						&info.record_format)) {
+					g_printerr("Unknown recording format: "
+						   "%s\n", optarg);
+					return -ECODE_ARGS;
+				}
+				dbg(1, "set record format to: %s\n", optarg);
+			} else if (strcmp(long_opts[opt_ndx].name,
+					  "record-max-mb") == 0) {
+				info.record_max_mb = MAX(atoi(optarg), 0);
+				dbg(1, "set record max mb to: %d\n",
+				    info.record_max_mb);
+			} else if (strcmp(long_opts[opt_ndx].name,
+					  "record-max-hours") == 0) {
+				info.record_max_hours = MAX(atoi(optarg), 0);
+				dbg(1, "set record max hours to: %d\n",
+				    info.record_max_hours);
+			} else if (strcmp(long_opts[opt_ndx].name,
+					  "record-direct") == 0) {
+				info.record_direct = TRUE;
+				dbg(1, "enabled record o_direct\n");
+			} else if (strcmp(long_opts[opt_ndx].name,
+					  "hls") == 0) {
+				info.hls_on = TRUE;
+				dbg(1, "enabled hls\n");
+			} else if (strcmp(long_opts[opt_ndx].name,
+					  "hls-segment") == 0) {
+				info.hls_segment = MAX(atoi(optarg), 1);
+				dbg(1, "set hls segment to: %d\n",
+				    info.hls_segment);
+			} else if (strcmp(long_opts[opt_ndx].name,
+					  "hls-part") == 0) {
+				info.hls_part = MAX(atoi(optarg), 100);
+				dbg(1, "set hls part to: %d\n",
+				    info.hls_part);
+			} else if (strcmp(long_opts[opt_ndx].name,
+					  "hls-weight") == 0) {
+				info.hls_weight = MAX(atoi(optarg), 0);
+				dbg(1, "set hls weight to: %d\n",
+				    info.hls_weight);
+			} else if (strcmp(long_opts[opt_ndx].name,
+					  "webrtc") == 0) {
+				info.webrtc_on = TRUE;
+				dbg(1, "enabled webrtc\n");
+			} else if (strcmp(long_opts[opt_ndx].name,
+					  "webrtc-stun") == 0) {
+				info.webrtc_stun = optarg;
+				dbg(1, "set webrtc stun to: %s\n",
+				    info.webrtc_stun);
+			} else if (strcmp(long_opts[opt_ndx].name,
+					  "webrtc-max") == 0) {
+				info.webrtc_max = MAX(atoi(optarg), 1);
+				dbg(1, "set webrtc max to: %d\n",
+				    info.webrtc_max);
 			} else {
 				puts(usage);
 				return -ECODE_ARGS;
@@ -610,6 +2764,23 @@ int main (int argc, char *argv[])
 		return -ECODE_ARGS;
 	}
 
+	/* The automatic interval grows from idr-auto up to idr */
+	if (info.idr_auto && info.idr_auto > ((info.idr > 0) ? info.idr :
+					      IDR_AUTO_MAX)) {
+		g_printerr("--idr-auto %d must not be more than %s %d\n",
+			   info.idr_auto, (info.idr > 0) ? "--idr" :
+			   "the automatic maximum", (info.idr > 0) ? info.idr :
+			   IDR_AUTO_MAX);
+		return -ECODE_ARGS;
+	}
+
+	if (info.mtu < 2 * RTP_OVERHEAD + CAPTURE_EXT_BYTES ||
+	    info.mtu > 65507) {
+		g_printerr("MTU must be between %d and 65507\n",
+			   2 * RTP_OVERHEAD + CAPTURE_EXT_BYTES);
+		return -ECODE_ARGS;
+	}
+
 	if (info.steps < 1) {
 		/* Because we subtract 1 off of user input of steps,
 		 * we must account for it here when reporting to user
@@ -618,6 +2789,30 @@ int main (int argc, char *argv[])
 		return -ECODE_ARGS;
 	}
 
+#ifndef HAVE_WEBRTC
+	if (info.webrtc_on) {
+		g_print("Built without gstreamer-webrtc-1.0, ignoring "
+			"--webrtc\n");
+		info.webrtc_on = FALSE;
+	}
+#endif
+
+	/*
+	 * With intra refresh only the first frame is a key frame. These all
+	 * start, cut or sample on key frames and would wait forever. Options
+	 * that are ignored further down don't count.
+	 */
+	if (info.intra_refresh &&
+	    ((!user_pipeline && (info.timeshift_secs || info.record_dir)) ||
+	     (!user_pipeline && http_port > 0 &&
+	      (info.hls_on || info.webrtc_on)) ||
+	     info.quality_secs > 0)) {
+		g_printerr("--intra-refresh can't be used with --timeshift, "
+			   "--record, --hls, --webrtc or --quality, they need "
+			   "key frames\n");
+		return -ECODE_ARGS;
+	}
+
 	/* Configure RTSP */
 	info.server = gst_rtsp_server_new();
 	if (!info.server) {
@@ -636,6 +2831,21 @@ int main (int argc, char *argv[])
 	/* Share single pipeline with all clients */
 	gst_rtsp_media_factory_set_shared(info.factory, TRUE);
 
+	if (info.low_latency) {
+		g_print("Setting media latency=%dms\n", LOW_LATENCY_MS);
+		gst_rtsp_media_factory_set_latency(info.factory,
+						   LOW_LATENCY_MS);
+	}
+
+	/* RTX needs AVPF, plain AVP clients keep working without it */
+	if (info.rtx_time > 0) {
+		g_print("Enabling retransmission, %dms\n", info.rtx_time);
+		gst_rtsp_media_factory_set_retransmission_time(info.factory,
+			info.rtx_time * GST_MSECOND);
+		gst_rtsp_media_factory_set_profiles(info.factory,
+			GST_RTSP_PROFILE_AVP | GST_RTSP_PROFILE_AVPF);
+	}
+
 	/* Source Pipeline */
 	if (user_pipeline)
 		snprintf(launch, LAUNCH_MAX, "( %s )", user_pipeline);
@@ -644,7 +2854,10 @@ int main (int argc, char *argv[])
 			 STATIC_SINK_PIPELINE,
 			 src_element,
 			 (caps_filter) ? caps_filter : "",
-			 (caps_filter) ? " ! " : "");
+			 (caps_filter) ? " ! " : "",
+			 (info.low_latency) ? LOW_LATENCY_QUEUE("capq0") : "",
+			 (info.low_latency) ? LOW_LATENCY_QUEUE("encq0") : "",
+			 enc_element);
 	g_print("Pipeline set to: %s...\n", launch);
 	gst_rtsp_media_factory_set_launch(info.factory, launch);
 
@@ -652,9 +2865,227 @@ int main (int argc, char *argv[])
 	gst_rtsp_mount_points_add_factory(info.mounts, mount_point,
 					  info.factory);
 
+	if (info.timeshift_secs && user_pipeline) {
+		g_print("Can't find the encoder of a user pipeline, ignoring "
+			"--timeshift\n");
+	} else if (info.timeshift_secs) {
+		GstRTSPMediaFactory *factory;
+
+		info.timeshift = timeshift_new(info.timeshift_secs,
+					       (gsize) info.timeshift_mb <<
+					       20);
+		if (!info.timeshift) {
+			g_printerr("Unable to allocate %dMB for the "
+				   "timeshift\n", info.timeshift_mb);
+			return -ECODE_ARGS;
+		}
+
+		/* Not shared, every client replays from its own position */
+		factory = gst_rtsp_media_factory_new();
+		snprintf(launch, LAUNCH_MAX, TIMESHIFT_PIPELINE,
+			 info.config_interval, info.mtu);
+		gst_rtsp_media_factory_set_launch(factory, launch);
+		g_signal_connect(factory, "media-configure",
+				 G_CALLBACK(timeshift_configure_handler),
+				 &info);
+		info.timeshift_mount = g_strconcat(mount_point,
+						   TIMESHIFT_MOUNT, NULL);
+		gst_rtsp_mount_points_add_factory(info.mounts,
+						  info.timeshift_mount,
+						  factory);
+
+		/* Frames only reach the ring while the pipeline runs */
+		if (!info.always_on)
+			g_print("Keeping the pipeline running for "
+				"--timeshift\n");
+		info.always_on = TRUE;
+		g_print("Keeping %ds of video in up to %dMB at "
+			"rtsp://" DEFAULT_HOST ":%s%s\n", info.timeshift_secs,
+			info.timeshift_mb, port, info.timeshift_mount);
+	}
+
+	if (info.record_dir && user_pipeline) {
+		g_print("Can't find the encoder of a user pipeline, ignoring "
+			"--record\n");
+	} else if (info.record_dir) {
+		/* Reserve what a segment at the top bitrate needs */
+		guint64 prealloc = (info.max_bitrate) ?
+			(guint64) info.max_bitrate * 1000 / 8 *
+			info.record_secs * RECORD_PREALLOC_PCT / 100 :
+			RECORD_PREALLOC;
+
+		info.recorder = recorder_new(info.record_dir,
+					     info.record_format,
+					     info.record_secs,
+					     info.record_max_mb,
+					     info.record_max_hours,
+					     MIN(prealloc, RECORD_PREALLOC_MAX),
+					     info.record_direct);
+		if (!info.recorder) {
+			g_printerr("Unable to record to %s\n", info.record_dir);
+			return -ECODE_ARGS;
+		}
+
+		/* Frames only reach the writer while the pipeline runs */
+		if (!info.always_on)
+			g_print("Keeping the pipeline running for "
+				"--record\n");
+		info.always_on = TRUE;
+		g_print("Recording %ds %s segments to %s%s\n",
+			info.record_secs, recorder_ext(info.recorder),
+			info.record_dir, (info.record_direct) ?
+			" (O_DIRECT)" : "");
+	}
+
+	if (info.hls_on && user_pipeline) {
+		g_print("Can't find the encoder of a user pipeline, ignoring "
+			"--hls\n");
+	} else if (info.hls_on && http_port <= 0) {
+		g_print("HLS needs --http-port, ignoring --hls\n");
+	} else if (info.hls_on) {
+		/* Parts are cut from segments, never the other way round */
+		info.hls_part = MIN(info.hls_part, info.hls_segment * 1000);
+		info.hls = hls_new(info.hls_segment, info.hls_part,
+				   (hls_key_fn) request_idr, &info);
+
+		/* Frames only reach the segmenter while the pipeline runs */
+		if (!info.always_on)
+			g_print("Keeping the pipeline running for --hls\n");
+		info.always_on = TRUE;
+		g_print("HLS in %ds segments of %dms parts at "
+			"http://%s:%d" HLS_PATH "index.m3u8\n",
+			info.hls_segment, info.hls_part, http_addr,
+			http_port);
+	}
+
+	if (info.webrtc_on && user_pipeline) {
+		g_print("Can't find the encoder of a user pipeline, ignoring "
+			"--webrtc\n");
+	} else if (info.webrtc_on && http_port <= 0) {
+		g_print("WebRTC needs --http-port, ignoring --webrtc\n");
+	} else if (info.webrtc_on) {
+		info.webrtc = webrtc_new(info.webrtc_stun, info.webrtc_max,
+					 info.capture_ext, info.mtu,
+					 (webrtc_key_fn) request_idr, &info);
+
+		/* A peer shouldn't wait for the camera and encoder to start */
+		if (!info.always_on)
+			g_print("Keeping the pipeline running for "
+				"--webrtc\n");
+		info.always_on = TRUE;
+		g_print("WebRTC for up to %d peers at http://%s:%d"
+			WEBRTC_PATH "%s%s\n", info.webrtc_max, http_addr,
+			http_port, (info.webrtc_stun) ? ", STUN " : "",
+			(info.webrtc_stun) ? info.webrtc_stun : "");
+	}
+
 	/* Create GLIB MainContext */
 	info.main_loop = g_main_loop_new(NULL, FALSE);
 
+	/* Dump the flight recorder on demand */
+	g_unix_signal_add(SIGUSR1, (GSourceFunc) sigusr1_handler, &info);
+	g_unix_signal_add(SIGINT, (GSourceFunc) quit_handler, &info);
+	g_unix_signal_add(SIGTERM, (GSourceFunc) quit_handler, &info);
+
+	/* Statistics history, sampled for the lifetime of the server */
+	info.history = history_new();
+	g_timeout_add_seconds(1, (GSourceFunc) history_handler, &info);
+
+	if (info.quality_secs > 0) {
+		info.quality = quality_sampler_new(info.quality_frames,
+						   (quality_key_fn) request_idr,
+						   &info);
+		g_print("Sampling quality every %ds, %d frames (%s)\n",
+			info.quality_secs, info.quality->budget,
+			quality_simd());
+	}
+
+	if (info.intra_refresh) {
+		/* Forced IDRs would undo what the refresh saves */
+		if (info.idr_auto) {
+			g_print("Ignoring --idr-auto with --intra-refresh\n");
+			info.idr_auto = 0;
+		}
+		if (info.config_interval <= 0 ||
+		    info.config_interval > IR_CONFIG_INTERVAL) {
+			g_print("Sending rtp config every %ds for intra "
+				"refresh\n", IR_CONFIG_INTERVAL);
+			info.config_interval = IR_CONFIG_INTERVAL;
+		}
+	}
+
+	g_mutex_init(&info.enc_lock);
+	if (info.motion_pct) {
+		info.motion.changed = (motion_fn) motion_handler;
+		info.motion.data = &info;
+		g_print("Still scenes at %d%% after %ds below %.2f (%s)\n",
+			info.motion_pct, MOTION_HOLD_US / G_USEC_PER_SEC,
+			info.motion.threshold, quality_simd());
+	}
+	/* The watchdog would take a skipped run for a stall */
+	if (info.motion.skip_max_us >= WATCHDOG_SECS * G_USEC_PER_SEC) {
+		info.motion.skip_max_us = (WATCHDOG_SECS - 1) * G_USEC_PER_SEC;
+		g_print("Limiting --skip-static to %dms\n",
+			(WATCHDOG_SECS - 1) * 1000);
+	}
+	if (info.motion.skip_max_us)
+		g_print("Skipping frames below %.2f for up to %dms\n",
+			info.motion.skip_threshold,
+			(gint) (info.motion.skip_max_us / 1000));
+	info.motion_on = info.motion_pct || info.motion.skip_max_us;
+
+	if (shm_stats) {
+		g_snprintf(shm_name, sizeof(shm_name), SHM_STATS_PREFIX "%s",
+			   port);
+		info.shm = shm_stats_create(shm_name);
+		if (!info.shm) {
+			g_printerr("Unable to create /dev/shm%s\n", shm_name);
+			return -ECODE_ARGS;
+		}
+	}
+
+	if (snapshot && http_port <= 0) {
+		g_print("Snapshots need --http-port, ignoring --snapshot\n");
+	} else if (snapshot) {
+		info.snapshot = snapshot_new();
+		http_server_add(&info.http, "/snapshot.jpg",
+				(http_handler_fn) http_snapshot_handler, &info);
+	}
+
+	if (info.timeshift && http_port > 0)
+		http_server_add(&info.http, "/clip.mp4",
+				(http_handler_fn) http_clip_handler, &info);
+
+	if (info.recorder && http_port > 0)
+		http_server_add(&info.http, "/recording",
+				(http_handler_fn) http_recording_handler,
+				&info);
+
+	if (info.webrtc) {
+		http_server_add(&info.http, WEBRTC_PATH,
+				(http_handler_fn) http_webrtc_handler, &info);
+		http_server_add(&info.http, WEBRTC_PATH "/",
+				(http_handler_fn) http_webrtc_handler, &info);
+		g_timeout_add_seconds(1, (GSourceFunc) webrtc_handler, &info);
+	}
+
+	if (info.hls) {
+		http_server_add(&info.http, HLS_PATH,
+				(http_handler_fn) http_hls_handler, &info);
+		if (info.hls_weight)
+			g_timeout_add_seconds(1, (GSourceFunc) hls_handler,
+					      &info);
+	}
+
+	if (http_port > 0) {
+		http_server_add(&info.http, "/stats",
+				(http_handler_fn) http_stats_handler, &info);
+		if (!http_server_start(&info.http, http_addr, http_port))
+			return -ECODE_RTSP;
+		g_print("HTTP queries at http://%s:%d/\n", http_addr,
+			http_port);
+	}
+
 	/* Attach server to default maincontext */
 	ret = gst_rtsp_server_attach(info.server, NULL);
 	if (ret == FALSE) {
@@ -668,6 +3099,19 @@ int main (int argc, char *argv[])
 		dbg(2, "Creating 'client-connected' signal handler\n");
 		g_signal_connect(info.server, "client-connected",
 				 G_CALLBACK(new_client_handler), &info);
+		dbg(2, "Creating 'media-configure' signal handler\n");
+		g_signal_connect(info.factory, "media-configure",
+				 G_CALLBACK(media_configure_handler), &info);
+	}
+
+	if (info.always_on && user_pipeline) {
+		g_print("Can't keep a user pipeline running, ignoring "
+			"--always-on\n");
+		info.always_on = FALSE;
+	} else if (info.always_on &&
+		   !start_always_on(&info, port, mount_point)) {
+		g_printerr("Unable to start the pipeline\n");
+		return -ECODE_PIPE;
 	}
 
 	/* Run GBLIB main loop until it returns */
@@ -676,10 +3120,24 @@ int main (int argc, char *argv[])
 	g_main_loop_run(info.main_loop);
 
 	/* Cleanup */
+	/* No new HTTP requests, then no more frames for the outputs */
+	if (info.http.service)
+		g_socket_service_stop(info.http.service);
+	if (info.media)
+		gst_rtsp_media_unprepare(info.media);
+	if (info.hls)
+		hls_free(info.hls);
+	if (info.recorder)
+		recorder_free(info.recorder);
+
 	g_main_loop_unref(info.main_loop);
 	g_object_unref(info.factory);
-	g_object_unref(info.media);
+	if (info.media)
+		g_object_unref(info.media);
 	g_object_unref(info.mounts);
+	if (shm_stats)
+		shm_stats_destroy(shm_name, info.shm);
+	log_close();
 	return ECODE_OKAY;
 }
 
@@ -0,0 +1,173 @@
+/**
+ * Filename: history.c
+ * Description: Fixed memory statistics history with 1s/1m/1h rollups
+ * Created: Sat Oct 17 13:02:31 2026 (-0700)
+ * Version: 1.0
+ */
+
+/**
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <history.h>
+
+#include <stdio.h>
+#include <string.h>
+
+static const struct {
+	gint period;
+	guint size;
+	const char *name;
+} res_info[NUM_HIST_RES] = {
+	[HIST_1S] = {1,    600,  "1s"},
+	[HIST_1M] = {60,   1440, "1m"},
+	[HIST_1H] = {3600, 720,  "1h"},
+};
+
+static const char *metric_str[NUM_HIST_METRIC] = {
+	[HIST_CLIENTS] = "clients",
+	[HIST_BITRATE] = "bitrate_kbps",
+	[HIST_QUANT]   = "quant",
+	[HIST_FPS]     = "fps",
+	[HIST_EGRESS]  = "egress_kbps",
+	[HIST_LOSS]    = "loss_pct",
+	[HIST_PSNR]    = "psnr_db",
+	[HIST_SSIM]    = "ssim",
+	[HIST_MOTION]  = "motion",
+};
+
+/**
+ * history_new
+ * Allocate every ring up front, nothing is allocated after this
+ */
+struct history *history_new(void)
+{
+	struct history *h = g_new0(struct history, 1);
+	int r;
+
+	g_mutex_init(&h->lock);
+	for (r = 0; r < NUM_HIST_RES; r++) {
+		h->ring[r].period = res_info[r].period;
+		h->ring[r].size = res_info[r].size;
+		h->ring[r].pt = g_new0(struct hist_point, res_info[r].size);
+	}
+
+	return h;
+}
+
+static void flush_point(struct hist_ring *r)
+{
+	struct hist_point *p = &r->pt[r->head];
+	int m;
+
+	p->t = r->acc_t;
+	for (m = 0; m < NUM_HIST_METRIC; m++) {
+		p->avg[m] = r->acc_sum[m] / r->acc_n;
+		p->max[m] = r->acc_max[m];
+	}
+
+	r->head = (r->head + 1) % r->size;
+	if (r->count < r->size)
+		r->count++;
+	r->acc_n = 0;
+}
+
+/**
+ * history_add
+ * Add the sample for second 't'. Coarser points are averaged straight
+ * from the samples, not from the finer points.
+ */
+void history_add(struct history *h, gint64 t,
+		 const gfloat val[NUM_HIST_METRIC])
+{
+	int i, m;
+
+	g_mutex_lock(&h->lock);
+	for (i = 0; i < NUM_HIST_RES; i++) {
+		struct hist_ring *r = &h->ring[i];
+		gint64 start = t - t % r->period;
+
+		if (r->acc_n && start != r->acc_t)
+			flush_point(r);
+
+		if (!r->acc_n) {
+			r->acc_t = start;
+			memset(r->acc_sum, 0, sizeof(r->acc_sum));
+			memset(r->acc_max, 0, sizeof(r->acc_max));
+		}
+		for (m = 0; m < NUM_HIST_METRIC; m++) {
+			r->acc_sum[m] += val[m];
+			if (val[m] > r->acc_max[m])
+				r->acc_max[m] = val[m];
+		}
+		r->acc_n++;
+	}
+	g_mutex_unlock(&h->lock);
+}
+
+gboolean history_parse_res(const char *str, enum hist_res *res)
+{
+	int i;
+
+	for (i = 0; i < NUM_HIST_RES; i++) {
+		if (strcmp(str, res_info[i].name) == 0) {
+			*res = i;
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+/**
+ * history_json
+ * Completed points at resolution 'res' starting at or after 'since',
+ * oldest first:
+ * {"resolution":60,"points":[{"t":..,"clients":..,"clients_max":..},..]}
+ */
+gchar *history_json(struct history *h, enum hist_res res, gint64 since)
+{
+	struct hist_ring *r = &h->ring[res];
+	GString *s = g_string_new(NULL);
+	gboolean first = TRUE;
+	guint i, m;
+
+	g_mutex_lock(&h->lock);
+	g_string_append_printf(s, "{\"resolution\":%d,\"points\":[",
+			       r->period);
+	for (i = 0; i < r->count; i++) {
+		struct hist_point *p =
+			&r->pt[(r->head + r->size - r->count + i) % r->size];
+
+		if (p->t < since)
+			continue;
+
+		g_string_append_printf(s, "%s{\"t\":%" G_GINT64_FORMAT,
+				       (first) ? "" : ",", p->t);
+		for (m = 0; m < NUM_HIST_METRIC; m++)
+			g_string_append_printf(s,
+					       ",\"%s\":%.3f,\"%s_max\":%.3f",
+					       metric_str[m], p->avg[m],
+					       metric_str[m], p->max[m]);
+		g_string_append_c(s, '}');
+		first = FALSE;
+	}
+	g_string_append(s, "]}");
+	g_mutex_unlock(&h->lock);
+
+	return g_string_free(s, FALSE);
+}
+
+/* history.c ends here */
@@ -0,0 +1,1128 @@
+/**
+ * Filename: hls.c
+ * Description: HLS and Low-Latency HLS of the encoded stream, from memory
+ * Created: Fri Oct 23 10:26:54 2026 (-0700)
+ * Version: 1.0
+ */
+
+/**
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/**
+ * A probe on enc0's src pad queues a reference to every access unit for
+ * the segmenter thread, exactly like the recorder does, so the live
+ * pipeline never waits on it.
+ *
+ * The segmenter runs the frames through h264parse for length prefixed
+ * NAL units and an avcC, then writes the fragmented MP4 itself: one init
+ * section per caps, and one moof + mdat per part. Writing the boxes here
+ * rather than through a muxer is what lets a part be cut at any frame
+ * and published the moment it is, which is all Low-Latency HLS asks for.
+ * The recorder and clips can use mp4mux because they write whole files;
+ * mp4mux only closes a fragment when its own fragment-duration is up,
+ * doesn't say which fragments start with a key frame (INDEPENDENT=YES)
+ * and hands out a fragment's bytes split across buffers with nothing
+ * marking where a part ends, which a blocking part request needs to know.
+ * Only the boxes a single H.264 track needs are written.
+ *
+ * A frame is held back until the next one arrives since its duration is
+ * the difference of their timestamps. Segments start at a key frame once
+ * the previous one has reached its length, asking the encoder for one
+ * when it is late. A segment that would run past the target duration is
+ * cut without one, the target never changes while the playlist lives. A
+ * segment is just its parts one after the other.
+ *
+ * Everything lives in memory, the last HLS_SEGMENTS segments and the one
+ * being cut. Requests come in on the HTTP server's threads and wait on
+ * a condition for the playlist or part they asked for (blocking reload
+ * and preload hints), nothing polls. At most HLS_MAX_BLOCKING of them
+ * wait at once, the others get what there is.
+ */
+
+#include <hls.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <gst/app/gstappsink.h>
+#include <gst/app/gstappsrc.h>
+
+#define HLS_PIPELINE							\
+	"appsrc name=hsrc0 format=time block=true ! h264parse !"	\
+	" video/x-h264,stream-format=avc,alignment=au !"		\
+	" appsink name=hsink0 sync=false"
+
+#define HLS_TRACK_ID 1
+
+/* trun sample flags */
+#define SAMPLE_SYNC  0x02000000	/* Depends on no other */
+#define SAMPLE_DELTA 0x01010000	/* Depends on others, not a sync sample */
+
+struct fmp4_sample {
+	guint32 duration;
+	guint32 size;
+	guint32 flags;
+	gint32 cts;		/* PTS - DTS */
+};
+
+/* Segmenter thread state */
+struct segmenter {
+	struct hls *hls;
+	GstElement *pipe;
+	GstElement *src;
+	GstElement *sink;
+	GstCaps *caps;		/* Of the init section in use */
+	gboolean have_init;	/* The caps made one */
+	guint init;		/* Its number */
+	gboolean discont;	/* Next segment starts a new init */
+	gint64 base;		/* First DTS (HLS_TIMESCALE), -1 until then */
+
+	GstBuffer *pending;	/* Frame waiting for its duration */
+	gint64 pending_dts;
+	gint32 pending_cts;
+	guint32 last_dur;
+
+	struct hls_segment *seg; /* Being cut, NULL before a key frame */
+	gint64 seg_dur;
+	gboolean key_asked;	/* For this segment already */
+
+	GArray *samples;	/* fmp4_sample of the part being cut */
+	GByteArray *mdat;	/* And their data */
+	gint64 part_dts;
+	gint64 part_dur;
+	gboolean part_independent;
+	guint32 frag_seq;
+};
+
+static GstPadProbeReturn hls_probe(GstPad *pad, GstPadProbeInfo *info,
+				   struct hls *hls)
+{
+	GstBuffer *buf = GST_PAD_PROBE_INFO_BUFFER(info);
+	gsize size = gst_buffer_get_size(buf);
+	struct hls_au *au;
+	GstCaps *caps;
+
+	if (hls->need_key &&
+	    GST_BUFFER_FLAG_IS_SET(buf, GST_BUFFER_FLAG_DELTA_UNIT))
+		return GST_PAD_PROBE_OK;
+
+	if (g_atomic_int_get(&hls->queued) + size > HLS_QUEUE_MAX) {
+		g_atomic_int_inc(&hls->dropped);
+		hls->need_key = TRUE;
+		return GST_PAD_PROBE_OK;
+	}
+	hls->need_key = FALSE;
+
+	au = g_new0(struct hls_au, 1);
+	au->buf = gst_buffer_ref(buf);
+
+	caps = gst_pad_get_current_caps(pad);
+	if (caps && (!hls->caps || !gst_caps_is_equal(caps, hls->caps))) {
+		gst_caps_replace(&hls->caps, caps);
+		au->caps = gst_caps_ref(caps);
+	}
+	if (caps)
+		gst_caps_unref(caps);
+
+	g_atomic_int_add(&hls->queued, size);
+	g_async_queue_push(hls->queue, au);
+
+	return GST_PAD_PROBE_OK;
+}
+
+static void au_free(struct hls_au *au)
+{
+	if (au->buf)
+		gst_buffer_unref(au->buf);
+	if (au->caps)
+		gst_caps_unref(au->caps);
+	g_free(au);
+}
+
+static void part_free(struct hls_part *part)
+{
+	g_bytes_unref(part->data);
+	g_free(part);
+}
+
+static void segment_free(struct hls_segment *seg)
+{
+	g_ptr_array_unref(seg->parts);
+	g_free(seg);
+}
+
+/* Big endian box writing */
+static void put8(GByteArray *b, guint8 v)
+{
+	g_byte_array_append(b, &v, 1);
+}
+
+static void put16(GByteArray *b, guint16 v)
+{
+	guint8 d[2];
+
+	GST_WRITE_UINT16_BE(d, v);
+	g_byte_array_append(b, d, sizeof(d));
+}
+
+static void put32(GByteArray *b, guint32 v)
+{
+	guint8 d[4];
+
+	GST_WRITE_UINT32_BE(d, v);
+	g_byte_array_append(b, d, sizeof(d));
+}
+
+static void put64(GByteArray *b, guint64 v)
+{
+	guint8 d[8];
+
+	GST_WRITE_UINT64_BE(d, v);
+	g_byte_array_append(b, d, sizeof(d));
+}
+
+static void put_zero(GByteArray *b, guint n)
+{
+	while (n--)
+		put8(b, 0);
+}
+
+static void put_fourcc(GByteArray *b, const char *fourcc)
+{
+	g_byte_array_append(b, (const guint8 *) fourcc, 4);
+}
+
+static void put_matrix(GByteArray *b)
+{
+	static const guint32 unity[9] = {
+		0x00010000, 0, 0, 0, 0x00010000, 0, 0, 0, 0x40000000
+	};
+	guint i;
+
+	for (i = 0; i < G_N_ELEMENTS(unity); i++)
+		put32(b, unity[i]);
+}
+
+/* Start a box, its size is filled in by box_close() */
+static guint box_open(GByteArray *b, const char *type)
+{
+	guint pos = b->len;
+
+	put32(b, 0);
+	put_fourcc(b, type);
+
+	return pos;
+}
+
+static guint full_box_open(GByteArray *b, const char *type, guint8 version,
+			   guint32 flags)
+{
+	guint pos = box_open(b, type);
+
+	put32(b, ((guint32) version << 24) | flags);
+
+	return pos;
+}
+
+static void box_close(GByteArray *b, guint pos)
+{
+	GST_WRITE_UINT32_BE(b->data + pos, b->len - pos);
+}
+
+/**
+ * init_section
+ * ftyp and moov for H.264 'caps' from h264parse, NULL without an avcC
+ */
+static GBytes *init_section(GstCaps *caps)
+{
+	GstStructure *st = gst_caps_get_structure(caps, 0);
+	const GValue *v = gst_structure_get_value(st, "codec_data");
+	guint moov, trak, mdia, minf, dinf, dref, stbl, stsd, avc1, mvex, pos;
+	gint width = 0, height = 0;
+	GstBuffer *codec;
+	GstMapInfo map;
+	GByteArray *b;
+
+	if (!v || !GST_VALUE_HOLDS_BUFFER(v))
+		return NULL;
+	codec = gst_value_get_buffer(v);
+	gst_structure_get_int(st, "width", &width);
+	gst_structure_get_int(st, "height", &height);
+
+	b = g_byte_array_new();
+	pos = box_open(b, "ftyp");
+	put_fourcc(b, "iso6");
+	put32(b, 0);
+	put_fourcc(b, "iso6");
+	put_fourcc(b, "mp41");
+	box_close(b, pos);
+
+	moov = box_open(b, "moov");
+	pos = full_box_open(b, "mvhd", 0, 0);
+	put32(b, 0);			/* creation time */
+	put32(b, 0);			/* modification time */
+	put32(b, HLS_TIMESCALE);
+	put32(b, 0);			/* duration, all in fragments */
+	put32(b, 0x00010000);		/* rate 1.0 */
+	put16(b, 0x0100);		/* volume 1.0 */
+	put_zero(b, 10);
+	put_matrix(b);
+	put_zero(b, 24);
+	put32(b, HLS_TRACK_ID + 1);	/* next track */
+	box_close(b, pos);
+
+	trak = box_open(b, "trak");
+	pos = full_box_open(b, "tkhd", 0, 0x000003); /* enabled, in movie */
+	put32(b, 0);
+	put32(b, 0);
+	put32(b, HLS_TRACK_ID);
+	put32(b, 0);
+	put32(b, 0);			/* duration */
+	put_zero(b, 8);
+	put16(b, 0);			/* layer */
+	put16(b, 0);			/* alternate group */
+	put16(b, 0);			/* volume, video has none */
+	put16(b, 0);
+	put_matrix(b);
+	put32(b, (guint32) width << 16);
+	put32(b, (guint32) height << 16);
+	box_close(b, pos);
+
+	mdia = box_open(b, "mdia");
+	pos = full_box_open(b, "mdhd", 0, 0);
+	put32(b, 0);
+	put32(b, 0);
+	put32(b, HLS_TIMESCALE);
+	put32(b, 0);
+	put16(b, 0x55c4);		/* "und" */
+	put16(b, 0);
+	box_close(b, pos);
+
+	pos = full_box_open(b, "hdlr", 0, 0);
+	put32(b, 0);
+	put_fourcc(b, "vide");
+	put_zero(b, 12);
+	g_byte_array_append(b, (const guint8 *) "VideoHandler", 13);
+	box_close(b, pos);
+
+	minf = box_open(b, "minf");
+	pos = full_box_open(b, "vmhd", 0, 1);
+	put_zero(b, 8);
+	box_close(b, pos);
+
+	dinf = box_open(b, "dinf");
+	dref = full_box_open(b, "dref", 0, 0);
+	put32(b, 1);
+	pos = full_box_open(b, "url ", 0, 1); /* media in the same file */
+	box_close(b, pos);
+	box_close(b, dref);
+	box_close(b, dinf);
+
+	stbl = box_open(b, "stbl");
+	stsd = full_box_open(b, "stsd", 0, 0);
+	put32(b, 1);
+	avc1 = box_open(b, "avc1");
+	put_zero(b, 6);
+	put16(b, 1);			/* data reference index */
+	put_zero(b, 16);
+	put16(b, width);
+	put16(b, height);
+	put32(b, 0x00480000);		/* 72 dpi */
+	put32(b, 0x00480000);
+	put32(b, 0);
+	put16(b, 1);			/* frames per sample */
+	put_zero(b, 32);		/* compressor name */
+	put16(b, 0x0018);		/* depth */
+	put16(b, 0xffff);
+	pos = box_open(b, "avcC");
+	if (gst_buffer_map(codec, &map, GST_MAP_READ)) {
+		g_byte_array_append(b, map.data, map.size);
+		gst_buffer_unmap(codec, &map);
+	}
+	box_close(b, pos);
+	box_close(b, avc1);
+	box_close(b, stsd);
+
+	/* Empty, the samples are all described by the fragments */
+	pos = full_box_open(b, "stts", 0, 0);
+	put32(b, 0);
+	box_close(b, pos);
+	pos = full_box_open(b, "stsc", 0, 0);
+	put32(b, 0);
+	box_close(b, pos);
+	pos = full_box_open(b, "stsz", 0, 0);
+	put32(b, 0);
+	put32(b, 0);
+	box_close(b, pos);
+	pos = full_box_open(b, "stco", 0, 0);
+	put32(b, 0);
+	box_close(b, pos);
+	box_close(b, stbl);
+	box_close(b, minf);
+	box_close(b, mdia);
+	box_close(b, trak);
+
+	mvex = box_open(b, "mvex");
+	pos = full_box_open(b, "trex", 0, 0);
+	put32(b, HLS_TRACK_ID);
+	put32(b, 1);			/* sample description index */
+	put32(b, 0);
+	put32(b, 0);
+	put32(b, 0);
+	box_close(b, pos);
+	box_close(b, mvex);
+	box_close(b, moov);
+
+	return g_byte_array_free_to_bytes(b);
+}
+
+/**
+ * fragment
+ * moof and mdat of the part being cut
+ */
+static GBytes *fragment(struct segmenter *w)
+{
+	GByteArray *b = g_byte_array_sized_new(w->mdat->len + 64 +
+					       w->samples->len * 16);
+	guint moof, traf, pos, offset, i;
+	struct fmp4_sample *s;
+
+	moof = box_open(b, "moof");
+	pos = full_box_open(b, "mfhd", 0, 0);
+	put32(b, ++w->frag_seq);
+	box_close(b, pos);
+
+	traf = box_open(b, "traf");
+	pos = full_box_open(b, "tfhd", 0, 0x020000); /* default base is moof */
+	put32(b, HLS_TRACK_ID);
+	box_close(b, pos);
+	pos = full_box_open(b, "tfdt", 1, 0);
+	put64(b, w->part_dts);
+	box_close(b, pos);
+
+	/* data offset, duration, size, flags and composition offset */
+	pos = full_box_open(b, "trun", 1, 0x000f01);
+	put32(b, w->samples->len);
+	offset = b->len;
+	put32(b, 0);
+	for (i = 0; i < w->samples->len; i++) {
+		s = &g_array_index(w->samples, struct fmp4_sample, i);
+		put32(b, s->duration);
+		put32(b, s->size);
+		put32(b, s->flags);
+		put32(b, (guint32) s->cts);
+	}
+	box_close(b, pos);
+	box_close(b, traf);
+	box_close(b, moof);
+
+	/* The samples start right after mdat's header */
+	GST_WRITE_UINT32_BE(b->data + offset, b->len - moof + 8);
+	put32(b, w->mdat->len + 8);
+	put_fourcc(b, "mdat");
+	g_byte_array_append(b, w->mdat->data, w->mdat->len);
+
+	return g_byte_array_free_to_bytes(b);
+}
+
+/* Publish the part being cut */
+static void part_close(struct segmenter *w)
+{
+	struct hls *hls = w->hls;
+	struct hls_part *part;
+
+	if (!w->samples->len)
+		return;
+
+	part = g_new0(struct hls_part, 1);
+	part->data = fragment(w);
+	part->duration = w->part_dur;
+	part->independent = w->part_independent;
+
+	g_mutex_lock(&hls->lock);
+	g_ptr_array_add(w->seg->parts, part);
+	w->seg->duration += part->duration;
+	g_cond_broadcast(&hls->changed);
+	g_mutex_unlock(&hls->lock);
+
+	g_array_set_size(w->samples, 0);
+	g_byte_array_set_size(w->mdat, 0);
+	w->part_dur = 0;
+}
+
+/* Start a segment and let the oldest one go */
+static void segment_open(struct segmenter *w)
+{
+	struct hls *hls = w->hls;
+	struct hls_segment *seg = g_new0(struct hls_segment, 1);
+
+	seg->init = w->init;
+	seg->discont = w->discont;
+	seg->parts = g_ptr_array_new_with_free_func((GDestroyNotify)
+						    part_free);
+	w->discont = FALSE;
+
+	g_mutex_lock(&hls->lock);
+	seg->msn = hls->next_msn++;
+	g_queue_push_tail(&hls->segments, seg);
+	while (g_queue_get_length(&hls->segments) > HLS_SEGMENTS + 1) {
+		struct hls_segment *old = g_queue_pop_head(&hls->segments);
+
+		if (old->discont)
+			hls->discont_seq++;
+		segment_free(old);
+	}
+	g_cond_broadcast(&hls->changed);
+	g_mutex_unlock(&hls->lock);
+
+	w->seg = seg;
+	w->seg_dur = 0;
+	w->key_asked = FALSE;
+}
+
+static void segment_close(struct segmenter *w)
+{
+	struct hls *hls = w->hls;
+
+	if (!w->seg)
+		return;
+
+	part_close(w);
+	g_mutex_lock(&hls->lock);
+	w->seg->complete = TRUE;
+	g_cond_broadcast(&hls->changed);
+	g_mutex_unlock(&hls->lock);
+	w->seg = NULL;
+}
+
+/**
+ * add_sample
+ * Cut the held back frame into the current part now that its duration is
+ * known, starting a segment or a part first when it's time to
+ */
+static void add_sample(struct segmenter *w, guint32 duration)
+{
+	struct hls *hls = w->hls;
+	GstBuffer *buf = w->pending;
+	gboolean key = !GST_BUFFER_FLAG_IS_SET(buf, GST_BUFFER_FLAG_DELTA_UNIT);
+	struct fmp4_sample s;
+	GstMapInfo map;
+
+	w->pending = NULL;
+
+	if (key && (!w->seg || w->seg_dur >= hls->seg_len)) {
+		segment_close(w);
+		segment_open(w);
+	} else if (w->seg && w->seg_dur + duration > hls->target_len) {
+		/* The key frame asked for is late, keep to the target */
+		segment_close(w);
+		segment_open(w);
+	}
+	if (!w->seg || !gst_buffer_map(buf, &map, GST_MAP_READ)) {
+		gst_buffer_unref(buf);
+		return;
+	}
+
+	/* A part never runs over its target */
+	if (w->samples->len && w->part_dur + duration > hls->part_len)
+		part_close(w);
+
+	if (!w->samples->len) {
+		w->part_dts = w->pending_dts;
+		w->part_independent = key;
+	}
+	s.duration = duration;
+	s.size = map.size;
+	s.flags = (key) ? SAMPLE_SYNC : SAMPLE_DELTA;
+	s.cts = w->pending_cts;
+	g_array_append_val(w->samples, s);
+	g_byte_array_append(w->mdat, map.data, map.size);
+	gst_buffer_unmap(buf, &map);
+	gst_buffer_unref(buf);
+
+	w->part_dur += duration;
+	w->seg_dur += duration;
+	if (w->part_dur >= hls->part_len)
+		part_close(w);
+
+	/* Don't wait for the GOP to end the segment */
+	if (w->seg_dur >= hls->seg_len && !w->key_asked && hls->key_fn) {
+		w->key_asked = TRUE;
+		hls->key_fn(hls->key_data);
+	}
+}
+
+/* A new init section for 'caps', the next segment starts with it */
+static void init_change(struct segmenter *w, GstCaps *caps)
+{
+	struct hls *hls = w->hls;
+	GBytes *init = init_section(caps);
+
+	gst_caps_replace(&w->caps, caps);
+	w->have_init = (init != NULL);
+	if (!init) {
+		g_printerr("HLS: no avcC in %" GST_PTR_FORMAT "\n", caps);
+		return;
+	}
+
+	g_mutex_lock(&hls->lock);
+	w->init = hls->inits->len;
+	g_ptr_array_add(hls->inits, init);
+	g_mutex_unlock(&hls->lock);
+	w->discont = (w->init > 0);
+}
+
+static void segment_sample(struct segmenter *w, GstSample *sample)
+{
+	GstBuffer *buf = gst_sample_get_buffer(sample);
+	GstCaps *caps = gst_sample_get_caps(sample);
+	GstClockTime dts;
+	gint64 t, d;
+
+	if (!buf)
+		return;
+
+	if (caps && (!w->caps || !gst_caps_is_equal(caps, w->caps))) {
+		if (w->pending)
+			add_sample(w, w->last_dur);
+		segment_close(w);
+		init_change(w, caps);
+	}
+
+	dts = GST_BUFFER_DTS_OR_PTS(buf);
+	if (!w->have_init || !GST_CLOCK_TIME_IS_VALID(dts))
+		return;
+
+	t = gst_util_uint64_scale(dts, HLS_TIMESCALE, GST_SECOND);
+	if (w->base < 0)
+		w->base = t;
+	t -= w->base;
+
+	if (w->pending) {
+		d = t - w->pending_dts;
+		if (d > 0)
+			w->last_dur = d;
+		add_sample(w, w->last_dur);
+	}
+
+	w->pending = gst_buffer_ref(buf);
+	w->pending_dts = t;
+	w->pending_cts = 0;
+	if (GST_BUFFER_PTS_IS_VALID(buf))
+		w->pending_cts = (gint64) gst_util_uint64_scale(
+			GST_BUFFER_PTS(buf), HLS_TIMESCALE, GST_SECOND) -
+			w->base - t;
+}
+
+static gpointer segmenter_thread(struct hls *hls)
+{
+	struct segmenter w = {
+		.hls = hls,
+		.base = -1,
+		.last_dur = HLS_TIMESCALE / 30,
+	};
+	struct hls_au *au;
+	GstSample *sample;
+
+	w.pipe = gst_parse_launch(HLS_PIPELINE, NULL);
+	if (!w.pipe) {
+		g_printerr("Unable to create the HLS parser\n");
+		return NULL;
+	}
+	w.src = gst_bin_get_by_name(GST_BIN(w.pipe), "hsrc0");
+	w.sink = gst_bin_get_by_name(GST_BIN(w.pipe), "hsink0");
+	gst_element_set_state(w.pipe, GST_STATE_PLAYING);
+
+	w.samples = g_array_new(FALSE, FALSE, sizeof(struct fmp4_sample));
+	w.mdat = g_byte_array_new();
+
+	while (!g_atomic_int_get(&hls->stop)) {
+		au = g_async_queue_timeout_pop(hls->queue, HLS_WAIT);
+		if (au) {
+			g_atomic_int_add(&hls->queued,
+					 -(gint) gst_buffer_get_size(au->buf));
+			if (au->caps)
+				gst_app_src_set_caps(GST_APP_SRC(w.src),
+						     au->caps);
+			gst_app_src_push_buffer(GST_APP_SRC(w.src), au->buf);
+			au->buf = NULL;
+			au_free(au);
+		}
+
+		while ((sample = gst_app_sink_try_pull_sample(
+				GST_APP_SINK(w.sink), 0))) {
+			segment_sample(&w, sample);
+			gst_sample_unref(sample);
+		}
+	}
+
+	/* Whatever is held back is cut as the last segment */
+	if (w.pending)
+		add_sample(&w, w.last_dur);
+	segment_close(&w);
+
+	gst_element_set_state(w.pipe, GST_STATE_NULL);
+	gst_object_unref(w.src);
+	gst_object_unref(w.sink);
+	gst_object_unref(w.pipe);
+	gst_caps_replace(&w.caps, NULL);
+	g_array_unref(w.samples);
+	g_byte_array_unref(w.mdat);
+
+	return NULL;
+}
+
+/* Called with the lock held */
+static struct hls_segment *find_segment(struct hls *hls, guint64 msn)
+{
+	struct hls_segment *seg;
+	GList *l;
+
+	for (l = hls->segments.tail; l; l = l->prev) {
+		seg = l->data;
+		if (seg->msn == msn)
+			return seg;
+		if (seg->msn < msn)
+			break;
+	}
+
+	return NULL;
+}
+
+static gdouble secs(guint64 t)
+{
+	return (gdouble) t / HLS_TIMESCALE;
+}
+
+/**
+ * playlist
+ * The media playlist as it stands, NULL if there is nothing to list yet.
+ * Called with the lock held.
+ */
+static gchar *playlist(struct hls *hls)
+{
+	struct hls_segment *head = g_queue_peek_head(&hls->segments);
+	struct hls_segment *tail = g_queue_peek_tail(&hls->segments);
+	guint n = g_queue_get_length(&hls->segments);
+	struct hls_segment *seg;
+	gint init = -1;
+	GString *s;
+	GList *l;
+	guint i, j;
+
+	if (!head || (head == tail && !tail->parts->len))
+		return NULL;
+
+	s = g_string_new("#EXTM3U\n#EXT-X-VERSION:6\n");
+	g_string_append_printf(s, "#EXT-X-TARGETDURATION:%u\n",
+			       (guint) (hls->target_len / HLS_TIMESCALE));
+	g_string_append_printf(s, "#EXT-X-PART-INF:PART-TARGET=%.3f\n",
+			       secs(hls->part_len));
+	g_string_append_printf(s, "#EXT-X-SERVER-CONTROL:"
+			       "CAN-BLOCK-RELOAD=YES,PART-HOLD-BACK=%.3f\n",
+			       secs(3 * hls->part_len));
+	g_string_append_printf(s, "#EXT-X-MEDIA-SEQUENCE:%" G_GUINT64_FORMAT
+			       "\n", head->msn);
+	g_string_append_printf(s, "#EXT-X-DISCONTINUITY-SEQUENCE:%u\n",
+			       hls->discont_seq + (head->discont ? 1 : 0));
+
+	for (l = hls->segments.head, i = 0; l; l = l->next, i++) {
+		seg = l->data;
+		if (!seg->parts->len)
+			continue;
+		if (seg->discont && seg != head)
+			g_string_append(s, "#EXT-X-DISCONTINUITY\n");
+		if ((gint) seg->init != init) {
+			init = seg->init;
+			g_string_append_printf(s, "#EXT-X-MAP:URI=\"init%u.mp4\"\n",
+					       seg->init);
+		}
+		if (i + HLS_PART_SEGMENTS >= n) {
+			for (j = 0; j < seg->parts->len; j++) {
+				struct hls_part *part =
+					g_ptr_array_index(seg->parts, j);
+
+				g_string_append_printf(
+					s, "#EXT-X-PART:DURATION=%.3f,URI=\"seg%"
+					G_GUINT64_FORMAT ".%u.m4s\"%s\n",
+					secs(part->duration), seg->msn, j,
+					(part->independent) ?
+					",INDEPENDENT=YES" : "");
+			}
+		}
+		if (seg->complete)
+			g_string_append_printf(s, "#EXTINF:%.3f,\nseg%"
+					       G_GUINT64_FORMAT ".m4s\n",
+					       secs(seg->duration), seg->msn);
+	}
+
+	if (tail->complete)
+		g_string_append_printf(s, "#EXT-X-PRELOAD-HINT:TYPE=PART,"
+				       "URI=\"seg%" G_GUINT64_FORMAT ".0.m4s\"\n",
+				       hls->next_msn);
+	else
+		g_string_append_printf(s, "#EXT-X-PRELOAD-HINT:TYPE=PART,"
+				       "URI=\"seg%" G_GUINT64_FORMAT ".%u.m4s\"\n",
+				       tail->msn, tail->parts->len);
+
+	return g_string_free(s, FALSE);
+}
+
+/**
+ * playlist_ready
+ * Whether the playlist holds part 'part' of segment 'msn', or the whole
+ * segment when 'part' < 0. Called with the lock held.
+ */
+static gboolean playlist_ready(struct hls *hls, gint64 msn, gint part)
+{
+	struct hls_segment *tail = g_queue_peek_tail(&hls->segments);
+
+	if (msn < 0)
+		return tail && (tail->parts->len ||
+				g_queue_get_length(&hls->segments) > 1);
+	if (!tail || (gint64) tail->msn < msn)
+		return FALSE;
+	if ((gint64) tail->msn > msn)
+		return TRUE;
+	if (part < 0)
+		return tail->complete;
+
+	return tail->complete || (guint) part < tail->parts->len;
+}
+
+/* Blocking playlist reload with _HLS_msn and _HLS_part */
+static void serve_playlist(struct hls *hls, struct http_request *req,
+			   gint64 deadline)
+{
+	gchar *str = http_query_get(req, "_HLS_msn");
+	gint64 msn = -1;
+	gint part = -1;
+	gchar *body;
+
+	if (str) {
+		msn = g_ascii_strtoll(str, NULL, 10);
+		g_free(str);
+	}
+	if ((str = http_query_get(req, "_HLS_part"))) {
+		part = atoi(str);
+		g_free(str);
+		if (msn < 0) {
+			http_respond(req, 400, NULL, "_HLS_part needs _HLS_msn\n",
+				     25);
+			return;
+		}
+	}
+
+	g_mutex_lock(&hls->lock);
+	if (msn > (gint64) hls->next_msn + 1) {
+		g_mutex_unlock(&hls->lock);
+		http_respond(req, 400, NULL, "_HLS_msn too far ahead\n", 23);
+		return;
+	}
+	while (!playlist_ready(hls, msn, part) &&
+	       !g_atomic_int_get(&hls->stop))
+		if (!g_cond_wait_until(&hls->changed, &hls->lock, deadline))
+			break;
+	body = playlist(hls);
+	g_mutex_unlock(&hls->lock);
+
+	if (!body) {
+		http_respond(req, 503, NULL, "No segments yet\n", 16);
+		return;
+	}
+	http_respond(req, 200, "application/vnd.apple.mpegurl", body,
+		     strlen(body));
+	g_free(body);
+}
+
+/**
+ * serve_media
+ * Part 'part' of segment 'msn', or all of it when 'part' < 0. Waits for
+ * one that isn't cut yet but is next (a preload hint).
+ */
+static void serve_media(struct hls *hls, struct http_request *req,
+			guint64 msn, gint part, gint64 deadline)
+{
+	GPtrArray *parts = g_ptr_array_new_with_free_func((GDestroyNotify)
+							  g_bytes_unref);
+	struct hls_segment *seg;
+	GByteArray *body;
+	gsize size;
+	guint i;
+
+	g_mutex_lock(&hls->lock);
+	for (;;) {
+		seg = find_segment(hls, msn);
+		if (seg && part >= 0 && (guint) part < seg->parts->len) {
+			struct hls_part *p = g_ptr_array_index(seg->parts, part);
+
+			g_ptr_array_add(parts, g_bytes_ref(p->data));
+			break;
+		}
+		if (seg && seg->complete) {
+			for (i = 0; part < 0 && i < seg->parts->len; i++) {
+				struct hls_part *p =
+					g_ptr_array_index(seg->parts, i);
+
+				g_ptr_array_add(parts, g_bytes_ref(p->data));
+			}
+			break;
+		}
+		/* Gone, or further ahead than the next segment */
+		if ((!seg && msn != hls->next_msn) ||
+		    g_atomic_int_get(&hls->stop))
+			break;
+		if (!g_cond_wait_until(&hls->changed, &hls->lock, deadline))
+			break;
+	}
+	g_mutex_unlock(&hls->lock);
+
+	if (!parts->len) {
+		g_ptr_array_unref(parts);
+		http_respond(req, 404, NULL, "Not found\n", 10);
+		return;
+	}
+
+	body = g_byte_array_new();
+	for (i = 0; i < parts->len; i++) {
+		const guint8 *data = g_bytes_get_data(
+			g_ptr_array_index(parts, i), &size);
+
+		g_byte_array_append(body, data, size);
+	}
+	g_ptr_array_unref(parts);
+
+	http_respond(req, 200, "video/mp4", body->data, body->len);
+	g_byte_array_unref(body);
+}
+
+static void serve_init(struct hls *hls, struct http_request *req, guint n)
+{
+	GBytes *init = NULL;
+	gconstpointer data;
+	gsize size;
+
+	g_mutex_lock(&hls->lock);
+	if (n < hls->inits->len)
+		init = g_bytes_ref(g_ptr_array_index(hls->inits, n));
+	g_mutex_unlock(&hls->lock);
+
+	if (!init) {
+		http_respond(req, 404, NULL, "Not found\n", 10);
+		return;
+	}
+	data = g_bytes_get_data(init, &size);
+	http_respond(req, 200, "video/mp4", data, size);
+	g_bytes_unref(init);
+}
+
+/* seg<msn>.m4s or seg<msn>.<part>.m4s */
+static gboolean parse_media(const gchar *name, guint64 *msn, gint *part)
+{
+	gchar *end;
+
+	if (!g_str_has_prefix(name, "seg") || !g_ascii_isdigit(name[3]))
+		return FALSE;
+	*msn = g_ascii_strtoull(name + 3, &end, 10);
+	*part = -1;
+	if (end[0] == '.' && g_ascii_isdigit(end[1]))
+		*part = strtol(end + 1, &end, 10);
+
+	return strcmp(end, ".m4s") == 0;
+}
+
+static void viewer_seen(struct hls *hls, const gchar *remote)
+{
+	if (!remote)
+		return;
+
+	g_mutex_lock(&hls->lock);
+	g_hash_table_insert(hls->viewers, g_strdup(remote), GINT_TO_POINTER(
+				    g_get_monotonic_time() / G_USEC_PER_SEC));
+	g_mutex_unlock(&hls->lock);
+}
+
+/**
+ * hls_new
+ * Segments of about 'seg_secs' seconds cut in parts of at most 'part_ms'
+ * milliseconds. 'key_fn' is called from the segmenter thread when a
+ * segment needs a key frame to end.
+ */
+struct hls *hls_new(gint seg_secs, gint part_ms, hls_key_fn key_fn,
+		    gpointer key_data)
+{
+	struct hls *hls = g_new0(struct hls, 1);
+
+	hls->seg_len = (gint64) seg_secs * HLS_TIMESCALE;
+	hls->part_len = (gint64) part_ms * HLS_TIMESCALE / 1000;
+	hls->target_len = (gint64) (seg_secs + HLS_TARGET_SLACK) *
+		HLS_TIMESCALE;
+	hls->key_fn = key_fn;
+	hls->key_data = key_data;
+	hls->need_key = TRUE;
+	hls->queue = g_async_queue_new();
+	g_mutex_init(&hls->lock);
+	g_cond_init(&hls->changed);
+	g_queue_init(&hls->segments);
+	hls->inits = g_ptr_array_new_with_free_func((GDestroyNotify)
+						    g_bytes_unref);
+	hls->viewers = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+					     NULL);
+
+	hls->thread = g_thread_new("hls", (GThreadFunc) segmenter_thread,
+				   hls);
+
+	return hls;
+}
+
+/**
+ * hls_attach
+ * Segment the frames leaving encoder 'enc'
+ */
+gulong hls_attach(GstElement *enc, struct hls *hls)
+{
+	GstPad *pad = gst_element_get_static_pad(enc, "src");
+	gulong id;
+
+	if (!pad)
+		return 0;
+
+	hls->need_key = TRUE;
+	id = gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER,
+			       (GstPadProbeCallback) hls_probe, hls, NULL);
+	gst_object_unref(pad);
+
+	return id;
+}
+
+/**
+ * hls_serve
+ * Answer a request for 'name' below the HLS path: index.m3u8,
+ * init<n>.mp4, seg<msn>.m4s or seg<msn>.<part>.m4s. Blocks for up to
+ * three segment lengths for what isn't there yet, unless HLS_MAX_BLOCKING
+ * requests already do.
+ */
+void hls_serve(struct hls *hls, struct http_request *req, const gchar *name)
+{
+	gint64 deadline = g_get_monotonic_time() + 3 * hls->seg_len *
+		G_USEC_PER_SEC / HLS_TIMESCALE;
+	guint64 msn, n;
+	gint part;
+	gchar *end;
+
+	g_atomic_int_inc(&hls->requests);
+	viewer_seen(hls, req->remote);
+
+	/* Leave the other HTTP threads to the rest of the server */
+	if (g_atomic_int_add(&hls->blocking, 1) >= HLS_MAX_BLOCKING)
+		deadline = 0;
+
+	if (strcmp(name, "index.m3u8") == 0) {
+		serve_playlist(hls, req, deadline);
+	} else if (g_str_has_prefix(name, "init") &&
+		   g_ascii_isdigit(name[4])) {
+		n = g_ascii_strtoull(name + 4, &end, 10);
+		if (strcmp(end, ".mp4") == 0 && n <= G_MAXUINT)
+			serve_init(hls, req, n);
+		else
+			http_respond(req, 404, NULL, "Not found\n", 10);
+	} else if (parse_media(name, &msn, &part)) {
+		serve_media(hls, req, msn, part, deadline);
+	} else {
+		http_respond(req, 404, NULL, "Not found\n", 10);
+	}
+
+	g_atomic_int_add(&hls->blocking, -1);
+}
+
+/**
+ * hls_viewers
+ * Addresses that asked for anything in the last HLS_VIEWER_SECS seconds.
+ * Players behind one address count once.
+ */
+guint hls_viewers(struct hls *hls)
+{
+	gint now = g_get_monotonic_time() / G_USEC_PER_SEC;
+	GHashTableIter iter;
+	gpointer seen;
+	guint n;
+
+	g_mutex_lock(&hls->lock);
+	g_hash_table_iter_init(&iter, hls->viewers);
+	while (g_hash_table_iter_next(&iter, NULL, &seen))
+		if (now - GPOINTER_TO_INT(seen) > HLS_VIEWER_SECS)
+			g_hash_table_iter_remove(&iter);
+	n = g_hash_table_size(hls->viewers);
+	g_mutex_unlock(&hls->lock);
+
+	return n;
+}
+
+/**
+ * hls_held
+ * Segments in memory and the bytes they take
+ */
+void hls_held(struct hls *hls, guint *segments, guint64 *bytes)
+{
+	struct hls_segment *seg;
+	GList *l;
+	guint i;
+
+	*bytes = 0;
+	g_mutex_lock(&hls->lock);
+	*segments = g_queue_get_length(&hls->segments);
+	for (l = hls->segments.head; l; l = l->next) {
+		seg = l->data;
+		for (i = 0; i < seg->parts->len; i++)
+			*bytes += g_bytes_get_size(((struct hls_part *)
+				g_ptr_array_index(seg->parts, i))->data);
+	}
+	g_mutex_unlock(&hls->lock);
+}
+
+/**
+ * hls_free
+ * Stop the segmenter and let everything go. The probe must be gone and
+ * no new requests may come in, those still waiting are answered first.
+ */
+void hls_free(struct hls *hls)
+{
+	struct hls_segment *seg;
+	struct hls_au *au;
+
+	g_atomic_int_set(&hls->stop, 1);
+	g_thread_join(hls->thread);
+
+	g_mutex_lock(&hls->lock);
+	g_cond_broadcast(&hls->changed);
+	g_mutex_unlock(&hls->lock);
+	while (g_atomic_int_get(&hls->blocking))
+		g_usleep(1000);
+
+	while ((au = g_async_queue_try_pop(hls->queue)))
+		au_free(au);
+	g_async_queue_unref(hls->queue);
+	while ((seg = g_queue_pop_head(&hls->segments)))
+		segment_free(seg);
+	g_ptr_array_unref(hls->inits);
+	g_hash_table_unref(hls->viewers);
+	gst_caps_replace(&hls->caps, NULL);
+	g_mutex_clear(&hls->lock);
+	g_cond_clear(&hls->changed);
+	g_free(hls);
+}
+
+/* hls.c ends here */
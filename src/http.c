@@ -0,0 +1,324 @@
+/**
+ * Filename: http.c
+ * Description: Minimal threaded HTTP/1.0 server for local queries
+ * Created: Sat Oct 17 11:40:08 2026 (-0700)
+ * Version: 1.0
+ */
+
+/**
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <http.h>
+
+#include <string.h>
+
+/* A slow or idle peer can only hold a thread this long */
+#define HTTP_TIMEOUT_S 10
+
+static const char *status_str(gint status)
+{
+	switch (status) {
+	case 200:
+		return "OK";
+	case 201:
+		return "Created";
+	case 204:
+		return "No Content";
+	case 400:
+		return "Bad Request";
+	case 404:
+		return "Not Found";
+	case 405:
+		return "Method Not Allowed";
+	case 413:
+		return "Payload Too Large";
+	case 500:
+		return "Internal Server Error";
+	case 503:
+		return "Service Unavailable";
+	case 504:
+		return "Gateway Timeout";
+	}
+
+	return "Unknown";
+}
+
+/**
+ * http_respond_headers
+ * Send a complete response with extra 'headers', each ending in "\r\n".
+ * Returns FALSE if the peer went away.
+ */
+gboolean http_respond_headers(struct http_request *req, gint status,
+			      const char *type, const char *headers,
+			      const void *body, gsize len)
+{
+	gchar *hdr = g_strdup_printf("HTTP/1.0 %d %s\r\n"
+				     "Content-Type: %s\r\n"
+				     "Content-Length: %" G_GSIZE_FORMAT "\r\n"
+				     "Cache-Control: no-cache\r\n"
+				     "Access-Control-Allow-Origin: *\r\n"
+				     "%s"
+				     "Connection: close\r\n\r\n",
+				     status, status_str(status),
+				     (type) ? type : "text/plain", len,
+				     (headers) ? headers : "");
+	gboolean ret;
+
+	ret = g_output_stream_write_all(req->out, hdr, strlen(hdr), NULL,
+					NULL, NULL) &&
+		(!len || g_output_stream_write_all(req->out, body, len, NULL,
+						   NULL, NULL));
+	g_free(hdr);
+
+	return ret;
+}
+
+/**
+ * http_respond
+ * Send a complete response. Returns FALSE if the peer went away.
+ */
+gboolean http_respond(struct http_request *req, gint status,
+		      const char *type, const void *body, gsize len)
+{
+	return http_respond_headers(req, status, type, NULL, body, len);
+}
+
+/**
+ * http_query_get
+ * Value of 'key' in the query string, unescaped. Free with g_free().
+ */
+gchar *http_query_get(const struct http_request *req, const char *key)
+{
+	gchar **kv;
+	gchar *val = NULL;
+	size_t klen = strlen(key);
+	int i;
+
+	if (!req->query)
+		return NULL;
+
+	kv = g_strsplit(req->query, "&", -1);
+	for (i = 0; kv[i] && !val; i++)
+		if (strncmp(kv[i], key, klen) == 0 && kv[i][klen] == '=')
+			val = g_uri_unescape_string(kv[i] + klen + 1, NULL);
+	g_strfreev(kv);
+
+	return val;
+}
+
+/**
+ * read_header
+ * Read up to the blank line ending the request header. What was read of
+ * the body with it starts at *body, *len bytes of it.
+ */
+static gchar *read_header(GInputStream *in, gchar **body, gsize *len)
+{
+	gchar *buf = g_malloc(HTTP_HEADER_MAX + 1);
+	gsize fill = 0;
+	gssize n;
+	gchar *end;
+
+	while (fill < HTTP_HEADER_MAX) {
+		n = g_input_stream_read(in, buf + fill, HTTP_HEADER_MAX - fill,
+					NULL, NULL);
+		if (n <= 0)
+			break;
+		fill += n;
+		buf[fill] = '\0';
+		if ((end = strstr(buf, "\r\n\r\n"))) {
+			*body = end + 4;
+		} else if ((end = strstr(buf, "\n\n"))) {
+			*body = end + 2;
+		} else {
+			continue;
+		}
+		*len = buf + fill - *body;
+		return buf;
+	}
+
+	g_free(buf);
+	return NULL;
+}
+
+/**
+ * read_body
+ * The Content-Length bytes following 'header', 'have' of which came with
+ * it. FALSE if the peer sent less or more than HTTP_BODY_MAX.
+ */
+static gboolean read_body(GInputStream *in, struct http_request *req,
+			  const gchar *header, const gchar *have, gsize len)
+{
+	const gchar *cl = header;
+	gsize want, got, n;
+
+	/* Header names are case insensitive, the body may follow */
+	while ((cl = strchr(cl, '\n')) && ++cl < have &&
+	       g_ascii_strncasecmp(cl, "Content-Length:", 15) != 0)
+		;
+	if (!cl || cl >= have)
+		return TRUE;
+
+	want = g_ascii_strtoull(cl + 15, NULL, 10);
+	if (want > HTTP_BODY_MAX)
+		return FALSE;
+
+	got = MIN(len, want);
+	req->body = g_malloc(want + 1);
+	req->body_len = want;
+	req->body[want] = '\0';
+	memcpy(req->body, have, got);
+	if (got == want)
+		return TRUE;
+
+	return g_input_stream_read_all(in, req->body + got, want - got, &n,
+				       NULL, NULL) && n == want - got;
+}
+
+static const struct http_handler *find_handler(struct http_server *hs,
+					       const char *path)
+{
+	guint i;
+
+	for (i = 0; i < hs->n; i++) {
+		size_t len = strlen(hs->h[i].path);
+
+		if (strcmp(hs->h[i].path, path) == 0 ||
+		    (hs->h[i].path[len - 1] == '/' &&
+		     strncmp(hs->h[i].path, path, len) == 0))
+			return &hs->h[i];
+	}
+
+	return NULL;
+}
+
+static gboolean run_handler(GThreadedSocketService *service,
+			    GSocketConnection *conn, GObject *source,
+			    struct http_server *hs)
+{
+	struct http_request req = { .conn = conn };
+	const struct http_handler *h;
+	GSocketAddress *addr;
+	gchar *header, **line, *body;
+	gsize len;
+	gchar *q;
+
+	g_socket_set_timeout(g_socket_connection_get_socket(conn),
+			     HTTP_TIMEOUT_S);
+	req.out = g_io_stream_get_output_stream(G_IO_STREAM(conn));
+
+	header = read_header(g_io_stream_get_input_stream(G_IO_STREAM(conn)),
+			     &body, &len);
+	if (!header)
+		return TRUE;
+	if (!read_body(g_io_stream_get_input_stream(G_IO_STREAM(conn)), &req,
+		       header, body, len)) {
+		http_respond(&req, 413, NULL, NULL, 0);
+		g_free(req.body);
+		g_free(header);
+		return TRUE;
+	}
+
+	/* "GET /path?query HTTP/1.1" */
+	line = g_strsplit_set(header, " \r\n", 4);
+	if (!line[0] || !line[1] || line[1][0] != '/') {
+		http_respond(&req, 400, NULL, NULL, 0);
+		goto out;
+	}
+	req.method = line[0];
+	req.path = line[1];
+	q = strchr(req.path, '?');
+	if (q) {
+		*q = '\0';
+		req.query = q + 1;
+	}
+
+	addr = g_socket_connection_get_remote_address(conn, NULL);
+	if (addr) {
+		req.remote = g_inet_address_to_string(
+			g_inet_socket_address_get_address(
+				G_INET_SOCKET_ADDRESS(addr)));
+		g_object_unref(addr);
+	}
+
+	h = find_handler(hs, req.path);
+	if (h)
+		h->fn(&req, h->data);
+	else
+		http_respond(&req, 404, NULL, NULL, 0);
+
+	g_free(req.remote);
+out:
+	g_strfreev(line);
+	g_free(req.body);
+	g_free(header);
+
+	return TRUE;
+}
+
+/**
+ * http_server_add
+ * Serve 'path' with 'fn'
+ */
+void http_server_add(struct http_server *hs, const char *path,
+		     http_handler_fn fn, gpointer data)
+{
+	g_return_if_fail(hs->n < HTTP_MAX_HANDLERS);
+
+	hs->h[hs->n].path = path;
+	hs->h[hs->n].fn = fn;
+	hs->h[hs->n].data = data;
+	hs->n++;
+}
+
+/**
+ * http_server_start
+ * Listen on 'addr':'port'. Requests are served from a thread pool, not
+ * the main loop.
+ */
+gboolean http_server_start(struct http_server *hs, const char *addr,
+			   gint port)
+{
+	GSocketAddress *sa;
+	GError *err = NULL;
+
+	sa = g_inet_socket_address_new_from_string(addr, port);
+	if (!sa) {
+		g_printerr("Invalid HTTP address %s\n", addr);
+		return FALSE;
+	}
+
+	hs->service = g_threaded_socket_service_new(HTTP_MAX_THREADS);
+	if (!g_socket_listener_add_address(G_SOCKET_LISTENER(hs->service), sa,
+					   G_SOCKET_TYPE_STREAM,
+					   G_SOCKET_PROTOCOL_TCP, NULL, NULL,
+					   &err)) {
+		g_printerr("Unable to listen on %s:%d: %s\n", addr, port,
+			   err->message);
+		g_error_free(err);
+		g_object_unref(sa);
+		g_object_unref(hs->service);
+		hs->service = NULL;
+		return FALSE;
+	}
+	g_object_unref(sa);
+
+	g_signal_connect(hs->service, "run", G_CALLBACK(run_handler), hs);
+	g_socket_service_start(hs->service);
+
+	return TRUE;
+}
+
+/* http.c ends here */
@@ -0,0 +1,395 @@
+/**
+ * Filename: log.c
+ * Description: Asynchronous per-thread ring buffer logging
+ * Created: Fri Oct 16 18:02:44 2026 (-0700)
+ * Version: 1.0
+ */
+
+/**
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/**
+ * Every thread that logs gets a single producer/single consumer ring the
+ * first time it does. The thread only moves its own head and the writer
+ * only moves the tails, so a message costs a vsnprintf() and a couple of
+ * atomic operations. Messages carry a global sequence number which the
+ * writer uses to put them back in order across threads.
+ *
+ * The ring list itself is protected by a mutex, which a thread only takes
+ * once to register. Only the writer removes rings, so it walks the list
+ * without the mutex and writes out messages with nothing held; a thread
+ * registering never waits on a slow console. Rings of threads that have
+ * exited are freed by the writer once it has drained them.
+ *
+ * The writer sleeps on a condition when every ring is empty. A thread
+ * that queues a message only takes the wake lock when the writer is
+ * asleep, i.e. once per burst.
+ */
+
+#include <log.h>
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#define SLOT(r, i) (&(r)->msg[(i) & (LOG_RING_SIZE - 1)])
+
+struct log_msg {
+	guint seq;		/* Global order */
+	int prio;		/* syslog priority */
+	char text[LOG_MSG_MAX];
+};
+
+struct log_ring {
+	struct log_ring *next;
+	gint head;		/* Next slot to write, owner only (atomic) */
+	gint tail;		/* Next slot to read, writer only (atomic) */
+	gint dropped;		/* Messages lost to a full ring (atomic) */
+	gint truncated;		/* Messages cut at LOG_MSG_MAX (atomic) */
+	gint dead;		/* Owner thread has exited (atomic) */
+	struct log_msg msg[LOG_RING_SIZE];
+};
+
+static void ring_release(gpointer ring);
+
+static struct {
+	GMutex lock;		/* Protects 'rings' */
+	struct log_ring *rings;
+	GThread *writer;
+	GMutex wake_lock;
+	GCond wake;		/* A message was queued or we're closing */
+	gint sleeping;		/* Writer waits on 'wake' (atomic) */
+	gint running;		/* atomic */
+	gint dropped;		/* Totals since start (atomic) */
+	gint truncated;
+	gint seq;		/* atomic */
+	gint target;		/* enum log_target (atomic) */
+	const char *ident;
+} lg;
+
+static GPrivate my_ring = G_PRIVATE_INIT(ring_release);
+
+static void ring_release(gpointer ring)
+{
+	g_atomic_int_set(&((struct log_ring *) ring)->dead, 1);
+}
+
+static struct log_ring *get_ring(void)
+{
+	struct log_ring *r = g_private_get(&my_ring);
+
+	if (r)
+		return r;
+
+	r = g_new0(struct log_ring, 1);
+	g_mutex_lock(&lg.lock);
+	r->next = lg.rings;
+	lg.rings = r;
+	g_mutex_unlock(&lg.lock);
+	g_private_set(&my_ring, r);
+
+	return r;
+}
+
+static void emit(int prio, const char *text)
+{
+	if (g_atomic_int_get(&lg.target) == LOG_TO_SYSLOG) {
+		size_t len = strlen(text);
+
+		/* syslog adds its own line endings */
+		if (len && text[len - 1] == '\n')
+			len--;
+		syslog(prio, "%.*s", (int) len, text);
+	} else {
+		fputs(text, stdout);
+	}
+}
+
+/**
+ * first_ring
+ * Rings are only added in front, the rest of the list is the writer's
+ */
+static struct log_ring *first_ring(void)
+{
+	struct log_ring *r;
+
+	g_mutex_lock(&lg.lock);
+	r = lg.rings;
+	g_mutex_unlock(&lg.lock);
+
+	return r;
+}
+
+static gboolean all_empty(void)
+{
+	struct log_ring *r;
+
+	for (r = first_ring(); r; r = r->next)
+		if (g_atomic_int_get(&r->tail) != g_atomic_int_get(&r->head))
+			return FALSE;
+
+	return TRUE;
+}
+
+/**
+ * drain
+ * Write out every queued message, oldest first. Returns how many there
+ * were.
+ */
+static int drain(void)
+{
+	struct log_ring *r, **pr, *oldest;
+	gint dropped = 0, truncated = 0;
+	char note[80];
+	int n = 0;
+
+	while (TRUE) {
+		oldest = NULL;
+		for (r = first_ring(); r; r = r->next) {
+			if (r->tail == g_atomic_int_get(&r->head))
+				continue;
+			if (!oldest || (gint) (SLOT(r, r->tail)->seq -
+			    SLOT(oldest, oldest->tail)->seq) < 0)
+				oldest = r;
+		}
+		if (!oldest)
+			break;
+
+		/* The slot is ours until the tail moves past it */
+		emit(SLOT(oldest, oldest->tail)->prio,
+		     SLOT(oldest, oldest->tail)->text);
+		g_atomic_int_inc(&oldest->tail);
+		n++;
+	}
+
+	g_mutex_lock(&lg.lock);
+	for (pr = &lg.rings; (r = *pr);) {
+		dropped += g_atomic_int_and(&r->dropped, 0);
+		truncated += g_atomic_int_and(&r->truncated, 0);
+
+		if (g_atomic_int_get(&r->dead) &&
+		    g_atomic_int_get(&r->tail) == g_atomic_int_get(&r->head)) {
+			*pr = r->next;
+			g_free(r);
+		} else {
+			pr = &r->next;
+		}
+	}
+	g_mutex_unlock(&lg.lock);
+
+	if (dropped || truncated) {
+		g_atomic_int_add(&lg.dropped, dropped);
+		g_atomic_int_add(&lg.truncated, truncated);
+		snprintf(note, sizeof(note),
+			 "[log] %d messages dropped, %d truncated\n", dropped,
+			 truncated);
+		emit(LOG_WARNING, note);
+		n++;
+	}
+
+	if (n && g_atomic_int_get(&lg.target) == LOG_TO_STDOUT)
+		fflush(stdout);
+
+	return n;
+}
+
+/**
+ * wake_writer
+ * After a message is published. Only locks if the writer is asleep.
+ */
+static void wake_writer(void)
+{
+	if (!g_atomic_int_get(&lg.sleeping))
+		return;
+
+	g_mutex_lock(&lg.wake_lock);
+	g_cond_signal(&lg.wake);
+	g_mutex_unlock(&lg.wake_lock);
+}
+
+static gpointer writer_thread(gpointer data)
+{
+	while (g_atomic_int_get(&lg.running)) {
+		if (drain())
+			continue;
+
+		/*
+		 * A thread that published before seeing 'sleeping' set is
+		 * caught by all_empty(), one after waits for the wake lock
+		 */
+		g_mutex_lock(&lg.wake_lock);
+		g_atomic_int_set(&lg.sleeping, 1);
+		while (g_atomic_int_get(&lg.running) && all_empty())
+			g_cond_wait(&lg.wake, &lg.wake_lock);
+		g_atomic_int_set(&lg.sleeping, 0);
+		g_mutex_unlock(&lg.wake_lock);
+	}
+
+	drain();
+
+	return NULL;
+}
+
+/**
+ * rate_limited
+ * Whether 'site' has used up this second's messages. Sites are shared by
+ * threads without locking, at worst a message more or less gets through.
+ */
+static gboolean rate_limited(struct log_site *site, struct log_ring *r)
+{
+	gint64 now = g_get_monotonic_time();
+
+	if (now - site->window >= G_USEC_PER_SEC) {
+		if (site->suppressed) {
+			struct log_msg *m = SLOT(r, r->head);
+
+			if (r->head - g_atomic_int_get(&r->tail) <
+			    LOG_RING_SIZE) {
+				m->seq = g_atomic_int_add(&lg.seq, 1);
+				m->prio = LOG_WARNING;
+				snprintf(m->text, sizeof(m->text),
+					 "[log] %d messages suppressed\n",
+					 site->suppressed);
+				g_atomic_int_inc(&r->head);
+			} else {
+				g_atomic_int_inc(&r->dropped);
+			}
+		}
+		site->window = now;
+		site->count = 0;
+		site->suppressed = 0;
+	}
+
+	if (site->count >= LOG_RATE_MAX) {
+		site->suppressed++;
+		return TRUE;
+	}
+	site->count++;
+
+	return FALSE;
+}
+
+/**
+ * log_write
+ * Queue a message from any thread. 'site' may be NULL for no rate limit.
+ */
+void log_write(struct log_site *site, int prio, const char *fmt, ...)
+{
+	struct log_ring *r;
+	struct log_msg *m;
+	va_list ap;
+	int len;
+
+	/* Before log_init() or after log_close() there is nobody to drain */
+	if (!g_atomic_int_get(&lg.running)) {
+		va_start(ap, fmt);
+		vprintf(fmt, ap);
+		va_end(ap);
+		return;
+	}
+
+	r = get_ring();
+	if (site && rate_limited(site, r))
+		return;
+
+	if (r->head - g_atomic_int_get(&r->tail) >= LOG_RING_SIZE) {
+		g_atomic_int_inc(&r->dropped);
+		return;
+	}
+
+	m = SLOT(r, r->head);
+	m->seq = g_atomic_int_add(&lg.seq, 1);
+	m->prio = prio;
+	va_start(ap, fmt);
+	len = vsnprintf(m->text, sizeof(m->text), fmt, ap);
+	va_end(ap);
+	if (len >= (int) sizeof(m->text))
+		g_atomic_int_inc(&r->truncated);
+
+	/* Publishes the message to the writer */
+	g_atomic_int_inc(&r->head);
+	wake_writer();
+}
+
+/**
+ * print_handler
+ * g_print() output, in as many messages as it takes rather than cut
+ */
+static void print_handler(const gchar *str)
+{
+	size_t len = strlen(str);
+	int n;
+
+	while (len >= LOG_MSG_MAX) {
+		n = LOG_MSG_MAX - 1;
+		log_write(NULL, LOG_INFO, "%.*s", n, str);
+		str += n;
+		len -= n;
+	}
+	if (len)
+		log_write(NULL, LOG_INFO, "%s", str);
+}
+
+/**
+ * log_init
+ * Start the writer and route g_print() through it as well
+ */
+void log_init(const char *ident)
+{
+	lg.ident = ident;
+	g_atomic_int_set(&lg.running, 1);
+	lg.writer = g_thread_new("log", writer_thread, NULL);
+	g_set_print_handler(print_handler);
+}
+
+/**
+ * log_lost
+ * Messages dropped to full rings and cut at LOG_MSG_MAX since start, as
+ * far as the writer has reported them
+ */
+void log_lost(gint *dropped, gint *truncated)
+{
+	*dropped = g_atomic_int_get(&lg.dropped);
+	*truncated = g_atomic_int_get(&lg.truncated);
+}
+
+void log_set_target(enum log_target target)
+{
+	if (target == LOG_TO_SYSLOG)
+		openlog(lg.ident, LOG_PID, LOG_DAEMON);
+	g_atomic_int_set(&lg.target, target);
+}
+
+/**
+ * log_close
+ * Write out whatever is still queued. Safe to call more than once, also
+ * registered with atexit() by the caller.
+ */
+void log_close(void)
+{
+	if (!g_atomic_int_get(&lg.running))
+		return;
+
+	g_mutex_lock(&lg.wake_lock);
+	g_atomic_int_set(&lg.running, 0);
+	g_cond_signal(&lg.wake);
+	g_mutex_unlock(&lg.wake_lock);
+	g_thread_join(lg.writer);
+	g_set_print_handler(NULL);
+	fflush(stdout);
+}
+
+/* log.c ends here */
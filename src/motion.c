@@ -0,0 +1,150 @@
+/**
+ * Filename: motion.c
+ * Description: Per-frame motion score of the raw video
+ * Created: Mon Oct 19 09:48:26 2026 (-0700)
+ * Version: 1.0
+ */
+
+/**
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/**
+ * A probe on the src pad of the element feeding the encoder (caps0)
+ * downscales each frame's luma and compares it with the last frame that
+ * was let through, using the SIMD kernels in quality.c. State changes are
+ * reported from the probe, before the frame reaches the encoder, so
+ * whoever listens can reconfigure the encoder in time for the first moving
+ * frame.
+ *
+ * Skipped frames are simply dropped. The frames that do go on keep their
+ * capture PTS, which is what the payloader turns into RTP timestamps, so
+ * a client only sees a longer gap between two frames.
+ */
+
+#include <motion.h>
+#include <stats-util.h>
+
+static GstPadProbeReturn motion_probe(GstPad *pad, GstPadProbeInfo *info,
+				      struct motion *m)
+{
+	gint64 start = g_get_monotonic_time();
+	GstCaps *caps = gst_pad_get_current_caps(pad);
+	struct luma_plane tmp;
+	gboolean still, was_still, skip = FALSE;
+	gdouble score = -1;
+	gint cost;
+
+	if (luma_from_buffer(&m->cur, caps, GST_PAD_PROBE_INFO_BUFFER(info)))
+		score = luma_mad(&m->prev, &m->cur);
+	if (caps)
+		gst_caps_unref(caps);
+
+	/* First frame or a new size, nothing to compare with yet */
+	if (score < 0) {
+		m->last_motion = m->last_pass = start;
+		tmp = m->prev;
+		m->prev = m->cur;
+		m->cur = tmp;
+		return GST_PAD_PROBE_OK;
+	}
+
+	if (m->skip_max_us && score < m->skip_threshold &&
+	    start - m->last_pass < m->skip_max_us)
+		skip = TRUE;
+
+	/* Keep a frame that goes on to compare the next ones with */
+	if (!skip) {
+		m->last_pass = start;
+		tmp = m->prev;
+		m->prev = m->cur;
+		m->cur = tmp;
+	}
+
+	if (score > m->threshold)
+		m->last_motion = start;
+	still = start - m->last_motion >= MOTION_HOLD_US;
+
+	g_atomic_int_set(&m->score, score * 100);
+	g_atomic_int_inc(&m->frames);
+	g_atomic_int_add(&m->score_sum, score * 100);
+	atomic_max(&m->score_max, score * 100);
+
+	was_still = g_atomic_int_get(&m->still);
+	if (still != was_still) {
+		g_atomic_int_set(&m->still, still);
+		if (m->changed)
+			m->changed(still, score, m->data);
+	}
+
+	cost = g_get_monotonic_time() - start;
+	g_atomic_int_add(&m->cost_us, cost);
+	g_atomic_int_add(&m->cost_total, cost);
+
+	if (skip) {
+		g_atomic_int_inc(&m->skipped);
+		g_atomic_int_inc(&m->skipped_total);
+		return GST_PAD_PROBE_DROP;
+	}
+
+	return GST_PAD_PROBE_OK;
+}
+
+/**
+ * motion_attach
+ * Score (and maybe skip) the frames leaving 'elem'. A new media starts out
+ * moving.
+ */
+gulong motion_attach(GstElement *elem, struct motion *m)
+{
+	GstPad *pad = gst_element_get_static_pad(elem, "src");
+	gulong id;
+
+	if (!pad)
+		return 0;
+
+	luma_free(&m->prev);
+	g_atomic_int_set(&m->still, FALSE);
+	if (!m->last_sample)
+		m->last_sample = g_get_monotonic_time();
+
+	id = gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER,
+			       (GstPadProbeCallback) motion_probe, m, NULL);
+	gst_object_unref(pad);
+
+	return id;
+}
+
+/**
+ * motion_sample
+ * Scores, skipped frames and analyzer cost since the last call
+ */
+void motion_sample(struct motion *m, struct motion_sample *out)
+{
+	gint64 now = g_get_monotonic_time();
+	gdouble secs = (now - m->last_sample) / (gdouble) G_USEC_PER_SEC;
+	gint cost = g_atomic_int_and(&m->cost_us, 0);
+
+	m->last_sample = now;
+	out->frames = g_atomic_int_and(&m->frames, 0);
+	out->skipped = g_atomic_int_and(&m->skipped, 0);
+	out->score_avg = (out->frames) ?
+		g_atomic_int_and(&m->score_sum, 0) / 100.0 / out->frames : 0;
+	out->score_max = g_atomic_int_and(&m->score_max, 0) / 100.0;
+	out->cost_us = (out->frames) ? (gdouble) cost / out->frames : 0;
+	out->load_pct = (secs > 0) ? cost / 10000.0 / secs : 0;
+}
+
+/* motion.c ends here */
@@ -0,0 +1,359 @@
+/**
+ * Filename: quality-sampler.c
+ * Description: Sample PSNR/SSIM of the encoder's output against its input
+ * Created: Sun Oct 18 11:42:19 2026 (-0700)
+ * Version: 1.0
+ */
+
+/**
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/**
+ * A sample is a short run of frames taken at a low rate:
+ *  1. quality_sampler_trigger() arms the sampler. From now on raw frames
+ *     leaving 'raw' (caps0) have their luma downscaled into a ring.
+ *  2. The next IDR out of the encoder starts the sample: the periodic
+ *     one, or one a joining client or another output asked for. It and
+ *     the frames after it, up to the budget, are copied (reffed) into a
+ *     private appsrc ! decodebin ! appsink pipeline.
+ *  3. Each decoded frame after the IDR is matched with its raw original
+ *     by PTS and scored on the decoder's own thread. The IDR itself is
+ *     only decoded, so key frames don't flatter the score.
+ *
+ * Only when no IDR comes within QUALITY_KEY_WAIT does the sampler ask
+ * the owner for one, and no more often than every QUALITY_FORCE_US. Live
+ * viewers would see a bitrate spike for every forced one. Otherwise the sample is given
+ * up and the next trigger tries again.
+ *
+ * Outside a sample the probes cost an atomic read per frame. During one
+ * the CPU spent is a handful of downscales, the budgeted decodes and
+ * their scores, which keeps it negligible at one sample every few
+ * seconds.
+ */
+
+#include <quality-sampler.h>
+
+#include <gst/app/gstappsrc.h>
+
+#include <string.h>
+
+#define QUALITY_DECODER							\
+	"appsrc name=src format=time ! h264parse ! decodebin !"		\
+	" videoconvert ! video/x-raw ! appsink name=sink sync=false"	\
+	" emit-signals=true"
+
+enum {QS_IDLE=0, QS_ARMED, QS_RUNNING};
+
+/* Called with the lock held */
+static void finish(struct quality_sampler *qs)
+{
+	if (qs->acc.frames) {
+		qs->last = qs->acc;
+		qs->last.psnr /= qs->acc.frames;
+		qs->last.ssim /= qs->acc.frames;
+		qs->have_last = TRUE;
+	}
+
+	g_atomic_int_set(&qs->state, QS_IDLE);
+}
+
+static GstFlowReturn decoded_handler(GstElement *sink,
+				     struct quality_sampler *qs)
+{
+	GstSample *sample;
+	GstBuffer *buf;
+	gdouble psnr, ssim;
+	int i;
+
+	g_signal_emit_by_name(sink, "pull-sample", &sample);
+	if (!sample)
+		return GST_FLOW_OK;
+
+	buf = gst_sample_get_buffer(sample);
+
+	g_mutex_lock(&qs->lock);
+	/* A decoder being replaced still drains what it had */
+	if (g_atomic_int_get(&qs->state) != QS_RUNNING ||
+	    GST_ELEMENT_PARENT(sink) != (GstObject *) qs->pipe)
+		goto out;
+
+	qs->decoded++;
+	if (GST_BUFFER_PTS(buf) == qs->key_pts ||
+	    !luma_from_buffer(&qs->dec, gst_sample_get_caps(sample), buf))
+		goto done;
+
+	for (i = 0; i < MIN(qs->captured, QUALITY_REFS); i++) {
+		struct quality_ref *r = &qs->ref[i];
+
+		if (r->pts != GST_BUFFER_PTS(buf))
+			continue;
+
+		psnr = luma_psnr(&r->luma, &qs->dec);
+		ssim = luma_ssim(&r->luma, &qs->dec);
+		if (psnr < 0 || ssim < 0)
+			break;
+
+		qs->acc.psnr += psnr;
+		qs->acc.ssim += ssim;
+		qs->acc.psnr_min = (qs->acc.frames) ?
+			MIN(qs->acc.psnr_min, psnr) : psnr;
+		qs->acc.ssim_min = (qs->acc.frames) ?
+			MIN(qs->acc.ssim_min, ssim) : ssim;
+		qs->acc.frames++;
+		break;
+	}
+
+done:
+	if (qs->decoded > qs->budget)
+		finish(qs);
+out:
+	g_mutex_unlock(&qs->lock);
+	gst_sample_unref(sample);
+
+	return GST_FLOW_OK;
+}
+
+/**
+ * setup_decoder
+ * (Re)create the decoder for the encoder's current caps. Called with the
+ * lock held, from enc0's streaming thread. A decoder it replaces goes to
+ * 'old', for the caller to stop once it has let go of the lock: its
+ * appsink thread may be waiting for the lock in decoded_handler().
+ */
+static gboolean setup_decoder(struct quality_sampler *qs, GstCaps *caps,
+			      GstElement **old)
+{
+	GstElement *sink;
+	GstBus *bus;
+	GError *err = NULL;
+
+	if (qs->pipe && qs->caps && gst_caps_is_equal(qs->caps, caps))
+		return TRUE;
+
+	if (qs->pipe) {
+		*old = qs->pipe;
+		gst_object_unref(qs->src);
+		qs->src = NULL;
+		qs->pipe = NULL;
+	}
+	gst_caps_replace(&qs->caps, caps);
+
+	qs->pipe = gst_parse_launch(QUALITY_DECODER, &err);
+	if (!qs->pipe) {
+		g_printerr("Quality sampler: %s\n", (err) ? err->message : "?");
+		g_clear_error(&err);
+		return FALSE;
+	}
+
+	qs->src = gst_bin_get_by_name(GST_BIN(qs->pipe), "src");
+	g_object_set(qs->src, "caps", caps, NULL);
+
+	sink = gst_bin_get_by_name(GST_BIN(qs->pipe), "sink");
+	g_signal_connect(sink, "new-sample", G_CALLBACK(decoded_handler), qs);
+	gst_object_unref(sink);
+
+	/* Nobody watches this bus, don't let messages pile up on it */
+	bus = gst_element_get_bus(qs->pipe);
+	gst_bus_set_flushing(bus, TRUE);
+	gst_object_unref(bus);
+
+	gst_element_set_state(qs->pipe, GST_STATE_PLAYING);
+
+	return TRUE;
+}
+
+static GstPadProbeReturn raw_probe(GstPad *pad, GstPadProbeInfo *info,
+				   struct quality_sampler *qs)
+{
+	gint state = g_atomic_int_get(&qs->state);
+	struct quality_ref *r;
+	GstCaps *caps;
+
+	if (state == QS_IDLE)
+		return GST_PAD_PROBE_OK;
+
+	g_mutex_lock(&qs->lock);
+	state = g_atomic_int_get(&qs->state);
+	/* Frames after the last one decoded aren't needed */
+	if (state == QS_IDLE || (state == QS_RUNNING && qs->fed > qs->budget))
+		goto out;
+
+	/* No IDR came, or the encoder ignored ours, give up on this sample */
+	if (state == QS_ARMED &&
+	    g_get_monotonic_time() - qs->armed_at > 2 * QUALITY_KEY_WAIT) {
+		g_atomic_int_set(&qs->state, QS_IDLE);
+		goto out;
+	}
+
+	r = &qs->ref[qs->captured % QUALITY_REFS];
+	caps = gst_pad_get_current_caps(pad);
+	if (luma_from_buffer(&r->luma, caps,
+			     GST_PAD_PROBE_INFO_BUFFER(info))) {
+		r->pts = GST_BUFFER_PTS(GST_PAD_PROBE_INFO_BUFFER(info));
+		qs->captured++;
+	}
+	if (caps)
+		gst_caps_unref(caps);
+out:
+	g_mutex_unlock(&qs->lock);
+
+	return GST_PAD_PROBE_OK;
+}
+
+static GstPadProbeReturn enc_probe(GstPad *pad, GstPadProbeInfo *info,
+				   struct quality_sampler *qs)
+{
+	GstBuffer *buf = GST_PAD_PROBE_INFO_BUFFER(info);
+	gint state = g_atomic_int_get(&qs->state);
+	GstElement *old = NULL;
+	GstCaps *caps;
+	gint64 now;
+
+	if (state == QS_IDLE)
+		return GST_PAD_PROBE_OK;
+
+	g_mutex_lock(&qs->lock);
+	state = g_atomic_int_get(&qs->state);
+	if (state == QS_ARMED &&
+	    GST_BUFFER_FLAG_IS_SET(buf, GST_BUFFER_FLAG_DELTA_UNIT)) {
+		/* Waited long enough for one the encoder makes anyway */
+		now = g_get_monotonic_time();
+		if (!qs->forced && now - qs->armed_at > QUALITY_KEY_WAIT &&
+		    (!qs->forced_at ||
+		     now - qs->forced_at >= QUALITY_FORCE_US) && qs->key_fn) {
+			qs->key_fn(qs->key_data);
+			qs->forced = TRUE;
+			qs->forced_at = now;
+		}
+		goto out;
+	}
+
+	if (state == QS_ARMED) {
+		caps = gst_pad_get_current_caps(pad);
+		if (caps && setup_decoder(qs, caps, &old)) {
+			qs->fed = 0;
+			qs->decoded = 0;
+			qs->key_pts = GST_BUFFER_PTS(buf);
+			memset(&qs->acc, 0, sizeof(qs->acc));
+			state = QS_RUNNING;
+			g_atomic_int_set(&qs->state, state);
+		} else {
+			g_atomic_int_set(&qs->state, QS_IDLE);
+		}
+		if (caps)
+			gst_caps_unref(caps);
+	}
+
+	/* The IDR and the budget after it */
+	if (state == QS_RUNNING && qs->fed <= qs->budget) {
+		gst_app_src_push_buffer(GST_APP_SRC(qs->src),
+					gst_buffer_ref(buf));
+		qs->fed++;
+	}
+out:
+	g_mutex_unlock(&qs->lock);
+
+	if (old) {
+		gst_element_set_state(old, GST_STATE_NULL);
+		gst_object_unref(old);
+	}
+
+	return GST_PAD_PROBE_OK;
+}
+
+/**
+ * quality_sampler_new
+ * A sampler that decodes and scores up to 'frames' frames per sample.
+ * 'key_fn' is called from the streaming thread when no IDR came in time.
+ */
+struct quality_sampler *quality_sampler_new(gint frames,
+					    quality_key_fn key_fn,
+					    gpointer key_data)
+{
+	struct quality_sampler *qs = g_new0(struct quality_sampler, 1);
+
+	g_mutex_init(&qs->lock);
+	qs->budget = CLAMP(frames, 1, QUALITY_MAX_FRAMES);
+	qs->key_fn = key_fn;
+	qs->key_data = key_data;
+
+	return qs;
+}
+
+/**
+ * quality_sampler_attach
+ * Watch the raw frames leaving 'raw' and the encoded ones leaving 'enc'.
+ * The probes go away with the media.
+ */
+gboolean quality_sampler_attach(struct quality_sampler *qs, GstElement *raw,
+				GstElement *enc)
+{
+	GstPad *raw_pad = gst_element_get_static_pad(raw, "src");
+	GstPad *enc_pad = gst_element_get_static_pad(enc, "src");
+	gboolean ret = raw_pad && enc_pad;
+
+	if (ret) {
+		gst_pad_add_probe(raw_pad, GST_PAD_PROBE_TYPE_BUFFER,
+				  (GstPadProbeCallback) raw_probe, qs, NULL);
+		gst_pad_add_probe(enc_pad, GST_PAD_PROBE_TYPE_BUFFER,
+				  (GstPadProbeCallback) enc_probe, qs, NULL);
+	}
+
+	if (raw_pad)
+		gst_object_unref(raw_pad);
+	if (enc_pad)
+		gst_object_unref(enc_pad);
+
+	return ret;
+}
+
+/**
+ * quality_sampler_trigger
+ * Start a new sample. One the decoder never finished is scored with what
+ * it got.
+ */
+void quality_sampler_trigger(struct quality_sampler *qs)
+{
+	g_mutex_lock(&qs->lock);
+	if (g_atomic_int_get(&qs->state) == QS_RUNNING)
+		finish(qs);
+
+	qs->armed_at = g_get_monotonic_time();
+	qs->forced = FALSE;
+	qs->captured = 0;
+	g_atomic_int_set(&qs->state, QS_ARMED);
+	g_mutex_unlock(&qs->lock);
+}
+
+/**
+ * quality_sampler_result
+ * The last finished sample, FALSE if there hasn't been one yet
+ */
+gboolean quality_sampler_result(struct quality_sampler *qs,
+				struct quality_result *out)
+{
+	gboolean ret;
+
+	g_mutex_lock(&qs->lock);
+	ret = qs->have_last;
+	if (ret)
+		*out = qs->last;
+	g_mutex_unlock(&qs->lock);
+
+	return ret;
+}
+
+/* quality-sampler.c ends here */
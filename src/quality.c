@@ -0,0 +1,427 @@
+/**
+ * Filename: quality.c
+ * Description: PSNR and SSIM of downscaled luma planes
+ * Created: Sun Oct 18 10:05:51 2026 (-0700)
+ * Version: 1.0
+ */
+
+/**
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/**
+ * The row kernels have NEON (i.MX6 and later ARM) and SSE2 (x86 builds)
+ * versions, picked at compile time. Every kernel has a plain C version
+ * that does the tails and gives the same results bit for bit, so scores
+ * don't depend on where they were computed.
+ *
+ * SSIM is the usual fast variant: statistics over non-overlapping 8x8
+ * blocks, averaged over the plane.
+ */
+
+#include <quality.h>
+
+#include <gst/video/video.h>
+
+#include <math.h>
+#include <string.h>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define QUALITY_NEON
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define QUALITY_SSE2
+#endif
+
+#define SSIM_BLOCK 8
+#define SSIM_C1    (0.01 * 255 * 0.01 * 255)
+#define SSIM_C2    (0.03 * 255 * 0.03 * 255)
+
+struct block_sums {
+	guint32 a, b;		/* Sum of pixels */
+	guint32 aa, bb, ab;	/* Sum of products */
+};
+
+/**
+ * downscale_row
+ * One output row from two input rows of 'n' * 2 tightly packed pixels
+ */
+static void downscale_row(guint8 *out, const guint8 *r0, const guint8 *r1,
+			  gint n)
+{
+	gint x = 0;
+
+#if defined(QUALITY_NEON)
+	for (; x + 8 <= n; x += 8) {
+		uint16x8_t sum = vpaddlq_u8(vld1q_u8(r0 + x * 2));
+
+		sum = vpadalq_u8(sum, vld1q_u8(r1 + x * 2));
+		vst1_u8(out + x, vrshrn_n_u16(sum, 2));
+	}
+#elif defined(QUALITY_SSE2)
+	const __m128i lo = _mm_set1_epi16(0x00ff);
+	const __m128i two = _mm_set1_epi16(2);
+
+	for (; x + 8 <= n; x += 8) {
+		__m128i a = _mm_loadu_si128((const __m128i *) (r0 + x * 2));
+		__m128i b = _mm_loadu_si128((const __m128i *) (r1 + x * 2));
+		__m128i sum = _mm_add_epi16(_mm_and_si128(a, lo),
+					    _mm_srli_epi16(a, 8));
+
+		sum = _mm_add_epi16(sum, _mm_and_si128(b, lo));
+		sum = _mm_add_epi16(sum, _mm_srli_epi16(b, 8));
+		sum = _mm_srli_epi16(_mm_add_epi16(sum, two), 2);
+		_mm_storel_epi64((__m128i *) (out + x),
+				 _mm_packus_epi16(sum, sum));
+	}
+#endif
+	for (; x < n; x++)
+		out[x] = (r0[x * 2] + r0[x * 2 + 1] + r1[x * 2] +
+			  r1[x * 2 + 1] + 2) >> 2;
+}
+
+/**
+ * luma_downscale
+ * Reduce the 8 bit luma at 'src' into 'out', reallocating it as needed.
+ * 'pstride' is the distance between luma samples (1 for planar and
+ * semi-planar formats, 2 for YUY2 and friends), 'stride' between rows.
+ */
+void luma_downscale(struct luma_plane *out, const guint8 *src, gint pstride,
+		    gint stride, gint width, gint height)
+{
+	gint x, y;
+	gsize size;
+
+	out->width = width / QUALITY_SCALE;
+	out->height = height / QUALITY_SCALE;
+	size = (gsize) out->width * out->height;
+	if (size > out->alloc) {
+		g_free(out->data);
+		out->data = g_malloc(size);
+		out->alloc = size;
+	}
+
+	for (y = 0; y < out->height; y++) {
+		const guint8 *r0 = src + (gsize) y * 2 * stride;
+		const guint8 *r1 = r0 + stride;
+		guint8 *o = out->data + (gsize) y * out->width;
+
+		if (pstride == 1) {
+			downscale_row(o, r0, r1, out->width);
+			continue;
+		}
+
+		for (x = 0; x < out->width; x++)
+			o[x] = (r0[x * 2 * pstride] +
+				r0[(x * 2 + 1) * pstride] +
+				r1[x * 2 * pstride] +
+				r1[(x * 2 + 1) * pstride] + 2) >> 2;
+	}
+}
+
+/**
+ * luma_from_buffer
+ * Downscaled luma of an 8 bit YUV or gray frame, FALSE for anything else
+ */
+gboolean luma_from_buffer(struct luma_plane *out, GstCaps *caps,
+			  GstBuffer *buf)
+{
+	GstVideoInfo vi;
+	GstVideoFrame f;
+
+	if (!caps || !gst_video_info_from_caps(&vi, caps))
+		return FALSE;
+
+	if ((!GST_VIDEO_INFO_IS_YUV(&vi) && !GST_VIDEO_INFO_IS_GRAY(&vi)) ||
+	    GST_VIDEO_FORMAT_INFO_DEPTH(vi.finfo, 0) != 8 ||
+	    GST_VIDEO_FORMAT_INFO_IS_TILED(vi.finfo))
+		return FALSE;
+
+	if (!gst_video_frame_map(&f, &vi, buf, GST_MAP_READ))
+		return FALSE;
+
+	luma_downscale(out, GST_VIDEO_FRAME_COMP_DATA(&f, 0),
+		       GST_VIDEO_FRAME_COMP_PSTRIDE(&f, 0),
+		       GST_VIDEO_FRAME_COMP_STRIDE(&f, 0),
+		       GST_VIDEO_FRAME_WIDTH(&f), GST_VIDEO_FRAME_HEIGHT(&f));
+	gst_video_frame_unmap(&f);
+
+	return TRUE;
+}
+
+void luma_free(struct luma_plane *p)
+{
+	g_free(p->data);
+	memset(p, 0, sizeof(*p));
+}
+
+/* Sum of squared differences over 'n' pixels */
+static guint64 sse_row(const guint8 *a, const guint8 *b, gint n)
+{
+	guint64 sse = 0;
+	gint x = 0;
+
+#if defined(QUALITY_NEON)
+	uint32x4_t acc = vdupq_n_u32(0);
+	uint64x2_t sum;
+
+	for (; x + 16 <= n; x += 16) {
+		uint8x16_t d = vabdq_u8(vld1q_u8(a + x), vld1q_u8(b + x));
+
+		acc = vpadalq_u16(acc, vmull_u8(vget_low_u8(d),
+						vget_low_u8(d)));
+		acc = vpadalq_u16(acc, vmull_u8(vget_high_u8(d),
+						vget_high_u8(d)));
+	}
+	sum = vpaddlq_u32(acc);
+	sse = vgetq_lane_u64(sum, 0) + vgetq_lane_u64(sum, 1);
+#elif defined(QUALITY_SSE2)
+	const __m128i zero = _mm_setzero_si128();
+	__m128i acc = zero;
+	guint32 lane[4];
+
+	for (; x + 16 <= n; x += 16) {
+		__m128i va = _mm_loadu_si128((const __m128i *) (a + x));
+		__m128i vb = _mm_loadu_si128((const __m128i *) (b + x));
+		__m128i d = _mm_or_si128(_mm_subs_epu8(va, vb),
+					 _mm_subs_epu8(vb, va));
+		__m128i dl = _mm_unpacklo_epi8(d, zero);
+		__m128i dh = _mm_unpackhi_epi8(d, zero);
+
+		acc = _mm_add_epi32(acc, _mm_madd_epi16(dl, dl));
+		acc = _mm_add_epi32(acc, _mm_madd_epi16(dh, dh));
+	}
+	_mm_storeu_si128((__m128i *) lane, acc);
+	sse = (guint64) lane[0] + lane[1] + lane[2] + lane[3];
+#endif
+	for (; x < n; x++)
+		sse += (a[x] - b[x]) * (a[x] - b[x]);
+
+	return sse;
+}
+
+/**
+ * luma_psnr
+ * PSNR in dB, or a negative value if the planes don't match in size
+ */
+gdouble luma_psnr(const struct luma_plane *a, const struct luma_plane *b)
+{
+	guint64 sse = 0;
+	gdouble mse;
+	gint y;
+
+	if (a->width != b->width || a->height != b->height || !a->width ||
+	    !a->height)
+		return -1;
+
+	/* Rows are short enough that the lanes can't overflow */
+	for (y = 0; y < a->height; y++)
+		sse += sse_row(a->data + (gsize) y * a->width,
+			       b->data + (gsize) y * b->width, a->width);
+
+	if (!sse)
+		return QUALITY_PSNR_MAX;
+
+	mse = (gdouble) sse / ((gdouble) a->width * a->height);
+	return MIN(10 * log10(255.0 * 255.0 / mse), QUALITY_PSNR_MAX);
+}
+
+/* Sum of absolute differences over 'n' pixels */
+static guint64 sad_row(const guint8 *a, const guint8 *b, gint n)
+{
+	guint64 sad = 0;
+	gint x = 0;
+
+#if defined(QUALITY_NEON)
+	uint32x4_t acc = vdupq_n_u32(0);
+	uint64x2_t sum;
+
+	for (; x + 16 <= n; x += 16)
+		acc = vpadalq_u16(acc, vpaddlq_u8(vabdq_u8(vld1q_u8(a + x),
+							   vld1q_u8(b + x))));
+	sum = vpaddlq_u32(acc);
+	sad = vgetq_lane_u64(sum, 0) + vgetq_lane_u64(sum, 1);
+#elif defined(QUALITY_SSE2)
+	__m128i acc = _mm_setzero_si128();
+	guint64 lane[2];
+
+	for (; x + 16 <= n; x += 16)
+		acc = _mm_add_epi64(acc, _mm_sad_epu8(
+			_mm_loadu_si128((const __m128i *) (a + x)),
+			_mm_loadu_si128((const __m128i *) (b + x))));
+	_mm_storeu_si128((__m128i *) lane, acc);
+	sad = lane[0] + lane[1];
+#endif
+	for (; x < n; x++)
+		sad += (a[x] > b[x]) ? a[x] - b[x] : b[x] - a[x];
+
+	return sad;
+}
+
+/**
+ * luma_mad
+ * Mean absolute difference per pixel (0 - 255), or a negative value if
+ * the planes don't match in size
+ */
+gdouble luma_mad(const struct luma_plane *a, const struct luma_plane *b)
+{
+	guint64 sad = 0;
+	gint y;
+
+	if (a->width != b->width || a->height != b->height || !a->width ||
+	    !a->height)
+		return -1;
+
+	for (y = 0; y < a->height; y++)
+		sad += sad_row(a->data + (gsize) y * a->width,
+			       b->data + (gsize) y * b->width, a->width);
+
+	return (gdouble) sad / ((gdouble) a->width * a->height);
+}
+
+static void block_sums(const guint8 *a, const guint8 *b, gint stride,
+		       struct block_sums *s)
+{
+	gint x, y;
+
+#if defined(QUALITY_NEON)
+	uint16x8_t sa = vdupq_n_u16(0), sb = vdupq_n_u16(0);
+	uint32x4_t saa = vdupq_n_u32(0), sbb = vdupq_n_u32(0);
+	uint32x4_t sab = vdupq_n_u32(0);
+	uint64x2_t t;
+
+	for (y = 0; y < SSIM_BLOCK; y++) {
+		uint8x8_t va = vld1_u8(a + y * stride);
+		uint8x8_t vb = vld1_u8(b + y * stride);
+
+		sa = vaddw_u8(sa, va);
+		sb = vaddw_u8(sb, vb);
+		saa = vpadalq_u16(saa, vmull_u8(va, va));
+		sbb = vpadalq_u16(sbb, vmull_u8(vb, vb));
+		sab = vpadalq_u16(sab, vmull_u8(va, vb));
+	}
+
+	t = vpaddlq_u32(vpaddlq_u16(sa));
+	s->a = vgetq_lane_u64(t, 0) + vgetq_lane_u64(t, 1);
+	t = vpaddlq_u32(vpaddlq_u16(sb));
+	s->b = vgetq_lane_u64(t, 0) + vgetq_lane_u64(t, 1);
+	t = vpaddlq_u32(saa);
+	s->aa = vgetq_lane_u64(t, 0) + vgetq_lane_u64(t, 1);
+	t = vpaddlq_u32(sbb);
+	s->bb = vgetq_lane_u64(t, 0) + vgetq_lane_u64(t, 1);
+	t = vpaddlq_u32(sab);
+	s->ab = vgetq_lane_u64(t, 0) + vgetq_lane_u64(t, 1);
+	(void) x;
+#elif defined(QUALITY_SSE2)
+	const __m128i zero = _mm_setzero_si128();
+	__m128i sa = zero, sb = zero, saa = zero, sbb = zero, sab = zero;
+	guint32 lane[4];
+
+	for (y = 0; y < SSIM_BLOCK; y++) {
+		__m128i va = _mm_unpacklo_epi8(_mm_loadl_epi64(
+			(const __m128i *) (a + y * stride)), zero);
+		__m128i vb = _mm_unpacklo_epi8(_mm_loadl_epi64(
+			(const __m128i *) (b + y * stride)), zero);
+
+		sa = _mm_add_epi16(sa, va);
+		sb = _mm_add_epi16(sb, vb);
+		saa = _mm_add_epi32(saa, _mm_madd_epi16(va, va));
+		sbb = _mm_add_epi32(sbb, _mm_madd_epi16(vb, vb));
+		sab = _mm_add_epi32(sab, _mm_madd_epi16(va, vb));
+	}
+
+	/* Pixel sums fit 16 bits, widen them with a multiply by one */
+	sa = _mm_madd_epi16(sa, _mm_set1_epi16(1));
+	sb = _mm_madd_epi16(sb, _mm_set1_epi16(1));
+#define HSUM(v) (_mm_storeu_si128((__m128i *) lane, (v)),	\
+		 lane[0] + lane[1] + lane[2] + lane[3])
+	s->a = HSUM(sa);
+	s->b = HSUM(sb);
+	s->aa = HSUM(saa);
+	s->bb = HSUM(sbb);
+	s->ab = HSUM(sab);
+#undef HSUM
+	(void) x;
+#else
+	memset(s, 0, sizeof(*s));
+	for (y = 0; y < SSIM_BLOCK; y++) {
+		for (x = 0; x < SSIM_BLOCK; x++) {
+			guint32 pa = a[y * stride + x];
+			guint32 pb = b[y * stride + x];
+
+			s->a += pa;
+			s->b += pb;
+			s->aa += pa * pa;
+			s->bb += pb * pb;
+			s->ab += pa * pb;
+		}
+	}
+#endif
+}
+
+static gdouble block_ssim(const struct block_sums *s)
+{
+	const gdouble n = SSIM_BLOCK * SSIM_BLOCK;
+	gdouble ma = s->a / n, mb = s->b / n;
+	gdouble va = s->aa / n - ma * ma;
+	gdouble vb = s->bb / n - mb * mb;
+	gdouble cov = s->ab / n - ma * mb;
+
+	return ((2 * ma * mb + SSIM_C1) * (2 * cov + SSIM_C2)) /
+		((ma * ma + mb * mb + SSIM_C1) * (va + vb + SSIM_C2));
+}
+
+/**
+ * luma_ssim
+ * Mean SSIM (0.0 - 1.0) over the whole blocks of the planes, or a
+ * negative value if they don't match in size
+ */
+gdouble luma_ssim(const struct luma_plane *a, const struct luma_plane *b)
+{
+	struct block_sums s;
+	gdouble sum = 0;
+	gint x, y, n = 0;
+
+	if (a->width != b->width || a->height != b->height ||
+	    a->width < SSIM_BLOCK || a->height < SSIM_BLOCK)
+		return -1;
+
+	for (y = 0; y + SSIM_BLOCK <= a->height; y += SSIM_BLOCK) {
+		for (x = 0; x + SSIM_BLOCK <= a->width; x += SSIM_BLOCK) {
+			gsize off = (gsize) y * a->width + x;
+
+			block_sums(a->data + off, b->data + off, a->width, &s);
+			sum += block_ssim(&s);
+			n++;
+		}
+	}
+
+	return sum / n;
+}
+
+/* Which kernels this build uses, for the startup message */
+const char *quality_simd(void)
+{
+#if defined(QUALITY_NEON)
+	return "neon";
+#elif defined(QUALITY_SSE2)
+	return "sse2";
+#else
+	return "c";
+#endif
+}
+
+/* quality.c ends here */
@@ -0,0 +1,141 @@
+/**
+ * Filename: rate-stats.c
+ * Description: Encoded bitrate and frame sizes at the encoder's output
+ * Created: Sat Oct 17 17:10:38 2026 (-0700)
+ * Version: 1.0
+ */
+
+/**
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/**
+ * The encoder is told a bitrate, what it produces depends on the scene
+ * and on how well its rate control copes. A probe on enc0's src pad
+ * sorts each access unit into a key or delta frame size histogram (a few
+ * atomic adds per frame) and keeps a running byte total, so the actual
+ * rate can be compared with the target and the IDR cost with that of an
+ * average P frame.
+ */
+
+#include <rate-stats.h>
+#include <stats-util.h>
+
+static GstPadProbeReturn rate_probe(GstPad *pad, GstPadProbeInfo *info,
+				    struct rate_stats *rs)
+{
+	GstBuffer *buf = GST_PAD_PROBE_INFO_BUFFER(info);
+	gint size = gst_buffer_get_size(buf);
+	struct rate_hist *h = &rs->hist[
+		GST_BUFFER_FLAG_IS_SET(buf, GST_BUFFER_FLAG_DELTA_UNIT) ?
+		FRAME_DELTA : FRAME_KEY];
+
+	g_atomic_int_inc(&h->frames);
+	g_atomic_int_add(&h->bytes, size);
+	g_atomic_int_inc(&h->bucket[MIN(size / RATE_HIST_BYTES,
+					RATE_HIST_BUCKETS - 1)]);
+	atomic_max(&h->max, size);
+	g_atomic_int_add(&rs->total, size);
+
+	return GST_PAD_PROBE_OK;
+}
+
+/**
+ * rate_stats_attach
+ * Start measuring what leaves encoder 'enc'
+ */
+gulong rate_stats_attach(GstElement *enc, struct rate_stats *rs)
+{
+	GstPad *pad = gst_element_get_static_pad(enc, "src");
+	gulong id;
+
+	if (!pad)
+		return 0;
+
+	if (!rs->last_sample)
+		rs->last_sample = g_get_monotonic_time();
+
+	id = gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER,
+			       (GstPadProbeCallback) rate_probe, rs, NULL);
+	gst_object_unref(pad);
+
+	return id;
+}
+
+/* Smallest size (KB) at or below which 'pct' percent of 'n' frames were */
+static gdouble percentile(const gint *bucket, gint n, gint pct)
+{
+	return hist_percentile(bucket, RATE_HIST_BUCKETS, n, pct) *
+		RATE_HIST_BYTES / 1000.0;
+}
+
+/**
+ * rate_stats_sample
+ * Bitrate and frame sizes since the last call
+ */
+void rate_stats_sample(struct rate_stats *rs, struct rate_sample *out)
+{
+	gint bucket[RATE_HIST_BUCKETS];
+	gint64 now = g_get_monotonic_time();
+	gdouble secs = (now - rs->last_sample) / (gdouble) G_USEC_PER_SEC;
+	gint64 bytes = 0;
+	gint frames = 0;
+	gdouble peak = 0;
+	int t, i;
+
+	rs->last_sample = now;
+	for (t = 0; t < NUM_FRAME_TYPES; t++) {
+		struct rate_hist *h = &rs->hist[t];
+		struct rate_type_sample *ts = &out->type[t];
+		gint n = 0, b;
+
+		for (i = 0; i < RATE_HIST_BUCKETS; i++) {
+			bucket[i] = g_atomic_int_and(&h->bucket[i], 0);
+			n += bucket[i];
+		}
+
+		ts->frames = g_atomic_int_and(&h->frames, 0);
+		b = g_atomic_int_and(&h->bytes, 0);
+		ts->max_kb = g_atomic_int_and(&h->max, 0) / 1000.0;
+		ts->avg_kb = (ts->frames) ? b / 1000.0 / ts->frames : 0;
+		/* Buckets report their upper edge, don't go past the max */
+		ts->p50_kb = (n) ? MIN(percentile(bucket, n, 50),
+				       ts->max_kb) : 0;
+		ts->p95_kb = (n) ? MIN(percentile(bucket, n, 95),
+				       ts->max_kb) : 0;
+
+		bytes += (guint) b;
+		frames += ts->frames;
+		peak = MAX(peak, ts->max_kb);
+	}
+
+	out->kbps = (secs > 0) ? bytes * 8 / 1000.0 / secs : 0;
+	out->fps = (secs > 0) ? frames / secs : 0;
+	out->peak_avg = (bytes) ? peak * 1000 * frames / bytes : 0;
+}
+
+const char *frame_type_str(enum frame_type t)
+{
+	switch (t) {
+	case FRAME_KEY:
+		return "IDR";
+	case FRAME_DELTA:
+		return "P";
+	}
+
+	return "unknown";
+}
+
+/* rate-stats.c ends here */
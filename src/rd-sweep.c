@@ -0,0 +1,654 @@
+/**
+ * Filename: rd-sweep.c
+ * Description: Offline rate-distortion sweep over bitrate and quant levels
+ * Created: Sun Oct 18 15:27:03 2026 (-0700)
+ * Version: 1.0
+ */
+
+/**
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/**
+ * Encodes a clip at every point of a bitrate and a quant level grid with
+ * the encoder the server would use, through the same property mapping
+ * (encoder.c). Each point is then decoded and compared frame by frame
+ * with the clip on the downscaled luma plane the server's quality sampler
+ * uses. Nothing runs in real time, with a software encoder such as
+ * x264enc any Linux host will do.
+ */
+
+#ifndef VERSION
+#define VERSION "1.0"
+#endif
+
+#include <ecode.h>
+#include <encoder.h>
+#include <quality.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+
+#include <gst/gst.h>
+#include <gst/app/gstappsink.h>
+#include <gst/app/gstappsrc.h>
+#include <gst/video/video.h>
+#include <glib.h>
+
+#define DEFAULT_ENCODER  "x264enc"
+#define DEFAULT_FORMAT   "I420"
+#define DEFAULT_FPS      "30"
+#define DEFAULT_BITRATES "500,1000,2000,4000,8000"
+#define DEFAULT_QUANTS   "20,25,30,35,40"
+#define DEFAULT_STEPS    "5"	/* Same as the server's */
+#define DEFAULT_IDR      "0"	/* Encoder default */
+#define DEFAULT_REFRESH  "0"
+#define DEFAULT_SLICE    "0"
+
+/* IP and UDP headers, --slice-mtu slices leave room for them */
+#define RTP_OVERHEAD 28	/* Same as the server's */
+
+#define MAX_POINTS 64
+
+/* Y4M carries its own format, raw needs to be told */
+#define INPUT_Y4M "filesrc location=\"%s\" ! y4mdec"
+#define INPUT_RAW "filesrc location=\"%s\" ! rawvideoparse width=%d" \
+	" height=%d format=%s framerate=%d/1"
+
+#define ENCODE_PIPELINE							\
+	"%s ! videoconvert ! %s name=enc0 !"				\
+	" video/x-h264,stream-format=byte-stream,alignment=au !"	\
+	" appsink name=sink sync=false"
+#define DECODE_PIPELINE							\
+	"appsrc name=src format=time ! h264parse ! decodebin !"		\
+	" videoconvert ! video/x-raw ! appsink name=sink sync=false"
+#define REF_PIPELINE "%s ! appsink name=sink sync=false"
+
+struct rd_point {
+	gboolean quant;		/* Quant level point, otherwise bitrate */
+	gint val;		/* The level */
+	gint idr;		/* Frames between IDRs, 0 = default */
+	gint intra_refresh;	/* Frames per refresh cycle, 0 = off */
+	gboolean low_latency;	/* No B-frames or lookahead */
+	gint slice_bytes;	/* Most bytes per slice, 0 = whole frames */
+	gint frames;
+	guint64 bytes;
+	gsize peak;		/* Largest access unit */
+	gdouble kbps;		/* Produced bitrate */
+	gdouble fps;		/* Encode speed */
+	gint scored;		/* Frames compared */
+	gdouble psnr;
+	gdouble psnr_min;
+	gdouble ssim;
+	gdouble ssim_min;
+};
+
+/**
+ * pull
+ * Next sample out of appsink 'sink' in 'pipe'. NULL at the end of the
+ * stream, or on an error, which is printed and flagged in 'failed'.
+ */
+static GstSample *pull(GstElement *pipe, GstElement *sink, gboolean *failed)
+{
+	GstBus *bus = gst_element_get_bus(pipe);
+	GstSample *sample = NULL;
+	GstMessage *msg;
+	GError *err = NULL;
+
+	while (!sample && !gst_app_sink_is_eos(GST_APP_SINK(sink))) {
+		sample = gst_app_sink_try_pull_sample(GST_APP_SINK(sink),
+						      100 * GST_MSECOND);
+
+		msg = gst_bus_pop_filtered(bus, GST_MESSAGE_ERROR);
+		if (msg) {
+			gst_message_parse_error(msg, &err, NULL);
+			g_printerr("%s: %s\n", GST_OBJECT_NAME(msg->src),
+				   err->message);
+			g_error_free(err);
+			gst_message_unref(msg);
+			if (sample)
+				gst_sample_unref(sample);
+			sample = NULL;
+			*failed = TRUE;
+			break;
+		}
+	}
+
+	gst_object_unref(bus);
+	return sample;
+}
+
+static GstElement *launch(const gchar *desc)
+{
+	GError *err = NULL;
+	GstElement *pipe = gst_parse_launch(desc, &err);
+
+	if (!pipe) {
+		g_printerr("Couldn't create '%s': %s\n", desc,
+			   (err) ? err->message : "?");
+		g_clear_error(&err);
+	}
+
+	return pipe;
+}
+
+/**
+ * set_point
+ * Configure 'enc' the way the server would for a bitrate or quant level.
+ * x264enc only honours its quantizer in quant mode, others drop out of
+ * rate control with a zero bitrate.
+ */
+static void set_point(GstElement *enc, const struct rd_point *pt)
+{
+	enc_set(enc, ENC_IDR, pt->idr);
+	if (pt->intra_refresh &&
+	    !enc_set(enc, ENC_INTRA_REFRESH, pt->intra_refresh))
+		g_printerr("Encoder can't do intra refresh\n");
+	if (pt->low_latency) {
+		enc_set(enc, ENC_BFRAMES, 0);
+		enc_set(enc, ENC_LOOKAHEAD, 0);
+	}
+	if (pt->slice_bytes &&
+	    !enc_set(enc, ENC_SLICE_BYTES, pt->slice_bytes))
+		g_printerr("Encoder can't limit slice size\n");
+
+	if (!pt->quant) {
+		enc_set(enc, ENC_BITRATE, pt->val);
+		return;
+	}
+
+	if (g_object_class_find_property(G_OBJECT_GET_CLASS(enc), "pass"))
+		gst_util_set_object_arg(G_OBJECT(enc), "pass", "quant");
+	else
+		enc_set(enc, ENC_BITRATE, 0);
+	enc_set(enc, ENC_QUANT, pt->val);
+}
+
+/**
+ * encode
+ * Run the clip through the encoder at 'pt' and keep the access units.
+ * Size and speed go into 'pt', the stream's caps into 'caps'.
+ */
+static GPtrArray *encode(const gchar *input, const char *encoder,
+			 struct rd_point *pt, GstCaps **caps)
+{
+	gchar *desc = g_strdup_printf(ENCODE_PIPELINE, input, encoder);
+	GstElement *pipe = launch(desc);
+	GstElement *enc, *sink;
+	GPtrArray *au;
+	GstSample *sample;
+	GstCaps *in_caps;
+	GstPad *pad;
+	GstVideoInfo vi;
+	gboolean failed = FALSE;
+	gint64 start;
+	gdouble secs;
+
+	g_free(desc);
+	if (!pipe)
+		return NULL;
+
+	enc = gst_bin_get_by_name(GST_BIN(pipe), "enc0");
+	sink = gst_bin_get_by_name(GST_BIN(pipe), "sink");
+	set_point(enc, pt);
+
+	au = g_ptr_array_new_with_free_func((GDestroyNotify) gst_buffer_unref);
+	start = g_get_monotonic_time();
+	gst_element_set_state(pipe, GST_STATE_PLAYING);
+	while ((sample = pull(pipe, sink, &failed))) {
+		GstBuffer *buf = gst_sample_get_buffer(sample);
+
+		if (!*caps)
+			*caps = gst_caps_ref(gst_sample_get_caps(sample));
+		pt->bytes += gst_buffer_get_size(buf);
+		pt->peak = MAX(pt->peak, gst_buffer_get_size(buf));
+		g_ptr_array_add(au, gst_buffer_ref(buf));
+		gst_sample_unref(sample);
+	}
+	secs = (g_get_monotonic_time() - start) / (gdouble) G_USEC_PER_SEC;
+
+	/* The clip's frame rate, to turn bytes into a bitrate */
+	pad = gst_element_get_static_pad(enc, "sink");
+	in_caps = gst_pad_get_current_caps(pad);
+	pt->frames = au->len;
+	pt->fps = (secs > 0) ? au->len / secs : 0;
+	if (in_caps && gst_video_info_from_caps(&vi, in_caps) &&
+	    GST_VIDEO_INFO_FPS_N(&vi) && au->len)
+		pt->kbps = pt->bytes * 8 / 1000.0 /
+			(au->len * (gdouble) GST_VIDEO_INFO_FPS_D(&vi) /
+			 GST_VIDEO_INFO_FPS_N(&vi));
+	if (in_caps)
+		gst_caps_unref(in_caps);
+	gst_object_unref(pad);
+
+	gst_element_set_state(pipe, GST_STATE_NULL);
+	gst_object_unref(enc);
+	gst_object_unref(sink);
+	gst_object_unref(pipe);
+
+	if (failed || !*caps) {
+		g_ptr_array_unref(au);
+		return NULL;
+	}
+
+	return au;
+}
+
+/**
+ * measure
+ * Decode 'au' and score every frame against the same frame of the clip
+ */
+static gboolean measure(const gchar *input, GPtrArray *au, GstCaps *caps,
+			struct rd_point *pt)
+{
+	gchar *desc = g_strdup_printf(REF_PIPELINE, input);
+	GstElement *dec = launch(DECODE_PIPELINE);
+	GstElement *ref = launch(desc);
+	GstElement *src, *dec_sink, *ref_sink;
+	struct luma_plane dec_luma = { 0 }, ref_luma = { 0 };
+	GstClockTime ref_pts = GST_CLOCK_TIME_NONE;
+	GstSample *d, *r;
+	gboolean failed = FALSE;
+	gdouble psnr, ssim;
+	guint i;
+
+	g_free(desc);
+	if (!dec || !ref)
+		return FALSE;
+
+	src = gst_bin_get_by_name(GST_BIN(dec), "src");
+	dec_sink = gst_bin_get_by_name(GST_BIN(dec), "sink");
+	ref_sink = gst_bin_get_by_name(GST_BIN(ref), "sink");
+
+	g_object_set(src, "caps", caps, NULL);
+	for (i = 0; i < au->len; i++)
+		gst_app_src_push_buffer(GST_APP_SRC(src),
+			gst_buffer_ref(g_ptr_array_index(au, i)));
+	gst_app_src_end_of_stream(GST_APP_SRC(src));
+
+	gst_element_set_state(dec, GST_STATE_PLAYING);
+	gst_element_set_state(ref, GST_STATE_PLAYING);
+
+	while ((d = pull(dec, dec_sink, &failed))) {
+		GstClockTime pts = GST_BUFFER_PTS(gst_sample_get_buffer(d));
+
+		/* Catch the clip up, skipping frames the encoder dropped */
+		while (!GST_CLOCK_TIME_IS_VALID(ref_pts) || ref_pts < pts) {
+			r = pull(ref, ref_sink, &failed);
+			if (!r)
+				break;
+			if (luma_from_buffer(&ref_luma, gst_sample_get_caps(r),
+					     gst_sample_get_buffer(r)))
+				ref_pts = GST_BUFFER_PTS(
+					gst_sample_get_buffer(r));
+			gst_sample_unref(r);
+		}
+
+		if (ref_pts == pts &&
+		    luma_from_buffer(&dec_luma, gst_sample_get_caps(d),
+				     gst_sample_get_buffer(d))) {
+			psnr = luma_psnr(&ref_luma, &dec_luma);
+			ssim = luma_ssim(&ref_luma, &dec_luma);
+			if (psnr >= 0 && ssim >= 0) {
+				pt->psnr_min = (pt->scored) ?
+					MIN(pt->psnr_min, psnr) : psnr;
+				pt->ssim_min = (pt->scored) ?
+					MIN(pt->ssim_min, ssim) : ssim;
+				pt->psnr += psnr;
+				pt->ssim += ssim;
+				pt->scored++;
+			}
+		}
+		gst_sample_unref(d);
+	}
+
+	if (pt->scored) {
+		pt->psnr /= pt->scored;
+		pt->ssim /= pt->scored;
+	}
+
+	gst_element_set_state(dec, GST_STATE_NULL);
+	gst_element_set_state(ref, GST_STATE_NULL);
+	gst_object_unref(src);
+	gst_object_unref(dec_sink);
+	gst_object_unref(ref_sink);
+	gst_object_unref(dec);
+	gst_object_unref(ref);
+	luma_free(&dec_luma);
+	luma_free(&ref_luma);
+
+	return !failed && pt->scored;
+}
+
+static gint cmp_point(gconstpointer a, gconstpointer b)
+{
+	return ((const struct rd_point *) a)->val -
+		((const struct rd_point *) b)->val;
+}
+
+/* PSNR at level 'x', linear between the measured points */
+static gdouble psnr_at(const struct rd_point *pt, gint n, gdouble x)
+{
+	gint i;
+
+	if (x <= pt[0].val)
+		return pt[0].psnr;
+
+	for (i = 1; i < n; i++)
+		if (x <= pt[i].val)
+			return pt[i - 1].psnr + (x - pt[i - 1].val) *
+				(pt[i].psnr - pt[i - 1].psnr) /
+				(pt[i].val - pt[i - 1].val);
+
+	return pt[n - 1].psnr;
+}
+
+/* Level at which the PSNR curve first passes 'y' */
+static gdouble level_at(const struct rd_point *pt, gint n, gdouble y)
+{
+	gint i;
+
+	for (i = 1; i < n; i++) {
+		gdouble lo = MIN(pt[i - 1].psnr, pt[i].psnr);
+		gdouble hi = MAX(pt[i - 1].psnr, pt[i].psnr);
+
+		if (y < lo || y > hi)
+			continue;
+		if (hi == lo)
+			return pt[i - 1].val;
+		return pt[i - 1].val + (y - pt[i - 1].psnr) *
+			(pt[i].val - pt[i - 1].val) /
+			(pt[i].psnr - pt[i - 1].psnr);
+	}
+
+	return (fabs(y - pt[0].psnr) < fabs(y - pt[n - 1].psnr)) ?
+		pt[0].val : pt[n - 1].val;
+}
+
+/**
+ * suggest_steps
+ * Levels for 1 to steps + 1 clients that lose the same PSNR per client,
+ * next to the evenly spaced levels the server steps through today, from
+ * the best to the worst measured point. Printed as CSV comments.
+ */
+static void suggest_steps(struct rd_point *pt, gint n, gint steps)
+{
+	gboolean quant = pt[0].quant;
+	const char *name = (quant) ? "quant" : "bitrate";
+	gint best, worst, lin_step, i;
+	gdouble drop;
+
+	/* Quality drops with the bitrate, but rises with the quant level */
+	qsort(pt, n, sizeof(*pt), cmp_point);
+	best = (quant) ? 0 : n - 1;
+	worst = (quant) ? n - 1 : 0;
+	lin_step = (pt[worst].val - pt[best].val) / steps;
+	drop = (pt[best].psnr - pt[worst].psnr) / steps;
+
+	printf("# %s steps, equal %.2f dB drops (--steps %d):\n", name,
+	       drop, steps);
+	printf("# clients,%s,psnr_db,linear_%s,linear_psnr_db\n", name, name);
+	for (i = 0; i <= steps; i++) {
+		gdouble target = pt[best].psnr - i * drop;
+		gint lin = pt[best].val + i * lin_step;
+
+		printf("# %d,%.0f,%.2f,%d,%.2f\n", i + 1,
+		       level_at(pt, n, target), target, lin,
+		       psnr_at(pt, n, lin));
+	}
+}
+
+/**
+ * parse_levels
+ * Comma separated levels into 'pt', set up like 'tmpl' otherwise. Returns
+ * how many.
+ */
+static gint parse_levels(const char *list, const struct rd_point *tmpl,
+			 struct rd_point *pt, gint max)
+{
+	gchar **v = g_strsplit(list, ",", -1);
+	gint i, n = 0;
+
+	for (i = 0; v[i] && n < max; i++) {
+		if (!*v[i])
+			continue;
+		pt[n] = *tmpl;
+		pt[n].val = atoi(v[i]);
+		n++;
+	}
+	g_strfreev(v);
+
+	return n;
+}
+
+/**
+ * sweep
+ * Measure every point of one grid and print it, then the step table
+ */
+static int sweep(const gchar *input, const char *encoder,
+		 struct rd_point *pt, gint n, gint steps)
+{
+	GPtrArray *au;
+	GstCaps *caps;
+	gint i;
+
+	for (i = 0; i < n; i++) {
+		caps = NULL;
+		g_printerr("Encoding at %s %d...\n",
+			   (pt[i].quant) ? "quant" : "bitrate", pt[i].val);
+
+		au = encode(input, encoder, &pt[i], &caps);
+		if (!au || !measure(input, au, caps, &pt[i])) {
+			g_printerr("Measuring %d failed\n", pt[i].val);
+			return -ECODE_PIPE;
+		}
+		g_ptr_array_unref(au);
+		gst_caps_unref(caps);
+
+		printf("%s,%d,%d,%" G_GUINT64_FORMAT ",%.1f,%.2f,%.1f,%.2f,"
+		       "%.2f,%.4f,%.4f\n", (pt[i].quant) ? "quant" : "bitrate",
+		       pt[i].val, pt[i].frames, pt[i].bytes, pt[i].kbps,
+		       (pt[i].bytes) ? (gdouble) pt[i].peak * pt[i].frames /
+		       pt[i].bytes : 0, pt[i].fps, pt[i].psnr,
+		       pt[i].psnr_min, pt[i].ssim, pt[i].ssim_min);
+		fflush(stdout);
+	}
+
+	if (n > 1 && steps > 0)
+		suggest_steps(pt, n, steps);
+
+	return ECODE_OKAY;
+}
+
+int main(int argc, char *argv[])
+{
+	struct rd_point pt[MAX_POINTS];
+	char *input = NULL;
+	char *encoder = (char *) DEFAULT_ENCODER;
+	char *format = (char *) DEFAULT_FORMAT;
+	char *bitrates = (char *) DEFAULT_BITRATES;
+	char *quants = (char *) DEFAULT_QUANTS;
+	int width = 0, height = 0;
+	int fps = atoi(DEFAULT_FPS);
+	int steps = atoi(DEFAULT_STEPS);
+	int slice_mtu = atoi(DEFAULT_SLICE);
+	struct rd_point tmpl = {
+		.idr = atoi(DEFAULT_IDR),
+		.intra_refresh = atoi(DEFAULT_REFRESH),
+	};
+	gchar *src, *fmt;
+	int n, ret = ECODE_OKAY;
+
+	const struct option long_opts[] = {
+		{"help",      no_argument,       0, '?'},
+		{"version",   no_argument,       0, 'v'},
+		{"input",     required_argument, 0, 'i'},
+		{"width",     required_argument, 0, 'W'},
+		{"height",    required_argument, 0, 'H'},
+		{"format",    required_argument, 0, 'f'},
+		{"fps",       required_argument, 0, 'r'},
+		{"encoder",   required_argument, 0, 'e'},
+		{"bitrates",  required_argument, 0, 'b'},
+		{"quants",    required_argument, 0, 'q'},
+		{"steps",     required_argument, 0, 's'},
+		{"idr",       required_argument, 0, 'a'},
+		{"intra-refresh", required_argument, 0, 'R'},
+		{"low-latency", no_argument,     0, 'l'},
+		{"slice-mtu", required_argument, 0, 'm'},
+		{ /* Sentinel */ }
+	};
+	char *arg_parse = "?hvi:W:H:f:r:e:b:q:s:a:R:lm:";
+	const char *usage =
+		"Usage: rd-sweep [OPTIONS]\n\n"
+		"Encodes a clip at each bitrate and quant level with the\n"
+		"server's encoder settings and prints size, encode speed and\n"
+		"PSNR/SSIM per point as CSV, followed by step tables that\n"
+		"lose equal quality per client.\n\n"
+		"Options:\n"
+		" --help,     -? - This usage\n"
+		" --version,  -v - Program Version: " VERSION "\n"
+		" --input,    -i - Clip, .y4m or raw frames\n"
+		" --width,    -W - Raw frame width\n"
+		" --height,   -H - Raw frame height\n"
+		" --format,   -f - Raw pixel format"
+		" (default: " DEFAULT_FORMAT ")\n"
+		" --fps,      -r - Raw frame rate"
+		" (default: " DEFAULT_FPS ")\n"
+		" --encoder,  -e - Gstreamer H.264 encoder element\n"
+		"                  (default: " DEFAULT_ENCODER ")\n"
+		" --bitrates, -b - Bitrates (kbps) to try, '' == none\n"
+		"                  (default: " DEFAULT_BITRATES ")\n"
+		" --quants,   -q - Quant levels to try, '' == none\n"
+		"                  (default: " DEFAULT_QUANTS ")\n"
+		" --steps,    -s - Steps for the suggested tables"
+		" (default: " DEFAULT_STEPS ")\n"
+		" --idr,      -a - Interval between IDR Frames"
+		" (default: " DEFAULT_IDR ")\n"
+		" --intra-refresh,\n"
+		"             -R - Frames per intra refresh cycle, 0 == off"
+		" (default: " DEFAULT_REFRESH ")\n"
+		" --low-latency,\n"
+		"             -l - No B-frames or rate control lookahead, as\n"
+		"                  the server's --low-latency\n"
+		" --slice-mtu, -m - Slices that fit RTP packets of this MTU,\n"
+		"                  as the server's --slice-mtu, 0 == off"
+		" (default: " DEFAULT_SLICE ")\n"
+		;
+
+	gst_init(&argc, &argv);
+
+	while (1) {
+		int opt_ndx;
+		int c = getopt_long(argc, argv, arg_parse, long_opts, &opt_ndx);
+
+		if (c < 0)
+			break;
+
+		switch (c) {
+		case 'h': /* Help */
+		case '?':
+			puts(usage);
+			return ECODE_OKAY;
+		case 'v': /* Version */
+			puts("Program Version: " VERSION);
+			return ECODE_OKAY;
+		case 'i':
+			input = optarg;
+			break;
+		case 'W':
+			width = atoi(optarg);
+			break;
+		case 'H':
+			height = atoi(optarg);
+			break;
+		case 'f':
+			format = optarg;
+			break;
+		case 'r':
+			fps = atoi(optarg);
+			break;
+		case 'e':
+			encoder = optarg;
+			break;
+		case 'b':
+			bitrates = optarg;
+			break;
+		case 'q':
+			quants = optarg;
+			break;
+		case 's':
+			steps = atoi(optarg);
+			break;
+		case 'a':
+			tmpl.idr = atoi(optarg);
+			break;
+		case 'R':
+			tmpl.intra_refresh = atoi(optarg);
+			break;
+		case 'l':
+			tmpl.low_latency = TRUE;
+			break;
+		case 'm':
+			slice_mtu = atoi(optarg);
+			break;
+		default: /* Default - bad arg */
+			puts(usage);
+			return -ECODE_ARGS;
+		}
+	}
+
+	if (steps < 0 || fps < 1 || tmpl.idr < 0 || tmpl.intra_refresh < 0 ||
+	    (slice_mtu && slice_mtu <= 2 * RTP_OVERHEAD)) {
+		fprintf(stderr, "Invalid arguments\n");
+		return -ECODE_ARGS;
+	}
+	tmpl.slice_bytes = (slice_mtu) ? slice_mtu - RTP_OVERHEAD : 0;
+
+	if (!input ||
+	    (!g_str_has_suffix(input, ".y4m") && (width < 2 || height < 2))) {
+		fprintf(stderr, "Need a .y4m clip, or raw and its size\n");
+		return -ECODE_ARGS;
+	}
+
+	if (g_str_has_suffix(input, ".y4m")) {
+		src = g_strdup_printf(INPUT_Y4M, input);
+	} else {
+		/* rawvideoparse wants the format's nick */
+		fmt = g_ascii_strdown(format, -1);
+		src = g_strdup_printf(INPUT_RAW, input, width, height, fmt,
+				      fps);
+		g_free(fmt);
+	}
+
+	printf("mode,level,frames,bytes,kbps,peak_avg,encode_fps,psnr_db,"
+	       "psnr_min_db,ssim,ssim_min\n");
+
+	n = parse_levels(bitrates, &tmpl, pt, MAX_POINTS);
+	if (n)
+		ret = sweep(src, encoder, pt, n, steps);
+
+	tmpl.quant = TRUE;
+	n = parse_levels(quants, &tmpl, pt, MAX_POINTS);
+	if (n && ret == ECODE_OKAY)
+		ret = sweep(src, encoder, pt, n, steps);
+
+	g_free(src);
+	return ret;
+}
+
+/* rd-sweep.c ends here */
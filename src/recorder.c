@@ -0,0 +1,760 @@
+/**
+ * Filename: recorder.c
+ * Description: Segmented recording of the encoded stream to disk
+ * Created: Thu Oct 22 08:12:41 2026 (-0700)
+ * Version: 1.0
+ */
+
+/**
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/**
+ * A probe on enc0's src pad queues a reference to every access unit for
+ * the writer thread and returns; if the writer has fallen too far behind
+ * it drops frames up to the next key frame instead of waiting. The live
+ * pipeline never touches the disk.
+ *
+ * The writer feeds the frames through h264parse into a muxer of its own,
+ * one short pipeline per segment, and writes what comes out. Both muxers
+ * run in streamable mode so they never seek back, which keeps every
+ * write an append: whole RECORD_CHUNKs from an aligned buffer, with
+ * O_DIRECT if asked for, into space fallocate()d ahead of them. A
+ * segment is closed at the first key frame after its length is up, so
+ * every segment starts with one and plays on its own.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE		/* O_DIRECT, fallocate */
+#endif
+
+#include <recorder.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <gst/app/gstappsink.h>
+#include <gst/app/gstappsrc.h>
+
+#define RECORD_PIPELINE						\
+	"appsrc name=rsrc0 format=time block=true ! h264parse ! %s !"	\
+	" appsink name=rsink0 sync=false"
+
+/* At most one segment is removed per interval (us) */
+#define RECORD_RETAIN_US G_USEC_PER_SEC
+
+static const char *mux_str[] = {
+	[RECORD_MKV] = "matroskamux streamable=true",
+	[RECORD_MP4] = "mp4mux streamable=true fragment-duration=1000",
+};
+
+static const char *ext_str[] = {
+	[RECORD_MKV] = "mkv",
+	[RECORD_MP4] = "mp4",
+};
+
+/* Writer thread state */
+struct writer {
+	struct recorder *rec;
+	GstElement *pipe;
+	GstElement *src;
+	GstElement *sink;
+	GstCaps *caps;		/* Of the frames coming in */
+	struct record_segment *seg; /* Being written, NULL between them */
+	int fd;
+	int idx_fd;
+	gboolean direct;	/* fd is O_DIRECT */
+	guint8 *chunk;		/* RECORD_CHUNK bytes, RECORD_ALIGN aligned */
+	gsize fill;		/* Bytes in chunk */
+	guint64 offset;		/* Where chunk goes in the file */
+	guint64 alloc;		/* Bytes fallocate()d, 0 = can't */
+	GstClockTime base;	/* Timestamp of the segment's first frame */
+	gint64 retained;	/* Last retention check */
+};
+
+static GstPadProbeReturn recorder_probe(GstPad *pad, GstPadProbeInfo *info,
+					struct recorder *rec)
+{
+	GstBuffer *buf = GST_PAD_PROBE_INFO_BUFFER(info);
+	gsize size = gst_buffer_get_size(buf);
+	struct record_au *au;
+	GstCaps *caps;
+
+	if (rec->need_key &&
+	    GST_BUFFER_FLAG_IS_SET(buf, GST_BUFFER_FLAG_DELTA_UNIT))
+		return GST_PAD_PROBE_OK;
+
+	if (g_atomic_int_get(&rec->queued) + size > RECORD_QUEUE_MAX) {
+		g_atomic_int_inc(&rec->dropped);
+		rec->need_key = TRUE;
+		return GST_PAD_PROBE_OK;
+	}
+	rec->need_key = FALSE;
+
+	au = g_new0(struct record_au, 1);
+	au->buf = gst_buffer_ref(buf);
+	au->time = g_get_real_time();
+
+	caps = gst_pad_get_current_caps(pad);
+	if (caps && (!rec->caps || !gst_caps_is_equal(caps, rec->caps))) {
+		gst_caps_replace(&rec->caps, caps);
+		au->caps = gst_caps_ref(caps);
+	}
+	if (caps)
+		gst_caps_unref(caps);
+
+	g_atomic_int_add(&rec->queued, size);
+	g_async_queue_push(rec->queue, au);
+
+	return GST_PAD_PROBE_OK;
+}
+
+static void au_free(struct record_au *au)
+{
+	gst_buffer_unref(au->buf);
+	if (au->caps)
+		gst_caps_unref(au->caps);
+	g_free(au);
+}
+
+static void segment_free(struct record_segment *seg)
+{
+	g_free(seg->name);
+	g_free(seg);
+}
+
+/* Count bytes added to the open segment */
+static void account(struct writer *w, guint64 bytes)
+{
+	g_mutex_lock(&w->rec->lock);
+	w->seg->bytes += bytes;
+	w->rec->total += bytes;
+	g_mutex_unlock(&w->rec->lock);
+}
+
+/**
+ * write_chunk
+ * Write the first 'len' bytes of the chunk, 'len' is fill rounded up to
+ * RECORD_ALIGN for O_DIRECT. Blocks this thread for as long as the card
+ * takes, which is the point of having it.
+ */
+static void write_chunk(struct writer *w, gsize len)
+{
+	struct recorder *rec = w->rec;
+	gint64 t = g_get_monotonic_time();
+	ssize_t n;
+
+	/* Keep space reserved ahead of the writes */
+	if (w->alloc && w->offset + len > w->alloc) {
+		if (fallocate(w->fd, FALLOC_FL_KEEP_SIZE, w->alloc,
+			      rec->prealloc) == 0)
+			w->alloc += rec->prealloc;
+		else
+			w->alloc = 0;
+	}
+
+	n = pwrite(w->fd, w->chunk, len, w->offset);
+	if (n < 0 && errno == EINVAL && w->direct) {
+		/* Took O_DIRECT on open, but not for writes */
+		fcntl(w->fd, F_SETFL, fcntl(w->fd, F_GETFL) & ~O_DIRECT);
+		w->direct = FALSE;
+		n = pwrite(w->fd, w->chunk, len, w->offset);
+	}
+	if (n != (ssize_t) len)
+		g_atomic_int_inc(&rec->errors);
+
+	t = g_get_monotonic_time() - t;
+	if (t > g_atomic_int_get(&rec->write_max_us))
+		g_atomic_int_set(&rec->write_max_us, t);
+
+	account(w, w->fill);
+	w->offset += w->fill;
+	w->fill = 0;
+}
+
+static void write_out(struct writer *w, const guint8 *data, gsize len)
+{
+	while (len) {
+		gsize n = MIN(len, RECORD_CHUNK - w->fill);
+
+		memcpy(w->chunk + w->fill, data, n);
+		w->fill += n;
+		data += n;
+		len -= n;
+		if (w->fill == RECORD_CHUNK)
+			write_chunk(w, RECORD_CHUNK);
+	}
+}
+
+/**
+ * drain
+ * Write what the muxer has produced, waiting up to 'timeout' for each
+ * more. TRUE once it has finished the segment.
+ */
+static gboolean drain(struct writer *w, GstClockTime timeout)
+{
+	GstSample *sample;
+	GstBuffer *buf;
+	GstMapInfo map;
+
+	while ((sample = gst_app_sink_try_pull_sample(GST_APP_SINK(w->sink),
+						      timeout))) {
+		buf = gst_sample_get_buffer(sample);
+		if (buf && gst_buffer_map(buf, &map, GST_MAP_READ)) {
+			write_out(w, map.data, map.size);
+			gst_buffer_unmap(buf, &map);
+		}
+		gst_sample_unref(sample);
+	}
+
+	return gst_app_sink_is_eos(GST_APP_SINK(w->sink));
+}
+
+static gchar *segment_path(struct recorder *rec, const gchar *name,
+			   const gchar *ext)
+{
+	return g_strdup_printf("%s/%s.%s", rec->dir, name, ext);
+}
+
+/**
+ * segment_open
+ * Start a segment with key frame 'au'. Named after its UTC start time,
+ * to the millisecond so a caps change within a second gets a new file.
+ */
+static gboolean segment_open(struct writer *w, struct record_au *au)
+{
+	struct recorder *rec = w->rec;
+	struct record_index_header hdr = {
+		.magic = RECORD_INDEX_MAGIC,
+		.version = RECORD_INDEX_VERSION,
+		.start = au->time,
+	};
+	int flags = O_WRONLY | O_CREAT | O_TRUNC;
+	GDateTime *dt = g_date_time_new_from_unix_utc(au->time /
+						      G_USEC_PER_SEC);
+	gchar *date = g_date_time_format(dt, "%Y%m%dT%H%M%S");
+	struct record_segment *seg = g_new0(struct record_segment, 1);
+	GError *err = NULL;
+	gchar *launch, *path;
+
+	seg->name = g_strdup_printf("%s.%03dZ", date, (gint)
+				    (au->time % G_USEC_PER_SEC / 1000));
+	seg->format = rec->format;
+	seg->start = seg->end = au->time;
+	g_date_time_unref(dt);
+	g_free(date);
+
+	path = segment_path(rec, seg->name, ext_str[rec->format]);
+	w->fd = open(path, flags | ((rec->direct) ? O_DIRECT : 0), 0644);
+	/* tmpfs and friends refuse O_DIRECT */
+	if (w->fd < 0 && rec->direct && errno == EINVAL)
+		w->fd = open(path, flags, 0644);
+	if (w->fd < 0) {
+		g_printerr("Unable to record to %s: %s\n", path,
+			   g_strerror(errno));
+		g_free(path);
+		segment_free(seg);
+		return FALSE;
+	}
+	g_free(path);
+	w->direct = (fcntl(w->fd, F_GETFL) & O_DIRECT) != 0;
+
+	path = segment_path(rec, seg->name, "idx");
+	w->idx_fd = open(path, flags, 0644);
+	g_free(path);
+	if (w->idx_fd < 0 || write(w->idx_fd, &hdr, sizeof(hdr)) !=
+	    sizeof(hdr))
+		g_atomic_int_inc(&rec->errors);
+
+	/* Reserved, not written, the file only grows with the data */
+	w->alloc = 0;
+	if (rec->prealloc &&
+	    fallocate(w->fd, FALLOC_FL_KEEP_SIZE, 0, rec->prealloc) == 0)
+		w->alloc = rec->prealloc;
+
+	launch = g_strdup_printf(RECORD_PIPELINE, mux_str[rec->format]);
+	w->pipe = gst_parse_launch(launch, &err);
+	g_free(launch);
+	if (!w->pipe) {
+		g_printerr("Unable to create the recording muxer: %s\n",
+			   (err) ? err->message : "?");
+		if (err)
+			g_error_free(err);
+		close(w->fd);
+		if (w->idx_fd >= 0)
+			close(w->idx_fd);
+		segment_free(seg);
+		return FALSE;
+	}
+	w->src = gst_bin_get_by_name(GST_BIN(w->pipe), "rsrc0");
+	w->sink = gst_bin_get_by_name(GST_BIN(w->pipe), "rsink0");
+	gst_app_src_set_caps(GST_APP_SRC(w->src), w->caps);
+	gst_element_set_state(w->pipe, GST_STATE_PLAYING);
+
+	w->seg = seg;
+	w->fill = 0;
+	w->offset = 0;
+	w->base = GST_CLOCK_TIME_NONE;
+
+	g_mutex_lock(&rec->lock);
+	g_queue_push_tail(&rec->segments, seg);
+	g_mutex_unlock(&rec->lock);
+	account(w, sizeof(hdr));
+
+	return TRUE;
+}
+
+/**
+ * segment_close
+ * Let the muxer finish, write the rest, give back the space reserved
+ * beyond it and drop the segment from the page cache
+ */
+static void segment_close(struct writer *w)
+{
+	gsize len;
+
+	gst_app_src_end_of_stream(GST_APP_SRC(w->src));
+	if (!drain(w, RECORD_EOS_TIMEOUT))
+		g_printerr("Recording muxer didn't finish %s\n",
+			   w->seg->name);
+	gst_element_set_state(w->pipe, GST_STATE_NULL);
+	gst_object_unref(w->src);
+	gst_object_unref(w->sink);
+	gst_object_unref(w->pipe);
+
+	if (w->fill) {
+		len = w->fill;
+		if (w->direct) {
+			len = (len + RECORD_ALIGN - 1) & ~(RECORD_ALIGN - 1);
+			memset(w->chunk + w->fill, 0, len - w->fill);
+		}
+		write_chunk(w, len);
+	}
+
+	if (ftruncate(w->fd, w->offset) || fdatasync(w->fd))
+		g_atomic_int_inc(&w->rec->errors);
+	if (!w->direct)
+		posix_fadvise(w->fd, 0, 0, POSIX_FADV_DONTNEED);
+	close(w->fd);
+	if (w->idx_fd >= 0)
+		close(w->idx_fd);
+	w->fd = w->idx_fd = -1;
+	w->seg = NULL;
+}
+
+static GstClockTime rebase(GstClockTime t, GstClockTime base)
+{
+	if (!GST_CLOCK_TIME_IS_VALID(t))
+		return t;
+
+	return (t > base) ? t - base : 0;
+}
+
+/**
+ * push_au
+ * Hand a frame to the muxer, timestamps relative to the segment start,
+ * and index it if it is a key frame
+ */
+static void push_au(struct writer *w, struct record_au *au, gboolean key)
+{
+	struct record_index_entry e;
+	GstBuffer *buf = gst_buffer_copy(au->buf); /* Shares the memory */
+	GstClockTime ts = GST_BUFFER_DTS_OR_PTS(buf);
+
+	if (GST_CLOCK_TIME_IS_VALID(ts)) {
+		if (!GST_CLOCK_TIME_IS_VALID(w->base))
+			w->base = ts;
+		GST_BUFFER_PTS(buf) = rebase(GST_BUFFER_PTS(buf), w->base);
+		GST_BUFFER_DTS(buf) = rebase(GST_BUFFER_DTS(buf), w->base);
+	} else {
+		GST_BUFFER_PTS(buf) = (au->time - w->seg->start) * GST_USECOND;
+		GST_BUFFER_DTS(buf) = GST_BUFFER_PTS(buf);
+	}
+
+	if (key) {
+		e.time = au->time;
+		e.pts = GST_TIME_AS_USECONDS(GST_BUFFER_PTS(buf));
+		if (w->idx_fd >= 0 &&
+		    write(w->idx_fd, &e, sizeof(e)) == sizeof(e))
+			account(w, sizeof(e));
+		else
+			g_atomic_int_inc(&w->rec->errors);
+	}
+
+	g_mutex_lock(&w->rec->lock);
+	w->seg->end = au->time;
+	g_mutex_unlock(&w->rec->lock);
+
+	gst_app_src_push_buffer(GST_APP_SRC(w->src), buf);
+}
+
+static void record(struct writer *w, struct record_au *au)
+{
+	struct recorder *rec = w->rec;
+	gboolean key = !GST_BUFFER_FLAG_IS_SET(au->buf,
+					       GST_BUFFER_FLAG_DELTA_UNIT);
+
+	/* A segment has one set of caps */
+	if (au->caps) {
+		if (w->seg)
+			segment_close(w);
+		gst_caps_replace(&w->caps, au->caps);
+	}
+
+	if (w->seg && key && au->time - w->seg->start >= rec->seg_len)
+		segment_close(w);
+
+	if (!w->seg && (!key || !w->caps || !segment_open(w, au)))
+		return;
+
+	push_au(w, au, key);
+	drain(w, 0);
+}
+
+/**
+ * retain
+ * Remove the oldest segment if the recording is over its size or age
+ * limit. One per RECORD_RETAIN_US at most, so a backlog (a lower limit
+ * after a restart) is worked off without long bursts of unlinks.
+ */
+static void retain(struct writer *w)
+{
+	struct recorder *rec = w->rec;
+	struct record_segment *seg;
+	gint64 now = g_get_real_time();
+	gchar *path;
+
+	if (now - w->retained < RECORD_RETAIN_US)
+		return;
+	w->retained = now;
+
+	g_mutex_lock(&rec->lock);
+	seg = g_queue_peek_head(&rec->segments);
+	if (!seg || seg == w->seg ||
+	    !((rec->max_bytes && rec->total > rec->max_bytes) ||
+	      (rec->max_age && now - seg->end > rec->max_age))) {
+		g_mutex_unlock(&rec->lock);
+		return;
+	}
+	g_queue_pop_head(&rec->segments);
+	rec->total -= seg->bytes;
+	g_mutex_unlock(&rec->lock);
+
+	path = segment_path(rec, seg->name, ext_str[seg->format]);
+	unlink(path);
+	g_free(path);
+	path = segment_path(rec, seg->name, "idx");
+	unlink(path);
+	g_free(path);
+
+	g_atomic_int_inc(&rec->removed);
+	segment_free(seg);
+}
+
+static gpointer writer_thread(struct recorder *rec)
+{
+	struct writer w = { .rec = rec, .fd = -1, .idx_fd = -1 };
+	struct record_au *au;
+
+	if (posix_memalign((void **) &w.chunk, RECORD_ALIGN, RECORD_CHUNK)) {
+		g_printerr("Unable to allocate the recording buffer\n");
+		return NULL;
+	}
+
+	while (!g_atomic_int_get(&rec->stop)) {
+		au = g_async_queue_timeout_pop(rec->queue, RECORD_WAIT);
+		if (au) {
+			g_atomic_int_add(&rec->queued,
+					 -(gint) gst_buffer_get_size(au->buf));
+			record(&w, au);
+			au_free(au);
+		}
+		retain(&w);
+	}
+
+	if (w.seg)
+		segment_close(&w);
+	while ((au = g_async_queue_try_pop(rec->queue)))
+		au_free(au);
+	gst_caps_replace(&w.caps, NULL);
+	free(w.chunk);
+
+	return NULL;
+}
+
+static gint segment_cmp(const struct record_segment *a,
+			const struct record_segment *b, gpointer data)
+{
+	return (a->start > b->start) - (a->start < b->start);
+}
+
+/**
+ * scan
+ * Pick up the segments of earlier runs, so retention covers them too
+ */
+static void scan(struct recorder *rec)
+{
+	GDir *dir = g_dir_open(rec->dir, 0, NULL);
+	struct record_index_header hdr;
+	struct record_segment *seg;
+	const gchar *f;
+	struct stat st;
+	gchar *path;
+	guint i;
+	int fd;
+
+	if (!dir)
+		return;
+
+	while ((f = g_dir_read_name(dir))) {
+		if (!g_str_has_suffix(f, ".idx"))
+			continue;
+
+		path = g_strdup_printf("%s/%s", rec->dir, f);
+		fd = open(path, O_RDONLY);
+		g_free(path);
+		if (fd < 0)
+			continue;
+		if (read(fd, &hdr, sizeof(hdr)) != sizeof(hdr) ||
+		    hdr.magic != RECORD_INDEX_MAGIC ||
+		    fstat(fd, &st)) {
+			close(fd);
+			continue;
+		}
+		close(fd);
+
+		seg = g_new0(struct record_segment, 1);
+		seg->name = g_strndup(f, strlen(f) - strlen(".idx"));
+		seg->start = hdr.start;
+		seg->bytes = st.st_size;
+		for (i = 0; i < G_N_ELEMENTS(ext_str); i++) {
+			path = segment_path(rec, seg->name, ext_str[i]);
+			if (stat(path, &st) == 0) {
+				seg->format = i;
+				seg->end = st.st_mtime * G_USEC_PER_SEC;
+				seg->bytes += st.st_size;
+			}
+			g_free(path);
+		}
+		if (!seg->end) {
+			segment_free(seg);
+			continue;
+		}
+
+		g_queue_push_tail(&rec->segments, seg);
+		rec->total += seg->bytes;
+	}
+	g_dir_close(dir);
+
+	g_queue_sort(&rec->segments, (GCompareDataFunc) segment_cmp, NULL);
+}
+
+/**
+ * recorder_new
+ * Record into 'dir' (created if needed) in segments of 'seg_secs'
+ * seconds, keeping at most 'max_mb' megabytes and 'max_hours' hours of
+ * them (0 = no limit). 'prealloc' bytes are reserved at a time. NULL if
+ * the directory can't be created.
+ */
+struct recorder *recorder_new(const gchar *dir, enum record_format format,
+			      gint seg_secs, gint max_mb, gint max_hours,
+			      gsize prealloc, gboolean direct)
+{
+	struct recorder *rec;
+
+	if (g_mkdir_with_parents(dir, 0755))
+		return NULL;
+
+	rec = g_new0(struct recorder, 1);
+	rec->dir = g_strdup(dir);
+	rec->format = format;
+	rec->seg_len = (gint64) seg_secs * G_USEC_PER_SEC;
+	rec->max_bytes = (guint64) max_mb << 20;
+	rec->max_age = (gint64) max_hours * 3600 * G_USEC_PER_SEC;
+	rec->prealloc = (prealloc + RECORD_ALIGN - 1) & ~(RECORD_ALIGN - 1);
+	rec->direct = direct;
+	rec->need_key = TRUE;
+	rec->queue = g_async_queue_new();
+	g_mutex_init(&rec->lock);
+	g_queue_init(&rec->segments);
+	scan(rec);
+
+	rec->thread = g_thread_new("recorder", (GThreadFunc) writer_thread,
+				   rec);
+
+	return rec;
+}
+
+/**
+ * recorder_attach
+ * Record the frames leaving encoder 'enc'
+ */
+gulong recorder_attach(GstElement *enc, struct recorder *rec)
+{
+	GstPad *pad = gst_element_get_static_pad(enc, "src");
+	gulong id;
+
+	if (!pad)
+		return 0;
+
+	rec->need_key = TRUE;
+	id = gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER,
+			       (GstPadProbeCallback) recorder_probe, rec,
+			       NULL);
+	gst_object_unref(pad);
+
+	return id;
+}
+
+/**
+ * recorder_parse_format
+ * "mkv" or "mp4"
+ */
+gboolean recorder_parse_format(const gchar *str, enum record_format *format)
+{
+	guint i;
+
+	for (i = 0; i < G_N_ELEMENTS(ext_str); i++) {
+		if (g_ascii_strcasecmp(str, ext_str[i]) == 0) {
+			*format = i;
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+/**
+ * recorder_ext
+ * File extension of new segments
+ */
+const gchar *recorder_ext(struct recorder *rec)
+{
+	return ext_str[rec->format];
+}
+
+/**
+ * recorder_held
+ * Segments on disk, the bytes they take and the wall clock time (us) the
+ * oldest starts at, 0 if there are none
+ */
+void recorder_held(struct recorder *rec, guint *segments, guint64 *bytes,
+		   gint64 *oldest)
+{
+	struct record_segment *seg;
+
+	g_mutex_lock(&rec->lock);
+	seg = g_queue_peek_head(&rec->segments);
+	*segments = g_queue_get_length(&rec->segments);
+	*bytes = rec->total;
+	*oldest = (seg) ? seg->start : 0;
+	g_mutex_unlock(&rec->lock);
+}
+
+/**
+ * recorder_find
+ * The segment holding wall clock time 'time' (us) and its last key frame
+ * at or before it. Returns the segment's path (free with g_free()), or
+ * FALSE if that time wasn't recorded. Reads the index, not for streaming
+ * threads.
+ */
+gboolean recorder_find(struct recorder *rec, gint64 time, gchar **path,
+		       struct record_index_entry *key)
+{
+	struct record_index_header *hdr;
+	struct record_index_entry *e;
+	struct record_segment *seg = NULL;
+	enum record_format format;
+	gchar *name, *idx, *data;
+	gsize len, lo, hi, mid, n;
+	GList *l;
+
+	g_mutex_lock(&rec->lock);
+	for (l = rec->segments.tail; l; l = l->prev) {
+		seg = l->data;
+		if (seg->start <= time)
+			break;
+	}
+	if (!l || time > seg->end + G_USEC_PER_SEC) {
+		g_mutex_unlock(&rec->lock);
+		return FALSE;
+	}
+	name = g_strdup(seg->name);
+	format = seg->format;
+	g_mutex_unlock(&rec->lock);
+
+	idx = segment_path(rec, name, "idx");
+	if (!g_file_get_contents(idx, &data, &len, NULL)) {
+		g_free(idx);
+		g_free(name);
+		return FALSE;
+	}
+	g_free(idx);
+
+	/* A torn last entry is left out */
+	hdr = (struct record_index_header *) data;
+	n = (len >= sizeof(*hdr)) ? (len - sizeof(*hdr)) / sizeof(*e) : 0;
+	e = (struct record_index_entry *) (data + sizeof(*hdr));
+	if (!n || hdr->magic != RECORD_INDEX_MAGIC) {
+		g_free(data);
+		g_free(name);
+		return FALSE;
+	}
+
+	/* Last key frame at or before 'time', else the first one */
+	lo = 0;
+	hi = n;
+	while (hi - lo > 1) {
+		mid = lo + (hi - lo) / 2;
+		if (e[mid].time <= time)
+			lo = mid;
+		else
+			hi = mid;
+	}
+
+	*key = e[lo];
+	*path = segment_path(rec, name, ext_str[format]);
+	g_free(data);
+	g_free(name);
+
+	return TRUE;
+}
+
+/**
+ * recorder_free
+ * Finish the open segment and stop the writer. The probe must be gone.
+ */
+void recorder_free(struct recorder *rec)
+{
+	struct record_segment *seg;
+
+	g_atomic_int_set(&rec->stop, 1);
+	g_thread_join(rec->thread);
+
+	while ((seg = g_queue_pop_head(&rec->segments)))
+		segment_free(seg);
+	g_async_queue_unref(rec->queue);
+	gst_caps_replace(&rec->caps, NULL);
+	g_mutex_clear(&rec->lock);
+	g_free(rec->dir);
+	g_free(rec);
+}
+
+/* recorder.c ends here */
@@ -0,0 +1,118 @@
+/**
+ * Filename: rtcp-stats.c
+ * Description: Per-client receiver report statistics from the RTP sessions
+ * Created: Wed Oct 14 10:31:48 2026 (-0700)
+ * Version: 1.0
+ */
+
+/**
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <rtcp-stats.h>
+
+#include <string.h>
+
+/* H.264 RTP clock rate, jitter is reported in its units */
+#define RTP_CLOCK_RATE 90000
+
+/**
+ * add_source
+ * Every client shows up in the session as a remote source. Once it has
+ * sent a receiver report about us 'have-rb' is set and the rb-* fields
+ * describe how our stream arrives there.
+ */
+static void add_source(const GstStructure *s, struct rtcp_stats *rs,
+		       gdouble *sum)
+{
+	struct rtcp_client *c;
+	gboolean internal = TRUE, have_rb = FALSE;
+	guint fraction = 0, rtt = 0, jitter = 0, ssrc = 0;
+	const gchar *from;
+
+	gst_structure_get_boolean(s, "internal", &internal);
+	gst_structure_get_boolean(s, "have-rb", &have_rb);
+	if (internal || !have_rb)
+		return;
+
+	gst_structure_get_uint(s, "rb-fractionlost", &fraction);
+	gst_structure_get_uint(s, "rb-round-trip", &rtt);
+	gst_structure_get_uint(s, "rb-jitter", &jitter);
+	gst_structure_get_uint(s, "ssrc", &ssrc);
+
+	*sum += fraction / 256.0;
+	if (fraction / 256.0 > rs->max_loss)
+		rs->max_loss = fraction / 256.0;
+
+	if (rs->n < RTCP_MAX_CLIENTS) {
+		c = &rs->cli[rs->n];
+		from = gst_structure_get_string(s, "rtcp-from");
+		g_strlcpy(c->addr, (from) ? from : "?", sizeof(c->addr));
+		c->ssrc = ssrc;
+		c->loss = fraction / 256.0;
+		/* Round trip is in 1/65536 s */
+		c->rtt_ms = rtt * 1000.0 / 65536;
+		c->jitter_ms = jitter * 1000.0 / RTP_CLOCK_RATE;
+	}
+	rs->n++;
+}
+
+/**
+ * rtcp_stats_collect
+ * Snapshot the receiver reports of every stream in 'media'
+ */
+void rtcp_stats_collect(GstRTSPMedia *media, struct rtcp_stats *rs)
+{
+	gdouble sum = 0;
+	guint i, j;
+
+	memset(rs, 0, sizeof(*rs));
+	if (!media)
+		return;
+
+	for (i = 0; i < gst_rtsp_media_n_streams(media); i++) {
+		GstRTSPStream *stream = gst_rtsp_media_get_stream(media, i);
+		GObject *session = gst_rtsp_stream_get_rtpsession(stream);
+		GstStructure *stats = NULL;
+		const GValue *val;
+		GValueArray *arr;
+
+		if (!session)
+			continue;
+
+		g_object_get(session, "stats", &stats, NULL);
+		g_object_unref(session);
+		if (!stats)
+			continue;
+
+		val = gst_structure_get_value(stats, "source-stats");
+		arr = (val) ? g_value_get_boxed(val) : NULL;
+		for (j = 0; arr && j < arr->n_values; j++) {
+			const GstStructure *s =
+				g_value_get_boxed(&arr->values[j]);
+
+			if (s)
+				add_source(s, rs, &sum);
+		}
+
+		gst_structure_free(stats);
+	}
+
+	rs->avg_loss = (rs->n) ? sum / rs->n : 0;
+	if (rs->n > RTCP_MAX_CLIENTS)
+		rs->n = RTCP_MAX_CLIENTS;
+}
+
+/* rtcp-stats.c ends here */
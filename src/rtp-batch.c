@@ -0,0 +1,242 @@
+/**
+ * Filename: rtp-batch.c
+ * Description: Count RTP output and collect a frame into one buffer list
+ * Created: Mon Oct 12 15:21:07 2026 (-0700)
+ * Version: 1.0
+ */
+
+/**
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/**
+ * The RTSP server sends RTP with a multiudpsink, which hands a whole
+ * GstBufferList to each client with a single g_socket_send_messages()
+ * (sendmmsg) call, but sends lone buffers one syscall at a time.
+ * rtph264pay only produces lists for the FU-A fragments of a single NAL, so
+ * SPS/PPS, SEI and every slice still cost a syscall per client.
+ *
+ * This probe sits on the payloader's src pad, swallows packets until it
+ * sees the RTP marker bit (last packet of an access unit) and then pushes
+ * the frame downstream as one list. The encoder hands over complete access
+ * units, so this adds no latency beyond the payloading of the frame itself.
+ */
+
+#include <rtp-batch.h>
+#include <stats-util.h>
+#include <trace.h>
+
+struct batch_pad {
+	struct rtp_batch *rb;	/* Shared counters */
+	GstBufferList *pending;	/* Packets of the frame being collected */
+	gboolean pushing;	/* Our own push is going through the pad */
+};
+
+static gsize list_size(GstBufferList *list)
+{
+	gsize size = 0;
+	guint i;
+
+	for (i = 0; i < gst_buffer_list_length(list); i++)
+		size += gst_buffer_get_size(gst_buffer_list_get(list, i));
+
+	return size;
+}
+
+static GstFlowReturn push_pending(GstPad *pad, struct batch_pad *bp)
+{
+	GstBufferList *list = bp->pending;
+	GstFlowReturn ret;
+	guint len;
+
+	if (!list)
+		return GST_FLOW_OK;
+
+	bp->pending = NULL;
+	len = gst_buffer_list_length(list);
+
+	bp->pushing = TRUE;
+	ret = gst_pad_push_list(pad, list);
+	bp->pushing = FALSE;
+
+	g_atomic_int_inc(&bp->rb->sends);
+	TRACE2(rtp_send, len, ret);
+
+	return ret;
+}
+
+static gboolean add_pending(GstBuffer **buf, guint idx, gpointer user_data)
+{
+	struct batch_pad *bp = user_data;
+
+	gst_buffer_list_add(bp->pending, gst_buffer_ref(*buf));
+
+	return TRUE;
+}
+
+/**
+ * count_probe
+ * Without batching only keep the counters up to date
+ */
+static GstPadProbeReturn count_probe(GstPad *pad, GstPadProbeInfo *info,
+				     struct batch_pad *bp)
+{
+	GstBuffer *last;
+	guint len = 1;
+
+	if (info->type & GST_PAD_PROBE_TYPE_BUFFER) {
+		last = GST_PAD_PROBE_INFO_BUFFER(info);
+		g_atomic_int_add(&bp->rb->bytes, gst_buffer_get_size(last));
+	} else {
+		GstBufferList *list = GST_PAD_PROBE_INFO_BUFFER_LIST(info);
+
+		len = gst_buffer_list_length(list);
+		if (!len)
+			return GST_PAD_PROBE_OK;
+		last = gst_buffer_list_get(list, len - 1);
+		g_atomic_int_add(&bp->rb->bytes, list_size(list));
+	}
+
+	g_atomic_int_inc(&bp->rb->sends);
+	g_atomic_int_add(&bp->rb->packets, len);
+	TRACE2(rtp_send, len, GST_FLOW_OK);
+	if (rtp_has_marker(last))
+		g_atomic_int_inc(&bp->rb->frames);
+
+	return GST_PAD_PROBE_OK;
+}
+
+static GstPadProbeReturn batch_probe(GstPad *pad, GstPadProbeInfo *info,
+				     struct batch_pad *bp)
+{
+	GstFlowReturn ret = GST_FLOW_OK;
+	gboolean marker;
+	guint len = 1;
+
+	if (bp->pushing)
+		return GST_PAD_PROBE_OK;
+
+	if (info->type & GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM) {
+		GstEvent *event = GST_PAD_PROBE_INFO_EVENT(info);
+
+		switch (GST_EVENT_TYPE(event)) {
+		case GST_EVENT_FLUSH_START:
+		case GST_EVENT_FLUSH_STOP:
+			if (bp->pending) {
+				gst_buffer_list_unref(bp->pending);
+				bp->pending = NULL;
+			}
+			break;
+		default:
+			/* Serialized events must not overtake packets */
+			if (GST_EVENT_IS_SERIALIZED(event))
+				push_pending(pad, bp);
+			break;
+		}
+
+		return GST_PAD_PROBE_OK;
+	}
+
+	if (!bp->pending)
+		bp->pending = gst_buffer_list_new_sized(RTP_BATCH_MAX);
+
+	if (info->type & GST_PAD_PROBE_TYPE_BUFFER) {
+		GstBuffer *buf = GST_PAD_PROBE_INFO_BUFFER(info);
+
+		marker = rtp_has_marker(buf);
+		g_atomic_int_add(&bp->rb->bytes, gst_buffer_get_size(buf));
+		gst_buffer_list_add(bp->pending, buf);
+	} else {
+		GstBufferList *list = GST_PAD_PROBE_INFO_BUFFER_LIST(info);
+
+		len = gst_buffer_list_length(list);
+		marker = len && rtp_has_marker(gst_buffer_list_get(list, len - 1));
+		g_atomic_int_add(&bp->rb->bytes, list_size(list));
+		gst_buffer_list_foreach(list, add_pending, bp);
+		gst_buffer_list_unref(list);
+	}
+
+	g_atomic_int_add(&bp->rb->packets, len);
+	if (marker)
+		g_atomic_int_inc(&bp->rb->frames);
+
+	if (marker || gst_buffer_list_length(bp->pending) >= RTP_BATCH_MAX)
+		ret = push_pending(pad, bp);
+
+#if GST_CHECK_VERSION(1, 16, 0)
+	GST_PAD_PROBE_INFO_FLOW_RETURN(info) = ret;
+#else
+	(void) ret;
+#endif
+
+	/* We own the data now, it continues inside the list */
+	return GST_PAD_PROBE_HANDLED;
+}
+
+static void batch_pad_free(struct batch_pad *bp)
+{
+	if (bp->pending)
+		gst_buffer_list_unref(bp->pending);
+	g_free(bp);
+}
+
+/**
+ * rtp_batch_attach
+ * Start counting (and batching, if enabled) the output of payloader 'pay'.
+ * The probe goes away with the pad, so there is nothing to detach when the
+ * media is torn down.
+ */
+gulong rtp_batch_attach(GstElement *pay, struct rtp_batch *rb)
+{
+	struct batch_pad *bp = g_new0(struct batch_pad, 1);
+	GstPad *pad = gst_element_get_static_pad(pay, "src");
+	gulong id;
+
+	if (!pad) {
+		g_free(bp);
+		return 0;
+	}
+
+	bp->rb = rb;
+	if (rb->enabled)
+		id = gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER |
+				       GST_PAD_PROBE_TYPE_BUFFER_LIST |
+				       GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM |
+				       GST_PAD_PROBE_TYPE_EVENT_FLUSH,
+				       (GstPadProbeCallback) batch_probe, bp,
+				       (GDestroyNotify) batch_pad_free);
+	else
+		id = gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER |
+				       GST_PAD_PROBE_TYPE_BUFFER_LIST,
+				       (GstPadProbeCallback) count_probe, bp,
+				       (GDestroyNotify) batch_pad_free);
+	gst_object_unref(pad);
+
+	return id;
+}
+
+/**
+ * rtp_batch_sample
+ * Sends (syscalls per client), packets and frames since the last call
+ */
+void rtp_batch_sample(struct rtp_batch *rb, gint *sends, gint *packets,
+		      gint *frames)
+{
+	*sends = g_atomic_int_and(&rb->sends, 0);
+	*packets = g_atomic_int_and(&rb->packets, 0);
+	*frames = g_atomic_int_and(&rb->frames, 0);
+}
+
+/* rtp-batch.c ends here */
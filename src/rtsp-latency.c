@@ -0,0 +1,314 @@
+/**
+ * Filename: rtsp-latency.c
+ * Description: Measure capture to receive latency from abs-capture-time
+ * Created: Fri Oct 16 14:22:17 2026 (-0700)
+ * Version: 1.0
+ */
+
+/**
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/**
+ * Plays an RTSP stream served with --capture-time and compares the capture
+ * time in each frame's last packet with the local wall clock as the packet
+ * leaves the jitterbuffer, i.e. when a player could start decoding it.
+ * Both ends need NTP synced clocks, any offset between them shows up in
+ * the numbers.
+ */
+
+#ifndef VERSION
+#define VERSION "1.0"
+#endif
+
+#include <capture-ext.h>
+#include <ecode.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+
+#include <gst/gst.h>
+#include <gst/rtp/gstrtpbuffer.h>
+#include <glib.h>
+
+#define DEFAULT_URL      "rtsp://127.0.0.1:9099/stream"
+#define DEFAULT_LATENCY  "200"
+#define DEFAULT_INTERVAL "1"
+
+struct latency_info {
+	GMainLoop *main_loop;
+	GMutex lock;		/* Samples are added from streaming threads */
+	guint8 ext_id;		/* Announced extension id, 0 = none (yet) */
+	GArray *samples;	/* Latencies (ms) since the last report */
+	gint missing;		/* Frames without the extension */
+};
+
+static gint cmp_double(gconstpointer a, gconstpointer b)
+{
+	gdouble x = *(const gdouble *) a, y = *(const gdouble *) b;
+
+	return (x > y) - (x < y);
+}
+
+static gboolean report_handler(struct latency_info *li)
+{
+	GArray *s = li->samples;
+	gdouble *v;
+	gdouble sum = 0;
+	gchar ts[16];
+	time_t t = time(NULL);
+	guint i;
+
+	strftime(ts, sizeof(ts), "%H:%M:%S", localtime(&t));
+
+	g_mutex_lock(&li->lock);
+	if (s->len == 0) {
+		g_print("%s frames 0 (%d without capture time)\n", ts,
+			li->missing);
+	} else {
+		/* Appends may have moved it, read it under the lock */
+		g_array_sort(s, cmp_double);
+		v = (gdouble *) s->data;
+		for (i = 0; i < s->len; i++)
+			sum += v[i];
+
+		g_print("%s frames %3u latency ms min %7.1f avg %7.1f "
+			"p50 %7.1f p99 %7.1f max %7.1f\n", ts, s->len, v[0],
+			sum / s->len, v[s->len / 2],
+			v[MIN(s->len - 1, s->len * 99 / 100)], v[s->len - 1]);
+	}
+
+	g_array_set_size(s, 0);
+	li->missing = 0;
+	g_mutex_unlock(&li->lock);
+
+	return TRUE;
+}
+
+static void measure(struct latency_info *li, GstBuffer *buf)
+{
+	gint64 cap;
+	gdouble ms;
+
+	if (!li->ext_id || !capture_ext_read(buf, li->ext_id, &cap)) {
+		li->missing++;
+		return;
+	}
+
+	ms = (g_get_real_time() - cap) / 1000.0;
+	g_array_append_val(li->samples, ms);
+}
+
+static gboolean measure_list(GstBuffer **buf, guint idx, gpointer li)
+{
+	GstRTPBuffer rtp = GST_RTP_BUFFER_INIT;
+	gboolean marker = FALSE;
+
+	if (gst_rtp_buffer_map(*buf, GST_MAP_READ, &rtp)) {
+		marker = gst_rtp_buffer_get_marker(&rtp);
+		gst_rtp_buffer_unmap(&rtp);
+	}
+	if (marker)
+		measure(li, *buf);
+
+	return TRUE;
+}
+
+/**
+ * depay_probe
+ * Frames as the depayloader gets them from the jitterbuffer
+ */
+static GstPadProbeReturn depay_probe(GstPad *pad, GstPadProbeInfo *info,
+				     struct latency_info *li)
+{
+	g_mutex_lock(&li->lock);
+	if (info->type & GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM) {
+		GstEvent *event = GST_PAD_PROBE_INFO_EVENT(info);
+
+		if (GST_EVENT_TYPE(event) == GST_EVENT_CAPS) {
+			GstCaps *caps;
+
+			gst_event_parse_caps(event, &caps);
+			li->ext_id = capture_ext_find_id(caps);
+			if (!li->ext_id)
+				g_print("Stream has no abs-capture-time"
+					" extension\n");
+		}
+	} else if (info->type & GST_PAD_PROBE_TYPE_BUFFER) {
+		GstBuffer *buf = GST_PAD_PROBE_INFO_BUFFER(info);
+
+		measure_list(&buf, 0, li);
+	} else {
+		gst_buffer_list_foreach(GST_PAD_PROBE_INFO_BUFFER_LIST(info),
+					measure_list, li);
+	}
+	g_mutex_unlock(&li->lock);
+
+	return GST_PAD_PROBE_OK;
+}
+
+static gboolean bus_handler(GstBus *bus, GstMessage *msg,
+			    struct latency_info *li)
+{
+	GError *err = NULL;
+	gchar *dbg_info = NULL;
+
+	switch (GST_MESSAGE_TYPE(msg)) {
+	case GST_MESSAGE_ERROR:
+		gst_message_parse_error(msg, &err, &dbg_info);
+		g_printerr("Error: %s\n", err->message);
+		g_error_free(err);
+		g_free(dbg_info);
+		g_main_loop_quit(li->main_loop);
+		break;
+	case GST_MESSAGE_EOS:
+		g_main_loop_quit(li->main_loop);
+		break;
+	default:
+		break;
+	}
+
+	return TRUE;
+}
+
+int main(int argc, char *argv[])
+{
+	struct latency_info li = { .ext_id = 0 };
+	char *url = (char *) DEFAULT_URL;
+	int latency = atoi(DEFAULT_LATENCY);
+	int interval = atoi(DEFAULT_INTERVAL);
+	gboolean tcp = FALSE;
+	GstElement *pipeline, *depay;
+	GstBus *bus;
+	GstPad *pad;
+	GError *err = NULL;
+	gchar *launch;
+
+	const struct option long_opts[] = {
+		{"help",      no_argument,       0, '?'},
+		{"version",   no_argument,       0, 'v'},
+		{"url",       required_argument, 0, 'u'},
+		{"latency",   required_argument, 0, 'l'},
+		{"interval",  required_argument, 0, 'i'},
+		{"tcp",       no_argument,       0, 't'},
+		{ /* Sentinel */ }
+	};
+	char *arg_parse = "?hvu:l:i:t";
+	const char *usage =
+		"Usage: rtsp-latency [OPTIONS]\n\n"
+		"Plays a stream from gst-variable-rtsp-server --capture-time\n"
+		"and reports capture to receive latency, measured as frames\n"
+		"leave the jitterbuffer. Both hosts' clocks must be NTP\n"
+		"synced.\n\n"
+		"Options:\n"
+		" --help,     -? - This usage\n"
+		" --version,  -v - Program Version: " VERSION "\n"
+		" --url,      -u - Stream to play\n"
+		"                  (default: " DEFAULT_URL ")\n"
+		" --latency,  -l - Jitterbuffer latency in ms, part of the\n"
+		"                  result (default: " DEFAULT_LATENCY ")\n"
+		" --interval, -i - Seconds between reports"
+		" (default: " DEFAULT_INTERVAL ")\n"
+		" --tcp,      -t - Use interleaved TCP instead of UDP\n"
+		;
+
+	gst_init(&argc, &argv);
+
+	while (1) {
+		int opt_ndx;
+		int c = getopt_long(argc, argv, arg_parse, long_opts, &opt_ndx);
+
+		if (c < 0)
+			break;
+
+		switch (c) {
+		case 'h': /* Help */
+		case '?':
+			puts(usage);
+			return ECODE_OKAY;
+		case 'v': /* Version */
+			puts("Program Version: " VERSION);
+			return ECODE_OKAY;
+		case 'u':
+			url = optarg;
+			break;
+		case 'l':
+			latency = atoi(optarg);
+			break;
+		case 'i':
+			interval = atoi(optarg);
+			break;
+		case 't':
+			tcp = TRUE;
+			break;
+		default: /* Default - bad arg */
+			puts(usage);
+			return -ECODE_ARGS;
+		}
+	}
+
+	if (latency < 0 || interval < 1) {
+		g_printerr("Invalid arguments\n");
+		return -ECODE_ARGS;
+	}
+
+	launch = g_strdup_printf("rtspsrc location=%s latency=%d%s !"
+				 " rtph264depay name=depay ! fakesink",
+				 url, latency, (tcp) ? " protocols=tcp" : "");
+	pipeline = gst_parse_launch(launch, &err);
+	g_free(launch);
+	if (!pipeline) {
+		g_printerr("Could not create pipeline: %s\n",
+			   (err) ? err->message : "unknown");
+		return -ECODE_PIPE;
+	}
+
+	depay = gst_bin_get_by_name(GST_BIN(pipeline), "depay");
+	pad = gst_element_get_static_pad(depay, "sink");
+	li.samples = g_array_new(FALSE, FALSE, sizeof(gdouble));
+	g_mutex_init(&li.lock);
+	gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER |
+			  GST_PAD_PROBE_TYPE_BUFFER_LIST |
+			  GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM,
+			  (GstPadProbeCallback) depay_probe, &li, NULL);
+
+	li.main_loop = g_main_loop_new(NULL, FALSE);
+	bus = gst_element_get_bus(pipeline);
+	gst_bus_add_watch(bus, (GstBusFunc) bus_handler, &li);
+	gst_object_unref(bus);
+	g_timeout_add_seconds(interval, (GSourceFunc) report_handler, &li);
+
+	g_print("Measuring %s, jitterbuffer %dms\n", url, latency);
+	if (gst_element_set_state(pipeline, GST_STATE_PLAYING) ==
+	    GST_STATE_CHANGE_FAILURE) {
+		g_printerr("Unable to play %s\n", url);
+		return -ECODE_PLAY;
+	}
+	g_main_loop_run(li.main_loop);
+
+	gst_element_set_state(pipeline, GST_STATE_NULL);
+	gst_object_unref(pad);
+	gst_object_unref(depay);
+	gst_object_unref(pipeline);
+	g_main_loop_unref(li.main_loop);
+	g_array_free(li.samples, TRUE);
+
+	return ECODE_OKAY;
+}
+
+/* rtsp-latency.c ends here */
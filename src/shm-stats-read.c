@@ -0,0 +1,240 @@
+/**
+ * Filename: shm-stats-read.c
+ * Description: Print the server's shared memory statistics
+ * Created: Sat Oct 17 16:02:44 2026 (-0700)
+ * Version: 1.0
+ */
+
+/**
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef VERSION
+#define VERSION "1.0"
+#endif
+
+#include <ecode.h>
+#include <shm-stats.h>
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#define DEFAULT_PORT     "9099"
+#define DEFAULT_INTERVAL "0"
+
+/* Updates are once a second, anything much older means a dead server */
+#define STALE_US 3000000
+
+static const char *stage_names[SHM_STATS_STAGES] = {
+	"source0", "caps0", "enc0", "pay0"
+};
+
+static int64_t now_us(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return (int64_t) tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+/**
+ * print_stats
+ * One snapshot; rates come from the difference to 'prev' when there is
+ * one, 'secs' apart.
+ */
+static void print_stats(const struct shm_stats *s,
+			const struct shm_stats *prev, int secs)
+{
+	int64_t age = now_us() - s->update_us;
+	uint32_t i;
+
+	printf("pid %d, version %u, updated %.1fs ago%s\n", s->pid,
+	       s->version, age / 1e6, (age > STALE_US) ? " (stale)" : "");
+	printf("clients %d%s\n", s->num_cli,
+	       (s->connected) ? "" : " (idle)");
+	printf("bitrate %d (%d - %d), quant %d (%d - %d), steps %d\n",
+	       s->curr_bitrate, s->min_bitrate, s->max_bitrate,
+	       s->curr_quant_lvl, s->min_quant_lvl, s->max_quant_lvl,
+	       s->steps);
+	printf("mtu %d, fec %d%%, loss %.2f%%\n", s->mtu, s->fec_pct,
+	       s->loss * 100);
+
+	if (prev && secs > 0) {
+		printf("rtp %.1f kbit/s per client\n",
+		       (uint32_t) (s->rtp_bytes - prev->rtp_bytes) * 8.0 /
+		       1000 / secs);
+		for (i = 0; i < SHM_STATS_STAGES; i++)
+			printf("%-8s %5.1f fps\n", stage_names[i],
+			       (uint32_t) (s->frames[i] - prev->frames[i]) /
+			       (double) secs);
+	} else {
+		printf("rtp %u bytes\n", s->rtp_bytes);
+		for (i = 0; i < SHM_STATS_STAGES; i++)
+			printf("%-8s %u frames\n", stage_names[i],
+			       s->frames[i]);
+	}
+
+	/* Not there in segments of older servers */
+	if (s->size >= offsetof(struct shm_stats, rate_scale) +
+	    sizeof(s->rate_scale) && s->rate_ratio > 0)
+		printf("encoder at %.0f%% of target, scale %.2f\n",
+		       s->rate_ratio * 100, s->rate_scale);
+
+	if (s->size >= offsetof(struct shm_stats, ssim) + sizeof(s->ssim) &&
+	    s->psnr > 0)
+		printf("quality %.1fdB psnr, %.3f ssim\n", s->psnr, s->ssim);
+
+	if (s->size >= offsetof(struct shm_stats, motion_cost_us) +
+	    sizeof(s->motion_cost_us) && s->motion_cost_us) {
+		printf("motion %.2f%s", s->motion_score,
+		       (s->motion_still) ? " (still)" : "");
+		if (prev && secs > 0)
+			printf(", analyzer %.1f%% cpu",
+			       (uint32_t) (s->motion_cost_us -
+					   prev->motion_cost_us) / 1e4 / secs);
+		printf("\n");
+	}
+
+	if (s->size >= offsetof(struct shm_stats, frames_skipped) +
+	    sizeof(s->frames_skipped) && s->frames_skipped) {
+		if (prev && secs > 0)
+			printf("skipped %.1f fps\n",
+			       (uint32_t) (s->frames_skipped -
+					   prev->frames_skipped) /
+			       (double) secs);
+		else
+			printf("skipped %u frames\n", s->frames_skipped);
+	}
+
+	if (s->size >= offsetof(struct shm_stats, idr_interval) +
+	    sizeof(s->idr_interval) && s->idr_interval)
+		printf("idr every %d frames\n", s->idr_interval);
+
+	for (i = 0; i < s->n_sessions && i < SHM_STATS_MAX_SESSIONS; i++)
+		printf("  %-40s ssrc %08x loss %5.2f%% rtt %6.1fms "
+		       "jitter %6.1fms\n", s->session[i].addr,
+		       s->session[i].ssrc, s->session[i].loss * 100,
+		       s->session[i].rtt_ms, s->session[i].jitter_ms);
+}
+
+int main(int argc, char *argv[])
+{
+	const struct shm_stats *shm;
+	struct shm_stats cur, prev;
+	size_t len;
+	char name[64];
+	char *port = (char *) DEFAULT_PORT;
+	char *shm_name = NULL;
+	int interval = atoi(DEFAULT_INTERVAL);
+	int have_prev = 0;
+
+	const struct option long_opts[] = {
+		{"help",      no_argument,       0, '?'},
+		{"version",   no_argument,       0, 'v'},
+		{"port",      required_argument, 0, 'p'},
+		{"name",      required_argument, 0, 'n'},
+		{"interval",  required_argument, 0, 'i'},
+		{ /* Sentinel */ }
+	};
+	char *arg_parse = "?hvp:n:i:";
+	const char *usage =
+		"Usage: shm-stats-read [OPTIONS]\n\n"
+		"Prints the live statistics gst-variable-rtsp-server\n"
+		"publishes with --shm-stats, without talking to it.\n\n"
+		"Options:\n"
+		" --help,     -? - This usage\n"
+		" --version,  -v - Program Version: " VERSION "\n"
+		" --port,     -p - RTSP port of the server"
+		" (default: " DEFAULT_PORT ")\n"
+		" --name,     -n - Segment name"
+		" (default: " SHM_STATS_PREFIX "<port>)\n"
+		" --interval, -i - Print every N seconds, 0 == once"
+		" (default: " DEFAULT_INTERVAL ")\n"
+		;
+
+	while (1) {
+		int opt_ndx;
+		int c = getopt_long(argc, argv, arg_parse, long_opts, &opt_ndx);
+
+		if (c < 0)
+			break;
+
+		switch (c) {
+		case 'h': /* Help */
+		case '?':
+			puts(usage);
+			return ECODE_OKAY;
+		case 'v': /* Version */
+			puts("Program Version: " VERSION);
+			return ECODE_OKAY;
+		case 'p':
+			port = optarg;
+			break;
+		case 'n':
+			shm_name = optarg;
+			break;
+		case 'i':
+			interval = atoi(optarg);
+			break;
+		default: /* Default - bad arg */
+			puts(usage);
+			return -ECODE_ARGS;
+		}
+	}
+
+	if (interval < 0) {
+		fprintf(stderr, "Invalid arguments\n");
+		return -ECODE_ARGS;
+	}
+
+	if (!shm_name) {
+		snprintf(name, sizeof(name), SHM_STATS_PREFIX "%s", port);
+		shm_name = name;
+	}
+
+	shm = shm_stats_open(shm_name, &len);
+	if (!shm) {
+		fprintf(stderr, "No statistics at %s, is the server running "
+			"with --shm-stats?\n", shm_name);
+		return -ECODE_PIPE;
+	}
+
+	do {
+		if (shm_stats_read(shm, len, &cur) < 0) {
+			fprintf(stderr, "Could not read %s\n", shm_name);
+			return -ECODE_PIPE;
+		}
+
+		print_stats(&cur, (have_prev) ? &prev : NULL, interval);
+		prev = cur;
+		have_prev = 1;
+
+		if (interval) {
+			putchar('\n');
+			fflush(stdout);
+			sleep(interval);
+		}
+	} while (interval);
+
+	return ECODE_OKAY;
+}
+
+/* shm-stats-read.c ends here */
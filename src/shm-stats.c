@@ -0,0 +1,162 @@
+/**
+ * Filename: shm-stats.c
+ * Description: Seqlock protected live statistics in shared memory
+ * Created: Sat Oct 17 15:20:12 2026 (-0700)
+ * Version: 1.0
+ */
+
+/**
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/**
+ * Plain C and no glib, the reader links this too. There is a single
+ * writer, so the seqlock is just the sequence number: odd while the
+ * fields change, even once they are consistent again.
+ */
+
+#include <shm-stats.h>
+
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/* Give up on a writer that never finishes rather than spin forever */
+#define SHM_READ_TRIES 1000
+
+/**
+ * shm_stats_create
+ * Create (or take over) the segment 'name' and zero it
+ */
+struct shm_stats *shm_stats_create(const char *name)
+{
+	struct shm_stats *s;
+	int fd = shm_open(name, O_CREAT | O_RDWR, 0644);
+
+	if (fd < 0)
+		return NULL;
+
+	if (ftruncate(fd, sizeof(*s)) < 0) {
+		close(fd);
+		return NULL;
+	}
+
+	s = mmap(NULL, sizeof(*s), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (s == MAP_FAILED)
+		return NULL;
+
+	memset(s, 0, sizeof(*s));
+	s->version = SHM_STATS_VERSION;
+	s->size = sizeof(*s);
+	s->pid = getpid();
+	/* Readers check this last, publish it last */
+	__atomic_store_n(&s->magic, SHM_STATS_MAGIC, __ATOMIC_RELEASE);
+
+	return s;
+}
+
+void shm_stats_destroy(const char *name, struct shm_stats *s)
+{
+	if (!s)
+		return;
+
+	munmap(s, sizeof(*s));
+	shm_unlink(name);
+}
+
+void shm_stats_begin(struct shm_stats *s)
+{
+	__atomic_store_n(&s->seq, s->seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+void shm_stats_end(struct shm_stats *s)
+{
+	__atomic_store_n(&s->seq, s->seq + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * shm_stats_open
+ * Map an existing segment read-only, whatever size its writer made it.
+ * 'len' is how much of it is mapped.
+ */
+const struct shm_stats *shm_stats_open(const char *name, size_t *len)
+{
+	const struct shm_stats *s;
+	int fd = shm_open(name, O_RDONLY, 0);
+	struct stat st;
+
+	if (fd < 0)
+		return NULL;
+
+	if (fstat(fd, &st) < 0 || st.st_size < (off_t) SHM_STATS_MIN_SIZE) {
+		close(fd);
+		return NULL;
+	}
+
+	s = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (s == MAP_FAILED)
+		return NULL;
+
+	*len = st.st_size;
+
+	return s;
+}
+
+/**
+ * shm_stats_read
+ * Copy out a consistent snapshot of the 'len' bytes mapped. Fields the
+ * writer doesn't have are zeroed and out->size tells which those are.
+ * Returns 0, or -1 if the segment isn't ours or the writer never let go.
+ */
+int shm_stats_read(const struct shm_stats *s, size_t len,
+		   struct shm_stats *out)
+{
+	size_t size;
+	uint32_t seq;
+	int i;
+
+	if (__atomic_load_n(&s->magic, __ATOMIC_ACQUIRE) != SHM_STATS_MAGIC)
+		return -1;
+
+	/* Older servers wrote less, newer ones more than we know of */
+	size = s->size;
+	if (size < SHM_STATS_MIN_SIZE || size > len)
+		return -1;
+	if (size > sizeof(*out))
+		size = sizeof(*out);
+
+	for (i = 0; i < SHM_READ_TRIES; i++) {
+		seq = __atomic_load_n(&s->seq, __ATOMIC_ACQUIRE);
+		if (seq & 1)
+			continue;
+
+		memcpy(out, s, size);
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&s->seq, __ATOMIC_RELAXED) == seq) {
+			memset((char *) out + size, 0, sizeof(*out) - size);
+			out->size = size;
+			return 0;
+		}
+	}
+
+	return -1;
+}
+
+/* shm-stats.c ends here */
@@ -0,0 +1,175 @@
+/**
+ * Filename: snapshot.c
+ * Description: Latest raw frame as a JPEG, encoded on demand
+ * Created: Tue Oct 20 10:14:52 2026 (-0700)
+ * Version: 1.0
+ */
+
+/**
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/**
+ * A probe on caps0's src pad keeps a reference to the latest raw frame,
+ * so keeping it costs nothing but one capture buffer being in use. The
+ * frame is only turned into a JPEG when someone asks for it, once per
+ * frame however many ask: the first request encodes, concurrent ones wait
+ * for it and later ones get the cached JPEG until a new frame arrives.
+ */
+
+#include <snapshot.h>
+
+#include <gst/video/video.h>
+
+static GstPadProbeReturn snapshot_probe(GstPad *pad, GstPadProbeInfo *info,
+					struct snapshot *s)
+{
+	GstCaps *caps = gst_pad_get_current_caps(pad);
+
+	g_mutex_lock(&s->lock);
+	gst_buffer_replace(&s->buf, GST_PAD_PROBE_INFO_BUFFER(info));
+	gst_caps_replace(&s->caps, caps);
+	s->time = g_get_monotonic_time();
+	s->seq++;
+	g_mutex_unlock(&s->lock);
+
+	if (caps)
+		gst_caps_unref(caps);
+
+	return GST_PAD_PROBE_OK;
+}
+
+struct snapshot *snapshot_new(void)
+{
+	struct snapshot *s = g_new0(struct snapshot, 1);
+
+	g_mutex_init(&s->lock);
+	g_cond_init(&s->done);
+
+	return s;
+}
+
+/**
+ * snapshot_attach
+ * Keep the latest frame leaving 'elem'
+ */
+gulong snapshot_attach(GstElement *elem, struct snapshot *s)
+{
+	GstPad *pad = gst_element_get_static_pad(elem, "src");
+	gulong id;
+
+	if (!pad)
+		return 0;
+
+	id = gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER,
+			       (GstPadProbeCallback) snapshot_probe, s, NULL);
+	gst_object_unref(pad);
+
+	return id;
+}
+
+/**
+ * snapshot_clear
+ * Give the frame back, the capture device can't close while it is held
+ */
+void snapshot_clear(struct snapshot *s)
+{
+	g_mutex_lock(&s->lock);
+	gst_buffer_replace(&s->buf, NULL);
+	gst_caps_replace(&s->caps, NULL);
+	g_mutex_unlock(&s->lock);
+}
+
+static GBytes *encode(GstSample *sample)
+{
+	GstCaps *caps = gst_caps_new_empty_simple("image/jpeg");
+	GstSample *out;
+	GstBuffer *buf;
+	GstMapInfo map;
+	GBytes *jpeg = NULL;
+	GError *err = NULL;
+
+	out = gst_video_convert_sample(sample, caps, SNAPSHOT_TIMEOUT, &err);
+	gst_caps_unref(caps);
+	if (!out) {
+		g_printerr("Snapshot: %s\n", (err) ? err->message : "?");
+		g_clear_error(&err);
+		return NULL;
+	}
+
+	buf = gst_sample_get_buffer(out);
+	if (buf && gst_buffer_map(buf, &map, GST_MAP_READ)) {
+		jpeg = g_bytes_new(map.data, map.size);
+		gst_buffer_unmap(buf, &map);
+	}
+	gst_sample_unref(out);
+
+	return jpeg;
+}
+
+/**
+ * snapshot_jpeg
+ * The latest frame as a JPEG, NULL if there is no recent one. Safe from
+ * any thread, the caller unrefs the result.
+ */
+GBytes *snapshot_jpeg(struct snapshot *s)
+{
+	GstSample *sample;
+	GBytes *jpeg = NULL;
+	guint64 seq;
+
+	g_atomic_int_inc(&s->requests);
+
+	g_mutex_lock(&s->lock);
+	while (s->encoding)
+		g_cond_wait(&s->done, &s->lock);
+
+	if (!s->buf || !s->caps ||
+	    g_get_monotonic_time() - s->time > SNAPSHOT_MAX_AGE) {
+		g_mutex_unlock(&s->lock);
+		return NULL;
+	}
+
+	if (s->jpeg && s->jpeg_seq == s->seq) {
+		jpeg = g_bytes_ref(s->jpeg);
+		g_mutex_unlock(&s->lock);
+		return jpeg;
+	}
+
+	/* Encode outside the lock, the probe must never wait for it */
+	sample = gst_sample_new(s->buf, s->caps, NULL, NULL);
+	seq = s->seq;
+	s->encoding = TRUE;
+	g_mutex_unlock(&s->lock);
+
+	jpeg = encode(sample);
+	gst_sample_unref(sample);
+
+	g_mutex_lock(&s->lock);
+	if (jpeg) {
+		if (s->jpeg)
+			g_bytes_unref(s->jpeg);
+		s->jpeg = g_bytes_ref(jpeg);
+		s->jpeg_seq = seq;
+		g_atomic_int_inc(&s->encodes);
+	}
+	s->encoding = FALSE;
+	g_cond_broadcast(&s->done);
+	g_mutex_unlock(&s->lock);
+
+	return jpeg;
+}
+
+/* snapshot.c ends here */
@@ -0,0 +1,155 @@
+/**
+ * Filename: sock-tune.c
+ * Description: Transport socket tuning (buffers, latency, DSCP)
+ * Created: Wed Oct 14 16:05:12 2026 (-0700)
+ * Version: 1.0
+ */
+
+/**
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <sock-tune.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+/* Not in older libc headers */
+#ifndef TCP_NOTSENT_LOWAT
+#define TCP_NOTSENT_LOWAT 25
+#endif
+
+static const struct {
+	const char *name;
+	int dscp;
+} dscp_names[] = {
+	{"BE", 0},
+	{"CS1", 8}, {"CS2", 16}, {"CS3", 24}, {"CS4", 32},
+	{"CS5", 40}, {"CS6", 48}, {"CS7", 56},
+	{"AF11", 10}, {"AF12", 12}, {"AF13", 14},
+	{"AF21", 18}, {"AF22", 20}, {"AF23", 22},
+	{"AF31", 26}, {"AF32", 28}, {"AF33", 30},
+	{"AF41", 34}, {"AF42", 36}, {"AF43", 38},
+	{"EF", 46},
+};
+
+int sock_tune_is_set(const struct sock_tune *t)
+{
+	return t->sndbuf != SOCK_TUNE_UNSET ||
+		t->nodelay != SOCK_TUNE_UNSET ||
+		t->notsent_lowat != SOCK_TUNE_UNSET ||
+		t->dscp != SOCK_TUNE_UNSET;
+}
+
+/**
+ * sock_tune_parse_dscp
+ * Accept a PHB name (EF, AF41, CS5, ...) or a number from 0 to 63.
+ * Returns SOCK_TUNE_UNSET if neither.
+ */
+int sock_tune_parse_dscp(const char *str)
+{
+	char *end;
+	long val;
+	unsigned int i;
+
+	for (i = 0; i < sizeof(dscp_names) / sizeof(dscp_names[0]); i++)
+		if (strcasecmp(str, dscp_names[i].name) == 0)
+			return dscp_names[i].dscp;
+
+	val = strtol(str, &end, 0);
+	if (*str && !*end && val >= 0 && val <= 63)
+		return val;
+
+	return SOCK_TUNE_UNSET;
+}
+
+/**
+ * set_dscp
+ * Mark the traffic class in the IP header and map the class selector onto
+ * the socket priority, so the qdisc and VLAN egress-qos-map see it too.
+ */
+static int set_dscp(int fd, int dscp)
+{
+	struct sockaddr_storage ss;
+	socklen_t len = sizeof(ss);
+	int tos = dscp << 2;
+	int prio = dscp >> 3;
+	int ret = 0;
+
+	if (getsockname(fd, (struct sockaddr *) &ss, &len) < 0)
+		return -1;
+
+	if (ss.ss_family == AF_INET6)
+		ret |= setsockopt(fd, IPPROTO_IPV6, IPV6_TCLASS, &tos,
+				  sizeof(tos));
+
+	/* IPv4 (and v4 mapped traffic on a dual stack socket) */
+	setsockopt(fd, IPPROTO_IP, IP_TOS, &tos, sizeof(tos));
+
+	ret |= setsockopt(fd, SOL_SOCKET, SO_PRIORITY, &prio, sizeof(prio));
+
+	return ret;
+}
+
+static int tune_common(int fd, const struct sock_tune *t)
+{
+	int ret = 0;
+
+	if (t->sndbuf != SOCK_TUNE_UNSET)
+		ret |= setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &t->sndbuf,
+				  sizeof(t->sndbuf));
+
+	if (t->dscp != SOCK_TUNE_UNSET)
+		ret |= set_dscp(fd, t->dscp);
+
+	return ret;
+}
+
+/**
+ * sock_tune_tcp
+ * Tune an RTSP connection. With interleaved transport the RTP goes over it
+ * as well, so a small TCP_NOTSENT_LOWAT keeps stale video from piling up in
+ * the kernel when the link is congested.
+ */
+int sock_tune_tcp(int fd, const struct sock_tune *t)
+{
+	int ret = tune_common(fd, t);
+
+	if (t->nodelay != SOCK_TUNE_UNSET)
+		ret |= setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &t->nodelay,
+				  sizeof(t->nodelay));
+
+	if (t->notsent_lowat != SOCK_TUNE_UNSET)
+		ret |= setsockopt(fd, IPPROTO_TCP, TCP_NOTSENT_LOWAT,
+				  &t->notsent_lowat,
+				  sizeof(t->notsent_lowat));
+
+	return ret;
+}
+
+/**
+ * sock_tune_udp
+ * Tune an RTP/RTCP socket
+ */
+int sock_tune_udp(int fd, const struct sock_tune *t)
+{
+	return tune_common(fd, t);
+}
+
+/* sock-tune.c ends here */
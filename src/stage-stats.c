@@ -0,0 +1,226 @@
+/**
+ * Filename: stage-stats.c
+ * Description: Per-stage capture latency histograms and frame rates
+ * Created: Fri Oct 16 09:48:12 2026 (-0700)
+ * Version: 1.0
+ */
+
+/**
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/**
+ * Every frame gets stamped with the clock time it was captured at when it
+ * leaves source0 (base time + PTS, a GstReferenceTimestampMeta so it
+ * survives elements that re-timestamp). Each later stage's src pad takes
+ * the clock time again and drops the difference into a fixed histogram,
+ * which costs a clock read and a few atomic adds per frame. Percentiles
+ * are only worked out when the stats get printed.
+ */
+
+#include <stage-stats.h>
+#include <stats-util.h>
+#include <trace.h>
+
+struct stage_pad {
+	struct stage_hist *hist;
+	GstElement *elem;	/* Not reffed, the pad goes away with it */
+	enum stage st;
+};
+
+#if GST_CHECK_VERSION(1, 14, 0)
+static GstCaps *capture_caps(void)
+{
+	static GstCaps *caps;
+
+	if (g_once_init_enter(&caps))
+		g_once_init_leave(&caps, gst_caps_new_empty_simple(
+			"timestamp/x-gst-variable-rtsp-server-capture"));
+
+	return caps;
+}
+#endif
+
+/**
+ * stage_capture_time
+ * Clock time 'buf' was captured at, stamped at source0 or worked out from
+ * its PTS after elements that drop metas
+ */
+GstClockTime stage_capture_time(GstElement *elem, GstBuffer *buf)
+{
+#if GST_CHECK_VERSION(1, 14, 0)
+	GstReferenceTimestampMeta *meta =
+		gst_buffer_get_reference_timestamp_meta(buf, capture_caps());
+
+	if (meta)
+		return meta->timestamp;
+#endif
+	if (!GST_BUFFER_PTS_IS_VALID(buf))
+		return GST_CLOCK_TIME_NONE;
+
+	return gst_element_get_base_time(elem) + GST_BUFFER_PTS(buf);
+}
+
+static void record(struct stage_pad *sp, GstBuffer *buf)
+{
+	GstClock *clock = gst_element_get_clock(sp->elem);
+	GstClockTime cap = stage_capture_time(sp->elem, buf);
+	GstClockTimeDiff diff;
+	gint us = -1, idx;
+
+	if (!clock)
+		return;
+
+	g_atomic_int_inc(&sp->hist->frames);
+	g_atomic_int_inc(&sp->hist->total);
+	if (GST_CLOCK_TIME_IS_VALID(cap)) {
+		diff = GST_CLOCK_DIFF(cap, gst_clock_get_time(clock));
+		us = CLAMP(diff / GST_USECOND, 0, G_MAXINT);
+		idx = MIN(us / STAGE_HIST_US, STAGE_HIST_BUCKETS - 1);
+
+		g_atomic_int_inc(&sp->hist->bucket[idx]);
+		atomic_max(&sp->hist->max_us, us);
+	}
+	TRACE2(stage_frame, sp->st, us);
+
+	gst_object_unref(clock);
+}
+
+static GstPadProbeReturn stage_probe(GstPad *pad, GstPadProbeInfo *info,
+				     struct stage_pad *sp)
+{
+	GstBuffer *buf;
+
+	if (info->type & GST_PAD_PROBE_TYPE_BUFFER) {
+		buf = GST_PAD_PROBE_INFO_BUFFER(info);
+	} else {
+		GstBufferList *list = GST_PAD_PROBE_INFO_BUFFER_LIST(info);
+		guint len = gst_buffer_list_length(list);
+
+		if (!len)
+			return GST_PAD_PROBE_OK;
+		buf = gst_buffer_list_get(list, len - 1);
+	}
+
+	/* A frame has only left the payloader with its last packet */
+	if (sp->st == STAGE_PAYLOAD && !rtp_has_marker(buf))
+		return GST_PAD_PROBE_OK;
+
+#if GST_CHECK_VERSION(1, 14, 0)
+	/* Sources push single buffers, one in a list is borrowed */
+	if (sp->st == STAGE_SOURCE && GST_BUFFER_PTS_IS_VALID(buf) &&
+	    (info->type & GST_PAD_PROBE_TYPE_BUFFER)) {
+		buf = gst_buffer_make_writable(buf);
+		gst_buffer_add_reference_timestamp_meta(buf, capture_caps(),
+			gst_element_get_base_time(sp->elem) +
+			GST_BUFFER_PTS(buf), GST_CLOCK_TIME_NONE);
+		GST_PAD_PROBE_INFO_DATA(info) = buf;
+	}
+#endif
+
+	record(sp, buf);
+
+	return GST_PAD_PROBE_OK;
+}
+
+/**
+ * stage_stats_attach
+ * Start measuring frames leaving 'elem'. Attach the payloader after
+ * rtp_batch_attach() so batched frames are only seen once, as a list.
+ */
+gulong stage_stats_attach(GstElement *elem, enum stage st,
+			  struct stage_stats *ss)
+{
+	struct stage_pad *sp;
+	GstPad *pad = gst_element_get_static_pad(elem, "src");
+	gulong id;
+
+	if (!pad)
+		return 0;
+
+	if (!ss->last_sample)
+		ss->last_sample = g_get_monotonic_time();
+
+	sp = g_new0(struct stage_pad, 1);
+	sp->hist = &ss->hist[st];
+	sp->elem = elem;
+	sp->st = st;
+
+	id = gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER |
+			       GST_PAD_PROBE_TYPE_BUFFER_LIST,
+			       (GstPadProbeCallback) stage_probe, sp, g_free);
+	gst_object_unref(pad);
+
+	return id;
+}
+
+/* Smallest latency (ms) at or below which 'pct' percent of 'n' frames were */
+static gdouble percentile(const gint *bucket, gint n, gint pct)
+{
+	return hist_percentile(bucket, STAGE_HIST_BUCKETS, n, pct) *
+		STAGE_HIST_US / 1000.0;
+}
+
+/**
+ * stage_stats_sample
+ * Latency and frame rate of every stage since the last call
+ */
+void stage_stats_sample(struct stage_stats *ss,
+			struct stage_sample out[NUM_STAGES])
+{
+	gint bucket[STAGE_HIST_BUCKETS];
+	gint64 now = g_get_monotonic_time();
+	gdouble secs = (now - ss->last_sample) / (gdouble) G_USEC_PER_SEC;
+	int st, i;
+	gint n;
+
+	ss->last_sample = now;
+	for (st = 0; st < NUM_STAGES; st++) {
+		struct stage_hist *h = &ss->hist[st];
+
+		n = 0;
+		for (i = 0; i < STAGE_HIST_BUCKETS; i++) {
+			bucket[i] = g_atomic_int_and(&h->bucket[i], 0);
+			n += bucket[i];
+		}
+
+		out[st].frames = g_atomic_int_and(&h->frames, 0);
+		out[st].fps = (secs > 0) ? out[st].frames / secs : 0;
+		out[st].max_ms = g_atomic_int_and(&h->max_us, 0) / 1000.0;
+		/* Buckets report their upper edge, don't go past the max */
+		out[st].p50_ms = (n) ? MIN(percentile(bucket, n, 50),
+					   out[st].max_ms) : 0;
+		out[st].p99_ms = (n) ? MIN(percentile(bucket, n, 99),
+					   out[st].max_ms) : 0;
+	}
+}
+
+const char *stage_str(enum stage st)
+{
+	switch (st) {
+	case STAGE_SOURCE:
+		return "source0";
+	case STAGE_CAPS:
+		return "caps0";
+	case STAGE_ENCODER:
+		return "enc0";
+	case STAGE_PAYLOAD:
+		return "pay0";
+	}
+
+	return "unknown";
+}
+
+/* stage-stats.c ends here */
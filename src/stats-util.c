@@ -0,0 +1,82 @@
+/**
+ * Filename: stats-util.c
+ * Description: Helpers shared by the statistics probes
+ * Created: Sun Oct 25 10:12:36 2026 (-0700)
+ * Version: 1.0
+ */
+
+/**
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <stats-util.h>
+
+#include <gst/rtp/gstrtpbuffer.h>
+
+/**
+ * atomic_max
+ * Raise '*p' to 'val' if it is lower, from any thread
+ */
+void atomic_max(gint *p, gint val)
+{
+	gint old;
+
+	do {
+		old = g_atomic_int_get(p);
+		if (val <= old)
+			return;
+	} while (!g_atomic_int_compare_and_exchange(p, old, val));
+}
+
+/**
+ * rtp_has_marker
+ * Whether 'buf' is the last packet of a frame
+ */
+gboolean rtp_has_marker(GstBuffer *buf)
+{
+	GstRTPBuffer rtp = GST_RTP_BUFFER_INIT;
+	gboolean marker;
+
+	if (!gst_rtp_buffer_map(buf, GST_MAP_READ, &rtp))
+		return FALSE;
+
+	marker = gst_rtp_buffer_get_marker(&rtp);
+	gst_rtp_buffer_unmap(&rtp);
+
+	return marker;
+}
+
+/**
+ * hist_percentile
+ * Number of the first of 'buckets' buckets at which 'pct' percent of 'n'
+ * samples have been seen, counting from 1 so it is the upper edge in
+ * bucket widths. 'buckets' if they never are.
+ */
+gint hist_percentile(const gint *bucket, gint buckets, gint n, gint pct)
+{
+	gint64 want = ((gint64) n * pct + 99) / 100;
+	gint64 seen = 0;
+	gint i;
+
+	for (i = 0; i < buckets; i++) {
+		seen += bucket[i];
+		if (seen >= want)
+			return i + 1;
+	}
+
+	return buckets;
+}
+
+/* stats-util.c ends here */
@@ -0,0 +1,548 @@
+/**
+ * Filename: timeshift.c
+ * Description: Ring of encoded frames for rewinding the live stream
+ * Created: Wed Oct 21 09:37:15 2026 (-0700)
+ * Version: 1.0
+ */
+
+/**
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/**
+ * A probe on enc0's src pad copies every access unit into one arena
+ * allocated up front, so holding a minute of video costs no allocations
+ * per frame and can't fragment the heap. Frames are written one after
+ * the other and wrap to the start when the next one doesn't fit; the
+ * oldest frames are dropped to make room, or once they are older than
+ * the configured time. Key frames are indexed separately so a reader can
+ * find where to start decoding from with a binary search.
+ *
+ * A reader copies frames out into an appsrc of its own pipeline from a
+ * thread, paced by the time they arrived at, faster when asked to. The
+ * encoder's timestamps are kept and shifted so the frame a reader starts
+ * at plays now, the spacing between frames stays what the encoder gave
+ * them whatever the speed. The live pipeline only ever pays for the copy
+ * into the arena.
+ */
+
+#include <timeshift.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#include <gst/app/gstappsrc.h>
+
+/* Called with the lock held */
+static void evict(struct timeshift *ts)
+{
+	struct timeshift_au *au = &ts->au[ts->first % ts->cap];
+
+	ts->used -= au->size;
+	ts->first++;
+	while (ts->key_first < ts->key_next &&
+	       ts->keys[ts->key_first % ts->cap] < ts->first)
+		ts->key_first++;
+}
+
+static gboolean overlaps(struct timeshift_au *au, gsize offset, gsize size)
+{
+	return au->offset < offset + size && offset < au->offset + au->size;
+}
+
+static GstPadProbeReturn timeshift_probe(GstPad *pad, GstPadProbeInfo *info,
+					 struct timeshift *ts)
+{
+	GstBuffer *buf = GST_PAD_PROBE_INFO_BUFFER(info);
+	GstCaps *caps = gst_pad_get_current_caps(pad);
+	gint64 now = g_get_monotonic_time();
+	struct timeshift_au *au;
+	GstMapInfo map;
+
+	if (!gst_buffer_map(buf, &map, GST_MAP_READ))
+		goto out;
+
+	/* One frame must never push out most of the ring */
+	if (map.size == 0 || map.size > ts->size / 4) {
+		g_atomic_int_inc(&ts->dropped);
+		gst_buffer_unmap(buf, &map);
+		goto out;
+	}
+
+	g_mutex_lock(&ts->lock);
+	if (ts->head + map.size > ts->size)
+		ts->head = 0;
+
+	/* The oldest frame is always the one right after the head */
+	while (ts->first < ts->next &&
+	       (ts->next - ts->first == ts->cap ||
+		overlaps(&ts->au[ts->first % ts->cap], ts->head, map.size) ||
+		now - ts->au[ts->first % ts->cap].time > ts->max_age))
+		evict(ts);
+
+	au = &ts->au[ts->next % ts->cap];
+	au->offset = ts->head;
+	au->size = map.size;
+	au->time = now;
+	au->pts = (GST_BUFFER_PTS_IS_VALID(buf)) ? GST_BUFFER_PTS(buf) :
+		now * GST_USECOND;
+	au->dts = GST_BUFFER_DTS(buf);
+	au->key = !GST_BUFFER_FLAG_IS_SET(buf, GST_BUFFER_FLAG_DELTA_UNIT);
+	memcpy(ts->arena + ts->head, map.data, map.size);
+	ts->head += map.size;
+	ts->used += map.size;
+
+	if (au->key)
+		ts->keys[ts->key_next++ % ts->cap] = ts->next;
+	ts->next++;
+
+	gst_caps_replace(&ts->caps, caps);
+	g_cond_broadcast(&ts->added);
+	g_mutex_unlock(&ts->lock);
+
+	gst_buffer_unmap(buf, &map);
+out:
+	if (caps)
+		gst_caps_unref(caps);
+
+	return GST_PAD_PROBE_OK;
+}
+
+/**
+ * timeshift_new
+ * A ring holding up to 'secs' seconds of video in at most 'bytes' bytes.
+ * NULL if the arena can't be allocated.
+ */
+struct timeshift *timeshift_new(gint secs, gsize bytes)
+{
+	struct timeshift *ts = g_new0(struct timeshift, 1);
+
+	ts->arena = g_try_malloc(bytes);
+	if (!ts->arena) {
+		g_free(ts);
+		return NULL;
+	}
+
+	g_mutex_init(&ts->lock);
+	g_cond_init(&ts->added);
+	ts->size = bytes;
+	ts->max_age = secs * G_USEC_PER_SEC;
+	ts->cap = secs * TIMESHIFT_MAX_FPS + 1;
+	ts->au = g_new0(struct timeshift_au, ts->cap);
+	ts->keys = g_new0(guint64, ts->cap);
+
+	return ts;
+}
+
+/**
+ * timeshift_attach
+ * Keep the frames leaving encoder 'enc'. The probe goes away with the
+ * media, the frames held stay.
+ */
+gulong timeshift_attach(GstElement *enc, struct timeshift *ts)
+{
+	GstPad *pad = gst_element_get_static_pad(enc, "src");
+	gulong id;
+
+	if (!pad)
+		return 0;
+
+	id = gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER,
+			       (GstPadProbeCallback) timeshift_probe, ts,
+			       NULL);
+	gst_object_unref(pad);
+
+	return id;
+}
+
+/**
+ * timeshift_held
+ * Seconds of video in the ring, and the bytes they take if 'bytes' is set
+ */
+gdouble timeshift_held(struct timeshift *ts, gsize *bytes)
+{
+	gdouble secs = 0;
+
+	g_mutex_lock(&ts->lock);
+	if (ts->next - ts->first > 1)
+		secs = (ts->au[(ts->next - 1) % ts->cap].time -
+			ts->au[ts->first % ts->cap].time) /
+			(gdouble) G_USEC_PER_SEC;
+	if (bytes)
+		*bytes = ts->used;
+	g_mutex_unlock(&ts->lock);
+
+	return secs;
+}
+
+/* Called with the lock held */
+static guint64 find_key(struct timeshift *ts, gint64 time)
+{
+	guint64 lo = ts->key_first, hi = ts->key_next, mid;
+
+	/* Nothing to start from yet, wait for the next key frame */
+	if (lo == hi)
+		return ts->next;
+
+	/* Last key frame at or before 'time', else the first one */
+	while (hi - lo > 1) {
+		mid = lo + (hi - lo) / 2;
+		if (ts->au[ts->keys[mid % ts->cap] % ts->cap].time <= time)
+			lo = mid;
+		else
+			hi = mid;
+	}
+
+	return ts->keys[lo % ts->cap];
+}
+
+/**
+ * timeshift_find
+ * Number of the key frame to start decoding from to show monotonic time
+ * 'time'
+ */
+guint64 timeshift_find(struct timeshift *ts, gint64 time)
+{
+	guint64 seq;
+
+	g_mutex_lock(&ts->lock);
+	seq = find_key(ts, time);
+	g_mutex_unlock(&ts->lock);
+
+	return seq;
+}
+
+/* Called with the lock held */
+static GstBuffer *copy_au(struct timeshift *ts, struct timeshift_au *au)
+{
+	GstBuffer *buf = gst_buffer_new_allocate(NULL, au->size, NULL);
+
+	gst_buffer_fill(buf, 0, ts->arena + au->offset, au->size);
+	GST_BUFFER_PTS(buf) = au->pts;
+	GST_BUFFER_DTS(buf) = au->dts;
+	if (!au->key)
+		GST_BUFFER_FLAG_SET(buf, GST_BUFFER_FLAG_DELTA_UNIT);
+
+	return buf;
+}
+
+/**
+ * timeshift_get
+ * A copy of frame 'seq' with the encoder's timestamps and the time it
+ * arrived, NULL once it has left the ring or before it arrives
+ */
+GstBuffer *timeshift_get(struct timeshift *ts, guint64 seq, gint64 *time)
+{
+	GstBuffer *buf = NULL;
+
+	g_mutex_lock(&ts->lock);
+	if (seq >= ts->first && seq < ts->next) {
+		buf = copy_au(ts, &ts->au[seq % ts->cap]);
+		if (time)
+			*time = ts->au[seq % ts->cap].time;
+	}
+	g_mutex_unlock(&ts->lock);
+
+	return buf;
+}
+
+/**
+ * timeshift_wait
+ * Wait until the ring holds a frame that arrived at monotonic time 'time'
+ * or later, at most until monotonic time 'deadline'. FALSE if it didn't.
+ */
+gboolean timeshift_wait(struct timeshift *ts, gint64 time, gint64 deadline)
+{
+	gboolean ret;
+
+	g_mutex_lock(&ts->lock);
+	while (!(ret = ts->first < ts->next &&
+		 ts->au[(ts->next - 1) % ts->cap].time >= time) &&
+	       g_cond_wait_until(&ts->added, &ts->lock, deadline))
+		;
+	g_mutex_unlock(&ts->lock);
+
+	return ret;
+}
+
+/**
+ * timeshift_caps
+ * Caps of the frames held, NULL before the first one. Unref when done.
+ */
+GstCaps *timeshift_caps(struct timeshift *ts)
+{
+	GstCaps *caps = NULL;
+
+	g_mutex_lock(&ts->lock);
+	if (ts->caps)
+		caps = gst_caps_ref(ts->caps);
+	g_mutex_unlock(&ts->lock);
+
+	return caps;
+}
+
+/* Running time of 'e', GST_CLOCK_TIME_NONE until its pipeline plays */
+static GstClockTime running_time(GstElement *e)
+{
+	GstClock *clock = gst_element_get_clock(e);
+	GstClockTime now, base;
+
+	if (!clock)
+		return GST_CLOCK_TIME_NONE;
+	now = gst_clock_get_time(clock);
+	base = gst_element_get_base_time(e);
+	gst_object_unref(clock);
+
+	return (now > base) ? now - base : 0;
+}
+
+/* Encoder time 't' moved to where the reader's anchor plays */
+static GstClockTime restamp(struct timeshift_reader *r, GstClockTime t)
+{
+	gint64 out;
+
+	if (!GST_CLOCK_TIME_IS_VALID(t))
+		return GST_CLOCK_TIME_NONE;
+	out = (gint64) r->base + (gint64) t - (gint64) r->anchor_pts;
+
+	return MAX(out, 0);
+}
+
+/**
+ * reader_thread
+ * Push frames from the ring into the reader's appsrc, each one no earlier
+ * than it is due, until stopped. Nothing is pushed before its pipeline
+ * plays; while the appsrc refuses them (the pipeline is stopping) the
+ * reader backs off and starts over at a key frame.
+ */
+static gpointer reader_thread(struct timeshift_reader *r)
+{
+	struct timeshift *ts = r->ts;
+	GstFlowReturn ret;
+	GstCaps *caps = NULL;
+
+	g_mutex_lock(&ts->lock);
+	while (!r->stop) {
+		struct timeshift_au *au;
+		gint64 now = g_get_monotonic_time();
+		gint64 due;
+		GstBuffer *buf;
+		gboolean new_caps = FALSE;
+
+		/* Too slow for the ring, continue from the oldest key frame */
+		if (r->pos < ts->first) {
+			r->pos = find_key(ts, (r->live) ? G_MAXINT64 : 0);
+			r->need_key = TRUE;
+		}
+
+		if (r->pos >= ts->next || !ts->caps) {
+			g_cond_wait_until(&ts->added, &ts->lock,
+					  now + TIMESHIFT_WAIT);
+			continue;
+		}
+
+		au = &ts->au[r->pos % ts->cap];
+		if (r->need_key && !au->key) {
+			r->pos++;
+			continue;
+		}
+		if (r->need_key) {
+			struct timeshift_au *anchor = (r->live) ?
+				&ts->au[(ts->next - 1) % ts->cap] : au;
+			GstClockTime run = running_time(r->src);
+
+			if (!GST_CLOCK_TIME_IS_VALID(run)) {
+				g_cond_wait_until(&ts->added, &ts->lock,
+						  now + TIMESHIFT_WAIT);
+				continue;
+			}
+
+			/*
+			 * Live readers burst up to the newest frame, which
+			 * plays now, the ones before it are already late.
+			 * Never behind what was stamped before a seek.
+			 */
+			r->anchor = now;
+			r->anchor_time = anchor->time;
+			r->anchor_pts = anchor->pts;
+			r->base = MAX(run, r->end + 1 + anchor->pts -
+				      MIN(au->pts, anchor->pts));
+			r->need_key = FALSE;
+		}
+
+		due = r->anchor + (au->time - r->anchor_time) / r->speed;
+		if (due > now) {
+			g_cond_wait_until(&ts->added, &ts->lock,
+					  MIN(due, now + TIMESHIFT_WAIT));
+			continue;
+		}
+
+		buf = copy_au(ts, au);
+		GST_BUFFER_PTS(buf) = restamp(r, au->pts);
+		GST_BUFFER_DTS(buf) = restamp(r, au->dts);
+		r->end = MAX(r->end, GST_BUFFER_PTS(buf));
+		r->pos++;
+		if (caps != ts->caps) {
+			gst_caps_replace(&caps, ts->caps);
+			new_caps = TRUE;
+		}
+		g_mutex_unlock(&ts->lock);
+
+		if (new_caps)
+			gst_app_src_set_caps(GST_APP_SRC(r->src), caps);
+		ret = gst_app_src_push_buffer(GST_APP_SRC(r->src), buf);
+		if (ret != GST_FLOW_OK)
+			g_usleep(TIMESHIFT_WAIT);
+
+		g_mutex_lock(&ts->lock);
+		if (ret != GST_FLOW_OK) {
+			if (r->live)
+				r->pos = find_key(ts, G_MAXINT64);
+			r->need_key = TRUE;
+		}
+	}
+	g_mutex_unlock(&ts->lock);
+
+	if (caps)
+		gst_caps_unref(caps);
+
+	return NULL;
+}
+
+/**
+ * timeshift_reader_new
+ * A reader for 'src', an appsrc with block=true so a full queue holds the
+ * reader back. It starts pushing on the first seek, so no stale frames
+ * are queued ahead of where PLAY asks for.
+ */
+struct timeshift_reader *timeshift_reader_new(struct timeshift *ts,
+					      GstElement *src)
+{
+	struct timeshift_reader *r = g_new0(struct timeshift_reader, 1);
+
+	r->ts = ts;
+	r->src = gst_object_ref(src);
+	r->speed = 1.0;
+
+	return r;
+}
+
+/**
+ * parse_range
+ * Where an RTSP Range asks to start, as a monotonic time:
+ *  - none, npt=now-: live, G_MAXINT64
+ *  - npt=-N: N seconds before live
+ *  - npt=N-: N seconds after the oldest frame held
+ *  - clock=YYYYMMDDThhmmss[.f]Z-: that UTC wall clock time
+ * Called with the lock held.
+ */
+static gboolean parse_range(struct timeshift *ts, const gchar *range,
+			    gint64 *time)
+{
+	gint64 now = g_get_monotonic_time();
+	gint y, mo, d, h, mi;
+	gdouble secs;
+	gchar *end;
+
+	if (!range || g_str_has_prefix(range, "npt=now")) {
+		*time = G_MAXINT64;
+		return TRUE;
+	}
+
+	if (g_str_has_prefix(range, "npt=-")) {
+		secs = g_ascii_strtod(range + 5, &end);
+		if (end == range + 5 || secs < 0)
+			return FALSE;
+		*time = now - secs * G_USEC_PER_SEC;
+		return TRUE;
+	}
+
+	if (g_str_has_prefix(range, "npt=")) {
+		secs = g_ascii_strtod(range + 4, &end);
+		if (end == range + 4 || *end != '-' || secs < 0)
+			return FALSE;
+		*time = (ts->first < ts->next) ?
+			ts->au[ts->first % ts->cap].time +
+			secs * G_USEC_PER_SEC : G_MAXINT64;
+		return TRUE;
+	}
+
+	if (sscanf(range, "clock=%4d%2d%2dT%2d%2d%lfZ", &y, &mo, &d, &h, &mi,
+		   &secs) == 6) {
+		GDateTime *dt = g_date_time_new_utc(y, mo, d, h, mi, secs);
+
+		if (!dt)
+			return FALSE;
+		*time = g_date_time_to_unix(dt) * G_USEC_PER_SEC +
+			g_date_time_get_microsecond(dt) -
+			g_get_real_time() + now;
+		g_date_time_unref(dt);
+		return TRUE;
+	}
+
+	return FALSE;
+}
+
+/**
+ * timeshift_reader_seek
+ * Continue from where RTSP Range 'range' (NULL for live) asks to, at
+ * 'speed' times real time, starting the reader on the first call. FALSE
+ * if the range makes no sense to us.
+ */
+gboolean timeshift_reader_seek(struct timeshift_reader *r,
+			       const gchar *range, gdouble speed)
+{
+	struct timeshift *ts = r->ts;
+	gint64 time;
+
+	g_mutex_lock(&ts->lock);
+	if (!parse_range(ts, range, &time)) {
+		g_mutex_unlock(&ts->lock);
+		return FALSE;
+	}
+
+	r->live = (time == G_MAXINT64);
+	r->pos = find_key(ts, time);
+	r->need_key = TRUE;
+	r->speed = (speed >= 1.0) ? MIN(speed, TIMESHIFT_MAX_SPEED) : 1.0;
+	g_cond_broadcast(&ts->added);
+	g_mutex_unlock(&ts->lock);
+
+	if (!r->thread)
+		r->thread = g_thread_new("timeshift",
+					 (GThreadFunc) reader_thread, r);
+
+	return TRUE;
+}
+
+/**
+ * timeshift_reader_free
+ * Stop the reader and wait for its thread. Its appsrc has to be flushing
+ * already (pipeline stopped), or the thread may be stuck pushing into it.
+ */
+void timeshift_reader_free(struct timeshift_reader *r)
+{
+	g_mutex_lock(&r->ts->lock);
+	r->stop = TRUE;
+	g_cond_broadcast(&r->ts->added);
+	g_mutex_unlock(&r->ts->lock);
+
+	if (r->thread)
+		g_thread_join(r->thread);
+	gst_object_unref(r->src);
+	g_free(r);
+}
+
+/* timeshift.c ends here */
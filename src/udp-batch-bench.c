@@ -0,0 +1,327 @@
+/**
+ * Filename: udp-batch-bench.c
+ * Description: Loopback microbenchmark of batched vs. unbatched RTP fan-out
+ * Created: Mon Oct 12 13:40:51 2026 (-0700)
+ * Version: 1.0
+ */
+
+/**
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE		/* recvmmsg, RUSAGE_THREAD */
+#endif
+
+#ifndef VERSION
+#define VERSION "1.0"
+#endif
+
+#include <ecode.h>
+#include <udp-batch.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <poll.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+
+#define DEFAULT_CLIENTS  "8"
+#define DEFAULT_PKT_SIZE "1400"
+#define DEFAULT_PKTS     "12"	/* ~16KB frame, 4Mbit/s @ 30fps */
+#define DEFAULT_SECONDS  "3"
+
+#define MAX_CLIENTS 256
+
+struct bench {
+	int clients;		/* Number of unicast receivers */
+	int pkt_size;		/* RTP packet size */
+	int pkts;		/* Packets per frame */
+	int seconds;		/* Run time per mode */
+	int rx_fd[MAX_CLIENTS];	/* Receiver sockets */
+	struct sockaddr_in rx_addr[MAX_CLIENTS];
+	volatile int running;	/* Receiver thread keeps draining */
+	unsigned long received;	/* Packets seen by receivers */
+};
+
+static double now_sec(int clk)
+{
+	struct timespec ts;
+
+	clock_gettime(clk, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * rx_thread
+ * Drain all receiver sockets so the loopback queues don't overflow and
+ * count what actually arrived.
+ */
+static void *rx_thread(void *arg)
+{
+	struct bench *b = arg;
+	struct pollfd pfd[MAX_CLIENTS];
+	static char buf[UDP_BATCH_MAX][2048];
+	struct iovec iov[UDP_BATCH_MAX];
+	struct mmsghdr msgs[UDP_BATCH_MAX];
+	int i;
+
+	for (i = 0; i < UDP_BATCH_MAX; i++) {
+		iov[i].iov_base = buf[i];
+		iov[i].iov_len = sizeof(buf[i]);
+		memset(&msgs[i], 0, sizeof(msgs[i]));
+		msgs[i].msg_hdr.msg_iov = &iov[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	for (i = 0; i < b->clients; i++) {
+		pfd[i].fd = b->rx_fd[i];
+		pfd[i].events = POLLIN;
+	}
+
+	while (b->running) {
+		if (poll(pfd, b->clients, 100) <= 0)
+			continue;
+
+		for (i = 0; i < b->clients; i++) {
+			int n;
+
+			if (!(pfd[i].revents & POLLIN))
+				continue;
+
+			while ((n = recvmmsg(pfd[i].fd, msgs, UDP_BATCH_MAX,
+					     MSG_DONTWAIT, NULL)) > 0)
+				__atomic_add_fetch(&b->received, n,
+						   __ATOMIC_RELAXED);
+		}
+	}
+
+	return NULL;
+}
+
+/**
+ * run_mode
+ * Fan frames out to every receiver for b->seconds and report throughput
+ * and sender CPU cost.
+ */
+static void run_mode(struct bench *b, int tx_fd, enum udp_batch_mode mode)
+{
+	struct udp_batch batch;
+	struct rusage ru0, ru1;
+	unsigned long frames = 0, sent_bytes = 0;
+	double t0, t1, cpu, mbit;
+	char *frame;
+	int i, c;
+
+	udp_batch_init(&batch, tx_fd, mode);
+	if (mode == UDP_BATCH_GSO && !batch.gso) {
+		printf("%-10s: UDP_SEGMENT not supported by this kernel\n",
+		       udp_batch_mode_str(mode));
+		return;
+	}
+
+	frame = calloc(b->pkts, b->pkt_size);
+	if (!frame) {
+		fprintf(stderr, "Out of memory\n");
+		exit(-ECODE_ARGS);
+	}
+
+	__atomic_store_n(&b->received, 0, __ATOMIC_RELAXED);
+	getrusage(RUSAGE_THREAD, &ru0);
+	t0 = now_sec(CLOCK_MONOTONIC);
+
+	do {
+		for (c = 0; c < b->clients; c++) {
+			const struct sockaddr *dst =
+				(struct sockaddr *) &b->rx_addr[c];
+
+			for (i = 0; i < b->pkts; i++) {
+				/* Last fragment of a frame is short */
+				size_t len = (i == b->pkts - 1) ?
+					b->pkt_size / 2 : b->pkt_size;
+
+				udp_batch_add(&batch, dst,
+					      sizeof(b->rx_addr[c]),
+					      frame + i * b->pkt_size, len);
+				sent_bytes += len;
+			}
+			udp_batch_flush(&batch, dst, sizeof(b->rx_addr[c]));
+		}
+		frames++;
+		t1 = now_sec(CLOCK_MONOTONIC);
+	} while (t1 - t0 < b->seconds);
+
+	getrusage(RUSAGE_THREAD, &ru1);
+
+	/* Let the receiver catch up before reading its counter */
+	usleep(100000);
+
+	cpu = (ru1.ru_utime.tv_sec - ru0.ru_utime.tv_sec) +
+		(ru1.ru_utime.tv_usec - ru0.ru_utime.tv_usec) / 1e6 +
+		(ru1.ru_stime.tv_sec - ru0.ru_stime.tv_sec) +
+		(ru1.ru_stime.tv_usec - ru0.ru_stime.tv_usec) / 1e6;
+	mbit = sent_bytes * 8 / 1e6;
+
+	printf("%-10s: %10.0f pkt/s %8.1f Mbit/s %10.0f syscalls/s"
+	       " %7.3f cpu-ms/Mbit %5.1f%% received\n",
+	       udp_batch_mode_str(mode),
+	       batch.packets / (t1 - t0),
+	       mbit / (t1 - t0),
+	       batch.syscalls / (t1 - t0),
+	       (mbit > 0) ? cpu * 1000 / mbit : 0,
+	       (batch.packets) ? 100.0 *
+	       __atomic_load_n(&b->received, __ATOMIC_RELAXED) /
+	       batch.packets : 0);
+
+	free(frame);
+}
+
+int main(int argc, char *argv[])
+{
+	struct bench b = {
+		.clients = atoi(DEFAULT_CLIENTS),
+		.pkt_size = atoi(DEFAULT_PKT_SIZE),
+		.pkts = atoi(DEFAULT_PKTS),
+		.seconds = atoi(DEFAULT_SECONDS),
+		.running = 1,
+	};
+	pthread_t rx;
+	int tx_fd, i;
+
+	const struct option long_opts[] = {
+		{"help",      no_argument,       0, '?'},
+		{"version",   no_argument,       0, 'v'},
+		{"clients",   required_argument, 0, 'c'},
+		{"pkt-size",  required_argument, 0, 's'},
+		{"pkts",      required_argument, 0, 'n'},
+		{"time",      required_argument, 0, 't'},
+		{ /* Sentinel */ }
+	};
+	char *arg_parse = "?hvc:s:n:t:";
+	const char *usage =
+		"Usage: udp-batch-bench [OPTIONS]\n\n"
+		"Sends RTP-sized frames over loopback to a number of unicast\n"
+		"receivers using one syscall per packet, sendmmsg() and\n"
+		"UDP_SEGMENT GSO, and reports packets per second and sender\n"
+		"CPU time per Mbit for each.\n\n"
+		"Options:\n"
+		" --help,     -? - This usage\n"
+		" --version,  -v - Program Version: " VERSION "\n"
+		" --clients,  -c - Number of receivers"
+		" (default: " DEFAULT_CLIENTS ")\n"
+		" --pkt-size, -s - RTP packet size in bytes"
+		" (default: " DEFAULT_PKT_SIZE ")\n"
+		" --pkts,     -n - Packets per frame"
+		" (default: " DEFAULT_PKTS ")\n"
+		" --time,     -t - Seconds to run each mode"
+		" (default: " DEFAULT_SECONDS ")\n"
+		;
+
+	while (1) {
+		int opt_ndx;
+		int c = getopt_long(argc, argv, arg_parse, long_opts, &opt_ndx);
+
+		if (c < 0)
+			break;
+
+		switch (c) {
+		case 'h': /* Help */
+		case '?':
+			puts(usage);
+			return ECODE_OKAY;
+		case 'v': /* Version */
+			puts("Program Version: " VERSION);
+			return ECODE_OKAY;
+		case 'c':
+			b.clients = atoi(optarg);
+			break;
+		case 's':
+			b.pkt_size = atoi(optarg);
+			break;
+		case 'n':
+			b.pkts = atoi(optarg);
+			break;
+		case 't':
+			b.seconds = atoi(optarg);
+			break;
+		default: /* Default - bad arg */
+			puts(usage);
+			return -ECODE_ARGS;
+		}
+	}
+
+	if (b.clients < 1 || b.clients > MAX_CLIENTS || b.pkts < 1 ||
+	    b.pkt_size < 64 || b.pkt_size > 1472 || b.seconds < 1) {
+		fprintf(stderr, "Invalid arguments\n");
+		return -ECODE_ARGS;
+	}
+
+	/* Receivers */
+	for (i = 0; i < b.clients; i++) {
+		socklen_t len = sizeof(b.rx_addr[i]);
+		int rcvbuf = 4 * 1024 * 1024;
+
+		b.rx_fd[i] = socket(AF_INET, SOCK_DGRAM, 0);
+		memset(&b.rx_addr[i], 0, sizeof(b.rx_addr[i]));
+		b.rx_addr[i].sin_family = AF_INET;
+		b.rx_addr[i].sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		setsockopt(b.rx_fd[i], SOL_SOCKET, SO_RCVBUF, &rcvbuf,
+			   sizeof(rcvbuf));
+		if (b.rx_fd[i] < 0 ||
+		    bind(b.rx_fd[i], (struct sockaddr *) &b.rx_addr[i],
+			 sizeof(b.rx_addr[i])) < 0 ||
+		    getsockname(b.rx_fd[i], (struct sockaddr *) &b.rx_addr[i],
+				&len) < 0) {
+			perror("receiver socket");
+			return -ECODE_PIPE;
+		}
+	}
+
+	/* Sender */
+	tx_fd = socket(AF_INET, SOCK_DGRAM, 0);
+	if (tx_fd < 0) {
+		perror("sender socket");
+		return -ECODE_PIPE;
+	}
+
+	if (pthread_create(&rx, NULL, rx_thread, &b)) {
+		fprintf(stderr, "Could not create receiver thread\n");
+		return -ECODE_PIPE;
+	}
+
+	printf("%d clients, %d x %d byte packets per frame, %ds per mode\n",
+	       b.clients, b.pkts, b.pkt_size, b.seconds);
+	run_mode(&b, tx_fd, UDP_BATCH_NONE);
+	run_mode(&b, tx_fd, UDP_BATCH_MMSG);
+	run_mode(&b, tx_fd, UDP_BATCH_GSO);
+
+	b.running = 0;
+	pthread_join(rx, NULL);
+
+	close(tx_fd);
+	for (i = 0; i < b.clients; i++)
+		close(b.rx_fd[i]);
+
+	return ECODE_OKAY;
+}
+
+/* udp-batch-bench.c ends here */
@@ -0,0 +1,252 @@
+/**
+ * Filename: udp-batch.c
+ * Description: Batched UDP transmission (sendmmsg / UDP_SEGMENT GSO)
+ * Created: Mon Oct 12 10:02:14 2026 (-0700)
+ * Version: 1.0
+ *
+ * Compatibility: Linux >= 3.0 (sendmmsg), Linux >= 4.18 (UDP_SEGMENT)
+ */
+
+/**
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE		/* sendmmsg */
+#endif
+
+#include <udp-batch.h>
+
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <netinet/in.h>
+
+/* Older toolchains (e.g. poky 1.8) don't know about UDP GSO */
+#ifndef SOL_UDP
+#define SOL_UDP 17
+#endif
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+
+/* Largest UDP payload the kernel will segment in one go */
+#define GSO_MAX_BYTES 65000
+
+/**
+ * udp_batch_gso_supported
+ * Probe whether the running kernel accepts UDP_SEGMENT on this socket
+ */
+int udp_batch_gso_supported(int fd)
+{
+	int val = 0;
+
+	return setsockopt(fd, SOL_UDP, UDP_SEGMENT, &val, sizeof(val)) == 0;
+}
+
+void udp_batch_init(struct udp_batch *b, int fd, enum udp_batch_mode mode)
+{
+	memset(b, 0, sizeof(*b));
+	b->fd = fd;
+	b->mode = mode;
+	b->gso = (mode == UDP_BATCH_GSO) ? udp_batch_gso_supported(fd) : 0;
+}
+
+const char *udp_batch_mode_str(enum udp_batch_mode mode)
+{
+	switch (mode) {
+	case UDP_BATCH_NONE:
+		return "unbatched";
+	case UDP_BATCH_MMSG:
+		return "sendmmsg";
+	case UDP_BATCH_GSO:
+		return "gso";
+	}
+
+	return "unknown";
+}
+
+/**
+ * udp_batch_add
+ * Queue a packet for 'dst'. The data must stay valid until the next flush.
+ * Flushes automatically when the queue is full.
+ */
+int udp_batch_add(struct udp_batch *b, const struct sockaddr *dst,
+		  socklen_t dst_len, void *data, size_t len)
+{
+	int ret = 0;
+
+	if (b->count == UDP_BATCH_MAX)
+		ret = udp_batch_flush(b, dst, dst_len);
+
+	b->iov[b->count].iov_base = data;
+	b->iov[b->count].iov_len = len;
+	b->count++;
+
+	return ret;
+}
+
+static int send_single(struct udp_batch *b, unsigned int i,
+		       const struct sockaddr *dst, socklen_t dst_len)
+{
+	b->syscalls++;
+	if (sendto(b->fd, b->iov[i].iov_base, b->iov[i].iov_len, 0,
+		   dst, dst_len) < 0)
+		return -1;
+
+	b->packets++;
+	return 0;
+}
+
+static int send_mmsg(struct udp_batch *b, unsigned int first,
+		     unsigned int n, const struct sockaddr *dst,
+		     socklen_t dst_len)
+{
+	unsigned int i;
+
+	for (i = 0; i < n; i++) {
+		struct msghdr *m = &b->msgs[i].msg_hdr;
+
+		memset(m, 0, sizeof(*m));
+		m->msg_name = (void *) dst;
+		m->msg_namelen = dst_len;
+		m->msg_iov = &b->iov[first + i];
+		m->msg_iovlen = 1;
+	}
+
+	i = 0;
+	while (i < n) {
+		int ret;
+
+		b->syscalls++;
+		ret = sendmmsg(b->fd, &b->msgs[i], n - i, 0);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		b->packets += ret;
+		i += ret;
+	}
+
+	return 0;
+}
+
+/**
+ * send_gso
+ * Hand 'n' packets of 'seg' bytes (the last one may be shorter) to the
+ * kernel as a single super-packet. The kernel splits it back into 'n'
+ * datagrams, so the wire format is identical to sending them one by one.
+ */
+static int send_gso(struct udp_batch *b, unsigned int first, unsigned int n,
+		    uint16_t seg, const struct sockaddr *dst,
+		    socklen_t dst_len)
+{
+	char ctrl[CMSG_SPACE(sizeof(uint16_t))];
+	struct msghdr m;
+	struct cmsghdr *cm;
+
+	memset(&m, 0, sizeof(m));
+	memset(ctrl, 0, sizeof(ctrl));
+	m.msg_name = (void *) dst;
+	m.msg_namelen = dst_len;
+	m.msg_iov = &b->iov[first];
+	m.msg_iovlen = n;
+	m.msg_control = ctrl;
+	m.msg_controllen = sizeof(ctrl);
+
+	cm = CMSG_FIRSTHDR(&m);
+	cm->cmsg_level = SOL_UDP;
+	cm->cmsg_type = UDP_SEGMENT;
+	cm->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+	memcpy(CMSG_DATA(cm), &seg, sizeof(seg));
+
+	b->syscalls++;
+	if (sendmsg(b->fd, &m, 0) < 0) {
+		/* Not every device/route can segment, stop trying */
+		if (errno == EIO || errno == EINVAL) {
+			b->gso = 0;
+			b->syscalls--;
+			return send_mmsg(b, first, n, dst, dst_len);
+		}
+		return -1;
+	}
+
+	b->packets += n;
+	return 0;
+}
+
+/**
+ * udp_batch_flush
+ * Send every queued packet to 'dst'. The queue is emptied even on error;
+ * UDP is lossy anyway and stalling the caller is worse.
+ */
+int udp_batch_flush(struct udp_batch *b, const struct sockaddr *dst,
+		    socklen_t dst_len)
+{
+	unsigned int i = 0;
+	int ret = 0;
+
+	if (b->count == 0)
+		return 0;
+
+	switch (b->mode) {
+	case UDP_BATCH_NONE:
+		for (i = 0; i < b->count; i++)
+			if (send_single(b, i, dst, dst_len) < 0)
+				ret = -1;
+		break;
+	case UDP_BATCH_GSO:
+		if (b->gso) {
+			while (i < b->count && ret == 0) {
+				size_t seg = b->iov[i].iov_len;
+				size_t total = seg;
+				unsigned int n = 1;
+
+				/* Collect a run of equally sized packets */
+				while (i + n < b->count &&
+				       n < UDP_BATCH_GSO_MAX_SEGS &&
+				       total + b->iov[i + n].iov_len <=
+				       GSO_MAX_BYTES &&
+				       b->iov[i + n].iov_len <= seg) {
+					total += b->iov[i + n].iov_len;
+					n++;
+					/* A short one can only end the run */
+					if (b->iov[i + n - 1].iov_len < seg)
+						break;
+				}
+
+				if (n > 1 && b->gso)
+					ret = send_gso(b, i, n, seg, dst,
+						       dst_len);
+				else if (n > 1)
+					ret = send_mmsg(b, i, n, dst, dst_len);
+				else
+					ret = send_single(b, i, dst, dst_len);
+				i += n;
+			}
+			break;
+		}
+		/* fall through */
+	case UDP_BATCH_MMSG:
+		ret = send_mmsg(b, i, b->count - i, dst, dst_len);
+		break;
+	}
+
+	b->count = 0;
+	return ret;
+}
+
+/* udp-batch.c ends here */
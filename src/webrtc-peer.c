@@ -0,0 +1,609 @@
+/**
+ * Filename: webrtc-peer.c
+ * Description: Headless WebRTC viewer of gst-variable-rtsp-server --webrtc
+ * Created: Sat Oct 24 15:08:43 2026 (-0700)
+ * Version: 1.0
+ */
+
+/**
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/**
+ * Does what a browser would: offers to receive H.264, POSTs the offer to
+ * the server's signalling endpoint, applies the answer and depayloads
+ * what arrives into a fakesink. Reports how long the first frame took,
+ * frames per interval, capture to receive latency when the server sends
+ * --capture-time, and with --pli how long a PLI takes to bring a key
+ * frame back. Hangs up with a DELETE on Ctrl-C. Over loopback it needs
+ * no STUN server and no clock sync.
+ */
+
+#ifndef VERSION
+#define VERSION "1.0"
+#endif
+
+#define GST_USE_UNSTABLE_API	/* gst/webrtc */
+
+#include <capture-ext.h>
+#include <ecode.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <signal.h>
+#include <time.h>
+
+#include <gst/gst.h>
+#include <gst/rtp/gstrtpbuffer.h>
+#include <gst/sdp/sdp.h>
+#include <gst/video/video.h>
+#include <gst/webrtc/webrtc.h>
+#include <gio/gio.h>
+#include <glib.h>
+#include <glib-unix.h>
+
+#define DEFAULT_URL      "http://127.0.0.1:8080/webrtc"
+#define DEFAULT_INTERVAL "1"
+#define DEFAULT_PLI      "0"
+
+/* Longest (us) to wait for ICE gathering of the offer */
+#define PEER_GATHER_US (5 * G_USEC_PER_SEC)
+
+#define PEER_CAPS							\
+	"application/x-rtp,media=video,encoding-name=H264,payload=96,"	\
+	"clock-rate=90000,rtcp-fb-nack-pli=true,rtcp-fb-ccm-fir=true,"	\
+	"extmap-" G_STRINGIFY(CAPTURE_EXT_ID) "=" CAPTURE_EXT_URI
+
+struct peer_info {
+	GMainLoop *main_loop;
+	GstElement *pipeline;
+	GstElement *bin;	/* webrtcbin */
+	GstPad *depay_sink;	/* Where PLIs are sent from */
+
+	GMutex lock;		/* Everything below */
+	GCond gathered;
+	gboolean complete;	/* ICE gathering done */
+	gint64 start;		/* Monotonic time of the POST */
+	gint64 first;		/* Of the first frame, 0 = none yet */
+	guint8 ext_id;		/* Announced extension id, 0 = none (yet) */
+	GArray *samples;	/* Latencies (ms) since the last report */
+	gint frames;		/* Since the last report */
+	gint keys;
+	gint64 pli_sent;	/* Monotonic time of the last PLI, 0 = none */
+	GArray *responses;	/* PLI to key frame (ms), since the last report */
+};
+
+static gint cmp_double(gconstpointer a, gconstpointer b)
+{
+	gdouble x = *(const gdouble *) a, y = *(const gdouble *) b;
+
+	return (x > y) - (x < y);
+}
+
+static gboolean report_handler(struct peer_info *pi)
+{
+	GArray *s = pi->samples, *r = pi->responses;
+	gdouble sum = 0, *v;
+	gchar ts[16];
+	time_t t = time(NULL);
+	guint i;
+
+	strftime(ts, sizeof(ts), "%H:%M:%S", localtime(&t));
+
+	g_mutex_lock(&pi->lock);
+	g_print("%s frames %3d keys %2d", ts, pi->frames, pi->keys);
+	if (s->len) {
+		g_array_sort(s, cmp_double);
+		v = (gdouble *) s->data;
+		for (i = 0; i < s->len; i++)
+			sum += v[i];
+		g_print(" latency ms min %7.1f avg %7.1f p50 %7.1f max %7.1f",
+			v[0], sum / s->len, v[s->len / 2], v[s->len - 1]);
+	}
+	for (i = 0; i < r->len; i++)
+		g_print(" pli->key ms %.1f", g_array_index(r, gdouble, i));
+	g_print("\n");
+
+	g_array_set_size(s, 0);
+	g_array_set_size(r, 0);
+	pi->frames = 0;
+	pi->keys = 0;
+	g_mutex_unlock(&pi->lock);
+
+	return TRUE;
+}
+
+/**
+ * pli_handler
+ * What a browser sends when it loses a reference frame
+ */
+static gboolean pli_handler(struct peer_info *pi)
+{
+	GstEvent *event;
+
+	g_mutex_lock(&pi->lock);
+	if (!pi->depay_sink || pi->pli_sent) {
+		/* Not playing yet, or the last one isn't answered */
+		g_mutex_unlock(&pi->lock);
+		return TRUE;
+	}
+	pi->pli_sent = g_get_monotonic_time();
+	g_mutex_unlock(&pi->lock);
+
+	event = gst_video_event_new_upstream_force_key_unit(GST_CLOCK_TIME_NONE,
+							    FALSE, 0);
+	gst_pad_push_event(pi->depay_sink, event);
+
+	return TRUE;
+}
+
+/**
+ * frame_probe
+ * Frames out of the depayloader, key frames answer PLIs
+ */
+static GstPadProbeReturn frame_probe(GstPad *pad, GstPadProbeInfo *info,
+				     struct peer_info *pi)
+{
+	GstBuffer *buf = GST_PAD_PROBE_INFO_BUFFER(info);
+	gint64 now = g_get_monotonic_time();
+	gdouble ms;
+
+	g_mutex_lock(&pi->lock);
+	if (!pi->first) {
+		pi->first = now;
+		g_print("First frame %.1fms after the offer\n",
+			(now - pi->start) / 1000.0);
+	}
+	pi->frames++;
+	if (!GST_BUFFER_FLAG_IS_SET(buf, GST_BUFFER_FLAG_DELTA_UNIT)) {
+		pi->keys++;
+		if (pi->pli_sent) {
+			ms = (now - pi->pli_sent) / 1000.0;
+			g_array_append_val(pi->responses, ms);
+			pi->pli_sent = 0;
+		}
+	}
+	g_mutex_unlock(&pi->lock);
+
+	return GST_PAD_PROBE_OK;
+}
+
+/**
+ * rtp_probe
+ * Capture time from the last packet of each frame, as it reaches the
+ * depayloader
+ */
+static GstPadProbeReturn rtp_probe(GstPad *pad, GstPadProbeInfo *info,
+				   struct peer_info *pi)
+{
+	GstRTPBuffer rtp = GST_RTP_BUFFER_INIT;
+	GstBuffer *buf;
+	gboolean marker = FALSE;
+	gint64 cap;
+	gdouble ms;
+
+	g_mutex_lock(&pi->lock);
+	if (info->type & GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM) {
+		GstEvent *event = GST_PAD_PROBE_INFO_EVENT(info);
+		GstCaps *caps;
+
+		if (GST_EVENT_TYPE(event) == GST_EVENT_CAPS) {
+			gst_event_parse_caps(event, &caps);
+			pi->ext_id = capture_ext_find_id(caps);
+		}
+		g_mutex_unlock(&pi->lock);
+		return GST_PAD_PROBE_OK;
+	}
+
+	buf = GST_PAD_PROBE_INFO_BUFFER(info);
+	if (pi->ext_id && gst_rtp_buffer_map(buf, GST_MAP_READ, &rtp)) {
+		marker = gst_rtp_buffer_get_marker(&rtp);
+		gst_rtp_buffer_unmap(&rtp);
+	}
+	if (marker && capture_ext_read(buf, pi->ext_id, &cap)) {
+		ms = (g_get_real_time() - cap) / 1000.0;
+		g_array_append_val(pi->samples, ms);
+	}
+	g_mutex_unlock(&pi->lock);
+
+	return GST_PAD_PROBE_OK;
+}
+
+static void pad_added(GstElement *bin, GstPad *pad, struct peer_info *pi)
+{
+	GstElement *depay, *sink;
+	GstPad *sinkpad, *srcpad;
+
+	if (GST_PAD_DIRECTION(pad) != GST_PAD_SRC)
+		return;
+
+	depay = gst_element_factory_make("rtph264depay", NULL);
+	sink = gst_element_factory_make("fakesink", NULL);
+	g_object_set(sink, "sync", FALSE, NULL);
+	gst_bin_add_many(GST_BIN(pi->pipeline), depay, sink, NULL);
+	gst_element_link(depay, sink);
+	gst_element_sync_state_with_parent(depay);
+	gst_element_sync_state_with_parent(sink);
+
+	sinkpad = gst_element_get_static_pad(depay, "sink");
+	gst_pad_add_probe(sinkpad, GST_PAD_PROBE_TYPE_BUFFER |
+			  GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM,
+			  (GstPadProbeCallback) rtp_probe, pi, NULL);
+	srcpad = gst_element_get_static_pad(depay, "src");
+	gst_pad_add_probe(srcpad, GST_PAD_PROBE_TYPE_BUFFER,
+			  (GstPadProbeCallback) frame_probe, pi, NULL);
+	gst_object_unref(srcpad);
+	gst_pad_link(pad, sinkpad);
+
+	g_mutex_lock(&pi->lock);
+	pi->depay_sink = sinkpad;
+	g_mutex_unlock(&pi->lock);
+}
+
+static void gathering_changed(GstElement *bin, GParamSpec *pspec,
+			      struct peer_info *pi)
+{
+	GstWebRTCICEGatheringState state;
+
+	g_object_get(bin, "ice-gathering-state", &state, NULL);
+	if (state != GST_WEBRTC_ICE_GATHERING_STATE_COMPLETE)
+		return;
+
+	g_mutex_lock(&pi->lock);
+	pi->complete = TRUE;
+	g_cond_broadcast(&pi->gathered);
+	g_mutex_unlock(&pi->lock);
+}
+
+/**
+ * make_offer
+ * A recvonly H.264 offer with every candidate in it. Free with g_free().
+ */
+static gchar *make_offer(struct peer_info *pi)
+{
+	GstWebRTCSessionDescription *desc = NULL;
+	GstWebRTCRTPTransceiver *trans = NULL;
+	const GstStructure *reply;
+	GstPromise *promise;
+	GstCaps *caps;
+	gchar *sdp;
+	gint64 deadline = g_get_monotonic_time() + PEER_GATHER_US;
+
+	caps = gst_caps_from_string(PEER_CAPS);
+	g_signal_emit_by_name(pi->bin, "add-transceiver",
+			      GST_WEBRTC_RTP_TRANSCEIVER_DIRECTION_RECVONLY,
+			      caps, &trans);
+	gst_caps_unref(caps);
+	if (trans)
+		gst_object_unref(trans);
+
+	promise = gst_promise_new();
+	g_signal_emit_by_name(pi->bin, "create-offer", NULL, promise);
+	if (gst_promise_wait(promise) != GST_PROMISE_RESULT_REPLIED) {
+		gst_promise_unref(promise);
+		return NULL;
+	}
+	reply = gst_promise_get_reply(promise);
+	gst_structure_get(reply, "offer",
+			  GST_TYPE_WEBRTC_SESSION_DESCRIPTION, &desc, NULL);
+	gst_promise_unref(promise);
+	if (!desc)
+		return NULL;
+
+	g_signal_emit_by_name(pi->bin, "set-local-description", desc, NULL);
+	gst_webrtc_session_description_free(desc);
+
+	/* No trickle ICE, the offer must carry the candidates */
+	g_mutex_lock(&pi->lock);
+	while (!pi->complete)
+		if (!g_cond_wait_until(&pi->gathered, &pi->lock, deadline))
+			break;
+	g_mutex_unlock(&pi->lock);
+
+	g_object_get(pi->bin, "local-description", &desc, NULL);
+	if (!desc)
+		return NULL;
+	sdp = gst_sdp_message_as_text(desc->sdp);
+	gst_webrtc_session_description_free(desc);
+
+	return sdp;
+}
+
+/**
+ * http_exchange
+ * One HTTP/1.0 request to 'url', 'path' replacing its path if not NULL.
+ * Returns the status, 0 if there was no answer, and the body and
+ * Location header when asked for. Free them with g_free().
+ */
+static gint http_exchange(const gchar *url, const gchar *method,
+			  const gchar *path, const gchar *body,
+			  gchar **reply, gchar **location)
+{
+	GSocketClient *client = g_socket_client_new();
+	GSocketConnection *conn;
+	GByteArray *in = g_byte_array_new();
+	const gchar *host, *sep, *hdr_end, *loc;
+	gchar *host_port, *req, buf[4096];
+	gssize n;
+	gint status = 0;
+
+	if (reply)
+		*reply = NULL;
+	if (location)
+		*location = NULL;
+
+	/* http://host:port/path */
+	host = strstr(url, "://");
+	host = (host) ? host + 3 : url;
+	sep = strchr(host, '/');
+	host_port = (sep) ? g_strndup(host, sep - host) : g_strdup(host);
+	if (!path)
+		path = (sep) ? sep : "/";
+
+	conn = g_socket_client_connect_to_host(client, host_port, 80, NULL,
+					       NULL);
+	if (!conn)
+		goto out;
+
+	req = g_strdup_printf("%s %s HTTP/1.0\r\n"
+			      "Host: %s\r\n"
+			      "Content-Type: application/sdp\r\n"
+			      "Content-Length: %" G_GSIZE_FORMAT "\r\n\r\n%s",
+			      method, path, host_port,
+			      (body) ? strlen(body) : 0, (body) ? body : "");
+	if (g_output_stream_write_all(g_io_stream_get_output_stream(
+					      G_IO_STREAM(conn)),
+				      req, strlen(req), NULL, NULL, NULL)) {
+		/* The server closes the connection after the response */
+		while ((n = g_input_stream_read(g_io_stream_get_input_stream(
+							G_IO_STREAM(conn)),
+						buf, sizeof(buf), NULL,
+						NULL)) > 0)
+			g_byte_array_append(in, (guint8 *) buf, n);
+	}
+	g_free(req);
+	g_object_unref(conn);
+
+	g_byte_array_append(in, (guint8 *) "", 1);
+	if (sscanf((gchar *) in->data, "HTTP/%*s %d", &status) != 1)
+		goto out;
+
+	hdr_end = strstr((gchar *) in->data, "\r\n\r\n");
+	if (reply && hdr_end)
+		*reply = g_strdup(hdr_end + 4);
+	loc = g_strstr_len((gchar *) in->data,
+			   (hdr_end) ? hdr_end - (gchar *) in->data : -1,
+			   "\r\nLocation: ");
+	if (location && loc)
+		*location = g_strndup(loc + 12, strcspn(loc + 12, "\r\n"));
+
+out:
+	g_byte_array_unref(in);
+	g_free(host_port);
+	g_object_unref(client);
+
+	return status;
+}
+
+static gboolean set_answer(struct peer_info *pi, const gchar *text)
+{
+	GstWebRTCSessionDescription *desc;
+	GstSDPMessage *sdp;
+
+	if (gst_sdp_message_new_from_text(text, &sdp) != GST_SDP_OK)
+		return FALSE;
+	desc = gst_webrtc_session_description_new(GST_WEBRTC_SDP_TYPE_ANSWER,
+						  sdp);
+	g_signal_emit_by_name(pi->bin, "set-remote-description", desc, NULL);
+	gst_webrtc_session_description_free(desc);
+
+	return TRUE;
+}
+
+static gboolean bus_handler(GstBus *bus, GstMessage *msg,
+			    struct peer_info *pi)
+{
+	GError *err = NULL;
+	gchar *dbg_info = NULL;
+
+	switch (GST_MESSAGE_TYPE(msg)) {
+	case GST_MESSAGE_ERROR:
+		gst_message_parse_error(msg, &err, &dbg_info);
+		g_printerr("Error: %s\n", err->message);
+		g_error_free(err);
+		g_free(dbg_info);
+		g_main_loop_quit(pi->main_loop);
+		break;
+	case GST_MESSAGE_EOS:
+		g_main_loop_quit(pi->main_loop);
+		break;
+	default:
+		break;
+	}
+
+	return TRUE;
+}
+
+static gboolean sigint_handler(struct peer_info *pi)
+{
+	g_main_loop_quit(pi->main_loop);
+
+	return TRUE;
+}
+
+int main(int argc, char *argv[])
+{
+	struct peer_info pi = { .ext_id = 0 };
+	char *url = (char *) DEFAULT_URL;
+	char *stun = NULL;
+	int interval = atoi(DEFAULT_INTERVAL);
+	int pli = atoi(DEFAULT_PLI);
+	gchar *offer, *answer, *location;
+	GstBus *bus;
+	GError *err = NULL;
+	gint status;
+	int ret = ECODE_OKAY;
+
+	const struct option long_opts[] = {
+		{"help",      no_argument,       0, '?'},
+		{"version",   no_argument,       0, 'v'},
+		{"url",       required_argument, 0, 'u'},
+		{"stun",      required_argument, 0, 's'},
+		{"interval",  required_argument, 0, 'i'},
+		{"pli",       required_argument, 0, 'p'},
+		{ /* Sentinel */ }
+	};
+	char *arg_parse = "?hvu:s:i:p:";
+	const char *usage =
+		"Usage: webrtc-peer [OPTIONS]\n\n"
+		"Views gst-variable-rtsp-server --webrtc without a browser\n"
+		"and reports time to first frame, frames per interval and,\n"
+		"with --capture-time, capture to receive latency.\n\n"
+		"Options:\n"
+		" --help,     -? - This usage\n"
+		" --version,  -v - Program Version: " VERSION "\n"
+		" --url,      -u - Signalling endpoint to POST the offer to\n"
+		"                  (default: " DEFAULT_URL ")\n"
+		" --stun,     -s - STUN server, stun://host:port"
+		" (default: none)\n"
+		" --interval, -i - Seconds between reports"
+		" (default: " DEFAULT_INTERVAL ")\n"
+		" --pli,      -p - Send a PLI every n seconds and report the\n"
+		"                  key frame response, 0 = never"
+		" (default: " DEFAULT_PLI ")\n"
+		;
+
+	gst_init(&argc, &argv);
+
+	while (1) {
+		int opt_ndx;
+		int c = getopt_long(argc, argv, arg_parse, long_opts, &opt_ndx);
+
+		if (c < 0)
+			break;
+
+		switch (c) {
+		case 'h': /* Help */
+		case '?':
+			puts(usage);
+			return ECODE_OKAY;
+		case 'v': /* Version */
+			puts("Program Version: " VERSION);
+			return ECODE_OKAY;
+		case 'u':
+			url = optarg;
+			break;
+		case 's':
+			stun = optarg;
+			break;
+		case 'i':
+			interval = atoi(optarg);
+			break;
+		case 'p':
+			pli = atoi(optarg);
+			break;
+		default: /* Default - bad arg */
+			puts(usage);
+			return -ECODE_ARGS;
+		}
+	}
+
+	if (interval < 1 || pli < 0) {
+		g_printerr("Invalid arguments\n");
+		return -ECODE_ARGS;
+	}
+
+	pi.pipeline = gst_parse_launch("webrtcbin name=wrtc0"
+				       " bundle-policy=max-bundle", &err);
+	if (!pi.pipeline) {
+		g_printerr("Could not create pipeline: %s\n",
+			   (err) ? err->message : "unknown");
+		return -ECODE_PIPE;
+	}
+	pi.bin = gst_bin_get_by_name(GST_BIN(pi.pipeline), "wrtc0");
+	if (stun)
+		g_object_set(pi.bin, "stun-server", stun, NULL);
+	pi.samples = g_array_new(FALSE, FALSE, sizeof(gdouble));
+	pi.responses = g_array_new(FALSE, FALSE, sizeof(gdouble));
+	g_mutex_init(&pi.lock);
+	g_cond_init(&pi.gathered);
+	g_signal_connect(pi.bin, "pad-added", G_CALLBACK(pad_added), &pi);
+	g_signal_connect(pi.bin, "notify::ice-gathering-state",
+			 G_CALLBACK(gathering_changed), &pi);
+
+	pi.main_loop = g_main_loop_new(NULL, FALSE);
+	bus = gst_element_get_bus(pi.pipeline);
+	gst_bus_add_watch(bus, (GstBusFunc) bus_handler, &pi);
+	gst_object_unref(bus);
+
+	if (gst_element_set_state(pi.pipeline, GST_STATE_PLAYING) ==
+	    GST_STATE_CHANGE_FAILURE) {
+		g_printerr("Unable to start webrtcbin\n");
+		return -ECODE_PLAY;
+	}
+
+	offer = make_offer(&pi);
+	if (!offer) {
+		g_printerr("Could not create an offer\n");
+		ret = -ECODE_ELEM;
+		goto out;
+	}
+
+	pi.start = g_get_monotonic_time();
+	status = http_exchange(url, "POST", NULL, offer, &answer, &location);
+	g_free(offer);
+	if (status != 201 || !answer || !set_answer(&pi, answer)) {
+		g_printerr("No answer from %s: %d %s", url, status,
+			   (answer) ? answer : "\n");
+		g_free(answer);
+		g_free(location);
+		ret = -ECODE_PLAY;
+		goto out;
+	}
+	g_free(answer);
+	g_print("Answered in %.1fms, viewing %s\n",
+		(g_get_monotonic_time() - pi.start) / 1000.0,
+		(location) ? location : url);
+
+	g_timeout_add_seconds(interval, (GSourceFunc) report_handler, &pi);
+	if (pli)
+		g_timeout_add_seconds(pli, (GSourceFunc) pli_handler, &pi);
+	g_unix_signal_add(SIGINT, (GSourceFunc) sigint_handler, &pi);
+	g_main_loop_run(pi.main_loop);
+
+	/* Hang up, or the server waits for the connection to time out */
+	if (location) {
+		status = http_exchange(url, "DELETE", location, NULL, NULL,
+				       NULL);
+		g_print("Hung up: %d\n", status);
+		g_free(location);
+	}
+
+out:
+	gst_element_set_state(pi.pipeline, GST_STATE_NULL);
+	if (pi.depay_sink)
+		gst_object_unref(pi.depay_sink);
+	gst_object_unref(pi.bin);
+	gst_object_unref(pi.pipeline);
+	g_main_loop_unref(pi.main_loop);
+	g_array_free(pi.samples, TRUE);
+	g_array_free(pi.responses, TRUE);
+
+	return ret;
+}
+
+/* webrtc-peer.c ends here */
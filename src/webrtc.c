@@ -0,0 +1,518 @@
+/**
+ * Filename: webrtc.c
+ * Description: WebRTC viewers of the encoded stream
+ * Created: Sat Oct 24 09:41:06 2026 (-0700)
+ * Version: 1.0
+ */
+
+/**
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/**
+ * Every peer gets a small pipeline of its own, appsrc ! rtph264pay !
+ * webrtcbin, so ICE, DTLS and SRTP of one never hold up another or the
+ * live pipeline. A probe on enc0's src pad hands each connected peer a
+ * copy of every access unit that shares its memory, nothing is encoded
+ * again. The encoder's timestamps are kept, moved by a fixed offset so
+ * the first frame a peer gets plays at once. A peer whose appsrc backs
+ * up skips to the next key frame.
+ *
+ * Signalling is a single HTTP exchange in the manner of WHEP: the viewer
+ * POSTs its offer, the answer goes back once ICE gathering is done so it
+ * carries every candidate, and a DELETE of the resource it names hangs
+ * up. Without trickle ICE there is nothing else to exchange. Peers still
+ * gathering count towards the limit, so no more than that many HTTP
+ * threads ever wait on it.
+ *
+ * A PLI or FIR from a viewer reaches its payloader as an upstream
+ * force-key-unit event. It is dropped there and turned into a key frame
+ * request to the caller, which shares the encoder with everyone else and
+ * decides when to force one. A peer that connects asks the same way.
+ */
+
+#define GST_USE_UNSTABLE_API	/* gst/webrtc */
+
+#include <capture-ext.h>
+#include <webrtc.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <gst/app/gstappsrc.h>
+#include <gst/sdp/sdp.h>
+#include <gst/video/video.h>
+#include <gst/webrtc/webrtc.h>
+
+#define WEBRTC_PIPELINE							\
+	"appsrc name=wsrc0 is-live=true format=time block=false !"	\
+	" rtph264pay name=wpay0 pt=96 config-interval=-1"		\
+	" mtu=%d ! application/x-rtp,media=video,encoding-name=H264,"	\
+	"payload=96,clock-rate=90000,rtcp-fb-nack-pli=true,"		\
+	"rtcp-fb-ccm-fir=true ! webrtcbin name=wrtc0"			\
+	" bundle-policy=max-bundle%s%s"
+
+/* Running time of 'e', GST_CLOCK_TIME_NONE until its pipeline plays */
+static GstClockTime running_time(GstElement *e)
+{
+	GstClock *clock = gst_element_get_clock(e);
+	GstClockTime now, base;
+
+	if (!clock)
+		return GST_CLOCK_TIME_NONE;
+	now = gst_clock_get_time(clock);
+	base = gst_element_get_base_time(e);
+	gst_object_unref(clock);
+
+	return (now > base) ? now - base : 0;
+}
+
+/* enc0 time 't' in the peer's running time */
+static GstClockTime restamp(struct webrtc_peer *p, GstClockTime t)
+{
+	if (!GST_CLOCK_TIME_IS_VALID(t))
+		return GST_CLOCK_TIME_NONE;
+
+	return MAX((gint64) t + p->offset, 0);
+}
+
+static GstPadProbeReturn webrtc_probe(GstPad *pad, GstPadProbeInfo *info,
+				      struct webrtc *w)
+{
+	GstBuffer *buf = GST_PAD_PROBE_INFO_BUFFER(info);
+	gboolean key = !GST_BUFFER_FLAG_IS_SET(buf, GST_BUFFER_FLAG_DELTA_UNIT);
+	struct webrtc_peer *p;
+	GstClockTime start = GST_BUFFER_DTS_OR_PTS(buf);
+	GstClockTime run;
+	GstBuffer *copy;
+	GstCaps *caps;
+	GList *l;
+
+	caps = gst_pad_get_current_caps(pad);
+
+	g_mutex_lock(&w->lock);
+	if (caps && (!w->caps || !gst_caps_is_equal(caps, w->caps))) {
+		gst_caps_replace(&w->caps, caps);
+		for (l = w->peers; l; l = l->next) {
+			p = l->data;
+			gst_app_src_set_caps(GST_APP_SRC(p->src), caps);
+		}
+	}
+
+	for (l = w->peers; l; l = l->next) {
+		p = l->data;
+		if (!p->live || (p->need_key && !key))
+			continue;
+
+		if (gst_app_src_get_current_level_bytes(GST_APP_SRC(p->src)) >
+		    WEBRTC_QUEUE_MAX) {
+			g_atomic_int_inc(&w->dropped);
+			p->need_key = TRUE;
+			continue;
+		}
+
+		/* The first frame plays now, the others as enc0 spaced them */
+		if (!p->have_offset) {
+			run = running_time(p->src);
+			if (!GST_CLOCK_TIME_IS_VALID(run) ||
+			    !GST_CLOCK_TIME_IS_VALID(start))
+				continue;
+			p->offset = (gint64) run - (gint64) start;
+			p->have_offset = TRUE;
+		}
+		p->need_key = FALSE;
+
+		/* Shares the memory */
+		copy = gst_buffer_copy(buf);
+		GST_BUFFER_PTS(copy) = restamp(p, GST_BUFFER_PTS(buf));
+		GST_BUFFER_DTS(copy) = restamp(p, GST_BUFFER_DTS(buf));
+		gst_app_src_push_buffer(GST_APP_SRC(p->src), copy);
+		g_atomic_int_inc(&p->frames);
+	}
+	g_mutex_unlock(&w->lock);
+
+	if (caps)
+		gst_caps_unref(caps);
+
+	return GST_PAD_PROBE_OK;
+}
+
+/**
+ * key_probe
+ * A PLI/FIR from the viewer, on its way up from webrtcbin's RTP session
+ */
+static GstPadProbeReturn key_probe(GstPad *pad, GstPadProbeInfo *info,
+				   struct webrtc_peer *p)
+{
+	GstEvent *event = GST_PAD_PROBE_INFO_EVENT(info);
+
+	if (!gst_video_event_is_force_key_unit(event))
+		return GST_PAD_PROBE_OK;
+
+	g_atomic_int_inc(&p->key_requests);
+	g_atomic_int_inc(&p->w->key_requests);
+	p->w->key_fn(p->w->key_data);
+
+	return GST_PAD_PROBE_DROP;
+}
+
+static void state_changed(GstElement *bin, GParamSpec *pspec,
+			  struct webrtc_peer *p)
+{
+	struct webrtc *w = p->w;
+	GstWebRTCPeerConnectionState state;
+
+	g_object_get(bin, "connection-state", &state, NULL);
+
+	g_mutex_lock(&w->lock);
+	p->state = state;
+	p->since = g_get_monotonic_time();
+	if (state == GST_WEBRTC_PEER_CONNECTION_STATE_CONNECTED && !p->live) {
+		p->live = TRUE;
+		p->need_key = TRUE;
+	}
+	g_cond_broadcast(&w->changed);
+	g_mutex_unlock(&w->lock);
+
+	/* Nothing decodes until the next key frame */
+	if (state == GST_WEBRTC_PEER_CONNECTION_STATE_CONNECTED)
+		w->key_fn(w->key_data);
+}
+
+static void gathering_changed(GstElement *bin, GParamSpec *pspec,
+			      struct webrtc_peer *p)
+{
+	GstWebRTCICEGatheringState state;
+
+	g_object_get(bin, "ice-gathering-state", &state, NULL);
+	if (state != GST_WEBRTC_ICE_GATHERING_STATE_COMPLETE)
+		return;
+
+	g_mutex_lock(&p->w->lock);
+	p->gathered = TRUE;
+	g_cond_broadcast(&p->w->changed);
+	g_mutex_unlock(&p->w->lock);
+}
+
+static void peer_free(struct webrtc_peer *p)
+{
+	gst_element_set_state(p->pipe, GST_STATE_NULL);
+	gst_object_unref(p->src);
+	gst_object_unref(p->bin);
+	gst_object_unref(p->pipe);
+	g_free(p->remote);
+	g_free(p);
+}
+
+/* A peer's pipeline, playing but not fed until it connects */
+static struct webrtc_peer *peer_new(struct webrtc *w, const gchar *remote)
+{
+	struct webrtc_peer *p;
+	GstElement *pipe, *pay;
+	gchar *launch;
+	GstPad *pad;
+
+	launch = g_strdup_printf(WEBRTC_PIPELINE, (w->capture_ext) ?
+				 w->mtu - CAPTURE_EXT_BYTES : w->mtu,
+				 (w->stun) ? " stun-server=" : "",
+				 (w->stun) ? w->stun : "");
+	pipe = gst_parse_launch(launch, NULL);
+	g_free(launch);
+	if (!pipe)
+		return NULL;
+
+	p = g_new0(struct webrtc_peer, 1);
+	p->w = w;
+	p->remote = g_strdup(remote);
+	p->pipe = pipe;
+	p->src = gst_bin_get_by_name(GST_BIN(pipe), "wsrc0");
+	p->bin = gst_bin_get_by_name(GST_BIN(pipe), "wrtc0");
+	p->since = g_get_monotonic_time();
+
+	pay = gst_bin_get_by_name(GST_BIN(pipe), "wpay0");
+	pad = gst_element_get_static_pad(pay, "sink");
+	gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_EVENT_UPSTREAM,
+			  (GstPadProbeCallback) key_probe, p, NULL);
+	gst_object_unref(pad);
+	if (w->capture_ext)
+		capture_ext_attach(pay);
+	gst_object_unref(pay);
+
+	g_signal_connect(p->bin, "notify::connection-state",
+			 G_CALLBACK(state_changed), p);
+	g_signal_connect(p->bin, "notify::ice-gathering-state",
+			 G_CALLBACK(gathering_changed), p);
+
+	g_mutex_lock(&w->lock);
+	if (w->caps)
+		gst_app_src_set_caps(GST_APP_SRC(p->src), w->caps);
+	g_mutex_unlock(&w->lock);
+
+	if (gst_element_set_state(pipe, GST_STATE_PLAYING) ==
+	    GST_STATE_CHANGE_FAILURE) {
+		peer_free(p);
+		return NULL;
+	}
+
+	return p;
+}
+
+/* Emit 'signal' with 'desc' (may be NULL) and wait for its promise */
+static const GstStructure *promise_wait(GstElement *bin, const gchar *signal,
+					GstWebRTCSessionDescription *desc,
+					GstPromise **promise)
+{
+	*promise = gst_promise_new();
+	g_signal_emit_by_name(bin, signal, desc, *promise);
+	if (gst_promise_wait(*promise) != GST_PROMISE_RESULT_REPLIED)
+		return NULL;
+
+	return gst_promise_get_reply(*promise);
+}
+
+/**
+ * webrtc_new
+ * Up to 'max_peers' viewers. 'key_fn' is called from streaming threads
+ * when a viewer needs a key frame.
+ */
+struct webrtc *webrtc_new(const gchar *stun, guint max_peers,
+			  gboolean capture_ext, gint mtu, webrtc_key_fn key_fn,
+			  gpointer key_data)
+{
+	struct webrtc *w = g_new0(struct webrtc, 1);
+
+	w->stun = g_strdup(stun);
+	w->max_peers = max_peers;
+	w->capture_ext = capture_ext;
+	w->mtu = mtu;
+	w->key_fn = key_fn;
+	w->key_data = key_data;
+	g_mutex_init(&w->lock);
+	g_cond_init(&w->changed);
+
+	return w;
+}
+
+/**
+ * webrtc_attach
+ * Send the frames leaving encoder 'enc' to the peers
+ */
+gulong webrtc_attach(GstElement *enc, struct webrtc *w)
+{
+	GstPad *pad = gst_element_get_static_pad(enc, "src");
+	gulong id;
+
+	if (!pad)
+		return 0;
+
+	id = gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER,
+			       (GstPadProbeCallback) webrtc_probe, w, NULL);
+	gst_object_unref(pad);
+
+	return id;
+}
+
+/**
+ * webrtc_answer
+ * Answer SDP 'offer' from 'remote' with a new peer, once its candidates
+ * are gathered. NULL with an HTTP 'status' if it can't be: 400 for an
+ * offer that isn't one, 503 when there are max_peers already (counting
+ * those being answered), 504 when gathering found no candidate by
+ * WEBRTC_GATHER_US. Blocks, for an HTTP thread.
+ */
+gchar *webrtc_answer(struct webrtc *w, const gchar *offer,
+		     const gchar *remote, guint *id, gint *status)
+{
+	gint64 deadline = g_get_monotonic_time() + WEBRTC_GATHER_US;
+	GstWebRTCSessionDescription *desc, *answer = NULL;
+	const GstStructure *reply;
+	struct webrtc_peer *p;
+	GstPromise *promise;
+	GstSDPMessage *sdp;
+	gchar *text = NULL;
+
+	g_mutex_lock(&w->lock);
+	*status = (g_list_length(w->peers) + w->answering >= w->max_peers) ?
+		503 : 400;
+	if (*status != 503)
+		w->answering++;
+	g_mutex_unlock(&w->lock);
+	if (*status == 503)
+		return NULL;
+
+	gst_sdp_message_new(&sdp);
+	if (gst_sdp_message_parse_buffer((const guint8 *) offer, strlen(offer),
+					 sdp) != GST_SDP_OK ||
+	    !gst_sdp_message_medias_len(sdp)) {
+		gst_sdp_message_free(sdp);
+		goto out;
+	}
+
+	*status = 500;
+	p = peer_new(w, remote);
+	if (!p) {
+		gst_sdp_message_free(sdp);
+		goto out;
+	}
+
+	desc = gst_webrtc_session_description_new(GST_WEBRTC_SDP_TYPE_OFFER,
+						  sdp);
+	promise_wait(p->bin, "set-remote-description", desc, &promise);
+	gst_promise_unref(promise);
+	gst_webrtc_session_description_free(desc);
+
+	reply = promise_wait(p->bin, "create-answer", NULL, &promise);
+	if (reply)
+		gst_structure_get(reply, "answer",
+				  GST_TYPE_WEBRTC_SESSION_DESCRIPTION, &answer,
+				  NULL);
+	gst_promise_unref(promise);
+	if (!answer) {
+		*status = 400;
+		peer_free(p);
+		goto out;
+	}
+
+	promise_wait(p->bin, "set-local-description", answer, &promise);
+	gst_promise_unref(promise);
+	gst_webrtc_session_description_free(answer);
+
+	/* No trickle, the answer has to carry every candidate */
+	g_mutex_lock(&w->lock);
+	while (!p->gathered)
+		if (!g_cond_wait_until(&w->changed, &w->lock, deadline))
+			break;
+	g_mutex_unlock(&w->lock);
+
+	g_object_get(p->bin, "local-description", &answer, NULL);
+	text = gst_sdp_message_as_text(answer->sdp);
+	gst_webrtc_session_description_free(answer);
+
+	/* Nothing to connect to, the viewer can only time out */
+	if (!strstr(text, "a=candidate:")) {
+		g_free(text);
+		text = NULL;
+		*status = 504;
+		g_atomic_int_inc(&w->failed);
+		peer_free(p);
+		goto out;
+	}
+
+	g_mutex_lock(&w->lock);
+	p->id = ++w->next_id;
+	w->peers = g_list_append(w->peers, p);
+	g_mutex_unlock(&w->lock);
+
+	*id = p->id;
+	*status = 201;
+	g_atomic_int_inc(&w->signalled);
+
+out:
+	g_mutex_lock(&w->lock);
+	w->answering--;
+	g_mutex_unlock(&w->lock);
+
+	return text;
+}
+
+/**
+ * webrtc_close
+ * Hang up peer 'id'. FALSE if there is no such peer.
+ */
+gboolean webrtc_close(struct webrtc *w, guint id)
+{
+	struct webrtc_peer *p = NULL;
+	GList *l;
+
+	g_mutex_lock(&w->lock);
+	for (l = w->peers; l; l = l->next) {
+		if (((struct webrtc_peer *) l->data)->id == id) {
+			p = l->data;
+			w->peers = g_list_delete_link(w->peers, l);
+			break;
+		}
+	}
+	g_mutex_unlock(&w->lock);
+
+	if (!p)
+		return FALSE;
+
+	peer_free(p);
+
+	return TRUE;
+}
+
+/**
+ * webrtc_reap
+ * Hang up peers that failed, closed, or haven't (re)connected within
+ * WEBRTC_CONNECT_US. Returns how many.
+ */
+guint webrtc_reap(struct webrtc *w)
+{
+	gint64 now = g_get_monotonic_time();
+	GList *l, *next, *dead = NULL;
+	struct webrtc_peer *p;
+	guint n;
+
+	g_mutex_lock(&w->lock);
+	for (l = w->peers; l; l = next) {
+		next = l->next;
+		p = l->data;
+		switch (p->state) {
+		case GST_WEBRTC_PEER_CONNECTION_STATE_CONNECTED:
+			continue;
+		case GST_WEBRTC_PEER_CONNECTION_STATE_FAILED:
+		case GST_WEBRTC_PEER_CONNECTION_STATE_CLOSED:
+			break;
+		default:
+			if (now - p->since < WEBRTC_CONNECT_US)
+				continue;
+			break;
+		}
+		if (!p->live)
+			g_atomic_int_inc(&w->failed);
+		w->peers = g_list_remove_link(w->peers, l);
+		dead = g_list_concat(l, dead);
+	}
+	g_mutex_unlock(&w->lock);
+
+	n = g_list_length(dead);
+	g_list_free_full(dead, (GDestroyNotify) peer_free);
+
+	return n;
+}
+
+/**
+ * webrtc_peers
+ * Peers signalled, and how many of them are connected
+ */
+guint webrtc_peers(struct webrtc *w, guint *connected)
+{
+	GList *l;
+	guint n;
+
+	g_mutex_lock(&w->lock);
+	n = g_list_length(w->peers);
+	*connected = 0;
+	for (l = w->peers; l; l = l->next)
+		if (((struct webrtc_peer *) l->data)->state ==
+		    GST_WEBRTC_PEER_CONNECTION_STATE_CONNECTED)
+			(*connected)++;
+	g_mutex_unlock(&w->lock);
+
+	return n;
+}
+
+/* webrtc.c ends here */